@@ -7,11 +7,21 @@
             'target_name': 'gdbm_binding',
             'sources': [
                 'csrc/gdbm_wrapper.c',
+                'csrc/redo_log.c',
+                'csrc/mem_table.c',
+                'csrc/shm_table.c',
+                'csrc/handle_cache.c',
+                'csrc/json_value.c',
+                'csrc/predicate.c',
+                'csrc/key_index.c',
+                'csrc/snapshot_file.c',
                 'csrc/gdbm_binding.c',
             ],
             'link_settings': {
                 'libraries': [
-                    '-lgdbm'
+                    '-lgdbm',
+                    '-lpthread',
+                    '-lrt'
                 ],
             },
             'conditions': [
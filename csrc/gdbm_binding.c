@@ -16,6 +16,9 @@ limitations under the License.
 
 #include "gdbm_binding.h"
 #include "gdbm_wrapper.h"
+#include "handle_cache.h"
+#include "json_value.h"
+#include "predicate.h"
 #include <assert.h>
 #include <node_api.h>
 #include <stdio.h>
@@ -29,9 +32,14 @@ static napi_value clean_table(napi_env env, napi_callback_info info);
 
 // number countRecords(string name)
 static napi_value count_records(napi_env env, napi_callback_info info);
-// undefined insertRecord(string name, string key, uint8array content)
+// boolean insertRecord(string name, string key, uint8array|string content,
+//     { suffix: string, content: uint8array }[] siblings?)
 static napi_value insert_record(napi_env env, napi_callback_info info);
-// undefined removeRecord(string name, string key)
+// boolean[] insertRecords(string name, { key: string, content: uint8array,
+//     siblings?: { suffix: string, content: uint8array }[] }[] records)
+// Records are inserted one by one, not atomically.
+static napi_value insert_records(napi_env env, napi_callback_info info);
+// boolean removeRecord(string name, string key, string[] siblingSuffixes?)
 static napi_value remove_record(napi_env env, napi_callback_info info);
 
 // boolean hasKey(string name, string key)
@@ -39,127 +47,577 @@ static napi_value has_key(napi_env env, napi_callback_info info);
 
 // buffer getContent(string name, string key)
 static napi_value get_content(napi_env env, napi_callback_info info);
-// undefined updateContent(string name, string key, buffer content)
+// string|undefined getString(string name, string key)
+static napi_value get_string(napi_env env, napi_callback_info info);
+// (string|undefined)[] getStrings(string name, string[] keys, string suffix?)
+static napi_value get_strings(napi_env env, napi_callback_info info);
+// undefined updateContent(string name, string key, buffer|string content)
 static napi_value update_content(napi_env env, napi_callback_info info);
+// undefined upsert(string name, string key, buffer|string content)
+static napi_value upsert(napi_env env, napi_callback_info info);
+// boolean[] compareAndSwapRecords(string name, string[] keys,
+//     (string|undefined)[] expected, (uint8array|null)[] contents,
+//     boolean all?)
+// Each record is replaced only if its data is still `expected[i]`, or is
+// stored if it is missing as an undefined `expected[i]` says. A null
+// content removes the record. With `all`, either every record is swapped
+// as one unit, or none.
+static napi_value
+compare_and_swap_records(napi_env env, napi_callback_info info);
+// buffer|undefined replaceReturningOld(string name, string key,
+//     buffer|string content)
+static napi_value
+replace_returning_old(napi_env env, napi_callback_info info);
+// buffer|undefined deleteReturningValue(string name, string key,
+//     string[] siblingSuffixes?)
+static napi_value
+delete_returning_value(napi_env env, napi_callback_info info);
+
+// buffer|undefined getSibling(string name, string key, string suffix)
+static napi_value get_sibling(napi_env env, napi_callback_info info);
+// number readInto(string name, string key, uint8array target, number offset,
+//     string suffix?)
+static napi_value read_into(napi_env env, napi_callback_info info);
+// undefined setCopyThreshold(number bytes)
+static napi_value set_copy_threshold(napi_env env, napi_callback_info info);
+// undefined setFrozenSet(WeakSet set)
+static napi_value set_frozen_set(napi_env env, napi_callback_info info);
+// any getObject(string name, string key, string suffix?)
+static napi_value get_object(napi_env env, napi_callback_info info);
+// any[] getObjects(string name, string[] keys, string suffix?)
+static napi_value get_objects(napi_env env, napi_callback_info info);
+// undefined setSibling(string name, string key, string suffix,
+//     uint8array|null content)
+static napi_value set_sibling(napi_env env, napi_callback_info info);
+
+// number incr(string name, string key, number delta)
+static napi_value incr(napi_env env, napi_callback_info info);
+// (number|undefined)[] getCounters(string name, string[] keys)
+static napi_value get_counters(napi_env env, napi_callback_info info);
+
+// boolean commitBatch(string name, {
+//     type: "insert"|"update"|"upsert"|"remove"|"incr"|"discard",
+//     key: string, content?: uint8array, delta?: number
+// }[] ops)
+static napi_value commit_batch(napi_env env, napi_callback_info info);
+
+// Promise<{ entries: [string, ...any][], cursor: string|undefined }>
+// scan(string name, object|null predicate, string[] siblingSuffixes,
+//     number limit, number budget, string cursor?)
+static napi_value scan(napi_env env, napi_callback_info info);
+// Promise<{ keys: string[], cursor: string|undefined }>
+// scanKeys(string name, number limit, string cursor?)
+// Same as scan without a predicate, but no record is read.
+static napi_value scan_keys(napi_env env, napi_callback_info info);
+
+// Promise<{ records, siblings, keyBytes, valueBytes, keySizes: number[],
+//     valueSizes: number[], recordSizes: number[], multiBlockRecords,
+//     blockSize, directoryDepth, bucketSize, bucketCount, cacheSize,
+//     fileSize }> analyzeTable(string name)
+// Sizes are counted in power-of-two bins, see table_stats_t.
+static napi_value analyze_table(napi_env env, napi_callback_info info);
+// Promise<undefined> rebuildTable(string name, number blockSize)
+static napi_value rebuild_table(napi_env env, napi_callback_info info);
+// Promise<undefined> createTableAsync(string name, number blockSize)
+static napi_value create_table_async(napi_env env, napi_callback_info info);
+// Promise<number> preloadKeys(string name, string[] keys)
+// Resolves to the number of keys found.
+static napi_value preload_keys(napi_env env, napi_callback_info info);
+
+// undefined openKeyIndex(string name)
+static napi_value open_key_index(napi_env env, napi_callback_info info);
+// boolean closeKeyIndex(string name)
+static napi_value close_key_index(napi_env env, napi_callback_info info);
+// string[] queryKeys(string name,
+//     { prefix?: string, gt?: string, gte?: string, lt?: string,
+//       lte?: string } range, number limit)
+static napi_value query_keys(napi_env env, napi_callback_info info);
+
+// undefined openMemoryTable(string name, boolean syncWrites,
+//                           number sharedSize = 0)
+static napi_value open_memory_table(napi_env env, napi_callback_info info);
+// boolean closeMemoryTable(string name)
+static napi_value close_memory_table(napi_env env, napi_callback_info info);
+// boolean snapshotMemoryTable(string name)
+static napi_value snapshot_memory_table(napi_env env, napi_callback_info info);
+
+// undefined writeSnapshotFile(string path, string[] keys, string[] values)
+static napi_value write_snapshot_file(napi_env env, napi_callback_info info);
+// number openSnapshotFile(string path)
+static napi_value open_snapshot_file(napi_env env, napi_callback_info info);
+// boolean closeSnapshotFile(string path)
+static napi_value close_snapshot_file(napi_env env, napi_callback_info info);
+// string|undefined getSnapshotString(string path, string key)
+static napi_value get_snapshot_string(napi_env env, napi_callback_info info);
+// boolean hasSnapshotKey(string path, string key)
+static napi_value has_snapshot_key(napi_env env, napi_callback_info info);
+// string[] listSnapshotKeys(string path)
+static napi_value list_snapshot_keys(napi_env env, napi_callback_info info);
+
+// undefined configureHandleCache(number maxOpen, number idleTimeoutMs)
+static napi_value
+configure_handle_cache(napi_env env, napi_callback_info info);
+// undefined sweepHandleCache()
+static napi_value sweep_handle_cache(napi_env env, napi_callback_info info);
+// { hits, misses, evictions, opens, openTimeTotalMs, openTimeMaxMs,
+//   openHandles } getHandleCacheStats()
+static napi_value
+get_handle_cache_stats(napi_env env, napi_callback_info info);
+
+// State of one Node-API environment, see napi_set_instance_data.
+typedef struct {
+    // reused to encode string contents, grows as needed
+    char *string_buf;
+    size_t string_bufsize;
+    // Object.create, to make objects without prototype
+    napi_ref object_create;
+    // WeakSet of the deeply frozen objects, NULL until set
+    napi_ref frozen_set;
+    // contents shorter than this are copied into V8 buffers
+    size_t copy_threshold;
+} instance_data_t;
+
+static void finalize_instance_data(napi_env env, void *data, void *hint) {
+    instance_data_t *instance = data;
+    free(instance->string_buf);
+    if (instance->object_create != NULL) {
+        napi_delete_reference(env, instance->object_create);
+    }
+    if (instance->frozen_set != NULL) {
+        napi_delete_reference(env, instance->frozen_set);
+    }
+    free(instance);
+}
 
-static napi_value create_table(napi_env env, napi_callback_info info) {
+// Error with code "GDBM_ERR_<code>"; only formatted on failure.
+static napi_value create_wrap_error_(napi_env env, error_t err) {
     napi_status status;
 
-    size_t argc = 2;
-    napi_value args[2];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    char error_code_buf[ERROR_CODE_SIZE];
+    snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
+    char error_msg_buf[ERROR_BUFFER_SIZE];
+    snprintf(
+        error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
+        err.message != NULL ? err.message : "unexpected error"
+    );
+
+    napi_value code, message, error;
+    status =
+        napi_create_string_utf8(env, error_code_buf, NAPI_AUTO_LENGTH, &code);
+    assert(status == napi_ok);
+    status =
+        napi_create_string_utf8(env, error_msg_buf, NAPI_AUTO_LENGTH, &message);
+    assert(status == napi_ok);
+    status = napi_create_error(env, code, message, &error);
     assert(status == napi_ok);
 
-    if (argc < 2) {
-        napi_throw_type_error(env, NULL, "Wrong number of arguments");
-        return NULL;
-    }
+    return error;
+}
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
+static void throw_wrap_error_(napi_env env, error_t err) {
+    napi_status status = napi_throw(env, create_wrap_error_(env, err));
     assert(status == napi_ok);
+}
+
+// Copy a JS string into `buf`. Throws and returns false if it does not fit.
+static bool get_string_arg_(
+    napi_env env, napi_value value, char *buf, size_t bufsize, size_t *len,
+    const char *too_long_message
+) {
+    napi_status status;
+    status = napi_get_value_string_utf8(env, value, buf, bufsize, len);
+    if (status != napi_ok) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return false;
+    }
+    if (*len == bufsize - 1) {
+        napi_throw_error(env, NULL, too_long_message);
+        return false;
+    }
+    return true;
+}
+
+// Build the key of a sibling record, "<key>\0<suffix>", into `buf` of
+// SIBLING_KEY_SIZE bytes. `buf` may be `key_buf` itself.
+static bool get_sibling_key_(
+    napi_env env, const char *key_buf, size_t key_len, napi_value suffix,
+    char *buf, size_t *len
+) {
+    if (buf != key_buf) {
+        memcpy(buf, key_buf, key_len);
+    }
+    buf[key_len] = '\0';
+
+    size_t suffix_len;
+    if (!get_string_arg_(
+            env, suffix, buf + key_len + 1, SIBLING_KEY_SIZE - key_len - 1,
+            &suffix_len, "Too long suffix"
+        )) {
+        return false;
+    }
+    *len = key_len + 1 + suffix_len;
+    return true;
+}
+
+// Read the data of a typed array argument; empty arrays give "".
+static bool get_content_arg_(
+    napi_env env, napi_value value, char **data_p, size_t *data_len
+) {
+    napi_status status;
 
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
+    bool is_typedarray;
+    status = napi_is_typedarray(env, value, &is_typedarray);
     assert(status == napi_ok);
 
-    if (valuetype0 != napi_string || valuetype1 != napi_number) {
+    if (!is_typedarray) {
         napi_throw_type_error(env, NULL, "Wrong arguments");
-        return NULL;
+        return false;
     }
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
+    napi_typedarray_type content_type;
+    size_t content_offset;
+    status = napi_get_typedarray_info(
+        env, value, &content_type, data_len, (void *)data_p, NULL,
+        &content_offset
     );
     assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long name");
-        return NULL;
+    if (content_type != napi_uint8_array || content_offset != 0) {
+        napi_throw_error(env, NULL, "Invalid content type");
+        return false;
+    }
+
+    // UInt8Array from empty string or undefined will be NULL content
+    if (*data_len == 0 && *data_p == NULL) {
+        *data_p = "";
     }
+    return true;
+}
+
+// Encode a string argument as UTF-8 into the buffer of the environment.
+// `*data_p` is valid until the next call.
+static bool get_string_content_arg_(
+    napi_env env, napi_value value, char **data_p, size_t *data_len
+) {
+    napi_status status;
 
-    int32_t block_size;
-    status = napi_get_value_int32(env, args[1], &block_size);
+    instance_data_t *instance;
+    status = napi_get_instance_data(env, (void **)&instance);
     assert(status == napi_ok);
 
-    error_t err = wrap_create_db(name_buf, (int)block_size);
+    // a UTF-16 code unit takes at most 3 bytes in UTF-8
+    size_t utf16_len;
+    status = napi_get_value_string_utf16(env, value, NULL, 0, &utf16_len);
+    assert(status == napi_ok);
 
-    if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
-        return NULL;
+    size_t bufsize = utf16_len * 3 + 1;
+    if (bufsize > instance->string_bufsize) {
+        size_t new_size = instance->string_bufsize * 2;
+        if (new_size < bufsize) {
+            new_size = bufsize;
+        }
+        char *buf = realloc(instance->string_buf, new_size);
+        if (buf == NULL) {
+            napi_throw_error(env, NULL, "Out of memory");
+            return false;
+        }
+        instance->string_buf = buf;
+        instance->string_bufsize = new_size;
     }
 
-    napi_value result;
-    status = napi_get_undefined(env, &result);
+    status = napi_get_value_string_utf8(
+        env, value, instance->string_buf, instance->string_bufsize, data_len
+    );
     assert(status == napi_ok);
 
-    return result;
+    *data_p = instance->string_buf;
+    return true;
 }
 
-static napi_value clean_table(napi_env env, napi_callback_info info) {
+// Read a content argument given either as a Uint8Array or as a string.
+static bool get_content_or_string_arg_(
+    napi_env env, napi_value value, char **data_p, size_t *data_len
+) {
     napi_status status;
 
-    size_t argc = 2;
-    napi_value args[2];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    napi_valuetype valuetype;
+    status = napi_typeof(env, value, &valuetype);
     assert(status == napi_ok);
 
-    if (argc < 2) {
-        napi_throw_type_error(env, NULL, "Wrong number of arguments");
-        return NULL;
+    if (valuetype == napi_string) {
+        return get_string_content_arg_(env, value, data_p, data_len);
     }
+    return get_content_arg_(env, value, data_p, data_len);
+}
+
+// Read an optional array of sibling descriptions. With `with_content`,
+// elements are { suffix, content } objects, otherwise suffix strings.
+// On success `*records_p` must be released with free().
+static bool get_siblings_arg_(
+    napi_env env, napi_value value, const char *key_buf, size_t key_len,
+    bool with_content, record_t **records_p, int *count_p
+) {
+    napi_status status;
+
+    *records_p = NULL;
+    *count_p = 0;
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
+    napi_valuetype valuetype;
+    status = napi_typeof(env, value, &valuetype);
     assert(status == napi_ok);
 
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
+    if (valuetype == napi_undefined) {
+        return true;
+    }
+
+    bool is_array;
+    status = napi_is_array(env, value, &is_array);
     assert(status == napi_ok);
 
-    if (valuetype0 != napi_string || valuetype1 != napi_number) {
+    if (!is_array) {
         napi_throw_type_error(env, NULL, "Wrong arguments");
-        return NULL;
+        return false;
     }
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
-    );
+    uint32_t count;
+    status = napi_get_array_length(env, value, &count);
     assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long name");
-        return NULL;
+    if (count == 0) {
+        return true;
+    }
+
+    // records followed by their key buffers
+    record_t *records =
+        malloc(count * (sizeof(record_t) + SIBLING_KEY_SIZE));
+    if (records == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return false;
+    }
+    char *keys = (char *)(records + count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value element;
+        status = napi_get_element(env, value, i, &element);
+        assert(status == napi_ok);
+
+        napi_value suffix = element;
+        if (with_content) {
+            status = napi_get_named_property(env, element, "suffix", &suffix);
+            if (status != napi_ok) {
+                free(records);
+                napi_throw_type_error(env, NULL, "Wrong arguments");
+                return false;
+            }
+        }
+
+        record_t *record = &records[i];
+        size_t sibling_key_len;
+        record->key_p = keys + (size_t)i * SIBLING_KEY_SIZE;
+        if (!get_sibling_key_(
+                env, key_buf, key_len, suffix, record->key_p, &sibling_key_len
+            )) {
+            free(records);
+            return false;
+        }
+        record->key_len = (int)sibling_key_len;
+        record->data_p = NULL;
+        record->data_len = 0;
+
+        if (with_content) {
+            napi_value content;
+            status = napi_get_named_property(env, element, "content", &content);
+            assert(status == napi_ok);
+
+            size_t data_len;
+            if (!get_content_arg_(env, content, &record->data_p, &data_len)) {
+                free(records);
+                return false;
+            }
+            record->data_len = (int)data_len;
+        }
     }
 
-    int32_t block_size;
-    status = napi_get_value_int32(env, args[1], &block_size);
+    *records_p = records;
+    *count_p = (int)count;
+    return true;
+}
+
+// Argument specs list one type per argument. get_args_() checks and
+// converts them in a single pass, so exports only deal with C values.
+// Arguments after ARG_OPTIONAL are optional and skipped when undefined.
+typedef enum {
+    ARG_END,
+    ARG_NAME,     // table name string      -> args->name
+    ARG_KEY,      // key string             -> args->key, args->key_len
+    ARG_SUFFIX,   // sibling suffix string  -> args->key becomes
+                  //                           "<key>\0<suffix>"
+    ARG_CONTENT,  // Uint8Array or string   -> args->data_p, args->data_len
+    ARG_BYTES,    // Uint8Array             -> args->data_p, args->data_len
+    ARG_INT,      // integer number         -> args->ints[]
+    ARG_BOOL,     // boolean                -> args->flag
+    ARG_ARRAY,    // array                  -> args->argv[]
+    ARG_ANY,      // any value              -> args->argv[]
+    ARG_OPTIONAL,
+} arg_type_t;
+
+#define MAX_ARGS 6
+#define MAX_INT_ARGS 2
+
+// Declare the spec of an export as a static array, so it is neither
+// parsed nor built on each call, and its length is checked at build time.
+#define ARG_SPEC(spec, ...)                                                  \
+    static const arg_type_t spec[] = {__VA_ARGS__, ARG_END};                 \
+    _Static_assert(                                                          \
+        sizeof(spec) / sizeof(spec[0]) <= MAX_ARGS + 2, "Too many arguments" \
+    )
+
+typedef struct {
+    napi_value argv[MAX_ARGS];
+    char name[TABLE_NAME_SIZE];
+    // the key, extended in place to a sibling key when a suffix is given
+    char key[SIBLING_KEY_SIZE];
+    size_t key_len;
+    // length of the record key to look up, with the suffix if given
+    size_t record_key_len;
+    bool has_suffix;
+    char *data_p;
+    size_t data_len;
+    int64_t ints[MAX_INT_ARGS];
+    bool flag;
+} args_t;
+
+static bool get_args_(
+    napi_env env, napi_callback_info info, const arg_type_t *spec,
+    args_t *args
+) {
+    napi_status status;
+
+    size_t argc = MAX_ARGS;
+    status = napi_get_cb_info(env, info, &argc, args->argv, NULL, NULL);
     assert(status == napi_ok);
 
-    error_t err = wrap_clean_db(name_buf, (int)block_size);
+    args->has_suffix = false;
+
+    size_t index = 0;
+    int int_count = 0;
+    bool optional = false;
+    for (const arg_type_t *p = spec; *p != ARG_END; p++) {
+        if (*p == ARG_OPTIONAL) {
+            optional = true;
+            continue;
+        }
+
+        if (index >= argc) {
+            if (optional) {
+                break;
+            }
+            napi_throw_type_error(env, NULL, "Wrong number of arguments");
+            return false;
+        }
+
+        napi_value value = args->argv[index++];
+        if (optional) {
+            napi_valuetype valuetype;
+            status = napi_typeof(env, value, &valuetype);
+            assert(status == napi_ok);
+
+            if (valuetype == napi_undefined) {
+                continue;
+            }
+        }
+
+        switch (*p) {
+        case ARG_NAME: {
+            size_t name_len;
+            if (!get_string_arg_(
+                    env, value, args->name, TABLE_NAME_SIZE, &name_len,
+                    "Too long name"
+                )) {
+                return false;
+            }
+            break;
+        }
+        case ARG_KEY:
+            if (!get_string_arg_(
+                    env, value, args->key, TABLE_KEY_SIZE, &args->key_len,
+                    "Too long key"
+                )) {
+                return false;
+            }
+            args->record_key_len = args->key_len;
+            break;
+        case ARG_SUFFIX:
+            if (!get_sibling_key_(
+                    env, args->key, args->key_len, value, args->key,
+                    &args->record_key_len
+                )) {
+                return false;
+            }
+            args->has_suffix = true;
+            break;
+        case ARG_CONTENT:
+            if (!get_content_or_string_arg_(
+                    env, value, &args->data_p, &args->data_len
+                )) {
+                return false;
+            }
+            break;
+        case ARG_BYTES:
+            if (!get_content_arg_(env, value, &args->data_p, &args->data_len)) {
+                return false;
+            }
+            break;
+        case ARG_INT:
+            assert(int_count < MAX_INT_ARGS);
+            status = napi_get_value_int64(env, value, &args->ints[int_count++]);
+            if (status != napi_ok) {
+                napi_throw_type_error(env, NULL, "Wrong arguments");
+                return false;
+            }
+            break;
+        case ARG_BOOL:
+            status = napi_get_value_bool(env, value, &args->flag);
+            if (status != napi_ok) {
+                napi_throw_type_error(env, NULL, "Wrong arguments");
+                return false;
+            }
+            break;
+        case ARG_ARRAY: {
+            bool is_array;
+            status = napi_is_array(env, value, &is_array);
+            assert(status == napi_ok);
+
+            if (!is_array) {
+                napi_throw_type_error(env, NULL, "Wrong arguments");
+                return false;
+            }
+            break;
+        }
+        case ARG_ANY:
+            break;
+        case ARG_END:
+        case ARG_OPTIONAL:
+            break;
+        }
+    }
+
+    return true;
+}
+
+static napi_value create_table(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    error_t err = wrap_create_db(args.name, (int)args.ints[0]);
 
     if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
@@ -170,53 +628,43 @@ static napi_value clean_table(napi_env env, napi_callback_info info) {
     return result;
 }
 
-static napi_value count_records(napi_env env, napi_callback_info info) {
+static napi_value clean_table(napi_env env, napi_callback_info info) {
     napi_status status;
 
-    size_t argc = 1;
-    napi_value argv[1];
-    status = napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
-    assert(status == napi_ok);
-
-    if (argc < 1) {
-        napi_throw_type_error(env, NULL, "Wrong number of arguments");
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    napi_valuetype valuetype;
-    status = napi_typeof(env, argv[0], &valuetype);
-    assert(status == napi_ok);
+    error_t err = wrap_clean_db(args.name, (int)args.ints[0]);
 
-    if (valuetype != napi_string) {
-        napi_throw_error(env, NULL, "Wrong arguments");
+    if (err.code > 0) {
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, argv[0], name_buf, name_bufsize, &name_len
-    );
+    napi_value result;
+    status = napi_get_undefined(env, &result);
     assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long name");
+    return result;
+}
+
+static napi_value count_records(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
     int32_t count;
-    error_t err = wrap_count(name_buf, &count);
+    error_t err = wrap_count(args.name, &count);
 
     if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
@@ -230,96 +678,63 @@ static napi_value count_records(napi_env env, napi_callback_info info) {
 static napi_value insert_record(napi_env env, napi_callback_info info) {
     napi_status status;
 
-    size_t argc = 3;
-    napi_value args[3];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
-    assert(status == napi_ok);
-
-    if (argc < 3) {
-        napi_throw_type_error(env, NULL, "Wrong number of arguments");
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_CONTENT, ARG_OPTIONAL, ARG_ANY);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
-    assert(status == napi_ok);
-
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
-    assert(status == napi_ok);
-
-    napi_valuetype valuetype2;
-    status = napi_typeof(env, args[2], &valuetype2);
-    assert(status == napi_ok);
-
-    bool is_typedarray2;
-    status = napi_is_typedarray(env, args[2], &is_typedarray2);
-    assert(status == napi_ok);
-
-    if (valuetype0 != napi_string || valuetype1 != napi_string ||
-        valuetype2 != napi_object || !is_typedarray2) {
-        napi_throw_type_error(env, NULL, "Wrong arguments");
+    record_t *siblings;
+    int sibling_count;
+    if (!get_siblings_arg_(
+            env, args.argv[3], args.key, args.key_len, true, &siblings,
+            &sibling_count
+        )) {
         return NULL;
     }
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
+    error_t err = wrap_insert(
+        args.name, args.key, args.key_len, args.data_p, args.data_len,
+        siblings, sibling_count
     );
-    assert(status == napi_ok);
+    free(siblings);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long name");
+    if (err.code > 0) {
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
-    char key_buf[TABLE_KEY_SIZE];
-    size_t key_bufsize = TABLE_KEY_SIZE;
-    size_t key_len;
-    status = napi_get_value_string_utf8(
-        env, args[1], key_buf, key_bufsize, &key_len
-    );
+    napi_value result;
+    status = napi_get_boolean(env, err.code == 0, &result);
     assert(status == napi_ok);
 
-    if (key_len == key_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long key");
-        return NULL;
-    }
+    return result;
+}
 
-    char *content_buf;
-    napi_typedarray_type content_type;
-    size_t content_len;
-    size_t content_offset;
-    status = napi_get_typedarray_info(
-        env, args[2], &content_type, &content_len, (void *)(&content_buf), NULL,
-        &content_offset
-    );
-    assert(status == napi_ok);
+static napi_value remove_record(napi_env env, napi_callback_info info) {
+    napi_status status;
 
-    if (content_type != napi_uint8_array || content_offset != 0) {
-        napi_throw_error(env, NULL, "Invalid content type");
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_OPTIONAL, ARG_ANY);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    // UInt8Array from empty string or undefined will be NULL content
-    if (content_len == 0 && content_buf == NULL) {
-        content_buf = "";
+    record_t *siblings;
+    int sibling_count;
+    if (!get_siblings_arg_(
+            env, args.argv[2], args.key, args.key_len, false, &siblings,
+            &sibling_count
+        )) {
+        return NULL;
     }
 
     error_t err =
-        wrap_insert(name_buf, key_buf, key_len, content_buf, content_len);
+        wrap_remove(args.name, args.key, args.key_len, siblings, sibling_count);
+    free(siblings);
 
     if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
@@ -330,347 +745,2513 @@ static napi_value insert_record(napi_env env, napi_callback_info info) {
     return result;
 }
 
-static napi_value remove_record(napi_env env, napi_callback_info info) {
+static napi_value has_key(napi_env env, napi_callback_info info) {
     napi_status status;
 
-    size_t argc = 2;
-    napi_value args[2];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
-    assert(status == napi_ok);
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    bool exists;
+    error_t err = wrap_exists(args.name, args.key, args.key_len, &exists);
 
-    if (argc < 2) {
-        napi_throw_error(env, NULL, "Wrong number of arguments");
+    if (err.code > 0) {
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
+    napi_value result;
+    status = napi_get_boolean(env, exists, &result);
     assert(status == napi_ok);
 
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
-    assert(status == napi_ok);
+    return result;
+}
 
-    if (valuetype0 != napi_string || valuetype1 != napi_string) {
-        napi_throw_error(env, NULL, "Wrong arguments");
-        return NULL;
-    }
+void finalize_content(napi_env env, void *finalize_data, void *finalize_hint) {
+    // the hint carries the length reported to V8
+    int64_t change_in_bytes = -(int64_t)(uintptr_t)finalize_hint;
+    int64_t adjusted_value;
+    napi_adjust_external_memory(env, change_in_bytes, &adjusted_value);
+    free(finalize_data);
+}
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
-    );
+// Wrap fetched data in a Uint8Array, taking ownership of `data_p`.
+// Data under the copy threshold is copied to a V8 buffer and freed at once;
+// larger data is handed over and reported to V8 as external memory so that
+// it paces garbage collection.
+static napi_value
+create_content_(napi_env env, char *data_p, size_t data_len) {
+    napi_status status;
+
+    instance_data_t *instance;
+    status = napi_get_instance_data(env, (void **)&instance);
     assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long table name");
-        return NULL;
+    napi_value content_buf;
+    if (data_len < instance->copy_threshold) {
+        void *buf;
+        status = napi_create_arraybuffer(env, data_len, &buf, &content_buf);
+        assert(status == napi_ok);
+        memcpy(buf, data_p, data_len);
+        free(data_p);
+    } else {
+        status = napi_create_external_arraybuffer(
+            env, (void *)data_p, data_len, finalize_content,
+            (void *)(uintptr_t)data_len, &content_buf
+        );
+        assert(status == napi_ok);
+
+        int64_t adjusted_value;
+        status = napi_adjust_external_memory(
+            env, (int64_t)data_len, &adjusted_value
+        );
+        assert(status == napi_ok);
     }
 
-    char key_buf[TABLE_KEY_SIZE];
-    size_t key_bufsize = TABLE_KEY_SIZE;
-    size_t key_len;
-    status = napi_get_value_string_utf8(
-        env, args[1], key_buf, key_bufsize, &key_len
+    napi_value result;
+    status = napi_create_typedarray(
+        env, napi_uint8_array, data_len, content_buf, 0, &result
     );
     assert(status == napi_ok);
 
-    if (key_len == key_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long key");
+    return result;
+}
+
+static napi_value get_content(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    error_t err = wrap_remove(name_buf, key_buf, key_len);
+    char *data_p = NULL;
+    int data_len;
+    error_t err =
+        wrap_fetch(args.name, args.key, args.key_len, &data_p, &data_len);
 
     if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
     napi_value result;
-    status = napi_get_boolean(env, err.code == 0, &result);
-    assert(status == napi_ok);
+    if (data_p != NULL) {
+        result = create_content_(env, data_p, (size_t)data_len);
+    } else {
+        status = napi_get_undefined(env, &result);
+        assert(status == napi_ok);
+    }
 
     return result;
 }
 
-static napi_value has_key(napi_env env, napi_callback_info info) {
+// Create a JS string from UTF-8 bytes, taking the cheaper Latin-1 path
+// when they are all ASCII.
+static napi_value create_string_(napi_env env, const char *data, size_t len) {
     napi_status status;
 
-    size_t argc = 2;
-    napi_value args[2];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
-    assert(status == napi_ok);
-
-    if (argc < 2) {
-        napi_throw_error(env, NULL, "Wrong number of arguments");
-        return NULL;
+    bool is_ascii = true;
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char)data[i] >= 0x80) {
+            is_ascii = false;
+            break;
+        }
     }
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
+    napi_value result;
+    status = is_ascii ? napi_create_string_latin1(env, data, len, &result)
+                      : napi_create_string_utf8(env, data, len, &result);
     assert(status == napi_ok);
 
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
-    assert(status == napi_ok);
+    return result;
+}
+
+// Copy the value into `target` from `offset` and return its length. If it
+// does not fit, nothing is copied and the length is returned all the same,
+// like snprintf. -1 if the key does not exist.
+static napi_value read_into(napi_env env, napi_callback_info info) {
+    napi_status status;
 
-    if (valuetype0 != napi_string || valuetype1 != napi_string) {
-        napi_throw_error(env, NULL, "Wrong arguments");
+    args_t args;
+    ARG_SPEC(
+        spec, ARG_NAME, ARG_KEY, ARG_BYTES, ARG_INT, ARG_OPTIONAL, ARG_SUFFIX
+    );
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
+    int64_t offset = args.ints[0];
+    if (offset < 0 || (uint64_t)offset > args.data_len) {
+        napi_throw_range_error(env, NULL, "Offset out of range");
+        return NULL;
+    }
+
+    size_t data_len = 0;
+    error_t err = wrap_read_into(
+        args.name, args.key, (int)args.record_key_len, args.data_p + offset,
+        args.data_len - (size_t)offset, &data_len
     );
-    assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long table name");
+    napi_value result;
+    if (err.code == -1) {
+        status = napi_create_int32(env, -1, &result);
+        assert(status == napi_ok);
+        return result;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
-    char key_buf[TABLE_KEY_SIZE];
-    size_t key_bufsize = TABLE_KEY_SIZE;
-    size_t key_len;
-    status = napi_get_value_string_utf8(
-        env, args[1], key_buf, key_bufsize, &key_len
-    );
+    status = napi_create_int64(env, (int64_t)data_len, &result);
     assert(status == napi_ok);
 
-    if (key_len == key_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long key");
+    return result;
+}
+
+static napi_value set_copy_threshold(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    bool exists;
-    error_t err = wrap_exists(name_buf, key_buf, key_len, &exists);
-
-    if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+    if (args.ints[0] < 0) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
         return NULL;
     }
 
-    napi_value result;
-    status = napi_get_boolean(env, exists, &result);
+    instance_data_t *instance;
+    status = napi_get_instance_data(env, (void **)&instance);
     assert(status == napi_ok);
 
-    return result;
-}
+    instance->copy_threshold = (size_t)args.ints[0];
 
-void finalize_content(napi_env env, void *finalize_data, void *finalize_hint) {
-    free(finalize_data);
+    return NULL;
 }
 
-static napi_value get_content(napi_env env, napi_callback_info info) {
+static napi_value set_frozen_set(napi_env env, napi_callback_info info) {
     napi_status status;
 
-    size_t argc = 2;
-    napi_value args[2];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    size_t argc = 1;
+    napi_value set;
+    status = napi_get_cb_info(env, info, &argc, &set, NULL, NULL);
     assert(status == napi_ok);
 
-    if (argc < 2) {
-        napi_throw_error(env, NULL, "Wrong number of arguments");
+    napi_valuetype type;
+    status = napi_typeof(env, set, &type);
+    assert(status == napi_ok);
+    if (argc < 1 || type != napi_object) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
         return NULL;
     }
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
+    instance_data_t *instance;
+    status = napi_get_instance_data(env, (void **)&instance);
     assert(status == napi_ok);
 
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
+    if (instance->frozen_set != NULL) {
+        napi_delete_reference(env, instance->frozen_set);
+    }
+    status = napi_create_reference(env, set, 1, &instance->frozen_set);
     assert(status == napi_ok);
 
-    if (valuetype0 != napi_string || valuetype1 != napi_string) {
-        napi_throw_error(env, NULL, "Wrong arguments");
-        return NULL;
-    }
+    return NULL;
+}
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
-    );
+// Object.create and the frozen set (or NULL), as json_to_value takes them.
+static void get_json_hooks_(
+    napi_env env, napi_value *object_create, napi_value *frozen_set
+) {
+    napi_status status;
+
+    instance_data_t *instance;
+    status = napi_get_instance_data(env, (void **)&instance);
     assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long table name");
-        return NULL;
+    status =
+        napi_get_reference_value(env, instance->object_create, object_create);
+    assert(status == napi_ok);
+    *frozen_set = NULL;
+    if (instance->frozen_set != NULL) {
+        status =
+            napi_get_reference_value(env, instance->frozen_set, frozen_set);
+        assert(status == napi_ok);
     }
+}
 
-    char key_buf[TABLE_KEY_SIZE];
-    size_t key_bufsize = TABLE_KEY_SIZE;
-    size_t key_len;
-    status = napi_get_value_string_utf8(
-        env, args[1], key_buf, key_bufsize, &key_len
-    );
-    assert(status == napi_ok);
+static napi_value get_string(napi_env env, napi_callback_info info) {
+    napi_status status;
 
-    if (key_len == key_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long key");
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
     char *data_p = NULL;
     int data_len;
-    error_t err = wrap_fetch(name_buf, key_buf, key_len, &data_p, &data_len);
+    error_t err =
+        wrap_fetch(args.name, args.key, args.key_len, &data_p, &data_len);
 
     if (err.code > 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
     napi_value result;
     if (data_p != NULL) {
-        napi_value content_buf;
-        status = napi_create_external_arraybuffer(
-            env, (void *)data_p, (size_t)data_len, finalize_content, NULL,
-            &content_buf
-        );
+        result = create_string_(env, data_p, (size_t)data_len);
+        free(data_p);
+    } else {
+        status = napi_get_undefined(env, &result);
         assert(status == napi_ok);
+    }
 
-        status = napi_create_typedarray(
-            env, napi_uint8_array, (size_t)data_len, content_buf, 0, &result
+    return result;
+}
+
+static napi_value update_content(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_CONTENT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    error_t err = wrap_replace(
+        args.name, args.key, args.key_len, args.data_p, args.data_len
+    );
+
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+static napi_value upsert(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_CONTENT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    error_t err = wrap_upsert(
+        args.name, args.key, args.key_len, args.data_p, args.data_len
+    );
+
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+static napi_value
+replace_returning_old(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_CONTENT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    char *old_p = NULL;
+    int old_len;
+    error_t err = wrap_replace_returning_old(
+        args.name, args.key, args.key_len, args.data_p, args.data_len, &old_p,
+        &old_len
+    );
+
+    napi_value result;
+    if (err.code == -1) {
+        status = napi_get_undefined(env, &result);
+        assert(status == napi_ok);
+        return result;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    return create_content_(env, old_p, (size_t)old_len);
+}
+
+static napi_value
+delete_returning_value(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_OPTIONAL, ARG_ANY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    record_t *siblings;
+    int sibling_count;
+    if (!get_siblings_arg_(
+            env, args.argv[2], args.key, args.key_len, false, &siblings,
+            &sibling_count
+        )) {
+        return NULL;
+    }
+
+    char *data_p = NULL;
+    int data_len;
+    error_t err = wrap_delete_returning_value(
+        args.name, args.key, args.key_len, siblings, sibling_count, &data_p,
+        &data_len
+    );
+    free(siblings);
+
+    napi_value result;
+    if (err.code == -1) {
+        status = napi_get_undefined(env, &result);
+        assert(status == napi_ok);
+        return result;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    return create_content_(env, data_p, (size_t)data_len);
+}
+
+static napi_value get_sibling(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_SUFFIX);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    char *data_p = NULL;
+    int data_len;
+    error_t err = wrap_fetch(
+        args.name, args.key, (int)args.record_key_len, &data_p, &data_len
+    );
+
+    napi_value result;
+    if (err.code == -1) {
+        status = napi_get_undefined(env, &result);
+        assert(status == napi_ok);
+        return result;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    return create_content_(env, data_p, (size_t)data_len);
+}
+
+static napi_value get_object(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_OPTIONAL, ARG_SUFFIX);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    char *data_p = NULL;
+    int data_len;
+    error_t err = wrap_fetch(
+        args.name, args.key, (int)args.record_key_len, &data_p, &data_len
+    );
+
+    napi_value result;
+    if (err.code == -1) {
+        status = napi_get_undefined(env, &result);
+        assert(status == napi_ok);
+        return result;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value object_create, frozen_set;
+    get_json_hooks_(env, &object_create, &frozen_set);
+
+    char error_buf[JSON_ERROR_SIZE];
+    bool parsed = json_to_value(
+        env, object_create, frozen_set, data_p, (size_t)data_len, &result,
+        error_buf
+    );
+    free(data_p);
+
+    if (!parsed) {
+        napi_throw_error(env, "ERR_INVALID_JSON", error_buf);
+        return NULL;
+    }
+
+    return result;
+}
+
+static napi_value set_sibling(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_SUFFIX, ARG_ANY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    napi_valuetype valuetype3;
+    status = napi_typeof(env, args.argv[3], &valuetype3);
+    assert(status == napi_ok);
+
+    // the main key and the sibling key share the buffer
+    record_t sibling = {args.key, (int)args.record_key_len, NULL, 0};
+    if (valuetype3 != napi_null) {
+        size_t data_len;
+        if (!get_content_arg_(env, args.argv[3], &sibling.data_p, &data_len)) {
+            return NULL;
+        }
+        sibling.data_len = (int)data_len;
+    }
+
+    error_t err =
+        wrap_store_sibling(args.name, args.key, args.key_len, &sibling);
+
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+static napi_value incr(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_KEY, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    int64_t value;
+    error_t err =
+        wrap_incr(args.name, args.key, args.key_len, args.ints[0], &value);
+
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value result;
+    status = napi_create_int64(env, value, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+// Copy the strings of `array` one after another into `*buf_p`, to be
+// released with free(), and set the pointer and length of each in turn.
+// Undefined elements leave no data when `as_data`.
+static bool get_string_array_(
+    napi_env env, napi_value array, uint32_t count, record_t *records,
+    bool as_data, char **buf_p
+) {
+    napi_status status;
+
+    uint32_t length;
+    status = napi_get_array_length(env, array, &length);
+    assert(status == napi_ok);
+    if (length != count) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return false;
+    }
+
+    size_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value element;
+        status = napi_get_element(env, array, i, &element);
+        assert(status == napi_ok);
+
+        napi_valuetype valuetype;
+        status = napi_typeof(env, element, &valuetype);
+        assert(status == napi_ok);
+        if (as_data && valuetype == napi_undefined) {
+            continue;
+        }
+
+        size_t len;
+        status = napi_get_value_string_utf8(env, element, NULL, 0, &len);
+        if (status != napi_ok) {
+            napi_throw_type_error(env, NULL, "Wrong arguments");
+            return false;
+        }
+        if (len > INT32_MAX) {
+            napi_throw_range_error(env, NULL, "Too long string");
+            return false;
+        }
+        total += len + 1;
+    }
+
+    char *buf = malloc(total > 0 ? total : 1);
+    if (buf == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return false;
+    }
+
+    char *p = buf;
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value element;
+        status = napi_get_element(env, array, i, &element);
+        assert(status == napi_ok);
+
+        napi_valuetype valuetype;
+        status = napi_typeof(env, element, &valuetype);
+        assert(status == napi_ok);
+        if (as_data && valuetype == napi_undefined) {
+            records[i].data_p = NULL;
+            records[i].data_len = 0;
+            continue;
+        }
+
+        size_t len;
+        status = napi_get_value_string_utf8(
+            env, element, p, total - (p - buf), &len
+        );
+        assert(status == napi_ok);
+
+        if (as_data) {
+            records[i].data_p = p;
+            records[i].data_len = (int)len;
+        } else {
+            records[i].key_p = p;
+            records[i].key_len = (int)len;
+        }
+        p += len + 1;
+    }
+
+    *buf_p = buf;
+    return true;
+}
+
+// Copy the keys of `array` into `keys`, `count` of TABLE_KEY_SIZE bytes,
+// or of SIBLING_KEY_SIZE bytes extended to sibling keys if `suffix` is not
+// NULL.
+static bool get_keys_arg_(
+    napi_env env, napi_value array, uint32_t count, napi_value suffix,
+    char *keys, char **key_ps, int *key_lens
+) {
+    napi_status status;
+
+    size_t stride = suffix != NULL ? SIBLING_KEY_SIZE : TABLE_KEY_SIZE;
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value key;
+        status = napi_get_element(env, array, i, &key);
+        assert(status == napi_ok);
+
+        size_t key_len;
+        key_ps[i] = keys + (size_t)i * stride;
+        if (!get_string_arg_(
+                env, key, key_ps[i], TABLE_KEY_SIZE, &key_len, "Too long key"
+            )) {
+            return false;
+        }
+        if (suffix != NULL &&
+            !get_sibling_key_(
+                env, key_ps[i], key_len, suffix, key_ps[i], &key_len
+            )) {
+            return false;
+        }
+        key_lens[i] = (int)key_len;
+    }
+    return true;
+}
+
+static napi_value get_counters(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ARRAY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    uint32_t count;
+    status = napi_get_array_length(env, args.argv[1], &count);
+    assert(status == napi_ok);
+
+    napi_value result;
+    status = napi_create_array_with_length(env, count, &result);
+    assert(status == napi_ok);
+
+    if (count == 0) {
+        return result;
+    }
+
+    // one allocation holds every key and the per-key results
+    size_t keys_size = (size_t)count * TABLE_KEY_SIZE;
+    size_t block_size = keys_size + count * (sizeof(char *) + sizeof(int) +
+                                             sizeof(int64_t) + sizeof(bool));
+    char *block = malloc(block_size);
+    if (block == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    int64_t *values = (int64_t *)(block + keys_size);
+    char **key_ps = (char **)(values + count);
+    int *key_lens = (int *)(key_ps + count);
+    bool *found = (bool *)(key_lens + count);
+
+    if (!get_keys_arg_(
+            env, args.argv[1], count, NULL, block, key_ps, key_lens
+        )) {
+        free(block);
+        return NULL;
+    }
+
+    error_t err = wrap_fetch_counters(
+        args.name, (int)count, key_ps, key_lens, values, found
+    );
+
+    if (err.code != 0) {
+        free(block);
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value value;
+        if (found[i]) {
+            status = napi_create_int64(env, values[i], &value);
+        } else {
+            status = napi_get_undefined(env, &value);
+        }
+        assert(status == napi_ok);
+
+        status = napi_set_element(env, result, i, value);
+        assert(status == napi_ok);
+    }
+
+    free(block);
+
+    return result;
+}
+
+// Shared by getStrings and getObjects, which parse the data into objects.
+static napi_value
+fetch_many_(napi_env env, napi_callback_info info, bool parse) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ARRAY, ARG_OPTIONAL, ARG_ANY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    napi_valuetype suffix_type;
+    status = napi_typeof(env, args.argv[2], &suffix_type);
+    assert(status == napi_ok);
+    napi_value suffix = suffix_type != napi_undefined ? args.argv[2] : NULL;
+
+    uint32_t count;
+    status = napi_get_array_length(env, args.argv[1], &count);
+    assert(status == napi_ok);
+
+    napi_value result;
+    status = napi_create_array_with_length(env, count, &result);
+    assert(status == napi_ok);
+
+    if (count == 0) {
+        return result;
+    }
+
+    // one allocation holds every key and the per-key results
+    size_t keys_size =
+        (size_t)count * (suffix != NULL ? SIBLING_KEY_SIZE : TABLE_KEY_SIZE);
+    size_t block_size =
+        keys_size + count * (2 * sizeof(char *) + 2 * sizeof(int));
+    char *block = malloc(block_size);
+    if (block == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    char **key_ps = (char **)(block + keys_size);
+    char **data_ps = key_ps + count;
+    int *key_lens = (int *)(data_ps + count);
+    int *data_lens = key_lens + count;
+
+    if (!get_keys_arg_(
+            env, args.argv[1], count, suffix, block, key_ps, key_lens
+        )) {
+        free(block);
+        return NULL;
+    }
+
+    error_t err = wrap_fetch_many(
+        args.name, (int)count, key_ps, key_lens, data_ps, data_lens
+    );
+    if (err.code != 0) {
+        free(block);
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value object_create = NULL, frozen_set = NULL;
+    if (parse) {
+        get_json_hooks_(env, &object_create, &frozen_set);
+    }
+
+    bool parsed = true;
+    char error_buf[JSON_ERROR_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value value;
+        if (data_ps[i] == NULL || !parsed) {
+            status = napi_get_undefined(env, &value);
+            assert(status == napi_ok);
+        } else if (parse) {
+            parsed = json_to_value(
+                env, object_create, frozen_set, data_ps[i],
+                (size_t)data_lens[i], &value, error_buf
+            );
+        } else {
+            value = create_string_(env, data_ps[i], (size_t)data_lens[i]);
+        }
+        free(data_ps[i]);
+
+        if (parsed) {
+            status = napi_set_element(env, result, i, value);
+            assert(status == napi_ok);
+        }
+    }
+    free(block);
+
+    if (!parsed) {
+        napi_throw_error(env, "ERR_INVALID_JSON", error_buf);
+        return NULL;
+    }
+
+    return result;
+}
+
+static napi_value get_strings(napi_env env, napi_callback_info info) {
+    return fetch_many_(env, info, false);
+}
+
+static napi_value get_objects(napi_env env, napi_callback_info info) {
+    return fetch_many_(env, info, true);
+}
+
+static napi_value
+create_booleans_(napi_env env, const bool *values, int count) {
+    napi_status status;
+
+    napi_value result;
+    status = napi_create_array_with_length(env, count, &result);
+    assert(status == napi_ok);
+    for (int i = 0; i < count; i++) {
+        napi_value value;
+        status = napi_get_boolean(env, values[i], &value);
+        assert(status == napi_ok);
+        status = napi_set_element(env, result, i, value);
+        assert(status == napi_ok);
+    }
+    return result;
+}
+
+static napi_value insert_records(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ARRAY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    uint32_t count;
+    status = napi_get_array_length(env, args.argv[1], &count);
+    assert(status == napi_ok);
+
+    // records, their keys, their sibling arrays and counts, and the results
+    size_t keys_size = (size_t)count * TABLE_KEY_SIZE;
+    char *block = malloc(
+        (count > 0 ? count : 1) *
+            (TABLE_KEY_SIZE + sizeof(record_t) + sizeof(record_t *) +
+             sizeof(int) + sizeof(bool))
+    );
+    if (block == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    record_t *records = (record_t *)(block + keys_size);
+    record_t **sibling_arrays = (record_t **)(records + count);
+    int *sibling_counts = (int *)(sibling_arrays + count);
+    bool *inserted = (bool *)(sibling_counts + count);
+
+    bool ok = true;
+    int total_siblings = 0;
+    uint32_t read = 0;
+    for (; ok && read < count; read++) {
+        napi_value element, key, content, siblings;
+        status = napi_get_element(env, args.argv[1], read, &element);
+        assert(status == napi_ok);
+        sibling_arrays[read] = NULL;
+
+        record_t *record = &records[read];
+        record->key_p = block + (size_t)read * TABLE_KEY_SIZE;
+        size_t key_len, data_len;
+        ok = napi_get_named_property(env, element, "key", &key) == napi_ok &&
+             napi_get_named_property(env, element, "content", &content) ==
+                 napi_ok &&
+             napi_get_named_property(env, element, "siblings", &siblings) ==
+                 napi_ok;
+        if (!ok) {
+            napi_throw_type_error(env, NULL, "Wrong arguments");
+            break;
+        }
+        ok = get_string_arg_(
+                 env, key, record->key_p, TABLE_KEY_SIZE, &key_len,
+                 "Too long key"
+             ) &&
+             get_content_arg_(env, content, &record->data_p, &data_len) &&
+             get_siblings_arg_(
+                 env, siblings, record->key_p, key_len, true,
+                 &sibling_arrays[read], &sibling_counts[read]
+             );
+        record->key_len = (int)key_len;
+        record->data_len = (int)data_len;
+        total_siblings += ok ? sibling_counts[read] : 0;
+    }
+
+    record_t *siblings = NULL;
+    if (ok) {
+        siblings = malloc((total_siblings > 0 ? total_siblings : 1) *
+                          sizeof(record_t));
+        if (siblings == NULL) {
+            napi_throw_error(env, NULL, "Out of memory");
+            ok = false;
+        }
+    }
+    if (ok) {
+        record_t *p = siblings;
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(p, sibling_arrays[i], sibling_counts[i] * sizeof(record_t));
+            p += sibling_counts[i];
+        }
+    }
+
+    error_t err = {0, NULL};
+    if (ok) {
+        err = wrap_insert_many(
+            args.name, records, (int)count, siblings, sibling_counts, inserted
+        );
+    }
+    free(siblings);
+    for (uint32_t i = 0; i < read; i++) {
+        free(sibling_arrays[i]);
+    }
+
+    napi_value result = NULL;
+    if (ok) {
+        // a failed write is reported as false for the records it stopped at
+        (void)err;
+        result = create_booleans_(env, inserted, (int)count);
+    }
+    free(block);
+
+    return result;
+}
+
+static napi_value
+compare_and_swap_records(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    args.flag = false;
+    ARG_SPEC(
+        spec, ARG_NAME, ARG_ARRAY, ARG_ARRAY, ARG_ARRAY, ARG_OPTIONAL, ARG_BOOL
+    );
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    uint32_t count, content_count;
+    status = napi_get_array_length(env, args.argv[1], &count);
+    assert(status == napi_ok);
+    status = napi_get_array_length(env, args.argv[3], &content_count);
+    assert(status == napi_ok);
+    if (content_count != count) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return NULL;
+    }
+
+    // keys, then the records, the expected data, the key pointers and
+    // lengths, and the results
+    size_t keys_size = (size_t)count * TABLE_KEY_SIZE;
+    char *block = malloc(
+        (count > 0 ? count : 1) *
+        (TABLE_KEY_SIZE + 2 * sizeof(record_t) + sizeof(char *) +
+         sizeof(int) + sizeof(bool))
+    );
+    if (block == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    record_t *records = (record_t *)(block + keys_size);
+    record_t *expected = records + count;
+    char **key_ps = (char **)(expected + count);
+    int *key_lens = (int *)(key_ps + count);
+    bool *swapped = (bool *)(key_lens + count);
+
+    char *expected_buf = NULL;
+    if (!get_keys_arg_(
+            env, args.argv[1], count, NULL, block, key_ps, key_lens
+        ) ||
+        !get_string_array_(
+            env, args.argv[2], count, expected, true, &expected_buf
+        )) {
+        free(block);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value content;
+        status = napi_get_element(env, args.argv[3], i, &content);
+        assert(status == napi_ok);
+
+        napi_valuetype valuetype;
+        status = napi_typeof(env, content, &valuetype);
+        assert(status == napi_ok);
+
+        size_t data_len = 0;
+        records[i].data_p = NULL;
+        if (valuetype != napi_null &&
+            !get_content_arg_(env, content, &records[i].data_p, &data_len)) {
+            free(expected_buf);
+            free(block);
+            return NULL;
+        }
+        records[i].key_p = key_ps[i];
+        records[i].key_len = key_lens[i];
+        records[i].data_len = (int)data_len;
+    }
+
+    // a failed write is reported as false for the records it stopped at
+    if (args.flag) {
+        bool all_swapped;
+        wrap_compare_and_swap_all(
+            args.name, records, expected, (int)count, &all_swapped
+        );
+        for (uint32_t i = 0; i < count; i++) {
+            swapped[i] = all_swapped;
+        }
+    } else {
+        wrap_compare_and_swap_many(
+            args.name, records, expected, (int)count, swapped
+        );
+    }
+    napi_value result = create_booleans_(env, swapped, (int)count);
+    free(expected_buf);
+    free(block);
+
+    return result;
+}
+
+static int batch_op_type_(const char *type) {
+    static const struct {
+        const char *name;
+        int type;
+    } types[] = {
+        {"insert", BATCH_INSERT}, {"update", BATCH_UPDATE},
+        {"upsert", BATCH_UPSERT}, {"remove", BATCH_REMOVE},
+        {"incr", BATCH_INCR},     {"discard", BATCH_DISCARD},
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcmp(type, types[i].name) == 0) {
+            return types[i].type;
+        }
+    }
+    return -1;
+}
+
+// Read one element of the commitBatch operation list into `op`.
+// `key_buf` must have room for TABLE_KEY_SIZE bytes.
+static bool get_batch_op_(
+    napi_env env, napi_value value, batch_op_t *op, char *key_buf
+) {
+    napi_status status;
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, value, &valuetype);
+    assert(status == napi_ok);
+
+    if (valuetype != napi_object) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return false;
+    }
+
+    napi_value type_value;
+    status = napi_get_named_property(env, value, "type", &type_value);
+    assert(status == napi_ok);
+
+    char type_buf[16];
+    size_t type_len;
+    if (!get_string_arg_(
+            env, type_value, type_buf, sizeof(type_buf), &type_len,
+            "Unknown batch operation"
+        )) {
+        return false;
+    }
+    op->type = batch_op_type_(type_buf);
+    if (op->type < 0) {
+        napi_throw_type_error(env, NULL, "Unknown batch operation");
+        return false;
+    }
+
+    napi_value key_value;
+    status = napi_get_named_property(env, value, "key", &key_value);
+    assert(status == napi_ok);
+
+    size_t key_len;
+    if (!get_string_arg_(
+            env, key_value, key_buf, TABLE_KEY_SIZE, &key_len, "Too long key"
+        )) {
+        return false;
+    }
+    op->key_p = key_buf;
+    op->key_len = (int)key_len;
+    op->data_p = "";
+    op->data_len = 0;
+    op->delta = 0;
+
+    if (op->type == BATCH_INCR) {
+        napi_value delta_value;
+        status = napi_get_named_property(env, value, "delta", &delta_value);
+        assert(status == napi_ok);
+
+        status = napi_get_value_int64(env, delta_value, &op->delta);
+        if (status != napi_ok) {
+            napi_throw_type_error(env, NULL, "Wrong arguments");
+            return false;
+        }
+    } else if (op->type != BATCH_REMOVE && op->type != BATCH_DISCARD) {
+        napi_value content_value;
+        status =
+            napi_get_named_property(env, value, "content", &content_value);
+        assert(status == napi_ok);
+
+        size_t content_len;
+        if (!get_content_arg_(env, content_value, &op->data_p, &content_len)) {
+            return false;
+        }
+        op->data_len = (int)content_len;
+    }
+
+    return true;
+}
+
+static napi_value commit_batch(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ARRAY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    uint32_t count;
+    status = napi_get_array_length(env, args.argv[1], &count);
+    assert(status == napi_ok);
+
+    napi_value result;
+    if (count == 0) {
+        status = napi_get_boolean(env, true, &result);
+        assert(status == napi_ok);
+        return result;
+    }
+
+    batch_op_t *ops = malloc(count * sizeof(batch_op_t));
+    char *keys = malloc((size_t)count * TABLE_KEY_SIZE);
+    if (ops == NULL || keys == NULL) {
+        free(ops);
+        free(keys);
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value op;
+        status = napi_get_element(env, args.argv[1], i, &op);
+        assert(status == napi_ok);
+
+        if (!get_batch_op_(env, op, &ops[i], keys + (size_t)i * TABLE_KEY_SIZE)) {
+            free(ops);
+            free(keys);
+            return NULL;
+        }
+    }
+
+    bool committed;
+    error_t err = wrap_commit_batch(args.name, ops, (int)count, &committed);
+
+    free(ops);
+    free(keys);
+
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    status = napi_get_boolean(env, committed, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+#define MAX_PREDICATE_DEPTH 64
+
+static bool set_predicate_value_(
+    napi_env env, predicate_t *pred, napi_value value, bool scalar_only,
+    pred_value_t *result
+) {
+    napi_status status;
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, value, &valuetype);
+    assert(status == napi_ok);
+
+    switch (valuetype) {
+    case napi_null:
+        result->type = PRED_NULL;
+        return !scalar_only;
+    case napi_boolean:
+        result->type = PRED_BOOL;
+        status = napi_get_value_bool(env, value, &result->boolean);
+        assert(status == napi_ok);
+        return !scalar_only;
+    case napi_number:
+        result->type = PRED_NUMBER;
+        status = napi_get_value_double(env, value, &result->number);
+        assert(status == napi_ok);
+        return true;
+    case napi_string: {
+        result->type = PRED_STRING;
+        char *data_p;
+        size_t data_len;
+        if (!get_string_content_arg_(env, value, &data_p, &data_len)) {
+            return false;
+        }
+        return predicate_add_string(pred, data_p, data_len, &result->string);
+    }
+    default:
+        return false;
+    }
+}
+
+// Read one bound of a range, { gt, gte } or { lt, lte }.
+static bool get_range_bound_(
+    napi_env env, predicate_t *pred, napi_value range, const char *exclusive,
+    const char *inclusive, pred_value_t *bound, bool *is_inclusive
+) {
+    napi_status status;
+
+    bound->type = PRED_NONE;
+    for (int i = 0; i < 2; i++) {
+        const char *name = i == 0 ? exclusive : inclusive;
+        napi_value value;
+        status = napi_get_named_property(env, range, name, &value);
+        if (status != napi_ok) {
+            return false;
+        }
+        napi_valuetype valuetype;
+        status = napi_typeof(env, value, &valuetype);
+        assert(status == napi_ok);
+        if (valuetype == napi_undefined) {
+            continue;
+        }
+        if (bound->type != PRED_NONE ||
+            !set_predicate_value_(env, pred, value, true, bound)) {
+            return false;
+        }
+        *is_inclusive = i == 1;
+    }
+    return true;
+}
+
+// Compile a predicate description into `pred`. Returns false, possibly
+// with a pending exception, if it is malformed.
+//   { and: [...] } | { or: [...] } |
+//   { record?: number, path: string[],
+//     equals: null|boolean|number|string } |
+//   { record?: number, path: string[], prefix: string } |
+//   { record?: number, path: string[],
+//     range: { gt?|gte?: number|string, lt?|lte?: number|string } }
+static bool get_predicate_arg_(
+    napi_env env, napi_value value, predicate_t *pred, int depth
+) {
+    napi_status status;
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, value, &valuetype);
+    assert(status == napi_ok);
+
+    if (valuetype != napi_object || depth >= MAX_PREDICATE_DEPTH) {
+        return false;
+    }
+
+    static const char *const names[] = {"and", "or", "equals", "prefix",
+                                        "range"};
+    int op = -1;
+    napi_value operand;
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        bool has;
+        status = napi_has_named_property(env, value, names[i], &has);
+        if (status != napi_ok) {
+            return false;
+        }
+        if (has) {
+            if (op >= 0) {
+                return false;
+            }
+            op = i;
+            status = napi_get_named_property(env, value, names[i], &operand);
+            if (status != napi_ok) {
+                return false;
+            }
+        }
+    }
+    if (op < 0) {
+        return false;
+    }
+
+    int index = predicate_add_node(pred, op);
+    if (index < 0) {
+        return false;
+    }
+
+    if (op == PRED_AND || op == PRED_OR) {
+        bool is_array;
+        status = napi_is_array(env, operand, &is_array);
+        assert(status == napi_ok);
+        if (!is_array) {
+            return false;
+        }
+        uint32_t count;
+        status = napi_get_array_length(env, operand, &count);
+        assert(status == napi_ok);
+        for (uint32_t i = 0; i < count; i++) {
+            napi_value child;
+            status = napi_get_element(env, operand, i, &child);
+            if (status != napi_ok ||
+                !get_predicate_arg_(env, child, pred, depth + 1)) {
+                return false;
+            }
+        }
+        predicate_close_node(pred, index);
+        return true;
+    }
+
+    napi_value record_value;
+    status = napi_get_named_property(env, value, "record", &record_value);
+    if (status != napi_ok) {
+        return false;
+    }
+    int32_t record = 0;
+    status = napi_typeof(env, record_value, &valuetype);
+    assert(status == napi_ok);
+    if (valuetype != napi_undefined &&
+        (napi_get_value_int32(env, record_value, &record) != napi_ok ||
+         record < 0)) {
+        return false;
+    }
+
+    napi_value path;
+    bool is_array;
+    status = napi_get_named_property(env, value, "path", &path);
+    if (status != napi_ok ||
+        napi_is_array(env, path, &is_array) != napi_ok || !is_array) {
+        return false;
+    }
+    uint32_t path_count;
+    status = napi_get_array_length(env, path, &path_count);
+    assert(status == napi_ok);
+    for (uint32_t i = 0; i < path_count; i++) {
+        napi_value segment;
+        char *data_p;
+        size_t data_len;
+        status = napi_get_element(env, path, i, &segment);
+        if (status != napi_ok ||
+            napi_typeof(env, segment, &valuetype) != napi_ok ||
+            valuetype != napi_string ||
+            !get_string_content_arg_(env, segment, &data_p, &data_len) ||
+            !predicate_add_segment(pred, data_p, data_len)) {
+            return false;
+        }
+    }
+
+    pred_value_t operand_value = {PRED_NONE};
+    pred_value_t lower = {PRED_NONE}, upper = {PRED_NONE};
+    bool lower_inclusive = false, upper_inclusive = false;
+    if (op == PRED_EQUALS) {
+        if (!set_predicate_value_(env, pred, operand, false, &operand_value)) {
+            return false;
+        }
+    } else if (op == PRED_PREFIX) {
+        if (!set_predicate_value_(env, pred, operand, true, &operand_value) ||
+            operand_value.type != PRED_STRING) {
+            return false;
+        }
+    } else {
+        status = napi_typeof(env, operand, &valuetype);
+        assert(status == napi_ok);
+        if (valuetype != napi_object ||
+            !get_range_bound_(
+                env, pred, operand, "gt", "gte", &lower, &lower_inclusive
+            ) ||
+            !get_range_bound_(
+                env, pred, operand, "lt", "lte", &upper, &upper_inclusive
+            ) ||
+            (lower.type != PRED_NONE && upper.type != PRED_NONE &&
+             lower.type != upper.type)) {
+            return false;
+        }
+    }
+
+    pred_node_t *node = predicate_node(pred, index);
+    node->record = record;
+    node->value = operand_value;
+    node->lower = lower;
+    node->upper = upper;
+    node->lower_inclusive = lower_inclusive;
+    node->upper_inclusive = upper_inclusive;
+    predicate_close_node(pred, index);
+    return true;
+}
+
+typedef struct {
+    napi_async_work work;
+    napi_deferred deferred;
+    char name[TABLE_NAME_SIZE];
+    predicate_t *pred;
+    // suffix pointers followed by the suffixes
+    char **suffixes;
+    int suffix_count;
+    // keys without records, see scanKeys
+    bool keys_only;
+    char *cursor_p;
+    int cursor_len;
+    int limit;
+    int budget;
+
+    // matches, `suffix_count + 1` records each
+    record_t *items;
+    int item_count;
+    int item_capacity;
+    bool out_of_memory;
+
+    error_t err;
+    char *next_cursor_p;
+    int next_cursor_len;
+} scan_work_t;
+
+static void free_scan_work_(scan_work_t *scan) {
+    int width = scan->suffix_count + 1;
+    for (int i = 0; i < scan->item_count * width; i++) {
+        free(scan->items[i].key_p);
+        free(scan->items[i].data_p);
+    }
+    free(scan->items);
+    free(scan->next_cursor_p);
+    free(scan->cursor_p);
+    free(scan->suffixes);
+    predicate_free(scan->pred);
+    free(scan);
+}
+
+static bool visit_scan_(void *ctx, record_t *records) {
+    scan_work_t *scan = ctx;
+    if (!predicate_eval(scan->pred, records)) {
+        return true;
+    }
+
+    int width = scan->suffix_count + 1;
+    if (scan->item_count == scan->item_capacity) {
+        int capacity = scan->item_capacity > 0 ? scan->item_capacity * 2 : 16;
+        record_t *items =
+            realloc(scan->items, (size_t)capacity * width * sizeof(record_t));
+        if (items == NULL) {
+            scan->out_of_memory = true;
+            return false;
+        }
+        scan->items = items;
+        scan->item_capacity = capacity;
+    }
+
+    char *key_p = malloc(records[0].key_len > 0 ? records[0].key_len : 1);
+    if (key_p == NULL) {
+        scan->out_of_memory = true;
+        return false;
+    }
+    memcpy(key_p, records[0].key_p, records[0].key_len);
+
+    // keep the fetched data instead of copying it
+    record_t *item = &scan->items[scan->item_count * width];
+    for (int i = 0; i < width; i++) {
+        item[i] = (record_t){NULL, 0, records[i].data_p, records[i].data_len};
+        records[i].data_p = NULL;
+    }
+    item[0].key_p = key_p;
+    item[0].key_len = records[0].key_len;
+    scan->item_count++;
+
+    return scan->item_count < scan->limit;
+}
+
+static void execute_scan_(napi_env env, void *data) {
+    scan_work_t *scan = data;
+    scan->err = wrap_scan(
+        scan->name, scan->cursor_p, scan->cursor_len,
+        (const char **)scan->suffixes, scan->suffix_count, scan->keys_only,
+        scan->budget, visit_scan_, scan, &scan->next_cursor_p,
+        &scan->next_cursor_len
+    );
+}
+
+// Build { entries: [key, record, ...siblings][], cursor: string|undefined },
+// or { keys: string[], cursor: string|undefined } for keys only.
+static bool create_scan_result_(
+    napi_env env, scan_work_t *scan, napi_value *result, char *error_buf
+) {
+    napi_status status;
+
+    napi_value object_create, frozen_set;
+    get_json_hooks_(env, &object_create, &frozen_set);
+
+    int width = scan->suffix_count + 1;
+    napi_value entries;
+    status = napi_create_array_with_length(env, scan->item_count, &entries);
+    assert(status == napi_ok);
+    for (int i = 0; i < scan->item_count; i++) {
+        const record_t *item = &scan->items[i * width];
+        if (scan->keys_only) {
+            napi_value key =
+                create_string_(env, item[0].key_p, (size_t)item[0].key_len);
+            status = napi_set_element(env, entries, (uint32_t)i, key);
+            assert(status == napi_ok);
+            continue;
+        }
+
+        napi_value entry;
+        status = napi_create_array_with_length(env, width + 1, &entry);
+        assert(status == napi_ok);
+
+        napi_value value =
+            create_string_(env, item[0].key_p, (size_t)item[0].key_len);
+        status = napi_set_element(env, entry, 0, value);
+        assert(status == napi_ok);
+
+        for (int j = 0; j < width; j++) {
+            if (item[j].data_p == NULL) {
+                status = napi_get_undefined(env, &value);
+                assert(status == napi_ok);
+            } else if (!json_to_value(
+                           env, object_create, frozen_set, item[j].data_p,
+                           (size_t)item[j].data_len, &value, error_buf
+                       )) {
+                return false;
+            }
+            status = napi_set_element(env, entry, (uint32_t)j + 1, value);
+            assert(status == napi_ok);
+        }
+
+        status = napi_set_element(env, entries, (uint32_t)i, entry);
+        assert(status == napi_ok);
+    }
+
+    napi_value cursor;
+    if (scan->next_cursor_p != NULL) {
+        cursor = create_string_(
+            env, scan->next_cursor_p, (size_t)scan->next_cursor_len
+        );
+    } else {
+        status = napi_get_undefined(env, &cursor);
+        assert(status == napi_ok);
+    }
+
+    status = napi_create_object(env, result);
+    assert(status == napi_ok);
+    status = napi_set_named_property(
+        env, *result, scan->keys_only ? "keys" : "entries", entries
+    );
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, *result, "cursor", cursor);
+    assert(status == napi_ok);
+
+    return true;
+}
+
+static void complete_scan_(napi_env env, napi_status work_status, void *data) {
+    napi_status status;
+    scan_work_t *scan = data;
+
+    napi_value result;
+    bool resolved = false;
+    if (work_status != napi_ok || scan->out_of_memory) {
+        napi_value message;
+        status = napi_create_string_utf8(
+            env, work_status != napi_ok ? "Scan cancelled" : "Out of memory",
+            NAPI_AUTO_LENGTH, &message
+        );
+        assert(status == napi_ok);
+        status = napi_create_error(env, NULL, message, &result);
+        assert(status == napi_ok);
+    } else if (scan->err.code == -1) {
+        napi_value code, message;
+        status = napi_create_string_utf8(
+            env, "ERR_SCAN_CURSOR", NAPI_AUTO_LENGTH, &code
+        );
+        assert(status == napi_ok);
+        status = napi_create_string_utf8(
+            env, "Scan cursor no longer exists", NAPI_AUTO_LENGTH, &message
+        );
+        assert(status == napi_ok);
+        status = napi_create_error(env, code, message, &result);
+        assert(status == napi_ok);
+    } else if (scan->err.code != 0) {
+        result = create_wrap_error_(env, scan->err);
+    } else {
+        char error_buf[JSON_ERROR_SIZE];
+        resolved = create_scan_result_(env, scan, &result, error_buf);
+        if (!resolved) {
+            napi_value code, message;
+            status = napi_create_string_utf8(
+                env, "ERR_INVALID_JSON", NAPI_AUTO_LENGTH, &code
+            );
+            assert(status == napi_ok);
+            status = napi_create_string_utf8(
+                env, error_buf, NAPI_AUTO_LENGTH, &message
+            );
+            assert(status == napi_ok);
+            status = napi_create_error(env, code, message, &result);
+            assert(status == napi_ok);
+        }
+    }
+
+    if (resolved) {
+        status = napi_resolve_deferred(env, scan->deferred, result);
+    } else {
+        status = napi_reject_deferred(env, scan->deferred, result);
+    }
+    assert(status == napi_ok);
+
+    napi_delete_async_work(env, scan->work);
+    free_scan_work_(scan);
+}
+
+// Read the optional cursor argument into `scan` and run it on a worker
+// thread. `scan` is released on failure.
+static napi_value
+queue_scan_(napi_env env, scan_work_t *scan, napi_value cursor) {
+    napi_status status;
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, cursor, &valuetype);
+    assert(status == napi_ok);
+    if (valuetype != napi_undefined) {
+        char cursor_buf[TABLE_KEY_SIZE];
+        size_t cursor_len;
+        if (!get_string_arg_(
+                env, cursor, cursor_buf, TABLE_KEY_SIZE, &cursor_len,
+                "Too long key"
+            )) {
+            free_scan_work_(scan);
+            return NULL;
+        }
+        scan->cursor_p = malloc(cursor_len > 0 ? cursor_len : 1);
+        if (scan->cursor_p == NULL) {
+            free_scan_work_(scan);
+            napi_throw_error(env, NULL, "Out of memory");
+            return NULL;
+        }
+        memcpy(scan->cursor_p, cursor_buf, cursor_len);
+        scan->cursor_len = (int)cursor_len;
+    }
+
+    napi_value promise;
+    status = napi_create_promise(env, &scan->deferred, &promise);
+    assert(status == napi_ok);
+
+    napi_value resource_name;
+    status = napi_create_string_utf8(
+        env, "gdbm.scan", NAPI_AUTO_LENGTH, &resource_name
+    );
+    assert(status == napi_ok);
+
+    status = napi_create_async_work(
+        env, NULL, resource_name, execute_scan_, complete_scan_, scan,
+        &scan->work
+    );
+    assert(status == napi_ok);
+    status = napi_queue_async_work(env, scan->work);
+    assert(status == napi_ok);
+
+    return promise;
+}
+
+static napi_value scan(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(
+        spec, ARG_NAME, ARG_ANY, ARG_ARRAY, ARG_INT, ARG_INT, ARG_OPTIONAL,
+        ARG_ANY
+    );
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    int64_t limit = args.ints[0];
+    int64_t budget = args.ints[1];
+    if (limit < 1 || limit > INT32_MAX || budget < 1 || budget > INT32_MAX) {
+        napi_throw_range_error(env, NULL, "Limit out of range");
+        return NULL;
+    }
+
+    uint32_t suffix_count;
+    status = napi_get_array_length(env, args.argv[2], &suffix_count);
+    assert(status == napi_ok);
+
+    scan_work_t *scan = calloc(1, sizeof(scan_work_t));
+    if (scan != NULL) {
+        scan->pred = predicate_create();
+        scan->suffixes =
+            malloc(suffix_count * (sizeof(char *) + SIBLING_KEY_SIZE) + 1);
+    }
+    if (scan == NULL || scan->pred == NULL || scan->suffixes == NULL) {
+        if (scan != NULL) {
+            free_scan_work_(scan);
+        }
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    memcpy(scan->name, args.name, TABLE_NAME_SIZE);
+    scan->limit = (int)limit;
+    scan->budget = (int)budget;
+
+    char *suffix_buf = (char *)(scan->suffixes + suffix_count);
+    for (uint32_t i = 0; i < suffix_count; i++) {
+        napi_value suffix;
+        status = napi_get_element(env, args.argv[2], i, &suffix);
+        assert(status == napi_ok);
+
+        size_t suffix_len;
+        scan->suffixes[i] = suffix_buf + (size_t)i * SIBLING_KEY_SIZE;
+        if (!get_string_arg_(
+                env, suffix, scan->suffixes[i], SIBLING_KEY_SIZE, &suffix_len,
+                "Too long suffix"
+            )) {
+            free_scan_work_(scan);
+            return NULL;
+        }
+    }
+    scan->suffix_count = (int)suffix_count;
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, args.argv[1], &valuetype);
+    assert(status == napi_ok);
+    if (valuetype != napi_null &&
+        (!get_predicate_arg_(env, args.argv[1], scan->pred, 0) ||
+         predicate_record_count(scan->pred) > scan->suffix_count + 1)) {
+        free_scan_work_(scan);
+        bool pending;
+        status = napi_is_exception_pending(env, &pending);
+        assert(status == napi_ok);
+        if (!pending) {
+            napi_throw_type_error(env, NULL, "Invalid predicate");
+        }
+        return NULL;
+    }
+
+    return queue_scan_(env, scan, args.argv[5]);
+}
+
+static napi_value scan_keys(napi_env env, napi_callback_info info) {
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_INT, ARG_OPTIONAL, ARG_ANY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    int64_t limit = args.ints[0];
+    if (limit < 1 || limit > INT32_MAX) {
+        napi_throw_range_error(env, NULL, "Limit out of range");
+        return NULL;
+    }
+
+    scan_work_t *scan = calloc(1, sizeof(scan_work_t));
+    if (scan != NULL) {
+        scan->pred = predicate_create();
+    }
+    if (scan == NULL || scan->pred == NULL) {
+        if (scan != NULL) {
+            free_scan_work_(scan);
+        }
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    memcpy(scan->name, args.name, TABLE_NAME_SIZE);
+    scan->keys_only = true;
+    // no record is read, so a page visits as many keys as it returns
+    scan->limit = (int)limit;
+    scan->budget = (int)limit;
+
+    return queue_scan_(env, scan, args.argv[2]);
+}
+
+static napi_value open_memory_table(napi_env env, napi_callback_info info) {
+    args_t args;
+    args.ints[0] = 0;
+    ARG_SPEC(spec, ARG_NAME, ARG_BOOL, ARG_OPTIONAL, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+    if (args.ints[0] < 0) {
+        napi_throw_range_error(env, NULL, "Shared size out of range");
+        return NULL;
+    }
+
+    error_t err = wrap_open_memory(args.name, args.flag, (size_t)args.ints[0]);
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    return NULL;
+}
+
+// Shared by closeMemoryTable, snapshotMemoryTable, closeKeyIndex and
+// closeSnapshotFile; false if the table or file is not open.
+static napi_value call_native_handle_(
+    napi_env env, napi_callback_info info, error_t (*fn)(const char *)
+) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    error_t err = fn(args.name);
+    if (err.code > 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    napi_value result;
+    status = napi_get_boolean(env, err.code == 0, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+static napi_value close_memory_table(napi_env env, napi_callback_info info) {
+    return call_native_handle_(env, info, wrap_close_memory);
+}
+
+static napi_value
+snapshot_memory_table(napi_env env, napi_callback_info info) {
+    return call_native_handle_(env, info, wrap_snapshot_memory);
+}
+
+static napi_value open_key_index(napi_env env, napi_callback_info info) {
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    error_t err = wrap_open_key_index(args.name);
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    return NULL;
+}
+
+static napi_value close_key_index(napi_env env, napi_callback_info info) {
+    return call_native_handle_(env, info, wrap_close_key_index);
+}
+
+// Read the optional string property `name` of a range into `buf` of
+// TABLE_KEY_SIZE bytes. `*found` is false if it is undefined.
+static bool get_range_key_(
+    napi_env env, napi_value range, const char *name, char *buf, int *len,
+    bool *found
+) {
+    napi_status status;
+
+    napi_value value;
+    status = napi_get_named_property(env, range, name, &value);
+    if (status != napi_ok) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return false;
+    }
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, value, &valuetype);
+    assert(status == napi_ok);
+
+    *found = valuetype != napi_undefined;
+    if (!*found) {
+        return true;
+    }
+
+    size_t key_len;
+    if (!get_string_arg_(
+            env, value, buf, TABLE_KEY_SIZE, &key_len, "Too long key"
+        )) {
+        return false;
+    }
+    *len = (int)key_len;
+    return true;
+}
+
+typedef struct {
+    napi_env env;
+    napi_value keys;
+    uint32_t count;
+} key_list_t;
+
+static bool push_key_(void *ctx, const char *key_p, int key_len) {
+    key_list_t *list = ctx;
+    napi_status status = napi_set_element(
+        list->env, list->keys, list->count++,
+        create_string_(list->env, key_p, key_len)
+    );
+    assert(status == napi_ok);
+    return true;
+}
+
+static napi_value query_keys(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ANY, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    napi_valuetype valuetype;
+    status = napi_typeof(env, args.argv[1], &valuetype);
+    assert(status == napi_ok);
+
+    if (valuetype != napi_object || args.ints[0] < 0) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return NULL;
+    }
+    int limit = args.ints[0] < INT32_MAX ? (int)args.ints[0] : INT32_MAX;
+
+    char prefix[TABLE_KEY_SIZE], lower[TABLE_KEY_SIZE], upper[TABLE_KEY_SIZE];
+    key_range_t range = {0};
+    bool found, found_inclusive;
+    if (!get_range_key_(
+            env, args.argv[1], "prefix", prefix, &range.prefix_len, &found
+        )) {
+        return NULL;
+    }
+    range.prefix_p = found ? prefix : NULL;
+
+    if (!get_range_key_(
+            env, args.argv[1], "gt", lower, &range.lower_len, &found
+        ) ||
+        !get_range_key_(
+            env, args.argv[1], "gte", lower, &range.lower_len, &found_inclusive
+        )) {
+        return NULL;
+    }
+    if (found && found_inclusive) {
+        napi_throw_type_error(env, NULL, "Both gt and gte are given");
+        return NULL;
+    }
+    range.lower_p = found || found_inclusive ? lower : NULL;
+    range.lower_inclusive = found_inclusive;
+
+    if (!get_range_key_(
+            env, args.argv[1], "lt", upper, &range.upper_len, &found
+        ) ||
+        !get_range_key_(
+            env, args.argv[1], "lte", upper, &range.upper_len, &found_inclusive
+        )) {
+        return NULL;
+    }
+    if (found && found_inclusive) {
+        napi_throw_type_error(env, NULL, "Both lt and lte are given");
+        return NULL;
+    }
+    range.upper_p = found || found_inclusive ? upper : NULL;
+    range.upper_inclusive = found_inclusive;
+
+    key_list_t list = {env, NULL, 0};
+    status = napi_create_array(env, &list.keys);
+    assert(status == napi_ok);
+
+    error_t err = wrap_query_keys(args.name, &range, limit, push_key_, &list);
+    if (err.code == -1) {
+        napi_value code, message, error;
+        status = napi_create_string_utf8(
+            env, "ERR_NO_KEY_INDEX", NAPI_AUTO_LENGTH, &code
         );
         assert(status == napi_ok);
-    } else {
-        status = napi_get_undefined(env, &result);
+        status = napi_create_string_utf8(
+            env, "Key index is not open", NAPI_AUTO_LENGTH, &message
+        );
+        assert(status == napi_ok);
+        status = napi_create_error(env, code, message, &error);
+        assert(status == napi_ok);
+        status = napi_throw(env, error);
         assert(status == napi_ok);
+        return NULL;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
     }
 
-    return result;
+    return list.keys;
 }
 
-static napi_value update_content(napi_env env, napi_callback_info info) {
+static napi_value write_snapshot_file(napi_env env, napi_callback_info info) {
     napi_status status;
 
-    size_t argc = 3;
-    napi_value args[3];
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ARRAY, ARG_ARRAY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    uint32_t count;
+    status = napi_get_array_length(env, args.argv[1], &count);
     assert(status == napi_ok);
 
-    if (argc < 3) {
-        napi_throw_type_error(env, NULL, "Wrong number of arguments");
+    record_t *records = malloc((count > 0 ? count : 1) * sizeof(record_t));
+    if (records == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    char *keys, *values;
+    if (!get_string_array_(env, args.argv[1], count, records, false, &keys)) {
+        free(records);
+        return NULL;
+    }
+    if (!get_string_array_(env, args.argv[2], count, records, true, &values)) {
+        free(keys);
+        free(records);
+        return NULL;
+    }
+
+    error_t err = wrap_write_snapshot(args.name, records, count);
+    free(values);
+    free(keys);
+    free(records);
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return NULL;
+    }
+
+    return NULL;
+}
+
+static napi_value open_snapshot_file(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    size_t count;
+    error_t err = wrap_open_snapshot(args.name, &count);
+    if (err.code != 0) {
+        throw_wrap_error_(env, err);
         return NULL;
     }
 
-    napi_valuetype valuetype0;
-    status = napi_typeof(env, args[0], &valuetype0);
+    napi_value result;
+    status = napi_create_int64(env, (int64_t)count, &result);
     assert(status == napi_ok);
 
-    napi_valuetype valuetype1;
-    status = napi_typeof(env, args[1], &valuetype1);
+    return result;
+}
+
+static napi_value close_snapshot_file(napi_env env, napi_callback_info info) {
+    return call_native_handle_(env, info, wrap_close_snapshot);
+}
+
+typedef struct {
+    napi_env env;
+    napi_value result;
+} snapshot_read_t;
+
+static bool set_snapshot_string_(
+    void *ctx, const char *key_p, int key_len, const char *data_p,
+    int data_len
+) {
+    snapshot_read_t *read = ctx;
+    read->result = create_string_(read->env, data_p, data_len);
+    return true;
+}
+
+static bool set_snapshot_found_(
+    void *ctx, const char *key_p, int key_len, const char *data_p,
+    int data_len
+) {
+    snapshot_read_t *read = ctx;
+    napi_status status = napi_get_boolean(read->env, true, &read->result);
     assert(status == napi_ok);
+    return true;
+}
 
-    napi_valuetype valuetype2;
-    status = napi_typeof(env, args[2], &valuetype2);
+static bool push_snapshot_key_(
+    void *ctx, const char *key_p, int key_len, const char *data_p,
+    int data_len
+) {
+    key_list_t *list = ctx;
+    return push_key_(list, key_p, key_len);
+}
+
+// Visit the record of the key argument, or all records without one, and
+// throw if the file is not open.
+static bool read_snapshot_(
+    napi_env env, napi_callback_info info, bool with_key,
+    snapshot_visit_fn visit, void *ctx
+) {
+    args_t args;
+    ARG_SPEC(spec_key, ARG_NAME, ARG_ANY);
+    ARG_SPEC(spec, ARG_NAME);
+    if (!get_args_(env, info, with_key ? spec_key : spec, &args)) {
+        return false;
+    }
+
+    // keys of a snapshot are not limited to TABLE_KEY_SIZE
+    char *key_p = NULL;
+    size_t key_len = 0;
+    if (with_key) {
+        napi_valuetype valuetype;
+        napi_status status = napi_typeof(env, args.argv[1], &valuetype);
+        assert(status == napi_ok);
+        if (valuetype != napi_string) {
+            napi_throw_type_error(env, NULL, "Wrong arguments");
+            return false;
+        }
+        if (!get_string_content_arg_(env, args.argv[1], &key_p, &key_len)) {
+            return false;
+        }
+    }
+
+    error_t err =
+        wrap_read_snapshot(args.name, key_p, (int)key_len, visit, ctx);
+    if (err.code == -1) {
+        napi_throw_error(env, NULL, "Snapshot file is not open");
+        return false;
+    } else if (err.code != 0) {
+        throw_wrap_error_(env, err);
+        return false;
+    }
+    return true;
+}
+
+static napi_value get_snapshot_string(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    snapshot_read_t read = {env, NULL};
+    status = napi_get_undefined(env, &read.result);
     assert(status == napi_ok);
 
-    bool is_typedarray2;
-    status = napi_is_typedarray(env, args[2], &is_typedarray2);
+    if (!read_snapshot_(env, info, true, set_snapshot_string_, &read)) {
+        return NULL;
+    }
+    return read.result;
+}
+
+static napi_value has_snapshot_key(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    snapshot_read_t read = {env, NULL};
+    status = napi_get_boolean(env, false, &read.result);
     assert(status == napi_ok);
 
-    if (valuetype0 != napi_string || valuetype1 != napi_string ||
-        valuetype2 != napi_object || !is_typedarray2) {
-        napi_throw_type_error(env, NULL, "Wrong arguments");
+    if (!read_snapshot_(env, info, true, set_snapshot_found_, &read)) {
         return NULL;
     }
+    return read.result;
+}
 
-    char name_buf[TABLE_NAME_SIZE];
-    size_t name_bufsize = TABLE_NAME_SIZE;
-    size_t name_len;
-    status = napi_get_value_string_utf8(
-        env, args[0], name_buf, name_bufsize, &name_len
-    );
+static napi_value list_snapshot_keys(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    key_list_t list = {env, NULL, 0};
+    status = napi_create_array(env, &list.keys);
     assert(status == napi_ok);
 
-    if (name_len == name_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long name");
+    if (!read_snapshot_(env, info, false, push_snapshot_key_, &list)) {
         return NULL;
     }
+    return list.keys;
+}
 
-    char key_buf[TABLE_KEY_SIZE];
-    size_t key_bufsize = TABLE_KEY_SIZE;
-    size_t key_len;
-    status = napi_get_value_string_utf8(
-        env, args[1], key_buf, key_bufsize, &key_len
+static napi_value
+configure_handle_cache(napi_env env, napi_callback_info info) {
+    args_t args;
+    ARG_SPEC(spec, ARG_INT, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    if (args.ints[0] < INT32_MIN || args.ints[0] > INT32_MAX) {
+        napi_throw_type_error(env, NULL, "Wrong arguments");
+        return NULL;
+    }
+
+    if (!handle_cache_configure((int)args.ints[0], args.ints[1])) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+
+    return NULL;
+}
+
+static napi_value sweep_handle_cache(napi_env env, napi_callback_info info) {
+    handle_cache_sweep();
+    return NULL;
+}
+
+static void set_number_property_(
+    napi_env env, napi_value object, const char *name, double value
+) {
+    napi_status status;
+    napi_value number;
+    status = napi_create_double(env, value, &number);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, object, name, number);
+    assert(status == napi_ok);
+}
+
+static napi_value
+get_handle_cache_stats(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    handle_cache_stats_t stats;
+    handle_cache_stats(&stats);
+
+    napi_value result;
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    set_number_property_(env, result, "hits", (double)stats.hits);
+    set_number_property_(env, result, "misses", (double)stats.misses);
+    set_number_property_(env, result, "evictions", (double)stats.evictions);
+    set_number_property_(env, result, "opens", (double)stats.open_count);
+    set_number_property_(
+        env, result, "openTimeTotalMs", (double)stats.open_ns_total / 1e6
+    );
+    set_number_property_(
+        env, result, "openTimeMaxMs", (double)stats.open_ns_max / 1e6
+    );
+    set_number_property_(env, result, "openHandles", stats.open_handles);
+
+    return result;
+}
+
+typedef struct {
+    napi_async_work work;
+    napi_deferred deferred;
+    char name[TABLE_NAME_SIZE];
+    int block_size;
+    // what the promise resolves to
+    enum { TABLE_RESULT_NONE, TABLE_RESULT_STATS, TABLE_RESULT_FOUND } result;
+    table_stats_t stats;
+    // keys to preload, pointing into `keys`
+    record_t *records;
+    char *keys;
+    int count;
+    int found;
+    error_t err;
+} table_work_t;
+
+static void execute_analyze_(napi_env env, void *data) {
+    table_work_t *table = data;
+    table->err = wrap_analyze(table->name, &table->stats);
+}
+
+static void execute_rebuild_(napi_env env, void *data) {
+    table_work_t *table = data;
+    table->err = wrap_rebuild(table->name, table->block_size);
+}
+
+static void execute_create_(napi_env env, void *data) {
+    table_work_t *table = data;
+    table->err = wrap_create_db(table->name, table->block_size);
+}
+
+static void execute_preload_(napi_env env, void *data) {
+    table_work_t *table = data;
+    table->err =
+        wrap_preload(table->name, table->records, table->count, &table->found);
+}
+
+static napi_value create_bins_(napi_env env, const uint64_t *bins) {
+    napi_status status;
+
+    napi_value array;
+    status = napi_create_array_with_length(env, SIZE_BINS, &array);
+    assert(status == napi_ok);
+    for (uint32_t i = 0; i < SIZE_BINS; i++) {
+        napi_value count;
+        status = napi_create_double(env, (double)bins[i], &count);
+        assert(status == napi_ok);
+        status = napi_set_element(env, array, i, count);
+        assert(status == napi_ok);
+    }
+    return array;
+}
+
+static napi_value create_stats_(napi_env env, const table_stats_t *stats) {
+    napi_status status;
+
+    napi_value result;
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    set_number_property_(env, result, "records", (double)stats->records);
+    set_number_property_(env, result, "siblings", (double)stats->siblings);
+    set_number_property_(env, result, "keyBytes", (double)stats->key_bytes);
+    set_number_property_(env, result, "valueBytes", (double)stats->data_bytes);
+    status = napi_set_named_property(
+        env, result, "keySizes", create_bins_(env, stats->key_sizes)
     );
     assert(status == napi_ok);
+    status = napi_set_named_property(
+        env, result, "valueSizes", create_bins_(env, stats->data_sizes)
+    );
+    assert(status == napi_ok);
+    status = napi_set_named_property(
+        env, result, "recordSizes", create_bins_(env, stats->record_sizes)
+    );
+    assert(status == napi_ok);
+    set_number_property_(
+        env, result, "multiBlockRecords", (double)stats->multi_block
+    );
+    set_number_property_(env, result, "blockSize", stats->block_size);
+    set_number_property_(env, result, "directoryDepth", stats->dir_depth);
+    set_number_property_(
+        env, result, "bucketSize", (double)stats->bucket_elems
+    );
+    set_number_property_(
+        env, result, "bucketCount", (double)stats->bucket_count
+    );
+    set_number_property_(env, result, "cacheSize", (double)stats->cache_size);
+    set_number_property_(env, result, "fileSize", (double)stats->file_size);
+
+    return result;
+}
+
+// Shared by analyzeTable, rebuildTable, createTableAsync and preloadKeys.
+static void free_table_work_(table_work_t *table) {
+    free(table->keys);
+    free(table->records);
+    free(table);
+}
+
+static void complete_table_work_(
+    napi_env env, napi_status work_status, void *data
+) {
+    napi_status status;
+    table_work_t *table = data;
+
+    napi_value result;
+    if (work_status != napi_ok) {
+        napi_value message;
+        status = napi_create_string_utf8(
+            env, "Work cancelled", NAPI_AUTO_LENGTH, &message
+        );
+        assert(status == napi_ok);
+        status = napi_create_error(env, NULL, message, &result);
+        assert(status == napi_ok);
+        status = napi_reject_deferred(env, table->deferred, result);
+    } else if (table->err.code != 0) {
+        result = create_wrap_error_(env, table->err);
+        status = napi_reject_deferred(env, table->deferred, result);
+    } else {
+        if (table->result == TABLE_RESULT_STATS) {
+            result = create_stats_(env, &table->stats);
+        } else if (table->result == TABLE_RESULT_FOUND) {
+            status = napi_create_int32(env, table->found, &result);
+            assert(status == napi_ok);
+        } else {
+            status = napi_get_undefined(env, &result);
+            assert(status == napi_ok);
+        }
+        status = napi_resolve_deferred(env, table->deferred, result);
+    }
+    assert(status == napi_ok);
+
+    napi_delete_async_work(env, table->work);
+    free_table_work_(table);
+}
 
-    if (key_len == key_bufsize - 1) {
-        napi_throw_error(env, NULL, "Too long key");
+static table_work_t *
+new_table_work_(napi_env env, const char *name, int block_size) {
+    table_work_t *table = calloc(1, sizeof(table_work_t));
+    if (table == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
         return NULL;
     }
+    memcpy(table->name, name, TABLE_NAME_SIZE);
+    table->block_size = block_size;
+    return table;
+}
 
-    char *content_buf;
-    napi_typedarray_type content_type;
-    size_t content_len;
-    size_t content_offset;
-    status = napi_get_typedarray_info(
-        env, args[2], &content_type, &content_len, (void *)(&content_buf), NULL,
-        &content_offset
+static napi_value queue_table_work_(
+    napi_env env, table_work_t *table, napi_async_execute_callback execute,
+    const char *resource
+) {
+    napi_status status;
+
+    napi_value promise;
+    status = napi_create_promise(env, &table->deferred, &promise);
+    assert(status == napi_ok);
+
+    napi_value resource_name;
+    status =
+        napi_create_string_utf8(env, resource, NAPI_AUTO_LENGTH, &resource_name);
+    assert(status == napi_ok);
+
+    status = napi_create_async_work(
+        env, NULL, resource_name, execute, complete_table_work_, table,
+        &table->work
     );
     assert(status == napi_ok);
+    status = napi_queue_async_work(env, table->work);
+    assert(status == napi_ok);
 
-    if (content_type != napi_uint8_array || content_offset != 0) {
-        napi_throw_error(env, NULL, "Invalid content type");
+    return promise;
+}
+
+static napi_value analyze_table(napi_env env, napi_callback_info info) {
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    // UInt8Array from empty string or undefined will be NULL content
-    if (content_len == 0 && content_buf == NULL) {
-        content_buf = "";
+    table_work_t *table = new_table_work_(env, args.name, 0);
+    if (table == NULL) {
+        return NULL;
     }
+    table->result = TABLE_RESULT_STATS;
 
-    error_t err =
-        wrap_replace(name_buf, key_buf, key_len, content_buf, content_len);
+    return queue_table_work_(env, table, execute_analyze_, "gdbm.analyzeTable");
+}
 
-    if (err.code != 0) {
-        char error_code_buf[ERROR_CODE_SIZE];
-        snprintf(error_code_buf, ERROR_CODE_SIZE, "GDBM_ERR_%d", err.code);
-        char error_msg_buf[ERROR_BUFFER_SIZE];
-        snprintf(
-            error_msg_buf, ERROR_BUFFER_SIZE, "[GDBM] %s",
-            err.message != NULL ? err.message : "unexpected error"
-        );
-        napi_throw_error(env, error_code_buf, error_msg_buf);
+static napi_value rebuild_table(napi_env env, napi_callback_info info) {
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
         return NULL;
     }
 
-    napi_value result;
-    status = napi_get_undefined(env, &result);
+    if (args.ints[0] < 1 || args.ints[0] > INT32_MAX) {
+        napi_throw_range_error(env, NULL, "Block size out of range");
+        return NULL;
+    }
+
+    table_work_t *table = new_table_work_(env, args.name, (int)args.ints[0]);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    return queue_table_work_(env, table, execute_rebuild_, "gdbm.rebuildTable");
+}
+
+static napi_value create_table_async(napi_env env, napi_callback_info info) {
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_INT);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    if (args.ints[0] < 0 || args.ints[0] > INT32_MAX) {
+        napi_throw_range_error(env, NULL, "Block size out of range");
+        return NULL;
+    }
+
+    table_work_t *table = new_table_work_(env, args.name, (int)args.ints[0]);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    return queue_table_work_(
+        env, table, execute_create_, "gdbm.createTableAsync"
+    );
+}
+
+static napi_value preload_keys(napi_env env, napi_callback_info info) {
+    napi_status status;
+
+    args_t args;
+    ARG_SPEC(spec, ARG_NAME, ARG_ARRAY);
+    if (!get_args_(env, info, spec, &args)) {
+        return NULL;
+    }
+
+    uint32_t count;
+    status = napi_get_array_length(env, args.argv[1], &count);
     assert(status == napi_ok);
+    if (count > INT32_MAX) {
+        napi_throw_range_error(env, NULL, "Too many keys");
+        return NULL;
+    }
 
-    return result;
+    table_work_t *table = new_table_work_(env, args.name, 0);
+    if (table == NULL) {
+        return NULL;
+    }
+    table->result = TABLE_RESULT_FOUND;
+    table->count = (int)count;
+    table->records = calloc(count > 0 ? count : 1, sizeof(record_t));
+    if (table->records == NULL) {
+        free_table_work_(table);
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    if (!get_string_array_(
+            env, args.argv[1], count, table->records, false, &table->keys
+        )) {
+        free_table_work_(table);
+        return NULL;
+    }
+
+    return queue_table_work_(env, table, execute_preload_, "gdbm.preloadKeys");
 }
 
 napi_property_descriptor
@@ -685,6 +3266,8 @@ method_desc_(const char *name, napi_value (*cb)(napi_env, napi_callback_info)) {
 #ifdef DEBUG
     print_gdbm_version();
 #endif
+    // each thread running JavaScript loads the module for itself
+    wrap_init_js_thread();
 
     napi_property_descriptor descriptors[] = {
         method_desc_("createTable", create_table),
@@ -694,9 +3277,73 @@ method_desc_(const char *name, napi_value (*cb)(napi_env, napi_callback_info)) {
         method_desc_("removeRecord", remove_record),
         method_desc_("hasKey", has_key),
         method_desc_("getContent", get_content),
+        method_desc_("getString", get_string),
+        method_desc_("readInto", read_into),
+        method_desc_("setCopyThreshold", set_copy_threshold),
+        method_desc_("setFrozenSet", set_frozen_set),
         method_desc_("updateContent", update_content),
+        method_desc_("upsert", upsert),
+        method_desc_("replaceReturningOld", replace_returning_old),
+        method_desc_("deleteReturningValue", delete_returning_value),
+        method_desc_("getSibling", get_sibling),
+        method_desc_("getObject", get_object),
+        method_desc_("setSibling", set_sibling),
+        method_desc_("incr", incr),
+        method_desc_("getCounters", get_counters),
+        method_desc_("getStrings", get_strings),
+        method_desc_("getObjects", get_objects),
+        method_desc_("insertRecords", insert_records),
+        method_desc_("compareAndSwapRecords", compare_and_swap_records),
+        method_desc_("commitBatch", commit_batch),
+        method_desc_("scan", scan),
+        method_desc_("scanKeys", scan_keys),
+        method_desc_("analyzeTable", analyze_table),
+        method_desc_("rebuildTable", rebuild_table),
+        method_desc_("createTableAsync", create_table_async),
+        method_desc_("preloadKeys", preload_keys),
+        method_desc_("openKeyIndex", open_key_index),
+        method_desc_("closeKeyIndex", close_key_index),
+        method_desc_("queryKeys", query_keys),
+        method_desc_("openMemoryTable", open_memory_table),
+        method_desc_("closeMemoryTable", close_memory_table),
+        method_desc_("snapshotMemoryTable", snapshot_memory_table),
+        method_desc_("writeSnapshotFile", write_snapshot_file),
+        method_desc_("openSnapshotFile", open_snapshot_file),
+        method_desc_("closeSnapshotFile", close_snapshot_file),
+        method_desc_("getSnapshotString", get_snapshot_string),
+        method_desc_("hasSnapshotKey", has_snapshot_key),
+        method_desc_("listSnapshotKeys", list_snapshot_keys),
+        method_desc_("configureHandleCache", configure_handle_cache),
+        method_desc_("sweepHandleCache", sweep_handle_cache),
+        method_desc_("getHandleCacheStats", get_handle_cache_stats),
     };
     napi_status status;
+
+    instance_data_t *instance = calloc(1, sizeof(instance_data_t));
+    if (instance == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    napi_value global, object, object_create;
+    status = napi_get_global(env, &global);
+    assert(status == napi_ok);
+    status = napi_get_named_property(env, global, "Object", &object);
+    assert(status == napi_ok);
+    status = napi_get_named_property(env, object, "create", &object_create);
+    assert(status == napi_ok);
+    status =
+        napi_create_reference(env, object_create, 1, &instance->object_create);
+    assert(status == napi_ok);
+
+    status = napi_set_instance_data(
+        env, instance, finalize_instance_data, NULL
+    );
+    if (status != napi_ok) {
+        free(instance);
+        napi_throw_error(env, NULL, "Failed to set instance data");
+        return NULL;
+    }
+
     status = napi_define_properties(
         env, exports, sizeof(descriptors) / sizeof(descriptors[0]), descriptors
     );
@@ -21,6 +21,7 @@ limitations under the License.
 
 #define TABLE_NAME_SIZE 128
 #define TABLE_KEY_SIZE 128
+#define SIBLING_KEY_SIZE (TABLE_KEY_SIZE * 2)
 #define TABLE_CONTENT_SIZE 2048
 #define ERROR_CODE_SIZE 32
 #define ERROR_BUFFER_SIZE 512
@@ -15,9 +15,48 @@ limitations under the License.
 */
 
 #include "gdbm_wrapper.h"
+#include "handle_cache.h"
+#include "key_index.h"
+#include "mem_table.h"
+#include "redo_log.h"
+#include "snapshot_file.h"
 #include <gdbm.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SIDECAR_PATH_SIZE 512
+#define REDO_EXT ".redo"
+#define REBUILD_EXT ".rebuild"
+#define LOCK_RETRIES 200
+#define JS_LOCK_RETRIES 2
+#define LOCK_RETRY_US 5000
+
+// Set on threads running JavaScript, see wrap_init_js_thread.
+static _Thread_local bool on_js_thread_ = false;
+
+void wrap_init_js_thread() {
+    on_js_thread_ = true;
+}
+
+// Worker threads may wait about a second for a lock; a thread running
+// JavaScript only a few ms, not to stall its event loop.
+static inline int lock_retries_() {
+    return on_js_thread_ ? JS_LOCK_RETRIES : LOCK_RETRIES;
+}
+
+// A table is either a GDBM file, possibly kept open by the handle cache,
+// or a registered memory table. Writers also hold the key index of the
+// table if it has one.
+typedef struct {
+    GDBM_FILE dbf;
+    mem_table_t *mem;
+    cached_handle_t *handle;
+    int open_flags;
+    key_index_t *index;
+} db_t;
 
 static inline gdbm_error get_errno(GDBM_FILE dbf) {
 #if GDBM_VERSION_MAJOR > 1 || GDBM_VERSION_MINOR >= 13
@@ -40,16 +79,224 @@ void print_gdbm_version() {
     fprintf(stderr, "%s\n", gdbm_version);
 }
 
-GDBM_FILE open_db_(const char *name, int block_size, int open_flags) {
+static GDBM_FILE open_raw_(const char *name, int block_size, int open_flags) {
     int open_mode = 0400 | 0200;
     void (*fatal_func)(const char *);
     fatal_func = NULL;
-    GDBM_FILE dbf =
-        gdbm_open(name, block_size, open_flags, open_mode, fatal_func);
-    return dbf;
+    // another process may hold the file for a moment, e.g. a worker
+    // opening a shared table next to this one
+    for (int retry = 0;; retry++) {
+        GDBM_FILE dbf =
+            gdbm_open(name, block_size, open_flags, open_mode, fatal_func);
+        if (dbf != NULL || retry == lock_retries_() ||
+            (gdbm_errno != GDBM_CANT_BE_READER &&
+             gdbm_errno != GDBM_CANT_BE_WRITER)) {
+            return dbf;
+        }
+        usleep(LOCK_RETRY_US);
+    }
+}
+
+static inline bool sidecar_path_(char *buf, const char *name, const char *ext) {
+    int len = snprintf(buf, SIDECAR_PATH_SIZE, "%s%s", name, ext);
+    return len > 0 && len < SIDECAR_PATH_SIZE;
+}
+
+static int apply_redo_entry_(void *ctx, const redo_entry_t *entry) {
+    GDBM_FILE dbf = ctx;
+    datum key_d = {entry->key_p, entry->key_len};
+    if (entry->op == REDO_STORE) {
+        datum data_d = {entry->data_p, entry->data_len};
+        return gdbm_store(dbf, key_d, data_d, GDBM_REPLACE);
+    }
+    // deleting twice is harmless when a batch is rolled forward again
+    int ret = gdbm_delete(dbf, key_d);
+    return ret == 0 || get_errno(dbf) == GDBM_ITEM_NOT_FOUND ? 0 : -1;
+}
+
+// Roll an interrupted batch forward. `dbf` must be opened as a writer.
+static gdbm_error recover_db_(GDBM_FILE dbf, const char *redo_path) {
+    int ret = redo_log_replay(redo_path, apply_redo_entry_, dbf, NULL);
+    if (ret == -1) {
+        return GDBM_FILE_READ_ERROR;
+    } else if (ret == -2) {
+        gdbm_error errno = get_errno(dbf);
+        return errno != GDBM_NO_ERROR ? errno : GDBM_FILE_WRITE_ERROR;
+    }
+    if (gdbm_sync(dbf) != 0) {
+        return GDBM_FILE_WRITE_ERROR;
+    }
+    return redo_log_remove(redo_path) == 0 ? GDBM_NO_ERROR
+                                           : GDBM_FILE_WRITE_ERROR;
+}
+
+// Finish a batch left behind by a crash or a failed apply, if any. The
+// log must be checked with the table locked, as a writer removes it
+// before unlocking. `dbf` must be opened as a writer.
+static gdbm_error roll_forward_(GDBM_FILE dbf, const char *name) {
+    char redo_path[SIDECAR_PATH_SIZE];
+    if (!sidecar_path_(redo_path, name, REDO_EXT)) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+    return redo_log_exists(redo_path) ? recover_db_(dbf, redo_path)
+                                      : GDBM_NO_ERROR;
+}
+
+static GDBM_FILE open_gdbm_(const char *name, int block_size, int open_flags) {
+    GDBM_FILE dbf = open_raw_(name, block_size, open_flags);
+    if (dbf == NULL || open_flags == GDBM_NEWDB) {
+        return dbf;
+    }
+
+    bool is_reader = open_flags == GDBM_READER;
+    if (is_reader) {
+        char redo_path[SIDECAR_PATH_SIZE];
+        if (!sidecar_path_(redo_path, name, REDO_EXT) ||
+            !redo_log_exists(redo_path)) {
+            return dbf;
+        }
+        // a batch was interrupted; finish it before anyone reads the table
+        gdbm_close(dbf);
+        dbf = open_raw_(name, block_size, GDBM_WRITER);
+        if (dbf == NULL) {
+            return NULL;
+        }
+    }
+
+    gdbm_error errno = roll_forward_(dbf, name);
+    if (errno != GDBM_NO_ERROR) {
+        gdbm_close(dbf);
+        gdbm_errno = errno;
+        return NULL;
+    }
+
+    if (!is_reader) {
+        return dbf;
+    }
+    gdbm_close(dbf);
+    return open_raw_(name, block_size, open_flags);
+}
+
+// Close the cached handle of `name`, waiting for calls using it to end.
+static bool evict_cached_(const char *name) {
+    for (int retry = 0;; retry++) {
+        if (handle_cache_evict(name)) {
+            return true;
+        } else if (retry == lock_retries_()) {
+            return false;
+        }
+        usleep(LOCK_RETRY_US);
+    }
+}
+
+static GDBM_FILE open_cached_(const char *name) {
+    // cached handles serve readers and writers alike
+    return open_gdbm_(name, 0, GDBM_WRITER);
+}
+
+static db_t open_table_(const char *name, int block_size, int open_flags) {
+    mem_table_t *mem = mem_table_acquire(name, open_flags != GDBM_READER);
+    if (mem != NULL) {
+        return (db_t){NULL, mem, NULL, open_flags, NULL};
+    }
+
+    if (open_flags != GDBM_NEWDB) {
+        GDBM_FILE dbf;
+        cached_handle_t *handle = handle_cache_acquire(name, open_cached_, &dbf);
+        if (handle != NULL) {
+            // the handle may be older than the log of a failed apply
+            gdbm_error errno = roll_forward_(dbf, name);
+            if (errno != GDBM_NO_ERROR) {
+                handle_cache_release(handle);
+                gdbm_errno = errno;
+                return (db_t){NULL, NULL, NULL, open_flags, NULL};
+            }
+            return (db_t){dbf, NULL, handle, open_flags, NULL};
+        }
+    }
+
+    GDBM_FILE dbf = open_gdbm_(name, block_size, open_flags);
+    return (db_t){dbf, NULL, NULL, open_flags, NULL};
+}
+
+static inline bool is_open_(db_t db) {
+    return db.dbf != NULL || db.mem != NULL;
+}
+
+static db_t open_db_(const char *name, int block_size, int open_flags) {
+    db_t db = open_table_(name, block_size, open_flags);
+    // the index is locked after the table, like everywhere else
+    if (is_open_(db) && open_flags != GDBM_READER) {
+        db.index = key_index_acquire(name);
+    }
+    return db;
+}
+
+// Keep the key index in step with a main record written or removed.
+static inline void index_note_(db_t db, datum key, bool present) {
+    if (db.index == NULL || memchr(key.dptr, '\0', key.dsize) != NULL) {
+        return;
+    }
+    // a failure leaves the index unusable, which queries report
+    if (present) {
+        key_index_add(db.index, key.dptr, key.dsize);
+    } else {
+        key_index_remove(db.index, key.dptr, key.dsize);
+    }
+}
+
+static inline datum db_fetch_(db_t db, datum key) {
+    return db.mem != NULL ? mem_table_fetch(db.mem, key)
+                          : gdbm_fetch(db.dbf, key);
+}
+
+static inline int db_store_(db_t db, datum key, datum data, int flag) {
+    return db.mem != NULL ? mem_table_store(db.mem, key, data, flag)
+                          : gdbm_store(db.dbf, key, data, flag);
+}
+
+static inline int db_delete_(db_t db, datum key) {
+    return db.mem != NULL ? mem_table_delete(db.mem, key)
+                          : gdbm_delete(db.dbf, key);
 }
 
-error_t close_db_(GDBM_FILE dbf) {
+static inline int db_exists_(db_t db, datum key) {
+    return db.mem != NULL ? mem_table_exists(db.mem, key)
+                          : gdbm_exists(db.dbf, key);
+}
+
+static inline datum db_firstkey_(db_t db) {
+    return db.mem != NULL ? mem_table_firstkey(db.mem)
+                          : gdbm_firstkey(db.dbf);
+}
+
+static inline datum db_nextkey_(db_t db, datum key) {
+    return db.mem != NULL ? mem_table_nextkey(db.mem, key)
+                          : gdbm_nextkey(db.dbf, key);
+}
+
+static inline gdbm_error db_errno_(db_t db) {
+    return db.mem != NULL ? mem_table_errno(db.mem) : get_errno(db.dbf);
+}
+
+static error_t close_db_(db_t db) {
+    if (db.index != NULL) {
+        key_index_release(db.index);
+    }
+
+    if (db.mem != NULL) {
+        mem_table_release(db.mem);
+        return to_no_error();
+    }
+
+    if (db.handle != NULL) {
+        // the handle stays open, so flush what closing would have flushed
+        int ret = db.open_flags != GDBM_READER ? gdbm_sync(db.dbf) : 0;
+        handle_cache_release(db.handle);
+        return ret != 0 ? to_error(GDBM_FILE_WRITE_ERROR) : to_no_error();
+    }
+
+    GDBM_FILE dbf = db.dbf;
     error_t err;
 #if GDBM_VERSION_MAJOR > 1 || GDBM_VERSION_MINOR >= 17
     int ret = gdbm_close(dbf);
@@ -63,47 +310,76 @@ error_t close_db_(GDBM_FILE dbf) {
 
 error_t wrap_create_db(const char *name, int block_size) {
     int open_flags = GDBM_WRCREAT;
-    GDBM_FILE dbf = open_db_(name, block_size, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, block_size, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
 
-    error_t err = close_db_(dbf);
+    error_t err = close_db_(db);
 
     return err;
 }
 
 error_t wrap_clean_db(const char *name, int block_size) {
+    if (!evict_cached_(name)) {
+        return to_error(GDBM_CANT_BE_WRITER);
+    }
+
     int open_flags = GDBM_NEWDB;
-    GDBM_FILE dbf = open_db_(name, block_size, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, block_size, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
 
-    error_t err = close_db_(dbf);
+    if (db.index != NULL) {
+        key_index_clear(db.index);
+    }
+
+    if (db.mem != NULL) {
+        gdbm_error errno = mem_table_clear(db.mem, block_size);
+        close_db_(db);
+        return to_error(errno);
+    }
+
+    // a pending batch must not be replayed into the new table
+    char redo_path[SIDECAR_PATH_SIZE];
+    if (sidecar_path_(redo_path, name, REDO_EXT)) {
+        redo_log_remove(redo_path);
+    }
+
+    error_t err = close_db_(db);
 
     return err;
 }
 
 error_t wrap_count(const char *name, int *count) {
     int open_flags = GDBM_READER;
-    GDBM_FILE dbf = open_db_(name, 0, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
 
-    datum key = gdbm_firstkey(dbf);
+    if (db.mem != NULL) {
+        *count = mem_table_count(db.mem);
+        return close_db_(db);
+    }
+
+    datum key = db_firstkey_(db);
     int counter = 0;
     while (key.dptr != NULL) {
-        counter++;
-        datum next_key = gdbm_nextkey(dbf, key);
+        // keys with a NUL byte are sibling records (counters etc.)
+        if (memchr(key.dptr, '\0', key.dsize) == NULL) {
+            counter++;
+        }
+        datum next_key = db_nextkey_(db, key);
+        free(key.dptr);
         key = next_key;
     }
 
-    error_t err = close_db_(dbf);
+    error_t err = close_db_(db);
     if (err.code != GDBM_NO_ERROR) {
         return err;
     }
@@ -114,11 +390,12 @@ error_t wrap_count(const char *name, int *count) {
 }
 
 error_t wrap_insert(
-    const char *name, char *key_p, int key_len, char *data_p, int data_len
+    const char *name, char *key_p, int key_len, char *data_p, int data_len,
+    const record_t *siblings, int sibling_count
 ) {
     int open_flags = GDBM_WRITER;
-    GDBM_FILE dbf = open_db_(name, 0, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
@@ -128,10 +405,20 @@ error_t wrap_insert(
 
     // insert
     int insert_flag = GDBM_INSERT;
-    int ret = gdbm_store(dbf, key_d, content_d, insert_flag);
+    int ret = db_store_(db, key_d, content_d, insert_flag);
+    if (ret == 0) {
+        index_note_(db, key_d, true);
+    }
+
+    // siblings left over by a failed remove are overwritten
+    for (int i = 0; ret == 0 && i < sibling_count; i++) {
+        datum sibling_key_d = {siblings[i].key_p, siblings[i].key_len};
+        datum sibling_d = {siblings[i].data_p, siblings[i].data_len};
+        ret = db_store_(db, sibling_key_d, sibling_d, GDBM_REPLACE);
+    }
 
-    gdbm_error errno = get_errno(dbf);
-    error_t err_close = close_db_(dbf);
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
     if (err_close.code != GDBM_NO_ERROR) {
         return err_close;
     }
@@ -148,10 +435,58 @@ error_t wrap_insert(
     return err;
 }
 
-error_t wrap_remove(const char *name, char *key_p, int key_len) {
+error_t wrap_insert_many(
+    const char *name, const record_t *records, int count,
+    const record_t *siblings, const int *sibling_counts, bool *inserted
+) {
+    for (int i = 0; i < count; i++) {
+        inserted[i] = false;
+    }
+
     int open_flags = GDBM_WRITER;
-    GDBM_FILE dbf = open_db_(name, 0, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    int ret = 0;
+    const record_t *sibling = siblings;
+    for (int i = 0; ret >= 0 && i < count; i++) {
+        datum key_d = {records[i].key_p, records[i].key_len};
+        datum content_d = {records[i].data_p, records[i].data_len};
+        int sibling_count = sibling_counts[i];
+
+        ret = db_store_(db, key_d, content_d, GDBM_INSERT);
+        if (ret == 0) {
+            index_note_(db, key_d, true);
+        }
+        // siblings left over by a failed remove are overwritten
+        for (int j = 0; ret == 0 && j < sibling_count; j++) {
+            datum sibling_key_d = {sibling[j].key_p, sibling[j].key_len};
+            datum sibling_d = {sibling[j].data_p, sibling[j].data_len};
+            ret = db_store_(db, sibling_key_d, sibling_d, GDBM_REPLACE);
+        }
+        inserted[i] = ret == 0;
+        sibling += sibling_count;
+    }
+
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return ret >= 0 ? to_no_error() : to_error(errno);
+}
+
+error_t wrap_remove(
+    const char *name, char *key_p, int key_len, const record_t *siblings,
+    int sibling_count
+) {
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
@@ -159,10 +494,22 @@ error_t wrap_remove(const char *name, char *key_p, int key_len) {
     datum key_d = {key_p, key_len};
 
     // delete
-    int ret = gdbm_delete(dbf, key_d);
+    int ret = db_delete_(db, key_d);
+    if (ret == 0) {
+        index_note_(db, key_d, false);
+    }
+
+    gdbm_error errno = db_errno_(db);
+    for (int i = 0; ret == 0 && i < sibling_count; i++) {
+        datum sibling_key_d = {siblings[i].key_p, siblings[i].key_len};
+        if (db_delete_(db, sibling_key_d) != 0 &&
+            db_errno_(db) != GDBM_ITEM_NOT_FOUND) {
+            ret = -1;
+            errno = db_errno_(db);
+        }
+    }
 
-    gdbm_error errno = get_errno(dbf);
-    error_t err_close = close_db_(dbf);
+    error_t err_close = close_db_(db);
     if (err_close.code != GDBM_NO_ERROR) {
         return err_close;
     }
@@ -179,20 +526,58 @@ error_t wrap_remove(const char *name, char *key_p, int key_len) {
     return err;
 }
 
+error_t wrap_store_sibling(
+    const char *name, char *key_p, int key_len, const record_t *sibling
+) {
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    datum key_d = {key_p, key_len};
+    datum sibling_key_d = {sibling->key_p, sibling->key_len};
+
+    // siblings only live next to an existing record
+    int ret = db_exists_(db, key_d) ? 0 : -1;
+    gdbm_error errno =
+        db_errno_(db) != GDBM_NO_ERROR ? db_errno_(db) : GDBM_ITEM_NOT_FOUND;
+
+    if (ret == 0 && sibling->data_p == NULL) {
+        ret = db_delete_(db, sibling_key_d);
+        errno = db_errno_(db);
+        if (ret != 0 && errno == GDBM_ITEM_NOT_FOUND) {
+            ret = 0;
+        }
+    } else if (ret == 0) {
+        datum sibling_d = {sibling->data_p, sibling->data_len};
+        ret = db_store_(db, sibling_key_d, sibling_d, GDBM_REPLACE);
+        errno = db_errno_(db);
+    }
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return ret == 0 ? to_no_error() : to_error(errno);
+}
+
 error_t wrap_exists(const char *name, char *key_p, int key_len, bool *result) {
     int open_flags = GDBM_READER;
-    GDBM_FILE dbf = open_db_(name, 0, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
 
     datum key_d = {key_p, key_len};
 
-    int ret = gdbm_exists(dbf, key_d);
+    int ret = db_exists_(db, key_d);
 
-    gdbm_error errno = get_errno(dbf);
-    error_t err_close = close_db_(dbf);
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
     if (err_close.code != GDBM_NO_ERROR) {
         return err_close;
     }
@@ -207,12 +592,43 @@ error_t wrap_exists(const char *name, char *key_p, int key_len, bool *result) {
     return err;
 }
 
+error_t wrap_preload(
+    const char *name, const record_t *records, int count, int *found
+) {
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    gdbm_error errno = GDBM_NO_ERROR;
+    *found = 0;
+    for (int i = 0; i < count && errno == GDBM_NO_ERROR; i++) {
+        datum key_d = {records[i].key_p, records[i].key_len};
+        if (db_exists_(db, key_d)) {
+            (*found)++;
+        } else {
+            errno = db_errno_(db);
+            if (errno == GDBM_ITEM_NOT_FOUND) {
+                errno = GDBM_NO_ERROR;
+            }
+        }
+    }
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+    return to_error(errno);
+}
+
 error_t wrap_fetch(
     const char *name, char *key_p, int key_len, char **data_p, int *data_len
 ) {
     int open_flags = GDBM_READER;
-    GDBM_FILE dbf = open_db_(name, 0, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
@@ -220,10 +636,10 @@ error_t wrap_fetch(
     datum key_d = {key_p, key_len};
 
     // fetch
-    datum content = gdbm_fetch(dbf, key_d);
+    datum content = db_fetch_(db, key_d);
 
-    gdbm_error errno = get_errno(dbf);
-    error_t err_close = close_db_(dbf);
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
     if (err_close.code != GDBM_NO_ERROR) {
         return err_close;
     }
@@ -241,12 +657,106 @@ error_t wrap_fetch(
     return err;
 }
 
+error_t wrap_fetch_many(
+    const char *name, int count, char **key_ps, int *key_lens, char **data_ps,
+    int *data_lens
+) {
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    error_t err = to_no_error();
+    int fetched = 0;
+    for (; fetched < count && err.code == GDBM_NO_ERROR; fetched++) {
+        datum key_d = {key_ps[fetched], key_lens[fetched]};
+        datum content = db_fetch_(db, key_d);
+        data_ps[fetched] = content.dptr;
+        data_lens[fetched] = content.dsize;
+        if (content.dptr == NULL) {
+            gdbm_error errno = db_errno_(db);
+            if (errno != GDBM_ITEM_NOT_FOUND) {
+                err = to_error(errno);
+            }
+        }
+    }
+
+    error_t err_close = close_db_(db);
+    if (err.code == GDBM_NO_ERROR) {
+        err = err_close;
+    }
+    if (err.code != GDBM_NO_ERROR) {
+        for (int i = 0; i < fetched; i++) {
+            free(data_ps[i]);
+            data_ps[i] = NULL;
+        }
+    }
+
+    return err;
+}
+
+error_t wrap_read_into(
+    const char *name, char *key_p, int key_len, char *buf, size_t bufsize,
+    size_t *data_len
+) {
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    datum key_d = {key_p, key_len};
+
+    // memory tables copy straight from their arena
+    int ret = 0;
+    if (db.mem != NULL) {
+        ret = mem_table_read(db.mem, key_d, buf, bufsize, data_len);
+    } else {
+        datum content = db_fetch_(db, key_d);
+        if (content.dptr != NULL) {
+            *data_len = content.dsize;
+            if ((size_t)content.dsize <= bufsize) {
+                memcpy(buf, content.dptr, content.dsize);
+            }
+            free(content.dptr);
+        } else {
+            ret = -1;
+        }
+    }
+
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    if (ret != 0) {
+        return errno == GDBM_ITEM_NOT_FOUND
+                   ? (error_t){-1, gdbm_strerror(errno)}
+                   : to_error(errno);
+    }
+    return to_no_error();
+}
+
 error_t wrap_replace(
     const char *name, char *key_p, int key_len, char *data_p, int data_len
+) {
+    error_t err = wrap_replace_returning_old(
+        name, key_p, key_len, data_p, data_len, NULL, NULL
+    );
+    // a missing key is an error for a plain replace
+    return err.code == -1 ? to_error(GDBM_ITEM_NOT_FOUND) : err;
+}
+
+error_t wrap_upsert(
+    const char *name, char *key_p, int key_len, char *data_p, int data_len
 ) {
     int open_flags = GDBM_WRITER;
-    GDBM_FILE dbf = open_db_(name, 0, open_flags);
-    if (dbf == NULL) {
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
         error_t err = to_error(gdbm_errno);
         return err;
     }
@@ -254,29 +764,1001 @@ error_t wrap_replace(
     datum key_d = {key_p, key_len};
     datum content_d = {data_p, data_len};
 
-    // check exists
-    int ret_exists = gdbm_exists(dbf, key_d);
-    if (ret_exists == 0) {
-        gdbm_error errno = get_errno(dbf);
-        error_t err_close = close_db_(dbf);
-        if (err_close.code != GDBM_NO_ERROR) {
-            return err_close;
+    int ret = db_store_(db, key_d, content_d, GDBM_REPLACE);
+    if (ret == 0) {
+        index_note_(db, key_d, true);
+    }
+
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return ret == 0 ? to_no_error() : to_error(errno);
+}
+
+// Whether the record of `key_d` still holds the data of `expected`, or is
+// missing if `expected` has no data.
+static error_t same_record_(
+    db_t db, datum key_d, const record_t *expected, bool *same
+) {
+    datum old = db_fetch_(db, key_d);
+    if (old.dptr == NULL) {
+        if (db_errno_(db) != GDBM_ITEM_NOT_FOUND) {
+            return to_error(db_errno_(db));
+        }
+        *same = expected->data_p == NULL;
+        return to_no_error();
+    }
+    *same = expected->data_p != NULL && old.dsize == expected->data_len &&
+            memcmp(old.dptr, expected->data_p, old.dsize) == 0;
+    free(old.dptr);
+    return to_no_error();
+}
+
+error_t wrap_compare_and_swap_many(
+    const char *name, const record_t *records, const record_t *expected,
+    int count, bool *swapped
+) {
+    for (int i = 0; i < count; i++) {
+        swapped[i] = false;
+    }
+
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    // the writer lock keeps other writers out between the fetch and the
+    // store, so nothing can change or remove the record in between
+    int ret = 0;
+    for (int i = 0; ret == 0 && i < count; i++) {
+        datum key_d = {records[i].key_p, records[i].key_len};
+        bool same = false;
+        if (same_record_(db, key_d, &expected[i], &same).code !=
+            GDBM_NO_ERROR) {
+            ret = -1;
+            continue;
+        }
+        if (!same) {
+            continue;
+        }
+
+        bool store = records[i].data_p != NULL;
+        datum content_d = {records[i].data_p, records[i].data_len};
+        ret = store ? db_store_(db, key_d, content_d, GDBM_REPLACE)
+                    : db_delete_(db, key_d);
+        swapped[i] = ret == 0;
+        if (ret == 0) {
+            index_note_(db, key_d, store);
         }
-        errno = errno == GDBM_NO_ERROR ? GDBM_ITEM_NOT_FOUND : errno;
-        error_t err_exsits = to_error(errno);
-        return err_exsits;
     }
 
-    // replace
-    int replace_flag = GDBM_REPLACE;
-    int ret = gdbm_store(dbf, key_d, content_d, replace_flag);
+    gdbm_error errno = db_errno_(db);
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return ret == 0 ? to_no_error() : to_error(errno);
+}
+
+error_t wrap_replace_returning_old(
+    const char *name, char *key_p, int key_len, char *data_p, int data_len,
+    char **old_p, int *old_len
+) {
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    datum key_d = {key_p, key_len};
+    datum content_d = {data_p, data_len};
+    datum old = {NULL, 0};
+
+    int ret;
+    if (db.mem != NULL) {
+        ret = mem_table_swap(
+            db.mem, key_d, content_d, true, old_p != NULL ? &old : NULL
+        );
+    } else {
+        // GDBM has no store that reports the previous data; the lookup
+        // leaves the bucket cached for the store that follows
+        bool exists;
+        if (old_p != NULL) {
+            old = gdbm_fetch(db.dbf, key_d);
+            exists = old.dptr != NULL;
+        } else {
+            exists = gdbm_exists(db.dbf, key_d);
+        }
+        ret = exists ? gdbm_store(db.dbf, key_d, content_d, GDBM_REPLACE)
+                     : -1;
+    }
 
-    error_t err_close = close_db_(dbf);
+    gdbm_error errno = db_errno_(db);
+    if (ret != 0 && errno == GDBM_NO_ERROR) {
+        errno = GDBM_ITEM_NOT_FOUND;
+    }
+    error_t err_close = close_db_(db);
     if (err_close.code != GDBM_NO_ERROR) {
+        free(old.dptr);
         return err_close;
     }
 
-    error_t err = ret == 0 ? to_no_error() : to_error(gdbm_errno);
+    if (ret != 0) {
+        free(old.dptr);
+        return errno == GDBM_ITEM_NOT_FOUND
+                   ? (error_t){-1, gdbm_strerror(errno)}
+                   : to_error(errno);
+    }
+
+    if (old_p != NULL) {
+        *old_p = old.dptr;
+        *old_len = old.dsize;
+    }
+    return to_no_error();
+}
 
-    return err;
+error_t wrap_delete_returning_value(
+    const char *name, char *key_p, int key_len, const record_t *siblings,
+    int sibling_count, char **data_p, int *data_len
+) {
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    datum key_d = {key_p, key_len};
+    datum old = {NULL, 0};
+
+    int ret;
+    if (db.mem != NULL) {
+        ret = mem_table_take(db.mem, key_d, &old);
+    } else {
+        old = gdbm_fetch(db.dbf, key_d);
+        ret = old.dptr != NULL ? gdbm_delete(db.dbf, key_d) : -1;
+    }
+    if (ret == 0) {
+        index_note_(db, key_d, false);
+    }
+
+    gdbm_error errno = db_errno_(db);
+    for (int i = 0; ret == 0 && i < sibling_count; i++) {
+        datum sibling_key_d = {siblings[i].key_p, siblings[i].key_len};
+        if (db_delete_(db, sibling_key_d) != 0 &&
+            db_errno_(db) != GDBM_ITEM_NOT_FOUND) {
+            ret = -1;
+            errno = db_errno_(db);
+        }
+    }
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        free(old.dptr);
+        return err_close;
+    }
+
+    if (ret != 0) {
+        free(old.dptr);
+        return errno == GDBM_ITEM_NOT_FOUND
+                   ? (error_t){-1, gdbm_strerror(errno)}
+                   : to_error(errno);
+    }
+
+    *data_p = old.dptr;
+    *data_len = old.dsize;
+    return to_no_error();
+}
+
+static inline bool decode_counter_(datum data, int64_t *value) {
+    if (data.dsize != sizeof(int64_t)) {
+        return false;
+    }
+    memcpy(value, data.dptr, sizeof(int64_t));
+    return true;
+}
+
+error_t wrap_incr(
+    const char *name, char *key_p, int key_len, int64_t delta, int64_t *result
+) {
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    datum key_d = {key_p, key_len};
+
+    // fetch and store under the same writer lock
+    int64_t value = 0;
+    error_t err = to_no_error();
+    datum old_d = db_fetch_(db, key_d);
+    if (old_d.dptr != NULL) {
+        if (!decode_counter_(old_d, &value)) {
+            err = (error_t){GDBM_ILLEGAL_DATA, "Not a counter record"};
+        }
+        free(old_d.dptr);
+    } else {
+        gdbm_error errno = db_errno_(db);
+        if (errno != GDBM_ITEM_NOT_FOUND) {
+            err = to_error(errno);
+        }
+    }
+
+    if (err.code == GDBM_NO_ERROR) {
+        if ((delta > 0 && value > INT64_MAX - delta) ||
+            (delta < 0 && value < INT64_MIN - delta)) {
+            err = (error_t){GDBM_ILLEGAL_DATA, "Counter overflow"};
+        } else {
+            value += delta;
+            datum value_d = {(char *)&value, sizeof(int64_t)};
+            int ret = db_store_(db, key_d, value_d, GDBM_REPLACE);
+            if (ret != 0) {
+                err = to_error(db_errno_(db));
+            }
+        }
+    }
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    if (err.code == GDBM_NO_ERROR) {
+        *result = value;
+    }
+
+    return err;
+}
+
+error_t wrap_fetch_counters(
+    const char *name, int count, char **key_ps, int *key_lens, int64_t *values,
+    bool *found
+) {
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    error_t err = to_no_error();
+    for (int i = 0; i < count && err.code == GDBM_NO_ERROR; i++) {
+        datum key_d = {key_ps[i], key_lens[i]};
+        datum data = db_fetch_(db, key_d);
+        if (data.dptr != NULL) {
+            found[i] = decode_counter_(data, &values[i]);
+            free(data.dptr);
+        } else {
+            found[i] = false;
+            gdbm_error errno = db_errno_(db);
+            if (errno != GDBM_ITEM_NOT_FOUND) {
+                err = to_error(errno);
+            }
+        }
+    }
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return err;
+}
+
+static inline bool same_key_(const batch_op_t *a, const batch_op_t *b) {
+    return a->key_len == b->key_len &&
+           memcmp(a->key_p, b->key_p, a->key_len) == 0;
+}
+
+// Check the preconditions of every operation and turn them into redo
+// entries. Operations see the effects of the earlier ones in the batch.
+static error_t resolve_batch_(
+    db_t db, const batch_op_t *ops, int count, redo_entry_t *entries,
+    int64_t *counters, bool *satisfied
+) {
+    *satisfied = false;
+    for (int i = 0; i < count; i++) {
+        const batch_op_t *op = &ops[i];
+        datum key_d = {op->key_p, op->key_len};
+
+        int prev = i - 1;
+        while (prev >= 0 && !same_key_(&ops[prev], op)) {
+            prev--;
+        }
+
+        bool exists;
+        datum current = {NULL, 0};
+        bool owns_current = false;
+        if (prev >= 0) {
+            exists = entries[prev].op == REDO_STORE;
+            current = (datum){entries[prev].data_p, entries[prev].data_len};
+        } else if (op->type == BATCH_INCR) {
+            current = db_fetch_(db, key_d);
+            exists = current.dptr != NULL;
+            owns_current = exists;
+            if (!exists && db_errno_(db) != GDBM_ITEM_NOT_FOUND) {
+                return to_error(db_errno_(db));
+            }
+        } else {
+            exists = db_exists_(db, key_d);
+            if (!exists && db_errno_(db) != GDBM_NO_ERROR &&
+                db_errno_(db) != GDBM_ITEM_NOT_FOUND) {
+                return to_error(db_errno_(db));
+            }
+        }
+
+        redo_entry_t *entry = &entries[i];
+        entry->key_p = op->key_p;
+        entry->key_len = op->key_len;
+        entry->op = REDO_STORE;
+        entry->data_p = op->data_p;
+        entry->data_len = op->data_len;
+
+        switch (op->type) {
+        case BATCH_INSERT:
+            if (exists) {
+                return to_no_error();
+            }
+            break;
+        case BATCH_UPDATE:
+            if (!exists) {
+                return to_no_error();
+            }
+            break;
+        case BATCH_UPSERT:
+            break;
+        case BATCH_REMOVE:
+            if (!exists) {
+                return to_no_error();
+            }
+            // fall through
+        case BATCH_DISCARD:
+            entry->op = REDO_DELETE;
+            entry->data_p = NULL;
+            entry->data_len = 0;
+            break;
+        case BATCH_INCR: {
+            int64_t value = 0;
+            bool valid = !exists || decode_counter_(current, &value);
+            if (owns_current) {
+                free(current.dptr);
+            }
+            if (!valid) {
+                return (error_t){GDBM_ILLEGAL_DATA, "Not a counter record"};
+            }
+            if ((op->delta > 0 && value > INT64_MAX - op->delta) ||
+                (op->delta < 0 && value < INT64_MIN - op->delta)) {
+                return (error_t){GDBM_ILLEGAL_DATA, "Counter overflow"};
+            }
+            counters[i] = value + op->delta;
+            entry->data_p = (char *)&counters[i];
+            entry->data_len = sizeof(int64_t);
+            break;
+        }
+        default:
+            return (error_t){GDBM_ILLEGAL_DATA, "Unknown batch operation"};
+        }
+    }
+
+    *satisfied = true;
+    return to_no_error();
+}
+
+// Log the batch as one frame of the memory table's log and apply it.
+static error_t commit_mem_batch_(
+    mem_table_t *mem, const redo_entry_t *entries, int count
+) {
+    if (mem_table_log(mem, entries, count) != 0) {
+        return to_error(mem_table_errno(mem));
+    }
+    for (int i = 0; i < count; i++) {
+        if (mem_table_apply(mem, &entries[i]) != 0) {
+            return to_error(mem_table_errno(mem));
+        }
+    }
+    return to_no_error();
+}
+
+static error_t commit_gdbm_batch_(
+    GDBM_FILE dbf, const char *redo_path, const redo_entry_t *entries,
+    int count
+) {
+    // the log is durable before the table is touched, so the batch is
+    // committed from here on: a crash or a failed apply leaves the log,
+    // which the next open_db_ rolls forward before using the table
+    if (redo_log_write(redo_path, entries, count) != 0) {
+        redo_log_remove(redo_path);
+        return to_error(GDBM_FILE_WRITE_ERROR);
+    }
+    int ret = 0;
+    for (int i = 0; i < count && ret == 0; i++) {
+        ret = apply_redo_entry_(dbf, &entries[i]);
+    }
+    if (ret == 0 && gdbm_sync(dbf) == 0) {
+        redo_log_remove(redo_path);
+    }
+    return to_no_error();
+}
+
+error_t wrap_commit_batch(
+    const char *name, const batch_op_t *ops, int count, bool *committed
+) {
+    *committed = false;
+
+    char redo_path[SIDECAR_PATH_SIZE];
+    if (!sidecar_path_(redo_path, name, REDO_EXT)) {
+        return to_error(GDBM_FILE_OPEN_ERROR);
+    }
+
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    redo_entry_t *entries = malloc(count * sizeof(redo_entry_t));
+    int64_t *counters = malloc(count * sizeof(int64_t));
+    if (entries == NULL || counters == NULL) {
+        free(entries);
+        free(counters);
+        close_db_(db);
+        return to_error(GDBM_MALLOC_ERROR);
+    }
+
+    bool satisfied;
+    error_t err =
+        resolve_batch_(db, ops, count, entries, counters, &satisfied);
+
+    if (err.code == GDBM_NO_ERROR && satisfied) {
+        err = db.mem != NULL
+                  ? commit_mem_batch_(db.mem, entries, count)
+                  : commit_gdbm_batch_(db.dbf, redo_path, entries, count);
+        *committed = err.code == GDBM_NO_ERROR;
+    }
+    for (int i = 0; *committed && i < count; i++) {
+        datum key_d = {entries[i].key_p, entries[i].key_len};
+        index_note_(db, key_d, entries[i].op == REDO_STORE);
+    }
+
+    free(entries);
+    free(counters);
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return err;
+}
+
+error_t wrap_compare_and_swap_all(
+    const char *name, const record_t *records, const record_t *expected,
+    int count, bool *swapped
+) {
+    *swapped = false;
+
+    char redo_path[SIDECAR_PATH_SIZE];
+    if (!sidecar_path_(redo_path, name, REDO_EXT)) {
+        return to_error(GDBM_FILE_OPEN_ERROR);
+    }
+
+    int open_flags = GDBM_WRITER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    redo_entry_t *entries = malloc((count > 0 ? count : 1) *
+                                   sizeof(redo_entry_t));
+    if (entries == NULL) {
+        close_db_(db);
+        return to_error(GDBM_MALLOC_ERROR);
+    }
+
+    // the writer lock keeps other writers out until the commit, so every
+    // record is still as compared when the batch is applied
+    error_t err = to_no_error();
+    bool same = true;
+    for (int i = 0; same && err.code == GDBM_NO_ERROR && i < count; i++) {
+        datum key_d = {records[i].key_p, records[i].key_len};
+        err = same_record_(db, key_d, &expected[i], &same);
+
+        redo_entry_t *entry = &entries[i];
+        entry->key_p = records[i].key_p;
+        entry->key_len = records[i].key_len;
+        entry->op = records[i].data_p != NULL ? REDO_STORE : REDO_DELETE;
+        entry->data_p = records[i].data_p;
+        entry->data_len = records[i].data_len;
+    }
+
+    if (err.code == GDBM_NO_ERROR && same) {
+        err = db.mem != NULL
+                  ? commit_mem_batch_(db.mem, entries, count)
+                  : commit_gdbm_batch_(db.dbf, redo_path, entries, count);
+        *swapped = err.code == GDBM_NO_ERROR;
+    }
+    for (int i = 0; *swapped && i < count; i++) {
+        datum key_d = {entries[i].key_p, entries[i].key_len};
+        index_note_(db, key_d, entries[i].op == REDO_STORE);
+    }
+
+    free(entries);
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return err;
+}
+
+error_t wrap_scan(
+    const char *name, char *cursor_p, int cursor_len, const char **suffixes,
+    int suffix_count, bool keys_only, int budget, scan_visit_fn visit,
+    void *ctx, char **next_cursor_p, int *next_cursor_len
+) {
+    *next_cursor_p = NULL;
+    *next_cursor_len = 0;
+
+    record_t *records = malloc((size_t)(suffix_count + 1) * sizeof(record_t));
+    size_t *suffix_lens = malloc((size_t)(suffix_count + 1) * sizeof(size_t));
+    char *sibling_key = NULL;
+    size_t sibling_key_size = 0;
+    if (records == NULL || suffix_lens == NULL) {
+        free(records);
+        free(suffix_lens);
+        return to_error(GDBM_MALLOC_ERROR);
+    }
+    size_t max_suffix_len = 0;
+    for (int i = 0; i < suffix_count; i++) {
+        suffix_lens[i] = strlen(suffixes[i]);
+        if (suffix_lens[i] > max_suffix_len) {
+            max_suffix_len = suffix_lens[i];
+        }
+    }
+
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        free(records);
+        free(suffix_lens);
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    datum key;
+    if (cursor_p != NULL) {
+        // the walk can only go on from a key that still exists
+        datum cursor_d = {cursor_p, cursor_len};
+        if (!db_exists_(db, cursor_d)) {
+            gdbm_error errno = db_errno_(db);
+            close_db_(db);
+            free(records);
+            free(suffix_lens);
+            return errno == GDBM_NO_ERROR || errno == GDBM_ITEM_NOT_FOUND
+                       ? (error_t){-1, gdbm_strerror(GDBM_ITEM_NOT_FOUND)}
+                       : to_error(errno);
+        }
+        key = db_nextkey_(db, cursor_d);
+    } else {
+        key = db_firstkey_(db);
+    }
+
+    gdbm_error errno = GDBM_NO_ERROR;
+    int visited = 0;
+    while (key.dptr != NULL) {
+        // keys with a NUL byte are sibling records
+        if (memchr(key.dptr, '\0', key.dsize) != NULL) {
+            datum next_key = db_nextkey_(db, key);
+            free(key.dptr);
+            key = next_key;
+            continue;
+        }
+
+        datum data = {NULL, 0};
+        if (!keys_only) {
+            data = db_fetch_(db, key);
+        }
+        records[0] = (record_t){key.dptr, key.dsize, data.dptr, data.dsize};
+
+        size_t needed = (size_t)key.dsize + 1 + max_suffix_len;
+        if (suffix_count > 0 && needed > sibling_key_size) {
+            char *buf = realloc(sibling_key, needed);
+            if (buf == NULL) {
+                free(data.dptr);
+                errno = GDBM_MALLOC_ERROR;
+                break;
+            }
+            sibling_key = buf;
+            sibling_key_size = needed;
+        }
+        for (int i = 0; i < suffix_count; i++) {
+            memcpy(sibling_key, key.dptr, key.dsize);
+            sibling_key[key.dsize] = '\0';
+            memcpy(sibling_key + key.dsize + 1, suffixes[i], suffix_lens[i]);
+            datum sibling_key_d = {
+                sibling_key, key.dsize + 1 + (int)suffix_lens[i]
+            };
+            datum sibling = db_fetch_(db, sibling_key_d);
+            records[i + 1] = (record_t){NULL, 0, sibling.dptr, sibling.dsize};
+        }
+
+        // a record without data was removed since its key was read
+        bool go_on =
+            (!keys_only && data.dptr == NULL) || visit(ctx, records);
+        for (int i = 0; i <= suffix_count; i++) {
+            free(records[i].data_p);
+        }
+
+        if (!go_on || ++visited >= budget) {
+            // resume after this key
+            *next_cursor_p = key.dptr;
+            *next_cursor_len = key.dsize;
+            key.dptr = NULL;
+            break;
+        }
+
+        datum next_key = db_nextkey_(db, key);
+        free(key.dptr);
+        key = next_key;
+    }
+    if (key.dptr == NULL && *next_cursor_p == NULL &&
+        errno == GDBM_NO_ERROR && db_errno_(db) != GDBM_ITEM_NOT_FOUND) {
+        errno = db_errno_(db);
+    }
+    free(key.dptr);
+
+    error_t err_close = close_db_(db);
+    free(records);
+    free(suffix_lens);
+    free(sibling_key);
+
+    if (err_close.code != GDBM_NO_ERROR || errno != GDBM_NO_ERROR) {
+        free(*next_cursor_p);
+        *next_cursor_p = NULL;
+        return err_close.code != GDBM_NO_ERROR ? err_close : to_error(errno);
+    }
+
+    return to_no_error();
+}
+
+error_t wrap_open_memory(
+    const char *name, bool sync_writes, size_t shared_size
+) {
+    // the file is replaced by snapshots from now on
+    if (!evict_cached_(name)) {
+        return to_error(GDBM_CANT_BE_WRITER);
+    }
+
+    // finish a batch interrupted while the file was used directly
+    int open_flags = GDBM_WRCREAT;
+    GDBM_FILE dbf = open_gdbm_(name, 0, open_flags);
+    if (dbf == NULL) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+    gdbm_close(dbf);
+
+    return to_error(mem_table_open(name, sync_writes, shared_size));
+}
+
+error_t wrap_close_memory(const char *name) {
+    gdbm_error errno = mem_table_close(name);
+    return errno == GDBM_ITEM_NOT_FOUND ? (error_t){-1, NULL}
+                                        : to_error(errno);
+}
+
+error_t wrap_snapshot_memory(const char *name) {
+    mem_table_t *mem = mem_table_acquire(name, true);
+    if (mem == NULL) {
+        return (error_t){-1, NULL};
+    }
+
+    gdbm_error errno = mem_table_snapshot(mem);
+    mem_table_release(mem);
+
+    return to_error(errno);
+}
+
+static inline int size_bin_(uint64_t size) {
+    int bin = 0;
+    while (size > 0 && bin < SIZE_BINS - 1) {
+        size >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+static void read_geometry_(GDBM_FILE dbf, table_stats_t *stats) {
+#if GDBM_VERSION_MAJOR > 1 || GDBM_VERSION_MINOR >= 18
+    int value;
+    size_t count;
+    if (gdbm_setopt(dbf, GDBM_GETBLOCKSIZE, &value, sizeof(value)) == 0) {
+        stats->block_size = value;
+    }
+    if (gdbm_setopt(dbf, GDBM_GETDIRDEPTH, &value, sizeof(value)) == 0) {
+        stats->dir_depth = value;
+    }
+    if (gdbm_setopt(dbf, GDBM_GETBUCKETSIZE, &value, sizeof(value)) == 0) {
+        stats->bucket_elems = value;
+    }
+    if (gdbm_setopt(dbf, GDBM_GETCACHESIZE, &count, sizeof(count)) == 0) {
+        stats->cache_size = count;
+    }
+    if (gdbm_bucket_count(dbf, &count) == 0) {
+        stats->bucket_count = count;
+    }
+#endif
+}
+
+error_t wrap_analyze(const char *name, table_stats_t *stats) {
+    memset(stats, 0, sizeof(table_stats_t));
+
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+
+    if (db.dbf != NULL) {
+        read_geometry_(db.dbf, stats);
+    } else {
+        // a memory table is laid out like its last snapshot
+        GDBM_FILE dbf = open_raw_(name, 0, GDBM_READER);
+        if (dbf != NULL) {
+            read_geometry_(dbf, stats);
+            gdbm_close(dbf);
+        }
+    }
+    struct stat st;
+    if (stat(name, &st) == 0) {
+        stats->file_size = (uint64_t)st.st_size;
+    }
+
+    datum key = db_firstkey_(db);
+    while (key.dptr != NULL) {
+        datum data = db_fetch_(db, key);
+        if (data.dptr != NULL) {
+            if (memchr(key.dptr, '\0', key.dsize) == NULL) {
+                stats->records++;
+            } else {
+                stats->siblings++;
+            }
+            uint64_t record_size = (uint64_t)key.dsize + data.dsize;
+            stats->key_bytes += key.dsize;
+            stats->data_bytes += data.dsize;
+            stats->key_sizes[size_bin_(key.dsize)]++;
+            stats->data_sizes[size_bin_(data.dsize)]++;
+            stats->record_sizes[size_bin_(record_size)]++;
+            if (stats->block_size > 0 && record_size > (uint64_t)stats->block_size) {
+                stats->multi_block++;
+            }
+            free(data.dptr);
+        }
+        datum next_key = db_nextkey_(db, key);
+        free(key.dptr);
+        key = next_key;
+    }
+    gdbm_error errno = db_errno_(db);
+
+    error_t err_close = close_db_(db);
+    if (err_close.code != GDBM_NO_ERROR) {
+        return err_close;
+    }
+
+    return errno != GDBM_ITEM_NOT_FOUND ? to_error(errno) : to_no_error();
+}
+
+static gdbm_error copy_records_(GDBM_FILE src, GDBM_FILE dst) {
+    gdbm_error errno = GDBM_NO_ERROR;
+    datum key = gdbm_firstkey(src);
+    while (key.dptr != NULL) {
+        datum data = gdbm_fetch(src, key);
+        if (data.dptr == NULL ||
+            gdbm_store(dst, key, data, GDBM_INSERT) != 0) {
+            errno = data.dptr == NULL ? get_errno(src) : get_errno(dst);
+            free(data.dptr);
+            break;
+        }
+        free(data.dptr);
+        datum next_key = gdbm_nextkey(src, key);
+        free(key.dptr);
+        key = next_key;
+    }
+    if (key.dptr == NULL && get_errno(src) != GDBM_ITEM_NOT_FOUND) {
+        errno = get_errno(src);
+    }
+    free(key.dptr);
+    return errno;
+}
+
+error_t wrap_rebuild(const char *name, int block_size) {
+    mem_table_t *mem = mem_table_acquire(name, false);
+    if (mem != NULL) {
+        mem_table_release(mem);
+        return (error_t){GDBM_OPT_ILLEGAL, "Cannot rebuild a memory table"};
+    }
+
+    char tmp_path[SIDECAR_PATH_SIZE];
+    if (!sidecar_path_(tmp_path, name, REBUILD_EXT)) {
+        return to_error(GDBM_FILE_OPEN_ERROR);
+    }
+
+    // the cached handle would keep writing to the replaced file
+    if (!evict_cached_(name)) {
+        return to_error(GDBM_CANT_BE_WRITER);
+    }
+
+    // the writer lock keeps everyone out until the new file is in place
+    GDBM_FILE src = open_gdbm_(name, 0, GDBM_WRITER);
+    if (src == NULL) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+    GDBM_FILE dst = open_raw_(tmp_path, block_size, GDBM_NEWDB);
+    if (dst == NULL) {
+        error_t err = to_error(gdbm_errno);
+        gdbm_close(src);
+        return err;
+    }
+
+    gdbm_error errno = copy_records_(src, dst);
+    if (errno == GDBM_NO_ERROR && gdbm_sync(dst) != 0) {
+        errno = GDBM_FILE_SYNC_ERROR;
+    }
+#if GDBM_VERSION_MAJOR > 1 || GDBM_VERSION_MINOR >= 17
+    if (gdbm_close(dst) != 0 && errno == GDBM_NO_ERROR) {
+        errno = gdbm_errno;
+    }
+#else
+    gdbm_close(dst);
+#endif
+
+    if (errno == GDBM_NO_ERROR && rename(tmp_path, name) != 0) {
+        errno = GDBM_FILE_WRITE_ERROR;
+    }
+    if (errno != GDBM_NO_ERROR) {
+        unlink(tmp_path);
+    }
+    gdbm_close(src);
+
+    return to_error(errno);
+}
+
+static gdbm_error fill_index_(void *ctx, key_index_t *index) {
+    db_t *db = ctx;
+    gdbm_error errno = GDBM_NO_ERROR;
+    datum key = db_firstkey_(*db);
+    while (key.dptr != NULL) {
+        if (memchr(key.dptr, '\0', key.dsize) == NULL &&
+            key_index_append(index, key.dptr, key.dsize) != 0) {
+            errno = GDBM_MALLOC_ERROR;
+            break;
+        }
+        datum next_key = db_nextkey_(*db, key);
+        free(key.dptr);
+        key = next_key;
+    }
+    if (key.dptr == NULL && db_errno_(*db) != GDBM_ITEM_NOT_FOUND) {
+        errno = db_errno_(*db);
+    }
+    free(key.dptr);
+    return errno;
+}
+
+error_t wrap_open_key_index(const char *name) {
+    // writers wait until the index is registered, so it misses none of them
+    int open_flags = GDBM_READER;
+    db_t db = open_db_(name, 0, open_flags);
+    if (!is_open_(db)) {
+        error_t err = to_error(gdbm_errno);
+        return err;
+    }
+    // the writes of other processes would bypass the index
+    if (db.mem != NULL && mem_table_is_shared(db.mem)) {
+        close_db_(db);
+        return (error_t){GDBM_OPT_ILLEGAL, "Cannot index a shared table"};
+    }
+
+    gdbm_error errno = key_index_open(name, fill_index_, &db);
+
+    error_t err_close = close_db_(db);
+    return errno != GDBM_NO_ERROR ? to_error(errno) : err_close;
+}
+
+error_t wrap_close_key_index(const char *name) {
+    gdbm_error errno = key_index_close(name);
+    return errno == GDBM_ITEM_NOT_FOUND ? (error_t){-1, NULL}
+                                        : to_error(errno);
+}
+
+error_t wrap_query_keys(
+    const char *name, const key_range_t *range, int limit, key_visit_fn visit,
+    void *ctx
+) {
+    key_index_t *index = key_index_acquire(name);
+    if (index == NULL) {
+        return (error_t){-1, NULL};
+    }
+
+    int ret = key_index_query(index, range, limit, visit, ctx);
+    key_index_release(index);
+
+    return ret >= 0 ? to_no_error()
+                    : (error_t){GDBM_MALLOC_ERROR, "Key index is out of sync"};
+}
+
+error_t wrap_write_snapshot(
+    const char *path, const record_t *records, size_t count
+) {
+    // keys followed by values
+    datum *data = malloc((count > 0 ? count : 1) * 2 * sizeof(datum));
+    if (data == NULL) {
+        return to_error(GDBM_MALLOC_ERROR);
+    }
+    for (size_t i = 0; i < count; i++) {
+        data[i] = (datum){records[i].key_p, records[i].key_len};
+        data[count + i] = (datum){records[i].data_p, records[i].data_len};
+    }
+
+    gdbm_error errno = snapshot_file_write(path, data, data + count, count);
+    free(data);
+    return to_error(errno);
+}
+
+error_t wrap_open_snapshot(const char *path, size_t *count) {
+    return to_error(snapshot_file_open(path, count));
+}
+
+error_t wrap_close_snapshot(const char *path) {
+    gdbm_error errno = snapshot_file_close(path);
+    return errno == GDBM_ITEM_NOT_FOUND ? (error_t){-1, NULL}
+                                        : to_error(errno);
+}
+
+error_t wrap_read_snapshot(
+    const char *path, const char *key_p, int key_len,
+    snapshot_visit_fn visit, void *ctx
+) {
+    snapshot_file_t *file = snapshot_file_acquire(path);
+    if (file == NULL) {
+        return (error_t){-1, NULL};
+    }
+
+    gdbm_error errno = GDBM_NO_ERROR;
+    datum key, value;
+    if (key_p != NULL) {
+        errno = snapshot_file_find(
+            file, (datum){(char *)key_p, key_len}, &value
+        );
+        if (errno == GDBM_NO_ERROR) {
+            visit(ctx, key_p, key_len, value.dptr, value.dsize);
+        } else if (errno == GDBM_ITEM_NOT_FOUND) {
+            errno = GDBM_NO_ERROR;
+        }
+    } else {
+        size_t count = snapshot_file_count(file);
+        for (size_t i = 0; i < count && errno == GDBM_NO_ERROR; i++) {
+            errno = snapshot_file_entry(file, i, &key, &value);
+            if (errno == GDBM_NO_ERROR &&
+                !visit(ctx, key.dptr, key.dsize, value.dptr, value.dsize)) {
+                break;
+            }
+        }
+    }
+
+    snapshot_file_release(file);
+    return to_error(errno);
 }
@@ -17,31 +17,238 @@ limitations under the License.
 #ifndef _GDBM_WRAPPER_H_
 #define _GDBM_WRAPPER_H_
 
+#include "key_index.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct {
     int code;
     const char *message;
 } error_t;
 
+typedef struct {
+    char *key_p;
+    int key_len;
+    char *data_p;
+    int data_len;
+} record_t;
+
 error_t wrap_create_db(const char *name, int block_size);
 error_t wrap_clean_db(const char *name, int block_size);
 
 error_t wrap_count(const char *name, int *count);
+// Sibling records are written and removed together with the record.
 error_t wrap_insert(
-    const char *name, char *key_p, int key_len, char *data_p, int data_len
+    const char *name, char *key_p, int key_len, char *data_p, int data_len,
+    const record_t *siblings, int sibling_count
+);
+// Insert the records with the table opened once, each with the next
+// `sibling_counts[i]` of `siblings`. `inserted[i]` is false if the key of
+// record i exists, or if a write failed on it or before it.
+error_t wrap_insert_many(
+    const char *name, const record_t *records, int count,
+    const record_t *siblings, const int *sibling_counts, bool *inserted
+);
+error_t wrap_remove(
+    const char *name, char *key_p, int key_len, const record_t *siblings,
+    int sibling_count
+);
+// Store the sibling of an existing record, or delete it if `data_p` is NULL.
+error_t wrap_store_sibling(
+    const char *name, char *key_p, int key_len, const record_t *sibling
 );
-error_t wrap_remove(const char *name, char *key_p, int key_len);
 
 error_t wrap_exists(const char *name, char *key_p, int key_len, bool *result);
+// Look the keys of `records` up with the table opened once, to read their
+// buckets into the caches. `*found` counts the ones that exist.
+error_t wrap_preload(
+    const char *name, const record_t *records, int count, int *found
+);
 
 error_t wrap_fetch(
     const char *name, char *key_p, int key_len, char **data_p, int *data_len
 );
+// Fetch the data of every key with the table opened once. `data_ps[i]` is
+// NULL if key i does not exist, otherwise to be released with free().
+// Nothing is handed back on error.
+error_t wrap_fetch_many(
+    const char *name, int count, char **key_ps, int *key_lens, char **data_ps,
+    int *data_lens
+);
+// Copy the data into `buf` if it fits in `bufsize` bytes; `data_len` is set
+// either way, so a caller can retry with a larger buffer.
+error_t wrap_read_into(
+    const char *name, char *key_p, int key_len, char *buf, size_t bufsize,
+    size_t *data_len
+);
 error_t wrap_replace(
     const char *name, char *key_p, int key_len, char *data_p, int data_len
 );
+// Store whether or not the key exists.
+error_t wrap_upsert(
+    const char *name, char *key_p, int key_len, char *data_p, int data_len
+);
+// Replace the data of each record with the table opened once, only if it
+// is still the data of `expected[i]`. An `expected[i]` without data_p
+// means the record must be missing, and a record without data_p is
+// removed. `swapped[i]` is false if record i was changed, or if a write
+// failed on it or before it.
+error_t wrap_compare_and_swap_many(
+    const char *name, const record_t *records, const record_t *expected,
+    int count, bool *swapped
+);
+// Replace the data of an existing key and hand back the previous data,
+// to be released with free(). Nothing is handed back if `old_p` is NULL.
+error_t wrap_replace_returning_old(
+    const char *name, char *key_p, int key_len, char *data_p, int data_len,
+    char **old_p, int *old_len
+);
+// Remove a record with its siblings and hand back its data, to be released
+// with free().
+error_t wrap_delete_returning_value(
+    const char *name, char *key_p, int key_len, const record_t *siblings,
+    int sibling_count, char **data_p, int *data_len
+);
+
+error_t wrap_incr(
+    const char *name, char *key_p, int key_len, int64_t delta, int64_t *result
+);
+error_t wrap_fetch_counters(
+    const char *name, int count, char **key_ps, int *key_lens, int64_t *values,
+    bool *found
+);
+
+#define BATCH_INSERT 0
+#define BATCH_UPDATE 1
+#define BATCH_UPSERT 2
+#define BATCH_REMOVE 3
+#define BATCH_INCR 4
+#define BATCH_DISCARD 5
+
+typedef struct {
+    int type;
+    char *key_p;
+    int key_len;
+    char *data_p;
+    int data_len;
+    int64_t delta;
+} batch_op_t;
+
+// Apply all operations or none of them. `committed` is false when a
+// precondition fails (insert of an existing key, update or remove of a
+// missing key); the table is left untouched in that case. Discard removes
+// the key if it exists.
+error_t wrap_commit_batch(
+    const char *name, const batch_op_t *ops, int count, bool *committed
+);
+
+// Same as wrap_compare_and_swap_many, but the records are swapped as one
+// unit like a batch, through the redo log, and only if none was changed.
+error_t wrap_compare_and_swap_all(
+    const char *name, const record_t *records, const record_t *expected,
+    int count, bool *swapped
+);
+
+// Called by wrap_scan for each record with `records[0]` holding the record
+// and `records[i]` its sibling of `suffixes[i - 1]`, data_p NULL if absent.
+// The visitor may keep data by setting data_p to NULL; the rest is freed.
+// Returning false stops the scan after this record.
+typedef bool (*scan_visit_fn)(void *ctx, record_t *records);
+
+// Visit the records after the key `cursor_p`, or from the first one if it
+// is NULL, skipping sibling records. Stops after `budget` records or when
+// the visitor says so, and hands back the key to resume from in
+// `next_cursor_p`, to be released with free(); NULL once every record is
+// visited. -1 if the cursor key no longer exists. With `keys_only`, no
+// data is fetched and `suffix_count` must be 0.
+// Records come in GDBM hash order, so records written between two calls
+// may be visited twice or not at all.
+error_t wrap_scan(
+    const char *name, char *cursor_p, int cursor_len, const char **suffixes,
+    int suffix_count, bool keys_only, int budget, scan_visit_fn visit,
+    void *ctx, char **next_cursor_p, int *next_cursor_len
+);
+
+// Serve `name` from memory until it is closed as many times as opened.
+// Writes are appended to "<name>.log", flushed to disk if `sync_writes`.
+// A nonzero `shared_size` puts the records in shared memory of that many
+// bytes, seen by every process opening `name` with a shared size.
+error_t wrap_open_memory(
+    const char *name, bool sync_writes, size_t shared_size
+);
+error_t wrap_close_memory(const char *name);
+// Write a memory table to its GDBM file and empty its log.
+error_t wrap_snapshot_memory(const char *name);
+
+#define SIZE_BINS 32
+
+// Sizes are counted in power-of-two bins: bin 0 holds empty ones and bin i
+// the sizes from 2^(i-1) to 2^i - 1; the last bin also holds larger ones.
+typedef struct {
+    uint64_t records;  // main records
+    uint64_t siblings; // sibling records, counters included
+    uint64_t key_bytes;
+    uint64_t data_bytes;
+    uint64_t key_sizes[SIZE_BINS];
+    uint64_t data_sizes[SIZE_BINS];
+    // key and data together, as GDBM stores them
+    uint64_t record_sizes[SIZE_BINS];
+    // records larger than a block
+    uint64_t multi_block;
+
+    // geometry of the GDBM file, 0 where unknown
+    int block_size;
+    int dir_depth;
+    uint64_t bucket_elems;
+    uint64_t bucket_count;
+    uint64_t cache_size;
+    uint64_t file_size;
+} table_stats_t;
+
+// Walk the whole table and collect `stats`.
+error_t wrap_analyze(const char *name, table_stats_t *stats);
+// Copy the table into a new file with `block_size` and rename it over the
+// table. The table cannot be opened by others until done. Memory tables are
+// not supported.
+error_t wrap_rebuild(const char *name, int block_size);
+
+// Keep an ordered index of the keys of `name` until it is closed as many
+// times as opened; see key_index.h. A memory table must be opened first.
+error_t wrap_open_key_index(const char *name);
+error_t wrap_close_key_index(const char *name);
+// Visit the keys of `range` in byte order, at most `limit` of them.
+// -1 if the table has no open index.
+error_t wrap_query_keys(
+    const char *name, const key_range_t *range, int limit, key_visit_fn visit,
+    void *ctx
+);
+
+// Read-only snapshot files, see snapshot_file.h. A file is written from
+// the keys and data of `records`, in any order.
+error_t wrap_write_snapshot(
+    const char *path, const record_t *records, size_t count
+);
+error_t wrap_open_snapshot(const char *path, size_t *count);
+// -1 if `path` is not open.
+error_t wrap_close_snapshot(const char *path);
+
+// Returning false stops the visit after this record.
+typedef bool (*snapshot_visit_fn)(
+    void *ctx, const char *key_p, int key_len, const char *data_p,
+    int data_len
+);
+// Visit the record of the key if there is one, or every record in key
+// order if `key_p` is NULL. -1 if `path` is not open.
+error_t wrap_read_snapshot(
+    const char *path, const char *key_p, int key_len,
+    snapshot_visit_fn visit, void *ctx
+);
 
 void print_gdbm_version();
+// Mark the calling thread as running JavaScript. Lock contention there
+// gives up after a few ms with GDBM_CANT_BE_READER or GDBM_CANT_BE_WRITER
+// instead of blocking the event loop.
+void wrap_init_js_thread();
 
 #endif // _GDBM_WRAPPER_H_
@@ -0,0 +1,322 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "handle_cache.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MIN_BUCKET_COUNT 16
+
+struct cached_handle_s {
+    char *name;
+    GDBM_FILE dbf; // NULL while being opened, or if opening it failed
+    gdbm_error open_errno;
+    struct cached_handle_s *hash_next;
+    // LRU list, most recently used first
+    struct cached_handle_s *prev;
+    struct cached_handle_s *next;
+    int pins;
+    uint64_t last_used_ms;
+    pthread_mutex_t lock;
+};
+
+// Everything below is guarded by cache_lock; a handle's own lock is held by
+// whoever pinned it, and only unpinned handles are closed. A handle is
+// listed before its file is opened, with its lock held by the opener, so
+// that files are opened outside cache_lock and only once.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static int max_open_ = 0;
+static int64_t idle_timeout_ms_ = 0;
+static cached_handle_t **buckets_ = NULL;
+static size_t bucket_count_ = 0;
+static cached_handle_t *head_ = NULL;
+static cached_handle_t *tail_ = NULL;
+static int count_ = 0;
+static handle_cache_stats_t stats_;
+
+static inline uint64_t now_ns_() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline size_t bucket_of_(const char *name) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (const char *p = name; *p != '\0'; p++) {
+        hash ^= (unsigned char)*p;
+        hash *= 1099511628211ull;
+    }
+    return hash & (bucket_count_ - 1);
+}
+
+static void unlink_lru_(cached_handle_t *handle) {
+    if (handle->prev != NULL) {
+        handle->prev->next = handle->next;
+    } else {
+        head_ = handle->next;
+    }
+    if (handle->next != NULL) {
+        handle->next->prev = handle->prev;
+    } else {
+        tail_ = handle->prev;
+    }
+    handle->prev = NULL;
+    handle->next = NULL;
+}
+
+static void push_lru_(cached_handle_t *handle) {
+    handle->next = head_;
+    if (head_ != NULL) {
+        head_->prev = handle;
+    } else {
+        tail_ = handle;
+    }
+    head_ = handle;
+}
+
+static cached_handle_t *find_(const char *name) {
+    if (bucket_count_ == 0) {
+        return NULL;
+    }
+    cached_handle_t *handle = buckets_[bucket_of_(name)];
+    while (handle != NULL && strcmp(handle->name, name) != 0) {
+        handle = handle->hash_next;
+    }
+    return handle;
+}
+
+static void unlist_(cached_handle_t *handle) {
+    cached_handle_t **link = &buckets_[bucket_of_(handle->name)];
+    while (*link != handle) {
+        link = &(*link)->hash_next;
+    }
+    *link = handle->hash_next;
+    unlink_lru_(handle);
+    count_--;
+}
+
+static void free_(cached_handle_t *handle) {
+    pthread_mutex_destroy(&handle->lock);
+    free(handle->name);
+    free(handle);
+}
+
+static void close_(cached_handle_t *handle) {
+    unlist_(handle);
+    gdbm_close(handle->dbf);
+    free_(handle);
+}
+
+// Unpin a handle whose file could not be opened, which is no longer listed.
+static void drop_failed_(cached_handle_t *handle) {
+    pthread_mutex_unlock(&handle->lock);
+    if (--handle->pins == 0) {
+        free_(handle);
+    }
+}
+
+// Close unpinned handles from the LRU end while there are more than `limit`.
+static void shrink_(int limit) {
+    cached_handle_t *handle = tail_;
+    while (handle != NULL && count_ > limit) {
+        cached_handle_t *prev = handle->prev;
+        if (handle->pins == 0) {
+            close_(handle);
+            stats_.evictions++;
+        }
+        handle = prev;
+    }
+}
+
+static void sweep_(uint64_t now_ms) {
+    if (idle_timeout_ms_ <= 0) {
+        return;
+    }
+    cached_handle_t *handle = tail_;
+    while (handle != NULL) {
+        cached_handle_t *prev = handle->prev;
+        if (now_ms - handle->last_used_ms < (uint64_t)idle_timeout_ms_) {
+            // the rest were used more recently
+            break;
+        }
+        if (handle->pins == 0) {
+            close_(handle);
+            stats_.evictions++;
+        }
+        handle = prev;
+    }
+}
+
+bool handle_cache_configure(int max_open, int64_t idle_timeout_ms) {
+    pthread_mutex_lock(&cache_lock);
+
+    shrink_(0);
+
+    size_t bucket_count = MIN_BUCKET_COUNT;
+    while (bucket_count < (size_t)max_open * 2) {
+        bucket_count *= 2;
+    }
+    cached_handle_t **buckets = calloc(bucket_count, sizeof(cached_handle_t *));
+    if (buckets == NULL) {
+        pthread_mutex_unlock(&cache_lock);
+        return false;
+    }
+
+    // handles still in use move to the new buckets
+    free(buckets_);
+    buckets_ = buckets;
+    bucket_count_ = bucket_count;
+    for (cached_handle_t *handle = head_; handle != NULL;
+         handle = handle->next) {
+        size_t i = bucket_of_(handle->name);
+        handle->hash_next = buckets_[i];
+        buckets_[i] = handle;
+    }
+
+    max_open_ = max_open > 0 ? max_open : 0;
+    idle_timeout_ms_ = idle_timeout_ms > 0 ? idle_timeout_ms : 0;
+
+    pthread_mutex_unlock(&cache_lock);
+    return true;
+}
+
+cached_handle_t *handle_cache_acquire(
+    const char *name, GDBM_FILE (*open)(const char *name), GDBM_FILE *dbf
+) {
+    pthread_mutex_lock(&cache_lock);
+
+    if (max_open_ == 0) {
+        pthread_mutex_unlock(&cache_lock);
+        return NULL;
+    }
+
+    sweep_(now_ns_() / 1000000u);
+
+    cached_handle_t *handle = find_(name);
+    if (handle != NULL) {
+        stats_.hits++;
+        handle->pins++;
+        unlink_lru_(handle);
+        push_lru_(handle);
+        pthread_mutex_unlock(&cache_lock);
+
+        // waits for the file to be opened if it is just being opened
+        pthread_mutex_lock(&handle->lock);
+        if (handle->dbf == NULL) {
+            gdbm_error open_errno = handle->open_errno;
+            pthread_mutex_lock(&cache_lock);
+            drop_failed_(handle);
+            pthread_mutex_unlock(&cache_lock);
+            gdbm_errno = open_errno;
+            return NULL;
+        }
+        *dbf = handle->dbf;
+        return handle;
+    }
+
+    stats_.misses++;
+    shrink_(max_open_ - 1);
+    if (count_ >= max_open_) {
+        // every handle is in use
+        pthread_mutex_unlock(&cache_lock);
+        return NULL;
+    }
+
+    handle = calloc(1, sizeof(cached_handle_t));
+    if (handle == NULL || (handle->name = strdup(name)) == NULL) {
+        free(handle);
+        pthread_mutex_unlock(&cache_lock);
+        return NULL;
+    }
+
+    uint64_t start = now_ns_();
+    pthread_mutex_init(&handle->lock, NULL);
+    handle->pins = 1;
+    handle->last_used_ms = start / 1000000u;
+    size_t i = bucket_of_(name);
+    handle->hash_next = buckets_[i];
+    buckets_[i] = handle;
+    push_lru_(handle);
+    count_++;
+
+    // nobody else can see it yet
+    pthread_mutex_lock(&handle->lock);
+    pthread_mutex_unlock(&cache_lock);
+
+    // others wanting the same file wait on its lock, the rest go on
+    GDBM_FILE opened = open(name);
+    gdbm_error open_errno = gdbm_errno;
+    uint64_t elapsed = now_ns_() - start;
+
+    pthread_mutex_lock(&cache_lock);
+    stats_.open_count++;
+    stats_.open_ns_total += elapsed;
+    if (elapsed > stats_.open_ns_max) {
+        stats_.open_ns_max = elapsed;
+    }
+    if (opened == NULL) {
+        handle->open_errno = open_errno;
+        unlist_(handle);
+        drop_failed_(handle);
+        pthread_mutex_unlock(&cache_lock);
+        gdbm_errno = open_errno;
+        return NULL;
+    }
+    handle->dbf = opened;
+    pthread_mutex_unlock(&cache_lock);
+
+    *dbf = opened;
+    return handle;
+}
+
+void handle_cache_release(cached_handle_t *handle) {
+    pthread_mutex_lock(&cache_lock);
+    handle->pins--;
+    handle->last_used_ms = now_ns_() / 1000000u;
+    pthread_mutex_unlock(&handle->lock);
+    // the limit may have been lowered while it was in use
+    shrink_(max_open_);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+bool handle_cache_evict(const char *name) {
+    pthread_mutex_lock(&cache_lock);
+    cached_handle_t *handle = find_(name);
+    bool evicted = handle == NULL || handle->pins == 0;
+    if (handle != NULL && evicted) {
+        close_(handle);
+        stats_.evictions++;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return evicted;
+}
+
+void handle_cache_sweep() {
+    pthread_mutex_lock(&cache_lock);
+    sweep_(now_ns_() / 1000000u);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void handle_cache_stats(handle_cache_stats_t *stats) {
+    pthread_mutex_lock(&cache_lock);
+    *stats = stats_;
+    stats->open_handles = count_;
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,61 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _HANDLE_CACHE_H_
+#define _HANDLE_CACHE_H_
+
+#include <gdbm.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Keeps GDBM files open between calls, at most `max_open` of them, and
+// closes the least recently used one to make room. Disabled by default.
+// Files are kept open as writers, which locks other processes out, so the
+// cache is only for tables used by a single process.
+typedef struct cached_handle_s cached_handle_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t open_count;
+    uint64_t open_ns_total;
+    uint64_t open_ns_max;
+    int open_handles;
+} handle_cache_stats_t;
+
+// Close every idle handle and apply the new limits. A `max_open` of 0
+// disables the cache; an `idle_timeout_ms` of 0 keeps idle handles open.
+bool handle_cache_configure(int max_open, int64_t idle_timeout_ms);
+
+// Get the handle of `name`, calling `open` on a miss without blocking the
+// handles of other files. The handle is locked until released. NULL if
+// the cache is disabled or full of handles in use, or if `open` failed
+// (gdbm_errno is set then).
+cached_handle_t *handle_cache_acquire(
+    const char *name, GDBM_FILE (*open)(const char *name), GDBM_FILE *dbf
+);
+void handle_cache_release(cached_handle_t *handle);
+
+// Close the handle of `name` if it is open. Returns false if it is in use.
+bool handle_cache_evict(const char *name);
+// Close the handles idle for longer than the timeout.
+void handle_cache_sweep();
+
+void handle_cache_stats(handle_cache_stats_t *stats);
+
+#endif // _HANDLE_CACHE_H_
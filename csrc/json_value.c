@@ -0,0 +1,519 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "json_value.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 1000
+#define NUMBER_BUFFER_SIZE 64
+// integers with at most this many digits are exact in a double
+#define FAST_INT_DIGITS 15
+
+typedef struct {
+    napi_env env;
+    napi_value object_create;
+    napi_value frozen_set;
+    napi_value frozen_add;
+    napi_value null_value;
+    const char *begin;
+    const char *p;
+    const char *end;
+    char *error;
+    // decoded UTF-16 of strings with escapes or non-ASCII bytes
+    uint16_t *buf;
+    size_t bufsize;
+    int depth;
+} parser_t;
+
+static bool parse_value_(parser_t *parser, napi_value *result);
+
+static bool fail_(parser_t *parser, const char *what) {
+    snprintf(
+        parser->error, JSON_ERROR_SIZE, "%s at position %zu", what,
+        (size_t)(parser->p - parser->begin)
+    );
+    return false;
+}
+
+static inline void skip_ws_(parser_t *parser) {
+    while (parser->p < parser->end &&
+           (*parser->p == ' ' || *parser->p == '\t' || *parser->p == '\n' ||
+            *parser->p == '\r')) {
+        parser->p++;
+    }
+}
+
+static bool create_null_object_(parser_t *parser, napi_value *result) {
+    napi_status status;
+    napi_value global;
+    status = napi_get_global(parser->env, &global);
+    assert(status == napi_ok);
+    status = napi_call_function(
+        parser->env, global, parser->object_create, 1, &parser->null_value,
+        result
+    );
+    return status == napi_ok || fail_(parser, "Failed to create object");
+}
+
+static inline int hex_digit_(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Decode one UTF-8 sequence at `p`. Invalid bytes decode to U+FFFD one at a
+// time, as TextDecoder replaces them.
+static uint32_t decode_utf8_(const unsigned char *p, const unsigned char *end,
+                             size_t *len) {
+    unsigned char c = p[0];
+    size_t n;
+    uint32_t cp, min;
+    if (c >= 0xc2 && c <= 0xdf) {
+        n = 2, cp = c & 0x1f, min = 0x80;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        n = 3, cp = c & 0x0f, min = 0x800;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        n = 4, cp = c & 0x07, min = 0x10000;
+    } else {
+        *len = 1;
+        return 0xfffd;
+    }
+    if ((size_t)(end - p) < n) {
+        *len = 1;
+        return 0xfffd;
+    }
+    for (size_t i = 1; i < n; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            *len = 1;
+            return 0xfffd;
+        }
+        cp = (cp << 6) | (p[i] & 0x3f);
+    }
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        *len = 1;
+        return 0xfffd;
+    }
+    *len = n;
+    return cp;
+}
+
+static bool parse_string_(parser_t *parser, napi_value *result) {
+    napi_status status;
+
+    // p is at the opening quote
+    const char *start = ++parser->p;
+    const char *q = start;
+    while (q < parser->end && *q != '"' && *q != '\\' &&
+           (unsigned char)*q >= 0x20 && (unsigned char)*q < 0x80) {
+        q++;
+    }
+    if (q < parser->end && *q == '"') {
+        // plain ASCII
+        size_t len = (size_t)(q - start);
+        status = napi_create_string_latin1(parser->env, start, len, result);
+        assert(status == napi_ok);
+        parser->p = q + 1;
+        return true;
+    }
+
+    // every input byte gives at most one UTF-16 unit
+    size_t needed = (size_t)(parser->end - start);
+    if (needed > parser->bufsize) {
+        uint16_t *buf = realloc(parser->buf, needed * sizeof(uint16_t));
+        if (buf == NULL) {
+            return fail_(parser, "Out of memory");
+        }
+        parser->buf = buf;
+        parser->bufsize = needed;
+    }
+
+    uint16_t *out = parser->buf;
+    const char *p = start;
+    for (;;) {
+        if (p >= parser->end) {
+            parser->p = p;
+            return fail_(parser, "Unterminated string");
+        }
+        unsigned char c = (unsigned char)*p;
+        if (c == '"') {
+            break;
+        } else if (c < 0x20) {
+            parser->p = p;
+            return fail_(parser, "Bad control character in string");
+        } else if (c < 0x80 && c != '\\') {
+            *out++ = c;
+            p++;
+        } else if (c >= 0x80) {
+            size_t len;
+            uint32_t cp = decode_utf8_(
+                (const unsigned char *)p, (const unsigned char *)parser->end,
+                &len
+            );
+            if (cp >= 0x10000) {
+                cp -= 0x10000;
+                *out++ = (uint16_t)(0xd800 + (cp >> 10));
+                *out++ = (uint16_t)(0xdc00 + (cp & 0x3ff));
+            } else {
+                *out++ = (uint16_t)cp;
+            }
+            p += len;
+        } else {
+            if (parser->end - p < 2) {
+                parser->p = p;
+                return fail_(parser, "Unterminated string");
+            }
+            char e = p[1];
+            p += 2;
+            switch (e) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                if (parser->end - p < 4) {
+                    parser->p = p;
+                    return fail_(parser, "Bad Unicode escape");
+                }
+                int unit = 0;
+                for (int i = 0; i < 4; i++) {
+                    int digit = hex_digit_(p[i]);
+                    if (digit < 0) {
+                        parser->p = p;
+                        return fail_(parser, "Bad Unicode escape");
+                    }
+                    unit = unit * 16 + digit;
+                }
+                // lone surrogates are kept, as JSON.parse does
+                *out++ = (uint16_t)unit;
+                p += 4;
+                break;
+            }
+            default:
+                parser->p = p - 1;
+                return fail_(parser, "Bad escaped character");
+            }
+        }
+    }
+
+    size_t len = (size_t)(out - parser->buf);
+    status = napi_create_string_utf16(parser->env, parser->buf, len, result);
+    assert(status == napi_ok);
+    parser->p = p + 1;
+    return true;
+}
+
+static bool parse_number_(parser_t *parser, napi_value *result) {
+    napi_status status;
+
+    const char *start = parser->p;
+    const char *p = start;
+    bool negative = false;
+    if (*p == '-') {
+        negative = true;
+        p++;
+    }
+
+    const char *digits = p;
+    if (p < parser->end && *p == '0') {
+        p++;
+    } else if (p < parser->end && *p >= '1' && *p <= '9') {
+        while (p < parser->end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    } else {
+        parser->p = p;
+        return fail_(parser, "No number after minus sign");
+    }
+    size_t int_digits = (size_t)(p - digits);
+
+    bool is_int = true;
+    if (p < parser->end && *p == '.') {
+        is_int = false;
+        p++;
+        const char *frac = p;
+        while (p < parser->end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == frac) {
+            parser->p = p;
+            return fail_(parser, "Unterminated fractional number");
+        }
+    }
+    if (p < parser->end && (*p == 'e' || *p == 'E')) {
+        is_int = false;
+        p++;
+        if (p < parser->end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        const char *exp = p;
+        while (p < parser->end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == exp) {
+            parser->p = p;
+            return fail_(parser, "Exponent part is missing a number");
+        }
+    }
+
+    double value;
+    if (is_int && int_digits <= FAST_INT_DIGITS) {
+        int64_t n = 0;
+        for (const char *d = digits; d < p; d++) {
+            n = n * 10 + (*d - '0');
+        }
+        value = negative ? -(double)n : (double)n;
+    } else {
+        size_t len = (size_t)(p - start);
+        char stack_buf[NUMBER_BUFFER_SIZE];
+        char *buf = len < NUMBER_BUFFER_SIZE ? stack_buf : malloc(len + 1);
+        if (buf == NULL) {
+            return fail_(parser, "Out of memory");
+        }
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        value = strtod(buf, NULL);
+        if (buf != stack_buf) {
+            free(buf);
+        }
+    }
+
+    status = napi_create_double(parser->env, value, result);
+    assert(status == napi_ok);
+    parser->p = p;
+    return true;
+}
+
+static bool parse_literal_(
+    parser_t *parser, const char *word, size_t len, napi_value *result
+) {
+    napi_status status;
+
+    if ((size_t)(parser->end - parser->p) < len ||
+        memcmp(parser->p, word, len) != 0) {
+        return fail_(parser, "Unexpected token");
+    }
+    parser->p += len;
+
+    if (word[0] == 'n') {
+        *result = parser->null_value;
+        return true;
+    }
+    status = napi_get_boolean(parser->env, word[0] == 't', result);
+    assert(status == napi_ok);
+    return true;
+}
+
+static bool freeze_(parser_t *parser, napi_value object) {
+    napi_status status = napi_object_freeze(parser->env, object);
+    if (status != napi_ok) {
+        return fail_(parser, "Failed to freeze object");
+    }
+    if (parser->frozen_set == NULL) {
+        return true;
+    }
+    // children are frozen first, so the whole branch is frozen now
+    napi_value added;
+    status = napi_call_function(
+        parser->env, parser->frozen_set, parser->frozen_add, 1, &object,
+        &added
+    );
+    return status == napi_ok || fail_(parser, "Failed to register object");
+}
+
+static bool parse_object_(parser_t *parser, napi_value *result) {
+    napi_status status;
+
+    parser->p++;
+    napi_value object;
+    if (!create_null_object_(parser, &object)) {
+        return false;
+    }
+
+    skip_ws_(parser);
+    if (parser->p < parser->end && *parser->p == '}') {
+        parser->p++;
+        *result = object;
+        return freeze_(parser, object);
+    }
+
+    for (;;) {
+        skip_ws_(parser);
+        if (parser->p >= parser->end || *parser->p != '"') {
+            return fail_(parser, "Expected property name");
+        }
+        napi_value key;
+        if (!parse_string_(parser, &key)) {
+            return false;
+        }
+
+        skip_ws_(parser);
+        if (parser->p >= parser->end || *parser->p != ':') {
+            return fail_(parser, "Expected ':' after property name");
+        }
+        parser->p++;
+
+        napi_value value;
+        if (!parse_value_(parser, &value)) {
+            return false;
+        }
+        // a repeated key overwrites, as with JSON.parse, and "__proto__"
+        // is an own property like any other key, as there is no prototype
+        status = napi_set_property(parser->env, object, key, value);
+        assert(status == napi_ok);
+
+        skip_ws_(parser);
+        if (parser->p < parser->end && *parser->p == ',') {
+            parser->p++;
+        } else if (parser->p < parser->end && *parser->p == '}') {
+            parser->p++;
+            break;
+        } else {
+            return fail_(parser, "Expected ',' or '}' after property value");
+        }
+    }
+
+    *result = object;
+    return freeze_(parser, object);
+}
+
+// Arrays become objects keyed by index, the same as reviverFreezeNullObj
+// turns them into with Object.assign.
+static bool parse_array_(parser_t *parser, napi_value *result) {
+    napi_status status;
+
+    parser->p++;
+    napi_value object;
+    if (!create_null_object_(parser, &object)) {
+        return false;
+    }
+
+    skip_ws_(parser);
+    if (parser->p < parser->end && *parser->p == ']') {
+        parser->p++;
+        *result = object;
+        return freeze_(parser, object);
+    }
+
+    for (uint32_t index = 0;; index++) {
+        napi_value value;
+        if (!parse_value_(parser, &value)) {
+            return false;
+        }
+        status = napi_set_element(parser->env, object, index, value);
+        assert(status == napi_ok);
+
+        skip_ws_(parser);
+        if (parser->p < parser->end && *parser->p == ',') {
+            parser->p++;
+        } else if (parser->p < parser->end && *parser->p == ']') {
+            parser->p++;
+            break;
+        } else {
+            return fail_(parser, "Expected ',' or ']' after array element");
+        }
+    }
+
+    *result = object;
+    return freeze_(parser, object);
+}
+
+static bool parse_value_(parser_t *parser, napi_value *result) {
+    skip_ws_(parser);
+    if (parser->p >= parser->end) {
+        return fail_(parser, "Unexpected end of JSON input");
+    }
+
+    switch (*parser->p) {
+    case '{':
+    case '[': {
+        if (++parser->depth > MAX_DEPTH) {
+            return fail_(parser, "Too deeply nested");
+        }
+        bool ok = *parser->p == '{' ? parse_object_(parser, result)
+                                    : parse_array_(parser, result);
+        parser->depth--;
+        return ok;
+    }
+    case '"':
+        return parse_string_(parser, result);
+    case 't':
+        return parse_literal_(parser, "true", 4, result);
+    case 'f':
+        return parse_literal_(parser, "false", 5, result);
+    case 'n':
+        return parse_literal_(parser, "null", 4, result);
+    default:
+        if (*parser->p == '-' || (*parser->p >= '0' && *parser->p <= '9')) {
+            return parse_number_(parser, result);
+        }
+        return fail_(parser, "Unexpected token");
+    }
+}
+
+bool json_to_value(
+    napi_env env, napi_value object_create, napi_value frozen_set,
+    const char *data, size_t len, napi_value *result, char *error
+) {
+    napi_status status;
+
+    parser_t parser = {
+        .env = env,
+        .object_create = object_create,
+        .frozen_set = frozen_set,
+        .begin = data,
+        .p = data,
+        .end = data + len,
+        .error = error,
+    };
+    status = napi_get_null(env, &parser.null_value);
+    assert(status == napi_ok);
+    if (frozen_set != NULL) {
+        status = napi_get_named_property(
+            env, frozen_set, "add", &parser.frozen_add
+        );
+        assert(status == napi_ok);
+    }
+
+    if (len == 0) {
+        *result = parser.null_value;
+        return true;
+    }
+
+    bool ok = parse_value_(&parser, result);
+    if (ok) {
+        skip_ws_(&parser);
+        if (parser.p != parser.end) {
+            ok = fail_(&parser, "Unexpected non-whitespace character");
+        }
+    }
+
+    free(parser.buf);
+    return ok;
+}
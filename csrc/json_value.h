@@ -0,0 +1,38 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _JSON_VALUE_H_
+#define _JSON_VALUE_H_
+
+#include <node_api.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JSON_ERROR_SIZE 64
+
+// Parse the JSON text `data` into JS values. Objects and arrays become
+// frozen objects without prototype, as JSON.parse with reviverFreezeNullObj
+// makes them; `object_create` must be Object.create. They are added to the
+// WeakSet `frozen_set` as well, unless it is NULL. A "__proto__" key is an
+// own property. Empty text gives null.
+// On a syntax error, returns false with a message in `error`.
+bool json_to_value(
+    napi_env env, napi_value object_create, napi_value frozen_set,
+    const char *data, size_t len, napi_value *result, char *error
+);
+
+#endif // _JSON_VALUE_H_
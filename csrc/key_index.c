@@ -0,0 +1,660 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Saved index layout, all integers in host byte order:
+//   "KIX1" | u64 table stamp | u32 count | entries | u32 checksum
+// Each entry, in ascending order:
+//   u32 key_len | key bytes
+// The checksum covers everything between the magic and itself.
+
+#include "key_index.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INDEX_EXT ".idx"
+#define TMP_EXT ".tmp"
+#define LOG_EXT ".log"
+#define PATH_SIZE 512
+#define FILE_MAGIC "KIX1"
+#define FILE_MAGIC_SIZE 4
+#define PENDING_CAPACITY 1024
+
+typedef struct {
+    char *key_p;
+    int key_len;
+} index_key_t;
+
+struct key_index_s {
+    struct key_index_s *next;
+    char *name;
+    int refs;
+    pthread_mutex_t lock;
+
+    // sorted run; removed keys are marked dead until the next merge
+    index_key_t *run;
+    size_t run_len;
+    size_t run_capacity;
+    unsigned char *dead;
+    size_t dead_count;
+
+    // sorted keys added since the last merge, none of them in the run
+    index_key_t pending[PENDING_CAPACITY];
+    size_t pending_len;
+
+    bool valid;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static key_index_t *registry = NULL;
+
+static inline int compare_(
+    const char *a_p, int a_len, const char *b_p, int b_len
+) {
+    int ret = memcmp(a_p, b_p, a_len < b_len ? a_len : b_len);
+    if (ret != 0) {
+        return ret;
+    }
+    return a_len < b_len ? -1 : a_len > b_len ? 1 : 0;
+}
+
+// Position of the first key not below `key_p`, or above it if not
+// `inclusive`.
+static size_t lower_bound_(
+    const index_key_t *keys, size_t len, const char *key_p, int key_len,
+    bool inclusive
+) {
+    size_t lo = 0;
+    size_t hi = len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int ret =
+            compare_(keys[mid].key_p, keys[mid].key_len, key_p, key_len);
+        if (ret < 0 || (ret == 0 && !inclusive)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static inline bool find_(
+    const index_key_t *keys, size_t len, const char *key_p, int key_len,
+    size_t *at
+) {
+    *at = lower_bound_(keys, len, key_p, key_len, true);
+    if (*at == len) {
+        return false;
+    }
+    return compare_(keys[*at].key_p, keys[*at].key_len, key_p, key_len) == 0;
+}
+
+static inline char *copy_key_(const char *key_p, int key_len) {
+    char *p = malloc(key_len > 0 ? key_len : 1);
+    if (p != NULL) {
+        memcpy(p, key_p, key_len);
+    }
+    return p;
+}
+
+static uint32_t checksum_(uint32_t hash, const char *p, size_t len) {
+    // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void free_keys_(key_index_t *index) {
+    for (size_t i = 0; i < index->run_len; i++) {
+        free(index->run[i].key_p);
+    }
+    for (size_t i = 0; i < index->pending_len; i++) {
+        free(index->pending[i].key_p);
+    }
+    index->run_len = 0;
+    index->pending_len = 0;
+    index->dead_count = 0;
+}
+
+static void free_index_(key_index_t *index) {
+    free_keys_(index);
+    free(index->run);
+    free(index->dead);
+    free(index->name);
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
+
+// Merge the pending keys into the run and drop the dead ones.
+static int merge_(key_index_t *index) {
+    size_t len = index->run_len - index->dead_count + index->pending_len;
+    index_key_t *run = malloc((len > 0 ? len : 1) * sizeof(index_key_t));
+    unsigned char *dead = calloc(len > 0 ? len : 1, 1);
+    if (run == NULL || dead == NULL) {
+        free(run);
+        free(dead);
+        return -1;
+    }
+
+    size_t i = 0, j = 0, k = 0;
+    while (i < index->run_len || j < index->pending_len) {
+        if (i < index->run_len && index->dead[i]) {
+            free(index->run[i++].key_p);
+        } else if (j == index->pending_len ||
+                   (i < index->run_len &&
+                    compare_(
+                        index->run[i].key_p, index->run[i].key_len,
+                        index->pending[j].key_p, index->pending[j].key_len
+                    ) < 0)) {
+            run[k++] = index->run[i++];
+        } else {
+            run[k++] = index->pending[j++];
+        }
+    }
+
+    free(index->run);
+    free(index->dead);
+    index->run = run;
+    index->run_len = len;
+    index->run_capacity = len;
+    index->dead = dead;
+    index->dead_count = 0;
+    index->pending_len = 0;
+    return 0;
+}
+
+int key_index_append(key_index_t *index, const char *key_p, int key_len) {
+    if (index->run_len == index->run_capacity) {
+        size_t capacity =
+            index->run_capacity > 0 ? index->run_capacity * 2 : 1024;
+        index_key_t *run = realloc(index->run, capacity * sizeof(index_key_t));
+        if (run == NULL) {
+            return -1;
+        }
+        index->run = run;
+        index->run_capacity = capacity;
+    }
+
+    char *p = copy_key_(key_p, key_len);
+    if (p == NULL) {
+        return -1;
+    }
+    index->run[index->run_len++] = (index_key_t){p, key_len};
+    return 0;
+}
+
+static int compare_keys_(const void *a, const void *b) {
+    const index_key_t *x = a;
+    const index_key_t *y = b;
+    return compare_(x->key_p, x->key_len, y->key_p, y->key_len);
+}
+
+// Sort the appended keys and drop duplicates.
+static int finish_fill_(key_index_t *index) {
+    qsort(index->run, index->run_len, sizeof(index_key_t), compare_keys_);
+
+    size_t len = 0;
+    for (size_t i = 0; i < index->run_len; i++) {
+        if (len > 0 && compare_keys_(&index->run[len - 1], &index->run[i]) == 0) {
+            free(index->run[i].key_p);
+        } else {
+            index->run[len++] = index->run[i];
+        }
+    }
+    index->run_len = len;
+
+    index->dead = calloc(len > 0 ? len : 1, 1);
+    return index->dead != NULL ? 0 : -1;
+}
+
+// Identifies the state of the table files, so that a saved index is only
+// used with the table it was saved with.
+static bool stamp_(const char *name, uint64_t *stamp) {
+    char log_path[PATH_SIZE];
+    int path_len = snprintf(log_path, PATH_SIZE, "%s%s", name, LOG_EXT);
+    if (path_len <= 0 || path_len >= PATH_SIZE) {
+        return false;
+    }
+
+    uint64_t fields[10] = {0};
+    struct stat st;
+    if (stat(name, &st) != 0) {
+        return false;
+    }
+    fields[0] = st.st_dev;
+    fields[1] = st.st_ino;
+    fields[2] = st.st_size;
+    fields[3] = st.st_mtim.tv_sec;
+    fields[4] = st.st_mtim.tv_nsec;
+    // a memory table keeps its recent writes in the log
+    if (stat(log_path, &st) == 0) {
+        fields[5] = st.st_dev;
+        fields[6] = st.st_ino;
+        fields[7] = st.st_size;
+        fields[8] = st.st_mtim.tv_sec;
+        fields[9] = st.st_mtim.tv_nsec;
+    }
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char *p = (const unsigned char *)fields;
+    for (size_t i = 0; i < sizeof(fields); i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    *stamp = hash;
+    return true;
+}
+
+static bool index_path_(char *buf, const char *name, const char *ext) {
+    int len = snprintf(buf, PATH_SIZE, "%s%s%s", name, INDEX_EXT, ext);
+    return len > 0 && len < PATH_SIZE;
+}
+
+static bool read_saved_(FILE *fp, char **data_p, size_t *data_len) {
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long len = ftell(fp);
+    if (len < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    char *data = malloc(len > 0 ? len : 1);
+    if (data == NULL) {
+        return false;
+    }
+    if (fread(data, 1, len, fp) != (size_t)len) {
+        free(data);
+        return false;
+    }
+    *data_p = data;
+    *data_len = len;
+    return true;
+}
+
+// Load the saved index if it matches the table. Any problem with it only
+// means that the index is built from the table instead.
+static bool load_(key_index_t *index) {
+    char path[PATH_SIZE];
+    uint64_t stamp;
+    if (!index_path_(path, index->name, "") || !stamp_(index->name, &stamp)) {
+        return false;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    char *data;
+    size_t len;
+    bool read = read_saved_(fp, &data, &len);
+    fclose(fp);
+    if (!read) {
+        return false;
+    }
+
+    const size_t header_size =
+        FILE_MAGIC_SIZE + sizeof(uint64_t) + sizeof(uint32_t);
+    uint64_t saved_stamp;
+    uint32_t count, checksum;
+    bool valid = len >= header_size + sizeof(uint32_t) &&
+                 memcmp(data, FILE_MAGIC, FILE_MAGIC_SIZE) == 0;
+    if (valid) {
+        memcpy(&saved_stamp, data + FILE_MAGIC_SIZE, sizeof(uint64_t));
+        memcpy(&count, data + FILE_MAGIC_SIZE + sizeof(uint64_t), sizeof(uint32_t));
+        memcpy(&checksum, data + len - sizeof(uint32_t), sizeof(uint32_t));
+        valid = saved_stamp == stamp &&
+                checksum == checksum_(
+                                2166136261u, data + FILE_MAGIC_SIZE,
+                                len - FILE_MAGIC_SIZE - sizeof(uint32_t)
+                            );
+    }
+
+    const char *p = data + header_size;
+    const char *end = data + len - sizeof(uint32_t);
+    for (uint32_t i = 0; valid && i < count; i++) {
+        uint32_t key_len;
+        if ((size_t)(end - p) < sizeof(uint32_t)) {
+            valid = false;
+            break;
+        }
+        memcpy(&key_len, p, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        if ((size_t)(end - p) < key_len || key_len > INT32_MAX) {
+            valid = false;
+            break;
+        }
+        // keys must be strictly ascending
+        if (index->run_len > 0) {
+            const index_key_t *last = &index->run[index->run_len - 1];
+            if (compare_(last->key_p, last->key_len, p, key_len) >= 0) {
+                valid = false;
+                break;
+            }
+        }
+        valid = key_index_append(index, p, key_len) == 0;
+        p += key_len;
+    }
+    valid = valid && p == end;
+    free(data);
+
+    if (valid) {
+        index->dead = calloc(index->run_len > 0 ? index->run_len : 1, 1);
+        valid = index->dead != NULL;
+    }
+    if (!valid) {
+        free_keys_(index);
+    }
+    return valid;
+}
+
+static bool write_key_(FILE *fp, const index_key_t *key, uint32_t *checksum) {
+    uint32_t key_len = (uint32_t)key->key_len;
+    *checksum = checksum_(*checksum, (const char *)&key_len, sizeof(key_len));
+    *checksum = checksum_(*checksum, key->key_p, key->key_len);
+    return fwrite(&key_len, sizeof(key_len), 1, fp) == 1 &&
+           fwrite(key->key_p, 1, key->key_len, fp) == (size_t)key->key_len;
+}
+
+// Write the index next to the table, or remove a stale saved one.
+static void save_(key_index_t *index) {
+    char path[PATH_SIZE];
+    char tmp_path[PATH_SIZE];
+    if (!index_path_(path, index->name, "") ||
+        !index_path_(tmp_path, index->name, TMP_EXT)) {
+        return;
+    }
+
+    uint64_t stamp;
+    if (!index->valid || merge_(index) != 0 || index->run_len > UINT32_MAX ||
+        !stamp_(index->name, &stamp)) {
+        unlink(path);
+        return;
+    }
+
+    // keys are as private as the table
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (fp == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        unlink(path);
+        return;
+    }
+
+    uint32_t count = (uint32_t)index->run_len;
+    uint32_t checksum = 2166136261u;
+    checksum = checksum_(checksum, (const char *)&stamp, sizeof(stamp));
+    checksum = checksum_(checksum, (const char *)&count, sizeof(count));
+    bool ok = fwrite(FILE_MAGIC, 1, FILE_MAGIC_SIZE, fp) == FILE_MAGIC_SIZE &&
+              fwrite(&stamp, sizeof(stamp), 1, fp) == 1 &&
+              fwrite(&count, sizeof(count), 1, fp) == 1;
+    for (size_t i = 0; ok && i < index->run_len; i++) {
+        ok = write_key_(fp, &index->run[i], &checksum);
+    }
+    ok = ok && fwrite(&checksum, sizeof(checksum), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        unlink(path);
+    }
+}
+
+static key_index_t *find_registered_(const char *name) {
+    for (key_index_t *index = registry; index != NULL; index = index->next) {
+        if (strcmp(index->name, name) == 0) {
+            return index;
+        }
+    }
+    return NULL;
+}
+
+gdbm_error key_index_open(const char *name, key_index_fill_fn fill, void *ctx) {
+    pthread_mutex_lock(&registry_lock);
+
+    key_index_t *index = find_registered_(name);
+    if (index != NULL) {
+        index->refs++;
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_NO_ERROR;
+    }
+
+    index = calloc(1, sizeof(key_index_t));
+    if (index == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_MALLOC_ERROR;
+    }
+    pthread_mutex_init(&index->lock, NULL);
+    index->refs = 1;
+    index->valid = true;
+    index->name = strdup(name);
+    if (index->name == NULL) {
+        free_index_(index);
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_MALLOC_ERROR;
+    }
+
+    gdbm_error err = GDBM_NO_ERROR;
+    if (!load_(index)) {
+        err = fill(ctx, index);
+        if (err == GDBM_NO_ERROR && finish_fill_(index) != 0) {
+            err = GDBM_MALLOC_ERROR;
+        }
+    }
+    if (err != GDBM_NO_ERROR) {
+        free_index_(index);
+        pthread_mutex_unlock(&registry_lock);
+        return err;
+    }
+
+    index->next = registry;
+    registry = index;
+    pthread_mutex_unlock(&registry_lock);
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error key_index_close(const char *name) {
+    pthread_mutex_lock(&registry_lock);
+
+    key_index_t **link = &registry;
+    while (*link != NULL && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    key_index_t *index = *link;
+    if (index == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_ITEM_NOT_FOUND;
+    }
+
+    if (--index->refs == 0) {
+        *link = index->next;
+        // wait for a caller still holding the index
+        pthread_mutex_lock(&index->lock);
+        pthread_mutex_unlock(&index->lock);
+        save_(index);
+        free_index_(index);
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    return GDBM_NO_ERROR;
+}
+
+key_index_t *key_index_acquire(const char *name) {
+    pthread_mutex_lock(&registry_lock);
+    key_index_t *index = registry != NULL ? find_registered_(name) : NULL;
+    if (index != NULL) {
+        pthread_mutex_lock(&index->lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return index;
+}
+
+void key_index_release(key_index_t *index) {
+    pthread_mutex_unlock(&index->lock);
+}
+
+int key_index_add(key_index_t *index, const char *key_p, int key_len) {
+    if (!index->valid) {
+        return -1;
+    }
+
+    size_t at;
+    if (find_(index->run, index->run_len, key_p, key_len, &at)) {
+        if (index->dead[at]) {
+            index->dead[at] = 0;
+            index->dead_count--;
+        }
+        return 0;
+    }
+    if (find_(index->pending, index->pending_len, key_p, key_len, &at)) {
+        return 0;
+    }
+
+    char *p = copy_key_(key_p, key_len);
+    if (p == NULL) {
+        index->valid = false;
+        return -1;
+    }
+    memmove(
+        &index->pending[at + 1], &index->pending[at],
+        (index->pending_len - at) * sizeof(index_key_t)
+    );
+    index->pending[at] = (index_key_t){p, key_len};
+    index->pending_len++;
+
+    if (index->pending_len == PENDING_CAPACITY && merge_(index) != 0) {
+        index->valid = false;
+        return -1;
+    }
+    return 0;
+}
+
+int key_index_remove(key_index_t *index, const char *key_p, int key_len) {
+    if (!index->valid) {
+        return -1;
+    }
+
+    size_t at;
+    if (find_(index->pending, index->pending_len, key_p, key_len, &at)) {
+        free(index->pending[at].key_p);
+        index->pending_len--;
+        memmove(
+            &index->pending[at], &index->pending[at + 1],
+            (index->pending_len - at) * sizeof(index_key_t)
+        );
+        return 0;
+    }
+    if (find_(index->run, index->run_len, key_p, key_len, &at) &&
+        !index->dead[at]) {
+        index->dead[at] = 1;
+        index->dead_count++;
+        // keep queries from stepping over more dead keys than live ones;
+        // if the merge fails the keys simply stay marked
+        if (index->dead_count > index->run_len / 2) {
+            merge_(index);
+        }
+    }
+    return 0;
+}
+
+void key_index_clear(key_index_t *index) {
+    free_keys_(index);
+    index->valid = true;
+}
+
+int key_index_query(
+    key_index_t *index, const key_range_t *range, int limit,
+    key_visit_fn visit, void *ctx
+) {
+    if (!index->valid) {
+        return -1;
+    }
+
+    // start from the greater of the lower bound and the prefix
+    const char *start_p = range->lower_p;
+    int start_len = range->lower_len;
+    bool start_inclusive = range->lower_inclusive;
+    if (range->prefix_p != NULL &&
+        (start_p == NULL ||
+         compare_(start_p, start_len, range->prefix_p, range->prefix_len) <
+             0)) {
+        start_p = range->prefix_p;
+        start_len = range->prefix_len;
+        start_inclusive = true;
+    }
+
+    size_t i = 0, j = 0;
+    if (start_p != NULL) {
+        i = lower_bound_(
+            index->run, index->run_len, start_p, start_len, start_inclusive
+        );
+        j = lower_bound_(
+            index->pending, index->pending_len, start_p, start_len,
+            start_inclusive
+        );
+    }
+
+    int count = 0;
+    while (count < limit) {
+        while (i < index->run_len && index->dead[i]) {
+            i++;
+        }
+
+        const index_key_t *key;
+        if (i < index->run_len &&
+            (j == index->pending_len ||
+             compare_(
+                 index->run[i].key_p, index->run[i].key_len,
+                 index->pending[j].key_p, index->pending[j].key_len
+             ) < 0)) {
+            key = &index->run[i++];
+        } else if (j < index->pending_len) {
+            key = &index->pending[j++];
+        } else {
+            break;
+        }
+
+        if (range->prefix_p != NULL &&
+            (key->key_len < range->prefix_len ||
+             memcmp(key->key_p, range->prefix_p, range->prefix_len) != 0)) {
+            break;
+        }
+        if (range->upper_p != NULL) {
+            int ret = compare_(
+                key->key_p, key->key_len, range->upper_p, range->upper_len
+            );
+            if (ret > 0 || (ret == 0 && !range->upper_inclusive)) {
+                break;
+            }
+        }
+
+        count++;
+        if (!visit(ctx, key->key_p, key->key_len)) {
+            break;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _KEY_INDEX_H_
+#define _KEY_INDEX_H_
+
+#include <gdbm.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// An ordered index of the keys of a table, kept next to the GDBM hash so
+// that prefix and range queries do not walk the whole table. Keys are
+// ordered by their bytes. Keys with a NUL byte (sibling records) are not
+// indexed.
+//
+// The index is a sorted run plus a small sorted buffer of added keys that
+// is merged into the run when it fills up; removed keys of the run are
+// only marked until the next merge. It is saved to "<name>.idx" when closed
+// and loaded from there on open unless the table changed in the meantime.
+// Only writes made through this process are seen while it is open.
+typedef struct key_index_s key_index_t;
+
+// Called by key_index_open to fill a new index with key_index_append when
+// there is no valid saved index. Returns a gdbm_error.
+typedef gdbm_error (*key_index_fill_fn)(void *ctx, key_index_t *index);
+
+// Load or build the index of `name` and register it. Opening a registered
+// index again only adds a reference.
+gdbm_error key_index_open(const char *name, key_index_fill_fn fill, void *ctx);
+// Drop a reference, and save and free the index with the last one.
+gdbm_error key_index_close(const char *name);
+
+// Find a registered index and lock it. NULL if `name` is not registered.
+key_index_t *key_index_acquire(const char *name);
+void key_index_release(key_index_t *index);
+
+// Add a key in any order while filling.
+int key_index_append(key_index_t *index, const char *key_p, int key_len);
+
+// Adding a present key or removing a missing one does nothing.
+// Returns -1 if out of memory; the index is unusable from then on.
+int key_index_add(key_index_t *index, const char *key_p, int key_len);
+int key_index_remove(key_index_t *index, const char *key_p, int key_len);
+void key_index_clear(key_index_t *index);
+
+// Bounds of a query; a NULL pointer leaves that side open. With a prefix,
+// only the keys starting with it are visited.
+typedef struct {
+    const char *lower_p;
+    int lower_len;
+    bool lower_inclusive;
+    const char *upper_p;
+    int upper_len;
+    bool upper_inclusive;
+    const char *prefix_p;
+    int prefix_len;
+} key_range_t;
+
+// Returning false stops the query after this key.
+typedef bool (*key_visit_fn)(void *ctx, const char *key_p, int key_len);
+
+// Visit at most `limit` keys within `range` in ascending order. Returns the
+// number of visited keys, -1 if the index is unusable.
+int key_index_query(
+    key_index_t *index, const key_range_t *range, int limit,
+    key_visit_fn visit, void *ctx
+);
+
+#endif // _KEY_INDEX_H_
@@ -0,0 +1,938 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "mem_table.h"
+#include "shm_table.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_EXT ".log"
+#define SNAPSHOT_EXT ".snapshot"
+#define PATH_SIZE 512
+#define INITIAL_CAPACITY 64
+#define CHUNK_SIZE (1 << 20)
+#define ALIGN(n) (((n) + 7) & ~(size_t)7)
+#define TOMBSTONE ((entry_t *)1)
+#define LOCK_RETRIES 200
+#define LOCK_RETRY_US 5000
+
+// Keys and values live in an arena; replaced and deleted entries are only
+// counted as garbage and reclaimed by compaction at snapshot time.
+typedef struct {
+    uint32_t key_len;
+    uint32_t data_len;
+    char bytes[]; // key followed by data
+} entry_t;
+
+typedef struct {
+    uint64_t hash;
+    entry_t *entry; // NULL if empty, TOMBSTONE if deleted
+} slot_t;
+
+typedef struct chunk_s {
+    struct chunk_s *next;
+    size_t size;
+    size_t used;
+    char data[];
+} chunk_t;
+
+struct mem_table_s {
+    struct mem_table_s *next;
+    char *name;
+    int refs;
+    pthread_mutex_t lock;
+
+    // open addressing with linear probing, capacity is a power of two
+    slot_t *slots;
+    size_t capacity;
+    size_t used; // live entries and tombstones
+    size_t live;
+    size_t primary; // live keys without a NUL byte
+
+    chunk_t *chunks;
+    size_t arena_bytes;
+    size_t garbage_bytes;
+
+    // records of a shared table, which leaves the fields above unused
+    shm_table_t *shm;
+    bool write_locked;
+
+    int log_fd;
+    bool sync_writes;
+    gdbm_error last_errno;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static mem_table_t *registry = NULL;
+
+static inline uint64_t hash_(const char *p, size_t len) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static inline size_t entry_size_(size_t key_len, size_t data_len) {
+    return ALIGN(sizeof(entry_t) + key_len + data_len);
+}
+
+static inline bool is_primary_(const char *key, size_t key_len) {
+    return memchr(key, '\0', key_len) == NULL;
+}
+
+static void *arena_alloc_(mem_table_t *table, size_t size) {
+    chunk_t *chunk = table->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+        chunk = malloc(sizeof(chunk_t) + chunk_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = table->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        table->chunks = chunk;
+    }
+    void *p = chunk->data + chunk->used;
+    chunk->used += size;
+    table->arena_bytes += size;
+    return p;
+}
+
+static void free_chunks_(chunk_t *chunk) {
+    while (chunk != NULL) {
+        chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+// Index of the slot holding `key`, or of the slot to insert it into.
+static size_t probe_(
+    const mem_table_t *table, const char *key, size_t key_len, uint64_t hash,
+    bool *found
+) {
+    size_t mask = table->capacity - 1;
+    size_t insert_at = SIZE_MAX;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const slot_t *slot = &table->slots[i];
+        if (slot->entry == NULL) {
+            *found = false;
+            return insert_at != SIZE_MAX ? insert_at : i;
+        } else if (slot->entry == TOMBSTONE) {
+            if (insert_at == SIZE_MAX) {
+                insert_at = i;
+            }
+        } else if (slot->hash == hash && slot->entry->key_len == key_len &&
+                   memcmp(slot->entry->bytes, key, key_len) == 0) {
+            *found = true;
+            return i;
+        }
+    }
+}
+
+static bool resize_(mem_table_t *table, size_t capacity) {
+    slot_t *slots = calloc(capacity, sizeof(slot_t));
+    if (slots == NULL) {
+        return false;
+    }
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < table->capacity; i++) {
+        slot_t *slot = &table->slots[i];
+        if (slot->entry == NULL || slot->entry == TOMBSTONE) {
+            continue;
+        }
+        size_t j = slot->hash & mask;
+        while (slots[j].entry != NULL) {
+            j = (j + 1) & mask;
+        }
+        slots[j] = *slot;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    table->used = table->live;
+    return true;
+}
+
+// Make room for one more slot, so that a slot found by probe_() stays
+// valid until it is filled.
+static bool reserve_(mem_table_t *table) {
+    if ((table->used + 1) * 4 > table->capacity * 3) {
+        // grow unless most of the used slots are tombstones
+        size_t capacity = (table->live + 1) * 2 > table->capacity
+                              ? table->capacity * 2
+                              : table->capacity;
+        if (!resize_(table, capacity)) {
+            table->last_errno = GDBM_MALLOC_ERROR;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Store into slot `i` as returned by probe_() for `key`.
+static int put_at_(
+    mem_table_t *table, size_t i, bool found, uint64_t hash, datum key,
+    datum data
+) {
+    entry_t *entry = arena_alloc_(table, entry_size_(key.dsize, data.dsize));
+    if (entry == NULL) {
+        table->last_errno = GDBM_MALLOC_ERROR;
+        return -1;
+    }
+    entry->key_len = key.dsize;
+    entry->data_len = data.dsize;
+    memcpy(entry->bytes, key.dptr, key.dsize);
+    if (data.dsize > 0) {
+        memcpy(entry->bytes + key.dsize, data.dptr, data.dsize);
+    }
+
+    slot_t *slot = &table->slots[i];
+    if (found) {
+        table->garbage_bytes +=
+            entry_size_(slot->entry->key_len, slot->entry->data_len);
+    } else {
+        if (slot->entry == NULL) {
+            table->used++;
+        }
+        table->live++;
+        if (is_primary_(key.dptr, key.dsize)) {
+            table->primary++;
+        }
+    }
+    slot->hash = hash;
+    slot->entry = entry;
+
+    table->last_errno = GDBM_NO_ERROR;
+    return 0;
+}
+
+// Returns 0 if stored, 1 if the key exists and `flag` is GDBM_INSERT,
+// -1 on error.
+static int put_(mem_table_t *table, datum key, datum data, int flag) {
+    if (table->shm != NULL) {
+        table->last_errno = shm_table_put(table->shm, key, data, flag);
+        return table->last_errno == GDBM_NO_ERROR         ? 0
+               : table->last_errno == GDBM_CANNOT_REPLACE ? 1
+                                                          : -1;
+    }
+
+    if (!reserve_(table)) {
+        return -1;
+    }
+
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    bool found;
+    size_t i = probe_(table, key.dptr, key.dsize, hash, &found);
+    if (found && flag == GDBM_INSERT) {
+        table->last_errno = GDBM_CANNOT_REPLACE;
+        return 1;
+    }
+
+    return put_at_(table, i, found, hash, key, data);
+}
+
+// Turn the entry in slot `i` into a tombstone.
+static void remove_at_(mem_table_t *table, size_t i) {
+    slot_t *slot = &table->slots[i];
+    table->garbage_bytes +=
+        entry_size_(slot->entry->key_len, slot->entry->data_len);
+    if (is_primary_(slot->entry->bytes, slot->entry->key_len)) {
+        table->primary--;
+    }
+    slot->entry = TOMBSTONE;
+    table->live--;
+
+    table->last_errno = GDBM_NO_ERROR;
+}
+
+static int remove_(mem_table_t *table, datum key) {
+    if (table->shm != NULL) {
+        table->last_errno = shm_table_remove(table->shm, key);
+        return table->last_errno == GDBM_NO_ERROR ? 0 : -1;
+    }
+
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    bool found;
+    size_t i = probe_(table, key.dptr, key.dsize, hash, &found);
+    if (!found) {
+        table->last_errno = GDBM_ITEM_NOT_FOUND;
+        return -1;
+    }
+
+    remove_at_(table, i);
+    return 0;
+}
+
+static const entry_t *find_(mem_table_t *table, datum key, size_t *index) {
+    bool found;
+    size_t i =
+        probe_(table, key.dptr, key.dsize, hash_(key.dptr, key.dsize), &found);
+    if (!found) {
+        return NULL;
+    }
+    if (index != NULL) {
+        *index = i;
+    }
+    return table->slots[i].entry;
+}
+
+static datum copy_bytes_(mem_table_t *table, const char *p, size_t len) {
+    // never NULL for an existing item, even if it is empty
+    char *copy = malloc(len > 0 ? len : 1);
+    if (copy == NULL) {
+        table->last_errno = GDBM_MALLOC_ERROR;
+        return (datum){NULL, 0};
+    }
+    memcpy(copy, p, len);
+    table->last_errno = GDBM_NO_ERROR;
+    return (datum){copy, (int)len};
+}
+
+// Move the live entries into a fresh arena sized to hold all of them.
+static bool compact_(mem_table_t *table) {
+    size_t live_bytes = table->arena_bytes - table->garbage_bytes;
+    chunk_t *chunk = malloc(sizeof(chunk_t) + live_bytes);
+    if (chunk == NULL) {
+        return false;
+    }
+    chunk->next = NULL;
+    chunk->size = live_bytes;
+    chunk->used = 0;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        slot_t *slot = &table->slots[i];
+        if (slot->entry == NULL || slot->entry == TOMBSTONE) {
+            continue;
+        }
+        size_t size = entry_size_(slot->entry->key_len, slot->entry->data_len);
+        entry_t *entry = (entry_t *)(chunk->data + chunk->used);
+        memcpy(entry, slot->entry, size);
+        chunk->used += size;
+        slot->entry = entry;
+    }
+
+    free_chunks_(table->chunks);
+    table->chunks = chunk;
+    table->arena_bytes = chunk->used;
+    table->garbage_bytes = 0;
+    return true;
+}
+
+static int apply_logged_(void *ctx, const redo_entry_t *entry) {
+    return mem_table_apply(ctx, entry);
+}
+
+static mem_table_t *find_registered_(const char *name) {
+    for (mem_table_t *table = registry; table != NULL; table = table->next) {
+        if (strcmp(table->name, name) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
+
+static void free_table_(mem_table_t *table) {
+    if (table->log_fd >= 0) {
+        close(table->log_fd);
+    }
+    if (table->shm != NULL) {
+        shm_table_close(table->shm);
+    }
+    free_chunks_(table->chunks);
+    free(table->slots);
+    free(table->name);
+    pthread_mutex_destroy(&table->lock);
+    free(table);
+}
+
+static gdbm_error load_snapshot_(mem_table_t *table) {
+    if (access(table->name, F_OK) != 0) {
+        return GDBM_NO_ERROR;
+    }
+
+    // a worker opening a shared table may be creating the file just now
+    GDBM_FILE dbf;
+    for (int retry = 0;; retry++) {
+        dbf = gdbm_open(table->name, 0, GDBM_READER, 0600, NULL);
+        if (dbf != NULL) {
+            break;
+        } else if (retry == LOCK_RETRIES || gdbm_errno != GDBM_CANT_BE_READER) {
+            return gdbm_errno;
+        }
+        usleep(LOCK_RETRY_US);
+    }
+
+    gdbm_error err = GDBM_NO_ERROR;
+    datum key = gdbm_firstkey(dbf);
+    while (key.dptr != NULL && err == GDBM_NO_ERROR) {
+        datum data = gdbm_fetch(dbf, key);
+        if (data.dptr != NULL) {
+            if (put_(table, key, data, GDBM_REPLACE) != 0) {
+                err = table->last_errno;
+            }
+            free(data.dptr);
+        }
+        datum next_key = gdbm_nextkey(dbf, key);
+        free(key.dptr);
+        key = next_key;
+    }
+    free(key.dptr);
+    gdbm_close(dbf);
+
+    return err;
+}
+
+static bool log_path_(char *log_path, const char *name) {
+    int path_len = snprintf(log_path, PATH_SIZE, "%s%s", name, LOG_EXT);
+    return path_len > 0 && path_len < PATH_SIZE;
+}
+
+// Fill the table from the snapshot and the log.
+static gdbm_error load_(void *ctx) {
+    mem_table_t *table = ctx;
+    char log_path[PATH_SIZE];
+    if (!log_path_(log_path, table->name)) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    gdbm_error err = load_snapshot_(table);
+    if (err != GDBM_NO_ERROR || !redo_log_exists(log_path)) {
+        return err;
+    }
+
+    size_t valid_len = 0;
+    int ret = redo_log_replay(log_path, apply_logged_, table, &valid_len);
+    if (ret == -1) {
+        return GDBM_FILE_READ_ERROR;
+    } else if (ret == -2) {
+        return table->last_errno;
+    }
+    // cut a torn tail so that new frames follow the valid ones
+    if (truncate(log_path, (off_t)valid_len) != 0) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error mem_table_open(
+    const char *name, bool sync_writes, size_t shared_size
+) {
+    pthread_mutex_lock(&registry_lock);
+
+    mem_table_t *table = find_registered_(name);
+    if (table != NULL) {
+        table->refs++;
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_NO_ERROR;
+    }
+
+    char log_path[PATH_SIZE];
+    if (!log_path_(log_path, name)) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    table = calloc(1, sizeof(mem_table_t));
+    if (table == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_MALLOC_ERROR;
+    }
+    pthread_mutex_init(&table->lock, NULL);
+    table->log_fd = -1;
+    table->refs = 1;
+    table->sync_writes = sync_writes;
+    table->name = strdup(name);
+    table->capacity = INITIAL_CAPACITY;
+    if (shared_size == 0) {
+        table->slots = calloc(INITIAL_CAPACITY, sizeof(slot_t));
+    }
+    if (table->name == NULL || (shared_size == 0 && table->slots == NULL)) {
+        free_table_(table);
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_MALLOC_ERROR;
+    }
+
+    gdbm_error err =
+        shared_size > 0
+            ? shm_table_open(name, shared_size, load_, table, &table->shm)
+            : load_(table);
+
+    if (err == GDBM_NO_ERROR) {
+        table->log_fd =
+            open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (table->log_fd < 0) {
+            err = GDBM_FILE_OPEN_ERROR;
+        }
+    }
+
+    if (err != GDBM_NO_ERROR) {
+        free_table_(table);
+        pthread_mutex_unlock(&registry_lock);
+        return err;
+    }
+
+    table->next = registry;
+    registry = table;
+    pthread_mutex_unlock(&registry_lock);
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error mem_table_close(const char *name) {
+    pthread_mutex_lock(&registry_lock);
+
+    mem_table_t **link = &registry;
+    while (*link != NULL && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    mem_table_t *table = *link;
+    if (table == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_ITEM_NOT_FOUND;
+    }
+
+    if (--table->refs == 0) {
+        *link = table->next;
+        // wait for a caller still holding the table
+        pthread_mutex_lock(&table->lock);
+        pthread_mutex_unlock(&table->lock);
+        free_table_(table);
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    return GDBM_NO_ERROR;
+}
+
+mem_table_t *mem_table_acquire(const char *name, bool write) {
+    pthread_mutex_lock(&registry_lock);
+    mem_table_t *table = registry != NULL ? find_registered_(name) : NULL;
+    if (table != NULL) {
+        pthread_mutex_lock(&table->lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (table != NULL && table->shm != NULL && write) {
+        shm_table_lock(table->shm);
+        table->write_locked = true;
+    }
+    return table;
+}
+
+void mem_table_release(mem_table_t *table) {
+    if (table->write_locked) {
+        table->write_locked = false;
+        shm_table_unlock(table->shm);
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+bool mem_table_is_shared(mem_table_t *table) {
+    return table->shm != NULL;
+}
+
+datum mem_table_fetch(mem_table_t *table, datum key) {
+    if (table->shm != NULL) {
+        datum data = {NULL, 0};
+        table->last_errno = shm_table_fetch(table->shm, key, &data);
+        return data;
+    }
+
+    const entry_t *entry = find_(table, key, NULL);
+    if (entry == NULL) {
+        table->last_errno = GDBM_ITEM_NOT_FOUND;
+        return (datum){NULL, 0};
+    }
+    return copy_bytes_(table, entry->bytes + entry->key_len, entry->data_len);
+}
+
+int mem_table_read(
+    mem_table_t *table, datum key, char *buf, size_t bufsize, size_t *len
+) {
+    if (table->shm != NULL) {
+        table->last_errno = shm_table_read(table->shm, key, buf, bufsize, len);
+        return table->last_errno == GDBM_NO_ERROR ? 0 : -1;
+    }
+
+    const entry_t *entry = find_(table, key, NULL);
+    if (entry == NULL) {
+        table->last_errno = GDBM_ITEM_NOT_FOUND;
+        return -1;
+    }
+    *len = entry->data_len;
+    if (entry->data_len <= bufsize) {
+        memcpy(buf, entry->bytes + entry->key_len, entry->data_len);
+    }
+    table->last_errno = GDBM_NO_ERROR;
+    return 0;
+}
+
+// Writes to a shared table check and reserve before logging, like the ones
+// below, and then apply what was logged.
+static int shared_store_(mem_table_t *table, datum key, datum data, int flag) {
+    table->last_errno = shm_table_reserve(table->shm, key.dsize, data.dsize);
+    if (table->last_errno != GDBM_NO_ERROR) {
+        return -1;
+    }
+    if (flag == GDBM_INSERT && shm_table_exists(table->shm, key)) {
+        table->last_errno = GDBM_CANNOT_REPLACE;
+        return 1;
+    }
+    redo_entry_t entry = {REDO_STORE, key.dptr, key.dsize, data.dptr,
+                          data.dsize};
+    if (mem_table_log(table, &entry, 1) != 0) {
+        return -1;
+    }
+    return put_(table, key, data, GDBM_REPLACE);
+}
+
+static int shared_swap_(
+    mem_table_t *table, datum key, datum data, bool must_exist, datum *old
+) {
+    table->last_errno = shm_table_reserve(table->shm, key.dsize, data.dsize);
+    if (table->last_errno != GDBM_NO_ERROR) {
+        return -1;
+    }
+
+    datum previous = {NULL, 0};
+    gdbm_error err = GDBM_NO_ERROR;
+    if (old != NULL) {
+        err = shm_table_fetch(table->shm, key, &previous);
+    } else if (!shm_table_exists(table->shm, key)) {
+        err = GDBM_ITEM_NOT_FOUND;
+    }
+    if (err != GDBM_NO_ERROR && (err != GDBM_ITEM_NOT_FOUND || must_exist)) {
+        table->last_errno = err;
+        return -1;
+    }
+
+    redo_entry_t entry = {REDO_STORE, key.dptr, key.dsize, data.dptr,
+                          data.dsize};
+    if (mem_table_log(table, &entry, 1) != 0 ||
+        put_(table, key, data, GDBM_REPLACE) != 0) {
+        free(previous.dptr);
+        return -1;
+    }
+
+    if (old != NULL) {
+        *old = previous;
+    }
+    return 0;
+}
+
+static int shared_take_(mem_table_t *table, datum key, datum *old) {
+    datum previous = {NULL, 0};
+    gdbm_error err = old != NULL ? shm_table_fetch(table->shm, key, &previous)
+                     : shm_table_exists(table->shm, key) ? GDBM_NO_ERROR
+                                                         : GDBM_ITEM_NOT_FOUND;
+    if (err != GDBM_NO_ERROR) {
+        table->last_errno = err;
+        return -1;
+    }
+
+    redo_entry_t entry = {REDO_DELETE, key.dptr, key.dsize, NULL, 0};
+    if (mem_table_log(table, &entry, 1) != 0 || remove_(table, key) != 0) {
+        free(previous.dptr);
+        return -1;
+    }
+
+    if (old != NULL) {
+        *old = previous;
+    }
+    return 0;
+}
+
+// Each write probes once: the slot found before logging is still the one
+// to fill, since logging does not touch the table.
+int mem_table_store(mem_table_t *table, datum key, datum data, int flag) {
+    if (table->shm != NULL) {
+        return shared_store_(table, key, data, flag);
+    }
+
+    if (!reserve_(table)) {
+        return -1;
+    }
+
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    bool found;
+    size_t i = probe_(table, key.dptr, key.dsize, hash, &found);
+    // only log what is going to be applied
+    if (found && flag == GDBM_INSERT) {
+        table->last_errno = GDBM_CANNOT_REPLACE;
+        return 1;
+    }
+    redo_entry_t entry = {REDO_STORE, key.dptr, key.dsize, data.dptr,
+                          data.dsize};
+    if (mem_table_log(table, &entry, 1) != 0) {
+        return -1;
+    }
+    return put_at_(table, i, found, hash, key, data);
+}
+
+int mem_table_swap(
+    mem_table_t *table, datum key, datum data, bool must_exist, datum *old
+) {
+    if (table->shm != NULL) {
+        return shared_swap_(table, key, data, must_exist, old);
+    }
+
+    if (!reserve_(table)) {
+        return -1;
+    }
+
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    bool found;
+    size_t i = probe_(table, key.dptr, key.dsize, hash, &found);
+    if (!found && must_exist) {
+        table->last_errno = GDBM_ITEM_NOT_FOUND;
+        return -1;
+    }
+
+    datum previous = {NULL, 0};
+    if (found && old != NULL) {
+        const entry_t *entry = table->slots[i].entry;
+        previous = copy_bytes_(
+            table, entry->bytes + entry->key_len, entry->data_len
+        );
+        if (previous.dptr == NULL) {
+            return -1;
+        }
+    }
+
+    redo_entry_t entry = {REDO_STORE, key.dptr, key.dsize, data.dptr,
+                          data.dsize};
+    if (mem_table_log(table, &entry, 1) != 0 ||
+        put_at_(table, i, found, hash, key, data) != 0) {
+        free(previous.dptr);
+        return -1;
+    }
+
+    if (old != NULL) {
+        *old = previous;
+    }
+    return 0;
+}
+
+int mem_table_delete(mem_table_t *table, datum key) {
+    return mem_table_take(table, key, NULL);
+}
+
+int mem_table_take(mem_table_t *table, datum key, datum *old) {
+    if (table->shm != NULL) {
+        return shared_take_(table, key, old);
+    }
+
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    bool found;
+    size_t i = probe_(table, key.dptr, key.dsize, hash, &found);
+    if (!found) {
+        table->last_errno = GDBM_ITEM_NOT_FOUND;
+        return -1;
+    }
+
+    datum previous = {NULL, 0};
+    if (old != NULL) {
+        const entry_t *entry = table->slots[i].entry;
+        previous = copy_bytes_(
+            table, entry->bytes + entry->key_len, entry->data_len
+        );
+        if (previous.dptr == NULL) {
+            return -1;
+        }
+    }
+
+    redo_entry_t entry = {REDO_DELETE, key.dptr, key.dsize, NULL, 0};
+    if (mem_table_log(table, &entry, 1) != 0) {
+        free(previous.dptr);
+        return -1;
+    }
+    remove_at_(table, i);
+
+    if (old != NULL) {
+        *old = previous;
+    }
+    return 0;
+}
+
+int mem_table_exists(mem_table_t *table, datum key) {
+    table->last_errno = GDBM_NO_ERROR;
+    if (table->shm != NULL) {
+        return shm_table_exists(table->shm, key);
+    }
+    return find_(table, key, NULL) != NULL;
+}
+
+static datum key_from_(mem_table_t *table, size_t start) {
+    for (size_t i = start; i < table->capacity; i++) {
+        const entry_t *entry = table->slots[i].entry;
+        if (entry != NULL && entry != TOMBSTONE) {
+            return copy_bytes_(table, entry->bytes, entry->key_len);
+        }
+    }
+    table->last_errno = GDBM_ITEM_NOT_FOUND;
+    return (datum){NULL, 0};
+}
+
+datum mem_table_firstkey(mem_table_t *table) {
+    if (table->shm != NULL) {
+        return mem_table_nextkey(table, (datum){NULL, 0});
+    }
+    return key_from_(table, 0);
+}
+
+datum mem_table_nextkey(mem_table_t *table, datum key) {
+    if (table->shm != NULL) {
+        datum next = {NULL, 0};
+        table->last_errno = shm_table_next_key(table->shm, key, &next);
+        return next;
+    }
+
+    size_t i;
+    if (find_(table, key, &i) == NULL) {
+        table->last_errno = GDBM_ITEM_NOT_FOUND;
+        return (datum){NULL, 0};
+    }
+    return key_from_(table, i + 1);
+}
+
+gdbm_error mem_table_errno(mem_table_t *table) {
+    return table->last_errno;
+}
+
+int mem_table_count(mem_table_t *table) {
+    if (table->shm != NULL) {
+        return (int)shm_table_count(table->shm);
+    }
+    return (int)table->primary;
+}
+
+int mem_table_log(mem_table_t *table, const redo_entry_t *entries, int count) {
+    if (redo_log_append(table->log_fd, entries, count, table->sync_writes) !=
+        0) {
+        table->last_errno = GDBM_FILE_WRITE_ERROR;
+        return -1;
+    }
+    return 0;
+}
+
+int mem_table_apply(mem_table_t *table, const redo_entry_t *entry) {
+    datum key = {entry->key_p, entry->key_len};
+    if (entry->op == REDO_STORE) {
+        datum data = {entry->data_p, entry->data_len};
+        return put_(table, key, data, GDBM_REPLACE);
+    }
+    // deleting twice is harmless when the log is replayed over a snapshot
+    return remove_(table, key) == 0 ||
+                   table->last_errno == GDBM_ITEM_NOT_FOUND
+               ? 0
+               : -1;
+}
+
+static int store_snapshot_(void *ctx, datum key, datum data) {
+    return gdbm_store(ctx, key, data, GDBM_REPLACE);
+}
+
+gdbm_error mem_table_snapshot(mem_table_t *table) {
+    char tmp_path[PATH_SIZE];
+    int path_len =
+        snprintf(tmp_path, PATH_SIZE, "%s%s", table->name, SNAPSHOT_EXT);
+    if (path_len <= 0 || path_len >= PATH_SIZE) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    GDBM_FILE dbf = gdbm_open(tmp_path, 0, GDBM_NEWDB, 0600, NULL);
+    if (dbf == NULL) {
+        return gdbm_errno;
+    }
+
+    gdbm_error err = GDBM_NO_ERROR;
+    if (table->shm != NULL) {
+        if (shm_table_foreach(table->shm, store_snapshot_, dbf) != 0) {
+            err = gdbm_errno;
+        }
+    } else {
+        for (size_t i = 0; i < table->capacity && err == GDBM_NO_ERROR; i++) {
+            entry_t *entry = table->slots[i].entry;
+            if (entry == NULL || entry == TOMBSTONE) {
+                continue;
+            }
+            datum key = {entry->bytes, entry->key_len};
+            datum data = {entry->bytes + entry->key_len, entry->data_len};
+            if (gdbm_store(dbf, key, data, GDBM_REPLACE) != 0) {
+                err = gdbm_errno;
+            }
+        }
+    }
+    if (err == GDBM_NO_ERROR && gdbm_sync(dbf) != 0) {
+        err = GDBM_FILE_WRITE_ERROR;
+    }
+    gdbm_close(dbf);
+
+    if (err == GDBM_NO_ERROR && rename(tmp_path, table->name) != 0) {
+        err = GDBM_FILE_WRITE_ERROR;
+    }
+    if (err != GDBM_NO_ERROR) {
+        unlink(tmp_path);
+        return err;
+    }
+
+    // a crash before this point replays the log over the new snapshot,
+    // which gives the same table
+    if (ftruncate(table->log_fd, 0) != 0 || fdatasync(table->log_fd) != 0) {
+        return GDBM_FILE_WRITE_ERROR;
+    }
+
+    if (table->shm == NULL && table->garbage_bytes > table->arena_bytes / 2) {
+        compact_(table);
+    }
+
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error mem_table_clear(mem_table_t *table, int block_size) {
+    GDBM_FILE dbf = gdbm_open(table->name, block_size, GDBM_NEWDB, 0600, NULL);
+    if (dbf == NULL) {
+        return gdbm_errno;
+    }
+    gdbm_close(dbf);
+
+    if (ftruncate(table->log_fd, 0) != 0) {
+        return GDBM_FILE_WRITE_ERROR;
+    }
+
+    if (table->shm != NULL) {
+        return shm_table_clear(table->shm);
+    }
+
+    memset(table->slots, 0, table->capacity * sizeof(slot_t));
+    table->used = 0;
+    table->live = 0;
+    table->primary = 0;
+    free_chunks_(table->chunks);
+    table->chunks = NULL;
+    table->arena_bytes = 0;
+    table->garbage_bytes = 0;
+
+    return GDBM_NO_ERROR;
+}
@@ -0,0 +1,89 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _MEM_TABLE_H_
+#define _MEM_TABLE_H_
+
+#include "redo_log.h"
+#include <gdbm.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// A table held in an in-process hash table. Every write is appended to
+// "<name>.log"; a snapshot writes the whole table to the GDBM file `name`
+// and empties the log. Tables are registered by name, so the functions of
+// gdbm_wrapper.h transparently use them.
+//
+// A shared table keeps its records in a shared memory table of
+// `shared_size` bytes (see shm_table.h) instead, which every process
+// opening it with a shared size maps. They append to the same log.
+typedef struct mem_table_s mem_table_t;
+
+// Load the snapshot and the log of `name` and register the table; for a
+// shared table, only when no other process has it open. Opening a
+// registered table again only adds a reference.
+gdbm_error mem_table_open(
+    const char *name, bool sync_writes, size_t shared_size
+);
+// Drop a reference and free the table with the last one.
+gdbm_error mem_table_close(const char *name);
+
+// Find a registered table and lock it. NULL if `name` is not registered.
+// With `write`, the writers of other processes sharing the table are
+// excluded as well; readers of a shared table never wait for them.
+mem_table_t *mem_table_acquire(const char *name, bool write);
+void mem_table_release(mem_table_t *table);
+bool mem_table_is_shared(mem_table_t *table);
+
+// The following mirror the GDBM functions of the same name.
+datum mem_table_fetch(mem_table_t *table, datum key);
+int mem_table_store(mem_table_t *table, datum key, datum data, int flag);
+int mem_table_delete(mem_table_t *table, datum key);
+int mem_table_exists(mem_table_t *table, datum key);
+datum mem_table_firstkey(mem_table_t *table);
+datum mem_table_nextkey(mem_table_t *table, datum key);
+gdbm_error mem_table_errno(mem_table_t *table);
+
+// Single-probe variants of store and delete that hand back the previous
+// data in `old`, to be released with free(); pass NULL to skip the copy.
+// mem_table_swap stores `data` and sets `old` to {NULL, 0} for a new key;
+// with `must_exist` a missing key is left alone and -1 returned.
+// mem_table_take deletes `key`.
+int mem_table_swap(
+    mem_table_t *table, datum key, datum data, bool must_exist, datum *old
+);
+int mem_table_take(mem_table_t *table, datum key, datum *old);
+
+// Copy the data of `key` into `buf` if it fits in `bufsize` bytes and
+// store its length to `len`. Returns -1 if `key` does not exist.
+int mem_table_read(
+    mem_table_t *table, datum key, char *buf, size_t bufsize, size_t *len
+);
+
+// Number of keys without a NUL byte, i.e. not counting sibling records.
+int mem_table_count(mem_table_t *table);
+
+// Append `entries` to the log as one frame, without applying them.
+int mem_table_log(mem_table_t *table, const redo_entry_t *entries, int count);
+// Apply a logged entry.
+int mem_table_apply(mem_table_t *table, const redo_entry_t *entry);
+
+// Write the table to its GDBM file and empty the log.
+gdbm_error mem_table_snapshot(mem_table_t *table);
+// Remove every record, from memory, log and snapshot.
+gdbm_error mem_table_clear(mem_table_t *table, int block_size);
+
+#endif // _MEM_TABLE_H_
@@ -0,0 +1,571 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "predicate.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 1000
+#define NUMBER_BUFFER_SIZE 64
+
+struct predicate_s {
+    pred_node_t *nodes;
+    int node_count;
+    int node_capacity;
+
+    pred_str_t *segments;
+    int segment_count;
+    int segment_capacity;
+
+    char *pool;
+    size_t pool_len;
+    size_t pool_capacity;
+
+    int record_count;
+
+    // decoded strings are compared here, one byte longer than the longest
+    // string of the predicate so that a longer value is told apart
+    char *scratch;
+    size_t scratch_size;
+};
+
+static bool grow_(void **p, size_t item_size, int *capacity, int count) {
+    if (count < *capacity) {
+        return true;
+    }
+    int new_capacity = *capacity > 0 ? *capacity * 2 : 8;
+    void *new_p = realloc(*p, (size_t)new_capacity * item_size);
+    if (new_p == NULL) {
+        return false;
+    }
+    *p = new_p;
+    *capacity = new_capacity;
+    return true;
+}
+
+static bool reserve_scratch_(predicate_t *pred, size_t len) {
+    if (len < pred->scratch_size) {
+        return true;
+    }
+    char *scratch = realloc(pred->scratch, len + 1);
+    if (scratch == NULL) {
+        return false;
+    }
+    pred->scratch = scratch;
+    pred->scratch_size = len + 1;
+    return true;
+}
+
+predicate_t *predicate_create() {
+    predicate_t *pred = calloc(1, sizeof(predicate_t));
+    if (pred != NULL && !reserve_scratch_(pred, 0)) {
+        free(pred);
+        return NULL;
+    }
+    return pred;
+}
+
+void predicate_free(predicate_t *pred) {
+    if (pred == NULL) {
+        return;
+    }
+    free(pred->nodes);
+    free(pred->segments);
+    free(pred->pool);
+    free(pred->scratch);
+    free(pred);
+}
+
+int predicate_add_node(predicate_t *pred, int op) {
+    if (!grow_(
+            (void **)&pred->nodes, sizeof(pred_node_t), &pred->node_capacity,
+            pred->node_count
+        )) {
+        return -1;
+    }
+    pred_node_t *node = &pred->nodes[pred->node_count];
+    memset(node, 0, sizeof(pred_node_t));
+    node->op = op;
+    node->size = 1;
+    node->path_start = pred->segment_count;
+    return pred->node_count++;
+}
+
+pred_node_t *predicate_node(predicate_t *pred, int index) {
+    return &pred->nodes[index];
+}
+
+bool predicate_add_string(
+    predicate_t *pred, const char *p, size_t len, pred_str_t *result
+) {
+    if (!reserve_scratch_(pred, len)) {
+        return false;
+    }
+    if (pred->pool_len + len > pred->pool_capacity) {
+        size_t capacity = pred->pool_capacity > 0 ? pred->pool_capacity : 64;
+        while (capacity < pred->pool_len + len) {
+            capacity *= 2;
+        }
+        char *pool = realloc(pred->pool, capacity);
+        if (pool == NULL) {
+            return false;
+        }
+        pred->pool = pool;
+        pred->pool_capacity = capacity;
+    }
+    if (len > 0) {
+        memcpy(pred->pool + pred->pool_len, p, len);
+    }
+    result->offset = pred->pool_len;
+    result->len = len;
+    pred->pool_len += len;
+    return true;
+}
+
+bool predicate_add_segment(predicate_t *pred, const char *p, size_t len) {
+    if (!grow_(
+            (void **)&pred->segments, sizeof(pred_str_t),
+            &pred->segment_capacity, pred->segment_count
+        )) {
+        return false;
+    }
+    pred_str_t segment;
+    if (!predicate_add_string(pred, p, len, &segment)) {
+        return false;
+    }
+    pred->segments[pred->segment_count++] = segment;
+    pred->nodes[pred->node_count - 1].path_count++;
+    return true;
+}
+
+void predicate_close_node(predicate_t *pred, int index) {
+    pred_node_t *node = &pred->nodes[index];
+    node->size = pred->node_count - index;
+    if (node->op != PRED_AND && node->op != PRED_OR &&
+        node->record >= pred->record_count) {
+        pred->record_count = node->record + 1;
+    }
+}
+
+int predicate_record_count(const predicate_t *pred) {
+    return pred->record_count;
+}
+
+static inline const char *skip_ws_(const char *p, const char *end) {
+    while (p < end &&
+           (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static int hex_digit_(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool read_hex4_(const char *p, const char *end, uint32_t *unit) {
+    if (end - p < 4) {
+        return false;
+    }
+    *unit = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit_(p[i]);
+        if (digit < 0) {
+            return false;
+        }
+        *unit = (*unit << 4) | (uint32_t)digit;
+    }
+    return true;
+}
+
+static inline void put_byte_(
+    char *out, size_t outsize, size_t *len, unsigned char c
+) {
+    if (*len < outsize) {
+        out[*len] = (char)c;
+    }
+    (*len)++;
+}
+
+// Decode the JSON string starting at the quote `p` as UTF-8. The first
+// `outsize` bytes are written to `out` and the full length to `len`.
+// Returns the end of the string, or NULL if it is malformed.
+static const char *decode_string_(
+    const char *p, const char *end, char *out, size_t outsize, size_t *len
+) {
+    *len = 0;
+    p++;
+    while (p < end) {
+        unsigned char c = (unsigned char)*p++;
+        if (c == '"') {
+            return p;
+        } else if (c != '\\') {
+            put_byte_(out, outsize, len, c);
+            continue;
+        }
+
+        if (p >= end) {
+            return NULL;
+        }
+        char escape = *p++;
+        uint32_t code;
+        switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+            put_byte_(out, outsize, len, (unsigned char)escape);
+            continue;
+        case 'b':
+            put_byte_(out, outsize, len, '\b');
+            continue;
+        case 'f':
+            put_byte_(out, outsize, len, '\f');
+            continue;
+        case 'n':
+            put_byte_(out, outsize, len, '\n');
+            continue;
+        case 'r':
+            put_byte_(out, outsize, len, '\r');
+            continue;
+        case 't':
+            put_byte_(out, outsize, len, '\t');
+            continue;
+        case 'u':
+            if (!read_hex4_(p, end, &code)) {
+                return NULL;
+            }
+            p += 4;
+            break;
+        default:
+            return NULL;
+        }
+
+        uint32_t low;
+        if (code >= 0xD800 && code <= 0xDBFF && end - p >= 6 && p[0] == '\\' &&
+            p[1] == 'u' && read_hex4_(p + 2, end, &low) && low >= 0xDC00 &&
+            low <= 0xDFFF) {
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+        }
+
+        if (code < 0x80) {
+            put_byte_(out, outsize, len, (unsigned char)code);
+        } else if (code < 0x800) {
+            put_byte_(out, outsize, len, 0xC0 | (code >> 6));
+            put_byte_(out, outsize, len, 0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            put_byte_(out, outsize, len, 0xE0 | (code >> 12));
+            put_byte_(out, outsize, len, 0x80 | ((code >> 6) & 0x3F));
+            put_byte_(out, outsize, len, 0x80 | (code & 0x3F));
+        } else {
+            put_byte_(out, outsize, len, 0xF0 | (code >> 18));
+            put_byte_(out, outsize, len, 0x80 | ((code >> 12) & 0x3F));
+            put_byte_(out, outsize, len, 0x80 | ((code >> 6) & 0x3F));
+            put_byte_(out, outsize, len, 0x80 | (code & 0x3F));
+        }
+    }
+    return NULL;
+}
+
+static const char *skip_string_(const char *p, const char *end) {
+    p++;
+    while (p < end) {
+        char c = *p++;
+        if (c == '"') {
+            return p;
+        } else if (c == '\\') {
+            p++;
+        }
+    }
+    return NULL;
+}
+
+static const char *skip_value_(const char *p, const char *end, int depth) {
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        return skip_string_(p, end);
+    } else if (*p != '{' && *p != '[') {
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' &&
+               *p != '\t' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        return p;
+    }
+    if (depth >= MAX_DEPTH) {
+        return NULL;
+    }
+
+    char close = *p == '{' ? '}' : ']';
+    bool is_object = *p == '{';
+    p = skip_ws_(p + 1, end);
+    if (p < end && *p == close) {
+        return p + 1;
+    }
+    while (p < end) {
+        if (is_object) {
+            if (*p != '"' || (p = skip_string_(p, end)) == NULL) {
+                return NULL;
+            }
+            p = skip_ws_(p, end);
+            if (p >= end || *p != ':') {
+                return NULL;
+            }
+            p = skip_ws_(p + 1, end);
+        }
+        p = skip_value_(p, end, depth + 1);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_ws_(p, end);
+        if (p < end && *p == ',') {
+            p = skip_ws_(p + 1, end);
+        } else if (p < end && *p == close) {
+            return p + 1;
+        } else {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Index given by an array path segment, -1 if it is not one.
+static int64_t array_index_(const char *p, size_t len) {
+    if (len == 0 || len > 9 || (len > 1 && p[0] == '0')) {
+        return -1;
+    }
+    int64_t index = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return -1;
+        }
+        index = index * 10 + (p[i] - '0');
+    }
+    return index;
+}
+
+// Find the value at `segment` of the object or array at `p`. Returns its
+// start, or NULL if there is none.
+static const char *find_member_(
+    predicate_t *pred, const char *p, const char *end, pred_str_t segment
+) {
+    const char *name = pred->pool + segment.offset;
+    if (p < end && *p == '[') {
+        int64_t index = array_index_(name, segment.len);
+        if (index < 0) {
+            return NULL;
+        }
+        p = skip_ws_(p + 1, end);
+        for (int64_t i = 0; p < end && *p != ']'; i++) {
+            if (i == index) {
+                return p;
+            }
+            p = skip_value_(p, end, 0);
+            if (p == NULL) {
+                return NULL;
+            }
+            p = skip_ws_(p, end);
+            if (p < end && *p == ',') {
+                p = skip_ws_(p + 1, end);
+            }
+        }
+        return NULL;
+    } else if (p >= end || *p != '{') {
+        return NULL;
+    }
+
+    p = skip_ws_(p + 1, end);
+    while (p < end && *p == '"') {
+        size_t key_len;
+        p = decode_string_(p, end, pred->scratch, pred->scratch_size, &key_len);
+        if (p == NULL) {
+            return NULL;
+        }
+        bool matched = key_len == segment.len &&
+                       memcmp(pred->scratch, name, key_len) == 0;
+        p = skip_ws_(p, end);
+        if (p >= end || *p != ':') {
+            return NULL;
+        }
+        p = skip_ws_(p + 1, end);
+        if (matched) {
+            return p;
+        }
+        p = skip_value_(p, end, 0);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_ws_(p, end);
+        if (p < end && *p == ',') {
+            p = skip_ws_(p + 1, end);
+        }
+    }
+    return NULL;
+}
+
+static bool read_number_(const char *p, const char *end, double *number) {
+    char buf[NUMBER_BUFFER_SIZE];
+    size_t len = 0;
+    while (p + len < end && len < NUMBER_BUFFER_SIZE - 1 &&
+           p[len] != '\0' && strchr("+-.0123456789eE", p[len]) != NULL) {
+        buf[len] = p[len];
+        len++;
+    }
+    if (len == 0 || (*p != '-' && (*p < '0' || *p > '9'))) {
+        return false;
+    }
+    buf[len] = '\0';
+    char *parsed_end;
+    *number = strtod(buf, &parsed_end);
+    return parsed_end == buf + len;
+}
+
+static inline bool match_token_(
+    const char *p, const char *end, const char *token, size_t len
+) {
+    return (size_t)(end - p) >= len && memcmp(p, token, len) == 0;
+}
+
+// Compare a decoded string, of which `avail` bytes are in `s`, with `bound`.
+static int compare_string_(
+    const char *s, size_t avail, size_t total, const char *bound,
+    size_t bound_len
+) {
+    size_t n = avail < bound_len ? avail : bound_len;
+    int c = memcmp(s, bound, n);
+    if (c != 0) {
+        return c;
+    }
+    return (total > bound_len) - (total < bound_len);
+}
+
+// Compare the value at `p` with `bound` of the same type. False if the
+// value is of another type.
+static bool compare_value_(
+    predicate_t *pred, const char *p, const char *end,
+    const pred_value_t *bound, int *result
+) {
+    if (bound->type == PRED_NUMBER) {
+        double number;
+        if (!read_number_(p, end, &number)) {
+            return false;
+        }
+        *result = (number > bound->number) - (number < bound->number);
+        return true;
+    }
+    if (bound->type != PRED_STRING || *p != '"') {
+        return false;
+    }
+    size_t len;
+    if (decode_string_(p, end, pred->scratch, pred->scratch_size, &len) ==
+        NULL) {
+        return false;
+    }
+    size_t avail = len < pred->scratch_size ? len : pred->scratch_size;
+    *result = compare_string_(
+        pred->scratch, avail, len, pred->pool + bound->string.offset,
+        bound->string.len
+    );
+    return true;
+}
+
+static bool eval_leaf_(
+    predicate_t *pred, const pred_node_t *node, const record_t *records
+) {
+    const record_t *record = &records[node->record];
+    if (record->data_p == NULL) {
+        return false;
+    }
+    const char *end = record->data_p + record->data_len;
+    const char *p = skip_ws_(record->data_p, end);
+    for (int i = 0; i < node->path_count && p != NULL; i++) {
+        p = find_member_(pred, p, end, pred->segments[node->path_start + i]);
+    }
+    if (p == NULL || p >= end) {
+        return false;
+    }
+
+    int c;
+    switch (node->op) {
+    case PRED_EQUALS:
+        switch (node->value.type) {
+        case PRED_NULL:
+            return match_token_(p, end, "null", 4);
+        case PRED_BOOL:
+            return node->value.boolean ? match_token_(p, end, "true", 4)
+                                       : match_token_(p, end, "false", 5);
+        default:
+            return compare_value_(pred, p, end, &node->value, &c) && c == 0;
+        }
+    case PRED_PREFIX: {
+        size_t len;
+        if (*p != '"' || decode_string_(
+                             p, end, pred->scratch, pred->scratch_size, &len
+                         ) == NULL) {
+            return false;
+        }
+        return len >= node->value.string.len &&
+               memcmp(
+                   pred->scratch, pred->pool + node->value.string.offset,
+                   node->value.string.len
+               ) == 0;
+    }
+    case PRED_RANGE:
+        if (node->lower.type != PRED_NONE &&
+            (!compare_value_(pred, p, end, &node->lower, &c) ||
+             (node->lower_inclusive ? c < 0 : c <= 0))) {
+            return false;
+        }
+        if (node->upper.type != PRED_NONE &&
+            (!compare_value_(pred, p, end, &node->upper, &c) ||
+             (node->upper_inclusive ? c > 0 : c >= 0))) {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool eval_node_(predicate_t *pred, int index, const record_t *records) {
+    const pred_node_t *node = &pred->nodes[index];
+    if (node->op != PRED_AND && node->op != PRED_OR) {
+        return eval_leaf_(pred, node, records);
+    }
+
+    bool is_and = node->op == PRED_AND;
+    int end = index + node->size;
+    for (int child = index + 1; child < end;
+         child += pred->nodes[child].size) {
+        if (eval_node_(pred, child, records) != is_and) {
+            return !is_and;
+        }
+    }
+    return is_and;
+}
+
+bool predicate_eval(predicate_t *pred, const record_t *records) {
+    return pred->node_count == 0 || eval_node_(pred, 0, records);
+}
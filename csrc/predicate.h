@@ -0,0 +1,92 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _PREDICATE_H_
+#define _PREDICATE_H_
+
+#include "gdbm_wrapper.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// A filter over records holding JSON text, tested on the text itself so
+// that nothing is parsed into values. Nodes are stored in prefix order:
+// an AND or OR node is followed by its children, and `size` counts the
+// nodes of its subtree. A leaf looks up `path` in `records[record]` and
+// compares the value found there.
+#define PRED_AND 0
+#define PRED_OR 1
+#define PRED_EQUALS 2
+#define PRED_PREFIX 3
+#define PRED_RANGE 4
+
+#define PRED_NONE 0
+#define PRED_NULL 1
+#define PRED_BOOL 2
+#define PRED_NUMBER 3
+#define PRED_STRING 4
+
+typedef struct {
+    size_t offset; // into the string pool of the predicate
+    size_t len;
+} pred_str_t;
+
+typedef struct {
+    int type; // PRED_NONE for an open end of a range
+    bool boolean;
+    double number;
+    pred_str_t string;
+} pred_value_t;
+
+typedef struct {
+    int op;
+    int size;
+    int record;
+    int path_start;
+    int path_count;
+    pred_value_t value; // equals and prefix
+    pred_value_t lower; // range
+    pred_value_t upper;
+    bool lower_inclusive;
+    bool upper_inclusive;
+} pred_node_t;
+
+typedef struct predicate_s predicate_t;
+
+predicate_t *predicate_create();
+void predicate_free(predicate_t *pred);
+
+// Append a node and return its index, -1 if out of memory. Pointers from
+// predicate_node() are invalidated by adding nodes.
+int predicate_add_node(predicate_t *pred, int op);
+pred_node_t *predicate_node(predicate_t *pred, int index);
+// Append a path segment to the leaf added last.
+bool predicate_add_segment(predicate_t *pred, const char *p, size_t len);
+bool predicate_add_string(
+    predicate_t *pred, const char *p, size_t len, pred_str_t *result
+);
+// Fix the subtree size of node `index` once its children are added.
+void predicate_close_node(predicate_t *pred, int index);
+
+// Number of records the leaves refer to.
+int predicate_record_count(const predicate_t *pred);
+
+// Test the predicate. `records` must have predicate_record_count() items,
+// with `data_p` NULL for a missing record. Not safe to call concurrently
+// on the same predicate.
+bool predicate_eval(predicate_t *pred, const record_t *records);
+
+#endif // _PREDICATE_H_
@@ -0,0 +1,314 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Frame layout, all integers in host byte order:
+//   "RDO1" | u32 count | u32 payload_len | payload | u32 checksum(payload)
+// Each payload entry:
+//   u8 op | u32 key_len | u32 data_len | key bytes | data bytes
+
+#include "redo_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FRAME_MAGIC "RDO1"
+#define FRAME_MAGIC_SIZE 4
+#define FRAME_HEADER_SIZE (FRAME_MAGIC_SIZE + 2 * sizeof(uint32_t))
+#define ENTRY_HEADER_SIZE (1 + 2 * sizeof(uint32_t))
+
+static uint32_t checksum_(const char *p, size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int write_all_(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+int redo_log_append(
+    int fd, const redo_entry_t *entries, int count, bool sync
+) {
+    size_t payload_len = 0;
+    for (int i = 0; i < count; i++) {
+        payload_len += ENTRY_HEADER_SIZE + (size_t)entries[i].key_len +
+                       (size_t)entries[i].data_len;
+    }
+    if (payload_len > UINT32_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    size_t frame_len = FRAME_HEADER_SIZE + payload_len + sizeof(uint32_t);
+    char *frame = malloc(frame_len);
+    if (frame == NULL) {
+        return -1;
+    }
+
+    char *p = frame;
+    uint32_t u32;
+    memcpy(p, FRAME_MAGIC, FRAME_MAGIC_SIZE);
+    p += FRAME_MAGIC_SIZE;
+    u32 = (uint32_t)count;
+    memcpy(p, &u32, sizeof(u32));
+    p += sizeof(u32);
+    u32 = (uint32_t)payload_len;
+    memcpy(p, &u32, sizeof(u32));
+    p += sizeof(u32);
+
+    char *payload = p;
+    for (int i = 0; i < count; i++) {
+        const redo_entry_t *entry = &entries[i];
+        *p++ = (char)entry->op;
+        u32 = (uint32_t)entry->key_len;
+        memcpy(p, &u32, sizeof(u32));
+        p += sizeof(u32);
+        u32 = (uint32_t)entry->data_len;
+        memcpy(p, &u32, sizeof(u32));
+        p += sizeof(u32);
+        memcpy(p, entry->key_p, entry->key_len);
+        p += entry->key_len;
+        if (entry->data_len > 0) {
+            memcpy(p, entry->data_p, entry->data_len);
+            p += entry->data_len;
+        }
+    }
+    u32 = checksum_(payload, payload_len);
+    memcpy(p, &u32, sizeof(u32));
+
+    int ret = write_all_(fd, frame, frame_len);
+    free(frame);
+    if (ret != 0) {
+        return -1;
+    }
+
+    return sync ? fdatasync(fd) : 0;
+}
+
+// Flush the directory holding `path`, so that a created or removed entry
+// for it survives a crash.
+static int sync_dir_(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    if (slash == NULL) {
+        dir = strdup(".");
+    } else if (slash == path) {
+        dir = strdup("/");
+    } else {
+        dir = strndup(path, (size_t)(slash - path));
+    }
+    if (dir == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = fsync(fd);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+
+    return ret;
+}
+
+int redo_log_write(const char *path, const redo_entry_t *entries, int count) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int ret = redo_log_append(fd, entries, count, true);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    if (ret != 0) {
+        return ret;
+    }
+
+    // the frame is on disk, but a crash could still lose the file itself
+    return sync_dir_(path);
+}
+
+static int read_file_(const char *path, char **data_p, size_t *data_len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+
+    size_t len = (size_t)st.st_size;
+    char *data = malloc(len > 0 ? len : 1);
+    if (data == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t offset = 0;
+    while (offset < len) {
+        ssize_t n = read(fd, data + offset, len - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        offset += (size_t)n;
+    }
+    close(fd);
+
+    *data_p = data;
+    *data_len = offset;
+    return 0;
+}
+
+int redo_log_replay(
+    const char *path, redo_apply_fn apply, void *ctx, size_t *valid_len
+) {
+    char *data;
+    size_t len;
+    if (read_file_(path, &data, &len) != 0) {
+        // someone else rolled it forward and removed it meanwhile
+        if (errno == ENOENT) {
+            if (valid_len != NULL) {
+                *valid_len = 0;
+            }
+            return 0;
+        }
+        return -1;
+    }
+
+    int frames = 0;
+    size_t offset = 0;
+    while (len - offset >= FRAME_HEADER_SIZE + sizeof(uint32_t)) {
+        const char *frame = data + offset;
+        if (memcmp(frame, FRAME_MAGIC, FRAME_MAGIC_SIZE) != 0) {
+            break;
+        }
+
+        uint32_t count, payload_len, checksum;
+        memcpy(&count, frame + FRAME_MAGIC_SIZE, sizeof(uint32_t));
+        memcpy(
+            &payload_len, frame + FRAME_MAGIC_SIZE + sizeof(uint32_t),
+            sizeof(uint32_t)
+        );
+        size_t frame_len =
+            FRAME_HEADER_SIZE + (size_t)payload_len + sizeof(uint32_t);
+        if (frame_len > len - offset) {
+            break;
+        }
+
+        const char *payload = frame + FRAME_HEADER_SIZE;
+        memcpy(&checksum, payload + payload_len, sizeof(uint32_t));
+        if (checksum != checksum_(payload, payload_len)) {
+            break;
+        }
+
+        // validate the whole frame before applying any entry of it
+        const char *p = payload;
+        const char *end = payload + payload_len;
+        bool valid = true;
+        for (uint32_t i = 0; i < count && valid; i++) {
+            uint32_t key_len, data_len;
+            if ((size_t)(end - p) < ENTRY_HEADER_SIZE) {
+                valid = false;
+                break;
+            }
+            memcpy(&key_len, p + 1, sizeof(uint32_t));
+            memcpy(&data_len, p + 1 + sizeof(uint32_t), sizeof(uint32_t));
+            p += ENTRY_HEADER_SIZE;
+            if ((size_t)(end - p) < (size_t)key_len + data_len) {
+                valid = false;
+                break;
+            }
+            p += key_len + data_len;
+        }
+        if (!valid || p != end) {
+            break;
+        }
+
+        p = payload;
+        for (uint32_t i = 0; i < count; i++) {
+            redo_entry_t entry;
+            uint32_t key_len, data_len;
+            entry.op = (unsigned char)*p;
+            memcpy(&key_len, p + 1, sizeof(uint32_t));
+            memcpy(&data_len, p + 1 + sizeof(uint32_t), sizeof(uint32_t));
+            p += ENTRY_HEADER_SIZE;
+            entry.key_p = (char *)p;
+            entry.key_len = (int)key_len;
+            p += key_len;
+            entry.data_p = (char *)p;
+            entry.data_len = (int)data_len;
+            p += data_len;
+
+            if (apply(ctx, &entry) != 0) {
+                free(data);
+                return -2;
+            }
+        }
+
+        frames++;
+        offset += frame_len;
+    }
+
+    free(data);
+    if (valid_len != NULL) {
+        *valid_len = offset;
+    }
+    return frames;
+}
+
+bool redo_log_exists(const char *path) {
+    return access(path, F_OK) == 0;
+}
+
+int redo_log_remove(const char *path) {
+    if (unlink(path) != 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    // a log coming back after a crash would be replayed over later writes
+    return sync_dir_(path);
+}
@@ -0,0 +1,63 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _REDO_LOG_H_
+#define _REDO_LOG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REDO_STORE 'S'
+#define REDO_DELETE 'D'
+
+typedef struct {
+    int op;
+    char *key_p;
+    int key_len;
+    char *data_p;
+    int data_len;
+} redo_entry_t;
+
+typedef int (*redo_apply_fn)(void *ctx, const redo_entry_t *entry);
+
+// Append `entries` as one checksummed frame, flushing it to disk if `sync`.
+// Returns 0 on success, -1 with errno set on failure.
+int redo_log_append(
+    int fd, const redo_entry_t *entries, int count, bool sync
+);
+
+// Write `entries` as the only frame of the file at `path`, flushing the
+// file and its directory entry to disk.
+// Returns 0 on success, -1 with errno set on failure.
+int redo_log_write(const char *path, const redo_entry_t *entries, int count);
+
+// Apply the entries of every complete frame in `path`, in order.
+// A torn or corrupted tail frame and anything after it are ignored, and a
+// missing file has no frames.
+// Returns the number of applied frames, -1 with errno set on I/O error, or
+// -2 if `apply` returned non-zero. The length of the valid prefix is stored
+// to `valid_len` unless it is NULL.
+int redo_log_replay(
+    const char *path, redo_apply_fn apply, void *ctx, size_t *valid_len
+);
+
+bool redo_log_exists(const char *path);
+// Remove the file at `path` and flush its directory. A missing file is
+// not an error. Returns 0 on success, -1 with errno set on failure.
+int redo_log_remove(const char *path);
+
+#endif // _REDO_LOG_H_
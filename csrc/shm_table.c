@@ -0,0 +1,788 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Segment layout: header | slots | arena. Slots hold arena offsets rather
+// than pointers, since every process maps the segment at its own address.
+//
+// Readers follow a sequence lock: a writer makes the sequence odd while it
+// changes the table, and a reader retries if the sequence was odd or moved
+// during its read. Offsets and lengths read meanwhile may be torn, so they
+// are bounds-checked before use.
+//
+// A writer that dies holding the lock may leave half a change, or a change
+// it logged but did not apply. The next process to take the lock refills
+// the segment with the load function, i.e. from the snapshot and the log,
+// while the sequence stays odd. If that fails, the segment is poisoned:
+// reads and writes fail until a later lock refills it.
+
+#define _GNU_SOURCE
+#include "shm_table.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_MAGIC 0x324d4853u // "SHM2"
+#define LOCK_EXT ".lock"
+#define PATH_SIZE 512
+#define SEGMENT_NAME_SIZE 64
+#define MIN_CAPACITY 64
+#define ALIGN(n) (((n) + 7) & ~(size_t)7)
+#define EMPTY 0
+#define TOMBSTONE 1
+// first arena offset, past the markers above
+#define ARENA_START 8
+// reader spins between checks for a writer that died mid-change
+#define SPINS_PER_CHECK 1024
+
+// Bytes of the lock file: one serializes opening and closing, the other is
+// held shared by every process that has the segment mapped.
+#define OPEN_BYTE 0
+#define USER_BYTE 1
+
+typedef struct {
+    uint32_t key_len;
+    uint32_t data_len;
+    char bytes[]; // key followed by data
+} entry_t;
+
+typedef struct {
+    _Atomic uint64_t hash;
+    _Atomic uint64_t offset; // EMPTY, TOMBSTONE or an arena offset
+} slot_t;
+
+// The plain fields are only changed by a writer holding the lock, while
+// the sequence is odd.
+typedef struct {
+    uint32_t magic;
+    uint64_t size;
+    uint64_t capacity; // a power of two
+    uint64_t slots_offset;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    pthread_mutex_t lock;
+    _Atomic uint64_t seq;
+    uint64_t arena_used;
+    uint64_t garbage_bytes;
+    uint64_t used; // live entries and tombstones
+    uint64_t live;
+    _Atomic uint64_t primary; // live keys without a NUL byte
+    bool rebuilding; // the sequence is held odd by rebuild_()
+    _Atomic uint64_t poisoned;
+} header_t;
+
+// An entry as read at one moment, with checked lengths.
+typedef struct {
+    const char *key_p;
+    size_t key_len;
+    const char *data_p;
+    size_t data_len;
+} view_t;
+
+struct shm_table_s {
+    header_t *header;
+    slot_t *slots;
+    char *arena;
+    size_t size;
+    int lock_fd;
+    char segment[SEGMENT_NAME_SIZE];
+    gdbm_error (*load)(void *ctx);
+    void *load_ctx;
+};
+
+static inline uint64_t load_(_Atomic uint64_t *p) {
+    return atomic_load_explicit(p, memory_order_relaxed);
+}
+
+static inline void store_(_Atomic uint64_t *p, uint64_t value) {
+    atomic_store_explicit(p, value, memory_order_relaxed);
+}
+
+static inline uint64_t hash_(const char *p, size_t len) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static inline size_t entry_size_(size_t key_len, size_t data_len) {
+    return ALIGN(sizeof(entry_t) + key_len + data_len);
+}
+
+static inline bool is_primary_(const char *key, size_t key_len) {
+    return memchr(key, '\0', key_len) == NULL;
+}
+
+static int lock_byte_(int fd, int cmd, short type, off_t byte) {
+    struct flock lock = {
+        .l_type = type, .l_whence = SEEK_SET, .l_start = byte, .l_len = 1
+    };
+    int ret;
+    while ((ret = fcntl(fd, cmd, &lock)) != 0 && errno == EINTR) {
+    }
+    return ret;
+}
+
+static void rebuild_(shm_table_t *table);
+
+// Let readers through again after a writer died while holding the lock.
+static void recover_(shm_table_t *table, int locked) {
+    header_t *header = table->header;
+    if (locked == EOWNERDEAD || load_(&header->poisoned)) {
+        rebuild_(table);
+    }
+    if (locked == EOWNERDEAD) {
+        pthread_mutex_consistent(&header->lock);
+    }
+}
+
+// Begin a read, or return false if the segment is poisoned.
+static bool read_begin_(shm_table_t *table, uint64_t *seq_p) {
+    header_t *header = table->header;
+    for (unsigned spins = 1;; spins++) {
+        uint64_t seq = atomic_load_explicit(&header->seq, memory_order_acquire);
+        if ((seq & 1) == 0) {
+            *seq_p = seq;
+            return !load_(&header->poisoned);
+        }
+        if (spins % SPINS_PER_CHECK == 0) {
+            // an odd sequence with a free lock is left by a dead writer
+            int locked = pthread_mutex_trylock(&header->lock);
+            if (locked == 0 || locked == EOWNERDEAD) {
+                recover_(table, locked);
+                pthread_mutex_unlock(&header->lock);
+            }
+        }
+        sched_yield();
+    }
+}
+
+static bool read_end_(header_t *header, uint64_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return load_(&header->seq) == seq;
+}
+
+static void write_begin_(header_t *header) {
+    if (header->rebuilding) {
+        return;
+    }
+    uint64_t seq = load_(&header->seq);
+    store_(&header->seq, seq + 1);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void write_end_(header_t *header) {
+    if (header->rebuilding) {
+        return;
+    }
+    uint64_t seq = load_(&header->seq);
+    atomic_store_explicit(&header->seq, seq + 1, memory_order_release);
+}
+
+// Entry at a trusted offset, for writers.
+static inline entry_t *entry_at_(const shm_table_t *table, uint64_t offset) {
+    return (entry_t *)(table->arena + offset);
+}
+
+static bool view_at_(const shm_table_t *table, uint64_t offset, view_t *view) {
+    uint64_t arena_size = table->header->arena_size;
+    if (offset < ARENA_START || offset > arena_size - sizeof(entry_t)) {
+        return false;
+    }
+    const entry_t *entry = entry_at_(table, offset);
+    uint32_t key_len = entry->key_len;
+    uint32_t data_len = entry->data_len;
+    if ((uint64_t)key_len + data_len > arena_size - offset - sizeof(entry_t)) {
+        return false;
+    }
+    *view = (view_t){entry->bytes, key_len, entry->bytes + key_len, data_len};
+    return true;
+}
+
+// Index of the slot holding `key`, or of the slot to insert it into.
+// A reader may get SIZE_MAX if writes kept it from finding an empty slot.
+static size_t probe_(
+    const shm_table_t *table, datum key, uint64_t hash, bool *found
+) {
+    size_t capacity = table->header->capacity;
+    size_t mask = capacity - 1;
+    size_t insert_at = SIZE_MAX;
+    size_t i = hash & mask;
+    for (size_t n = 0; n < capacity; n++, i = (i + 1) & mask) {
+        slot_t *slot = &table->slots[i];
+        uint64_t offset = load_(&slot->offset);
+        if (offset == EMPTY) {
+            *found = false;
+            return insert_at != SIZE_MAX ? insert_at : i;
+        } else if (offset == TOMBSTONE) {
+            if (insert_at == SIZE_MAX) {
+                insert_at = i;
+            }
+            continue;
+        }
+        view_t view;
+        if (load_(&slot->hash) == hash && view_at_(table, offset, &view) &&
+            view.key_len == (size_t)key.dsize &&
+            memcmp(view.key_p, key.dptr, key.dsize) == 0) {
+            *found = true;
+            return i;
+        }
+    }
+    *found = false;
+    return insert_at;
+}
+
+// Look `key` up as a reader would; false if it is missing.
+static bool find_(shm_table_t *table, datum key, uint64_t hash, view_t *view) {
+    bool found;
+    size_t i = probe_(table, key, hash, &found);
+    if (!found) {
+        return false;
+    }
+    return view_at_(table, load_(&table->slots[i].offset), view);
+}
+
+static void layout_(header_t *header, size_t size) {
+    // about an eighth of the segment for slots
+    size_t capacity = MIN_CAPACITY;
+    while (capacity * 2 * sizeof(slot_t) <= size / 8) {
+        capacity *= 2;
+    }
+    header->size = size;
+    header->capacity = capacity;
+    header->slots_offset = ALIGN(sizeof(header_t));
+    header->arena_offset = header->slots_offset + capacity * sizeof(slot_t);
+    header->arena_size = size - header->arena_offset;
+    header->arena_used = ARENA_START;
+}
+
+static gdbm_error map_(shm_table_t *table, int fd, size_t size) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+    table->header = base;
+    table->size = size;
+    return GDBM_NO_ERROR;
+}
+
+static void locate_(shm_table_t *table) {
+    char *base = (char *)table->header;
+    table->slots = (slot_t *)(base + table->header->slots_offset);
+    table->arena = base + table->header->arena_offset;
+}
+
+static gdbm_error create_(
+    shm_table_t *table, size_t size, gdbm_error (*load)(void *ctx), void *ctx
+) {
+    // a segment nobody uses is left from a crash and may be behind the files
+    shm_unlink(table->segment);
+    int fd = shm_open(
+        table->segment, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600
+    );
+    if (fd < 0) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+    gdbm_error err = ftruncate(fd, (off_t)size) == 0 ? map_(table, fd, size)
+                                                     : GDBM_FILE_OPEN_ERROR;
+    close(fd);
+    if (err != GDBM_NO_ERROR) {
+        return err;
+    }
+
+    header_t *header = table->header;
+    layout_(header, size);
+    locate_(table);
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int ret = pthread_mutex_init(&header->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (ret != 0) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    // no other process maps the segment before it is loaded
+    err = load(ctx);
+    if (err != GDBM_NO_ERROR) {
+        return err;
+    }
+    header->magic = SHM_MAGIC;
+    return GDBM_NO_ERROR;
+}
+
+static gdbm_error attach_(shm_table_t *table) {
+    int fd = shm_open(table->segment, O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+    struct stat st;
+    gdbm_error err = GDBM_FILE_OPEN_ERROR;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(header_t)) {
+        err = map_(table, fd, (size_t)st.st_size);
+    }
+    close(fd);
+    if (err != GDBM_NO_ERROR) {
+        return err;
+    }
+
+    if (table->header->magic != SHM_MAGIC ||
+        table->header->size != table->size) {
+        return GDBM_BAD_MAGIC_NUMBER;
+    }
+    locate_(table);
+    return GDBM_NO_ERROR;
+}
+
+static void free_table_(shm_table_t *table) {
+    if (table->header != NULL) {
+        munmap(table->header, table->size);
+    }
+    if (table->lock_fd >= 0) {
+        // drops the locks on the lock file as well
+        close(table->lock_fd);
+    }
+    free(table);
+}
+
+gdbm_error shm_table_open(
+    const char *name, size_t size, gdbm_error (*load)(void *ctx), void *ctx,
+    shm_table_t **table_p
+) {
+    if (size < SHM_TABLE_MIN_SIZE) {
+        return GDBM_OPT_ILLEGAL;
+    }
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page_size - 1) / page_size * page_size;
+
+    char lock_path[PATH_SIZE];
+    int path_len = snprintf(lock_path, PATH_SIZE, "%s%s", name, LOCK_EXT);
+    if (path_len <= 0 || path_len >= PATH_SIZE) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    shm_table_t *table = calloc(1, sizeof(shm_table_t));
+    if (table == NULL) {
+        return GDBM_MALLOC_ERROR;
+    }
+    snprintf(
+        table->segment, SEGMENT_NAME_SIZE, "/alier-gdbm-%016llx",
+        (unsigned long long)hash_(name, strlen(name))
+    );
+    table->lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (table->lock_fd < 0 ||
+        lock_byte_(table->lock_fd, F_OFD_SETLKW, F_WRLCK, OPEN_BYTE) != 0) {
+        free_table_(table);
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    bool first =
+        lock_byte_(table->lock_fd, F_OFD_SETLK, F_WRLCK, USER_BYTE) == 0;
+    table->load = load;
+    table->load_ctx = ctx;
+    *table_p = table;
+    gdbm_error err = first ? create_(table, size, load, ctx) : attach_(table);
+    if (err == GDBM_NO_ERROR &&
+        lock_byte_(table->lock_fd, F_OFD_SETLK, F_RDLCK, USER_BYTE) != 0) {
+        err = GDBM_FILE_OPEN_ERROR;
+    }
+    if (err != GDBM_NO_ERROR) {
+        if (first) {
+            shm_unlink(table->segment);
+        }
+        free_table_(table);
+        *table_p = NULL;
+        return err;
+    }
+
+    lock_byte_(table->lock_fd, F_OFD_SETLK, F_UNLCK, OPEN_BYTE);
+    return GDBM_NO_ERROR;
+}
+
+void shm_table_close(shm_table_t *table) {
+    lock_byte_(table->lock_fd, F_OFD_SETLKW, F_WRLCK, OPEN_BYTE);
+    if (lock_byte_(table->lock_fd, F_OFD_SETLK, F_WRLCK, USER_BYTE) == 0) {
+        shm_unlink(table->segment);
+    }
+    free_table_(table);
+}
+
+void shm_table_lock(shm_table_t *table) {
+    int locked = pthread_mutex_lock(&table->header->lock);
+    recover_(table, locked);
+}
+
+void shm_table_unlock(shm_table_t *table) {
+    pthread_mutex_unlock(&table->header->lock);
+}
+
+// Rebuild the slots without tombstones.
+static gdbm_error rehash_(shm_table_t *table) {
+    header_t *header = table->header;
+    size_t capacity = header->capacity;
+    uint64_t(*live)[2] = malloc((header->live + 1) * sizeof(*live));
+    if (live == NULL) {
+        return GDBM_MALLOC_ERROR;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        uint64_t offset = load_(&table->slots[i].offset);
+        if (offset != EMPTY && offset != TOMBSTONE) {
+            live[count][0] = load_(&table->slots[i].hash);
+            live[count][1] = offset;
+            count++;
+        }
+    }
+
+    write_begin_(header);
+    for (size_t i = 0; i < capacity; i++) {
+        store_(&table->slots[i].offset, EMPTY);
+    }
+    size_t mask = capacity - 1;
+    for (size_t n = 0; n < count; n++) {
+        size_t i = live[n][0] & mask;
+        while (load_(&table->slots[i].offset) != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        store_(&table->slots[i].hash, live[n][0]);
+        store_(&table->slots[i].offset, live[n][1]);
+    }
+    header->used = header->live;
+    write_end_(header);
+
+    free(live);
+    return GDBM_NO_ERROR;
+}
+
+// Move the live entries to the start of the arena.
+static gdbm_error compact_(shm_table_t *table) {
+    header_t *header = table->header;
+    size_t live_bytes =
+        header->arena_used - ARENA_START - header->garbage_bytes;
+    char *copy = malloc(live_bytes > 0 ? live_bytes : 1);
+    if (copy == NULL) {
+        return GDBM_MALLOC_ERROR;
+    }
+
+    write_begin_(header);
+    size_t used = 0;
+    for (size_t i = 0; i < header->capacity; i++) {
+        slot_t *slot = &table->slots[i];
+        uint64_t offset = load_(&slot->offset);
+        if (offset == EMPTY || offset == TOMBSTONE) {
+            continue;
+        }
+        const entry_t *entry = entry_at_(table, offset);
+        size_t size = entry_size_(entry->key_len, entry->data_len);
+        memcpy(copy + used, entry, size);
+        store_(&slot->offset, ARENA_START + used);
+        used += size;
+    }
+    memcpy(table->arena + ARENA_START, copy, used);
+    header->arena_used = ARENA_START + used;
+    header->garbage_bytes = 0;
+    write_end_(header);
+
+    free(copy);
+    return GDBM_NO_ERROR;
+}
+
+// Make room for one more slot and `size` arena bytes, so that a slot found
+// by probe_() stays valid until it is filled.
+static gdbm_error reserve_(shm_table_t *table, size_t size) {
+    header_t *header = table->header;
+    if ((header->used + 1) * 4 > header->capacity * 3) {
+        if ((header->live + 1) * 4 > header->capacity * 3) {
+            return GDBM_MALLOC_ERROR;
+        }
+        gdbm_error err = rehash_(table);
+        if (err != GDBM_NO_ERROR) {
+            return err;
+        }
+    }
+    if (header->arena_size - header->arena_used < size) {
+        if (header->arena_size - (header->arena_used - header->garbage_bytes) <
+            size) {
+            return GDBM_MALLOC_ERROR;
+        }
+        return compact_(table);
+    }
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error shm_table_reserve(
+    shm_table_t *table, size_t key_len, size_t data_len
+) {
+    if (load_(&table->header->poisoned)) {
+        return GDBM_FILE_READ_ERROR;
+    }
+    return reserve_(table, entry_size_(key_len, data_len));
+}
+
+gdbm_error shm_table_put(shm_table_t *table, datum key, datum data, int flag) {
+    header_t *header = table->header;
+    if (load_(&header->poisoned)) {
+        return GDBM_FILE_READ_ERROR;
+    }
+    size_t size = entry_size_(key.dsize, data.dsize);
+    gdbm_error err = reserve_(table, size);
+    if (err != GDBM_NO_ERROR) {
+        return err;
+    }
+
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    bool found;
+    size_t i = probe_(table, key, hash, &found);
+    if (found && flag == GDBM_INSERT) {
+        return GDBM_CANNOT_REPLACE;
+    }
+
+    // readers do not look past arena_used, so the entry is written first
+    entry_t *entry = entry_at_(table, header->arena_used);
+    entry->key_len = key.dsize;
+    entry->data_len = data.dsize;
+    memcpy(entry->bytes, key.dptr, key.dsize);
+    if (data.dsize > 0) {
+        memcpy(entry->bytes + key.dsize, data.dptr, data.dsize);
+    }
+
+    slot_t *slot = &table->slots[i];
+    write_begin_(header);
+    if (found) {
+        const entry_t *old = entry_at_(table, load_(&slot->offset));
+        header->garbage_bytes += entry_size_(old->key_len, old->data_len);
+    } else {
+        if (load_(&slot->offset) == EMPTY) {
+            header->used++;
+        }
+        header->live++;
+        if (is_primary_(key.dptr, key.dsize)) {
+            store_(&header->primary, load_(&header->primary) + 1);
+        }
+    }
+    store_(&slot->hash, hash);
+    store_(&slot->offset, header->arena_used);
+    header->arena_used += size;
+    write_end_(header);
+
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error shm_table_remove(shm_table_t *table, datum key) {
+    header_t *header = table->header;
+    if (load_(&header->poisoned)) {
+        return GDBM_FILE_READ_ERROR;
+    }
+    bool found;
+    size_t i = probe_(table, key, hash_(key.dptr, key.dsize), &found);
+    if (!found) {
+        return GDBM_ITEM_NOT_FOUND;
+    }
+
+    slot_t *slot = &table->slots[i];
+    const entry_t *entry = entry_at_(table, load_(&slot->offset));
+    write_begin_(header);
+    header->garbage_bytes += entry_size_(entry->key_len, entry->data_len);
+    if (is_primary_(entry->bytes, entry->key_len)) {
+        store_(&header->primary, load_(&header->primary) - 1);
+    }
+    store_(&slot->offset, TOMBSTONE);
+    header->live--;
+    write_end_(header);
+
+    return GDBM_NO_ERROR;
+}
+
+static void reset_(shm_table_t *table) {
+    header_t *header = table->header;
+    for (size_t i = 0; i < header->capacity; i++) {
+        store_(&table->slots[i].offset, EMPTY);
+    }
+    header->arena_used = ARENA_START;
+    header->garbage_bytes = 0;
+    header->used = 0;
+    header->live = 0;
+    store_(&header->primary, 0);
+    store_(&header->poisoned, 0);
+}
+
+gdbm_error shm_table_clear(shm_table_t *table) {
+    write_begin_(table->header);
+    reset_(table);
+    write_end_(table->header);
+    return GDBM_NO_ERROR;
+}
+
+// Refill the segment from the files. The lock must be held.
+static void rebuild_(shm_table_t *table) {
+    header_t *header = table->header;
+    // the dead writer may have left the sequence odd already
+    if ((load_(&header->seq) & 1) == 0) {
+        write_begin_(header);
+    }
+    header->rebuilding = true;
+    reset_(table);
+    gdbm_error err = table->load(table->load_ctx);
+    store_(&header->poisoned, err != GDBM_NO_ERROR);
+    header->rebuilding = false;
+    write_end_(header);
+}
+
+static gdbm_error copy_bytes_(const char *p, size_t len, datum *copy) {
+    // never NULL for an existing item, even if it is empty
+    copy->dptr = malloc(len > 0 ? len : 1);
+    if (copy->dptr == NULL) {
+        return GDBM_MALLOC_ERROR;
+    }
+    memcpy(copy->dptr, p, len);
+    copy->dsize = (int)len;
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error shm_table_fetch(shm_table_t *table, datum key, datum *data) {
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    for (;;) {
+        uint64_t seq;
+        if (!read_begin_(table, &seq)) {
+            return GDBM_FILE_READ_ERROR;
+        }
+        datum copy = {NULL, 0};
+        view_t view;
+        gdbm_error err = find_(table, key, hash, &view)
+                             ? copy_bytes_(view.data_p, view.data_len, &copy)
+                             : GDBM_ITEM_NOT_FOUND;
+        if (read_end_(table->header, seq)) {
+            *data = copy;
+            return err;
+        }
+        free(copy.dptr);
+    }
+}
+
+gdbm_error shm_table_read(
+    shm_table_t *table, datum key, char *buf, size_t bufsize, size_t *len
+) {
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    for (;;) {
+        uint64_t seq;
+        if (!read_begin_(table, &seq)) {
+            return GDBM_FILE_READ_ERROR;
+        }
+        view_t view;
+        bool found = find_(table, key, hash, &view);
+        if (found && view.data_len <= bufsize) {
+            memcpy(buf, view.data_p, view.data_len);
+        }
+        if (read_end_(table->header, seq)) {
+            if (!found) {
+                return GDBM_ITEM_NOT_FOUND;
+            }
+            *len = view.data_len;
+            return GDBM_NO_ERROR;
+        }
+    }
+}
+
+bool shm_table_exists(shm_table_t *table, datum key) {
+    uint64_t hash = hash_(key.dptr, key.dsize);
+    for (;;) {
+        uint64_t seq;
+        if (!read_begin_(table, &seq)) {
+            return false;
+        }
+        view_t view;
+        bool found = find_(table, key, hash, &view);
+        if (read_end_(table->header, seq)) {
+            return found;
+        }
+    }
+}
+
+gdbm_error shm_table_next_key(shm_table_t *table, datum key, datum *next) {
+    uint64_t hash = key.dptr != NULL ? hash_(key.dptr, key.dsize) : 0;
+    for (;;) {
+        uint64_t seq;
+        if (!read_begin_(table, &seq)) {
+            return GDBM_FILE_READ_ERROR;
+        }
+        size_t capacity = table->header->capacity;
+        size_t start = 0;
+        gdbm_error err = GDBM_ITEM_NOT_FOUND;
+        datum copy = {NULL, 0};
+
+        bool found = true;
+        if (key.dptr != NULL) {
+            start = probe_(table, key, hash, &found) + 1;
+        }
+        for (size_t i = start; found && i < capacity; i++) {
+            uint64_t offset = load_(&table->slots[i].offset);
+            view_t view;
+            if (offset != EMPTY && offset != TOMBSTONE &&
+                view_at_(table, offset, &view)) {
+                err = copy_bytes_(view.key_p, view.key_len, &copy);
+                break;
+            }
+        }
+
+        if (read_end_(table->header, seq)) {
+            *next = copy;
+            return err;
+        }
+        free(copy.dptr);
+    }
+}
+
+size_t shm_table_count(shm_table_t *table) {
+    return load_(&table->header->primary);
+}
+
+int shm_table_foreach(
+    shm_table_t *table, int (*fn)(void *ctx, datum key, datum data), void *ctx
+) {
+    // a snapshot of it would replace the files it is rebuilt from
+    if (load_(&table->header->poisoned)) {
+        gdbm_errno = GDBM_FILE_READ_ERROR;
+        return -1;
+    }
+    for (size_t i = 0; i < table->header->capacity; i++) {
+        uint64_t offset = load_(&table->slots[i].offset);
+        if (offset == EMPTY || offset == TOMBSTONE) {
+            continue;
+        }
+        entry_t *entry = entry_at_(table, offset);
+        datum key = {entry->bytes, (int)entry->key_len};
+        datum data = {entry->bytes + entry->key_len, (int)entry->data_len};
+        int ret = fn(ctx, key, data);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _SHM_TABLE_H_
+#define _SHM_TABLE_H_
+
+#include <gdbm.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// A hash table in a POSIX shared memory segment, mapped by every process
+// that opens the same table. Writers serialize on a process-shared mutex;
+// readers take no lock and retry when a write overlapped their read.
+// The table has a fixed size: a store fails with GDBM_MALLOC_ERROR once
+// neither its slots nor its arena have room left after compaction.
+typedef struct shm_table_s shm_table_t;
+
+#define SHM_TABLE_MIN_SIZE (1 << 20)
+
+// Map the segment of `name`. The first process to open it creates the
+// segment with `size` bytes and calls `load` to fill it before anyone else
+// can use it; `*table` is already set then. Later ones map the segment as
+// it is. `load` may be called again to refill the segment, see below.
+gdbm_error shm_table_open(
+    const char *name, size_t size, gdbm_error (*load)(void *ctx), void *ctx,
+    shm_table_t **table
+);
+// Unmap the segment, and remove it when no other process has it open.
+void shm_table_close(shm_table_t *table);
+
+// Exclude the writers of all processes. Every function below that changes
+// the table must be called between these two. Taking the lock left by a
+// dead writer refills the table with `load`; if that fails, the functions
+// below fail with GDBM_FILE_READ_ERROR until a later lock refills it.
+void shm_table_lock(shm_table_t *table);
+void shm_table_unlock(shm_table_t *table);
+
+// Make room for a record, so that the next put of that size will not fail
+// for lack of space.
+gdbm_error shm_table_reserve(
+    shm_table_t *table, size_t key_len, size_t data_len
+);
+// GDBM_CANNOT_REPLACE if the key exists and `flag` is GDBM_INSERT.
+gdbm_error shm_table_put(shm_table_t *table, datum key, datum data, int flag);
+gdbm_error shm_table_remove(shm_table_t *table, datum key);
+gdbm_error shm_table_clear(shm_table_t *table);
+
+// Copy the data of `key` into a buffer to be released with free().
+gdbm_error shm_table_fetch(shm_table_t *table, datum key, datum *data);
+// Copy the data of `key` into `buf` if it fits and store its length to
+// `len`, like mem_table_read().
+gdbm_error shm_table_read(
+    shm_table_t *table, datum key, char *buf, size_t bufsize, size_t *len
+);
+bool shm_table_exists(shm_table_t *table, datum key);
+// Copy the key following `key` in slot order, or the first one if `key`
+// has a NULL dptr. GDBM_ITEM_NOT_FOUND past the last key.
+gdbm_error shm_table_next_key(shm_table_t *table, datum key, datum *next);
+// Number of keys without a NUL byte.
+size_t shm_table_count(shm_table_t *table);
+
+// Call `fn` with every record until it returns nonzero. Writers must be
+// excluded.
+int shm_table_foreach(
+    shm_table_t *table, int (*fn)(void *ctx, datum key, datum data), void *ctx
+);
+
+#endif // _SHM_TABLE_H_
@@ -0,0 +1,355 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// File layout, all integers in host byte order:
+//   "SNP1" | u32 reserved | u64 count | entries | keys and values
+// Each entry, in ascending key order:
+//   u64 offset | u32 key_len | u32 value_len
+// where the key starts at `offset` from the start of the file and the value
+// right after it. Entries are only checked when used, so that opening does
+// not read the whole file.
+
+#include "snapshot_file.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TMP_EXT ".tmp"
+#define PATH_SIZE 512
+#define FILE_MAGIC "SNP1"
+#define FILE_MAGIC_SIZE 4
+
+typedef struct {
+    char magic[FILE_MAGIC_SIZE];
+    uint32_t reserved;
+    uint64_t count;
+} file_header_t;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t key_len;
+    uint32_t value_len;
+} file_entry_t;
+
+struct snapshot_file_s {
+    struct snapshot_file_s *next;
+    char *path;
+    int refs;
+    pthread_mutex_t lock;
+
+    const char *map;
+    size_t size;
+    const file_entry_t *entries;
+    size_t count;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static snapshot_file_t *registry = NULL;
+
+static inline int compare_(
+    const char *a_p, size_t a_len, const char *b_p, size_t b_len
+) {
+    int ret = memcmp(a_p, b_p, a_len < b_len ? a_len : b_len);
+    if (ret != 0) {
+        return ret;
+    }
+    return a_len < b_len ? -1 : a_len > b_len ? 1 : 0;
+}
+
+typedef struct {
+    datum key;
+    datum value;
+} record_ref_t;
+
+static int compare_records_(const void *a, const void *b) {
+    const record_ref_t *x = a;
+    const record_ref_t *y = b;
+    return compare_(x->key.dptr, x->key.dsize, y->key.dptr, y->key.dsize);
+}
+
+static gdbm_error write_records_(
+    FILE *fp, const record_ref_t *records, size_t count
+) {
+    file_header_t header = {FILE_MAGIC, 0, count};
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        return GDBM_FILE_WRITE_ERROR;
+    }
+
+    uint64_t offset = sizeof(header) + count * sizeof(file_entry_t);
+    for (size_t i = 0; i < count; i++) {
+        file_entry_t entry = {
+            offset, (uint32_t)records[i].key.dsize,
+            (uint32_t)records[i].value.dsize
+        };
+        if (fwrite(&entry, sizeof(entry), 1, fp) != 1) {
+            return GDBM_FILE_WRITE_ERROR;
+        }
+        offset += (uint64_t)entry.key_len + entry.value_len;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const datum *key = &records[i].key;
+        const datum *value = &records[i].value;
+        if (fwrite(key->dptr, 1, key->dsize, fp) != (size_t)key->dsize ||
+            fwrite(value->dptr, 1, value->dsize, fp) != (size_t)value->dsize) {
+            return GDBM_FILE_WRITE_ERROR;
+        }
+    }
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error snapshot_file_write(
+    const char *path, const datum *keys, const datum *values, size_t count
+) {
+    char tmp_path[PATH_SIZE];
+    int path_len = snprintf(tmp_path, PATH_SIZE, "%s%s", path, TMP_EXT);
+    if (path_len <= 0 || path_len >= PATH_SIZE) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    record_ref_t *records =
+        malloc((count > 0 ? count : 1) * sizeof(record_ref_t));
+    if (records == NULL) {
+        return GDBM_MALLOC_ERROR;
+    }
+    for (size_t i = 0; i < count; i++) {
+        records[i] = (record_ref_t){keys[i], values[i]};
+    }
+    qsort(records, count, sizeof(record_ref_t), compare_records_);
+    for (size_t i = 1; i < count; i++) {
+        if (compare_records_(&records[i - 1], &records[i]) == 0) {
+            free(records);
+            return GDBM_CANNOT_REPLACE;
+        }
+    }
+
+    // records are as private as the store they come from
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (fp == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(records);
+        return GDBM_FILE_OPEN_ERROR;
+    }
+
+    gdbm_error err = write_records_(fp, records, count);
+    free(records);
+    // the file replaces the records of a journal removed right after
+    if (err == GDBM_NO_ERROR && (fflush(fp) != 0 || fsync(fd) != 0)) {
+        err = GDBM_FILE_SYNC_ERROR;
+    }
+    if (fclose(fp) != 0 && err == GDBM_NO_ERROR) {
+        err = GDBM_FILE_WRITE_ERROR;
+    }
+    if (err == GDBM_NO_ERROR && rename(tmp_path, path) != 0) {
+        err = GDBM_FILE_WRITE_ERROR;
+    }
+    if (err != GDBM_NO_ERROR) {
+        unlink(tmp_path);
+    }
+    return err;
+}
+
+static gdbm_error map_(snapshot_file_t *file) {
+    int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return GDBM_FILE_OPEN_ERROR;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return GDBM_FILE_STAT_ERROR;
+    }
+    if ((uint64_t)st.st_size < sizeof(file_header_t) ||
+        (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return GDBM_BAD_MAGIC_NUMBER;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return GDBM_FILE_READ_ERROR;
+    }
+
+    file_header_t header;
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, FILE_MAGIC_SIZE) != 0 ||
+        header.count >
+            (size - sizeof(file_header_t)) / sizeof(file_entry_t)) {
+        munmap(map, size);
+        return GDBM_BAD_MAGIC_NUMBER;
+    }
+
+    file->map = map;
+    file->size = size;
+    // the mapping is page aligned and so are the entries after the header
+    file->entries = (const file_entry_t *)((const char *)map + sizeof(header));
+    file->count = (size_t)header.count;
+    return GDBM_NO_ERROR;
+}
+
+static void free_file_(snapshot_file_t *file) {
+    if (file->map != NULL) {
+        munmap((void *)file->map, file->size);
+    }
+    free(file->path);
+    pthread_mutex_destroy(&file->lock);
+    free(file);
+}
+
+static snapshot_file_t *find_registered_(const char *path) {
+    for (snapshot_file_t *file = registry; file != NULL; file = file->next) {
+        if (strcmp(file->path, path) == 0) {
+            return file;
+        }
+    }
+    return NULL;
+}
+
+gdbm_error snapshot_file_open(const char *path, size_t *count) {
+    pthread_mutex_lock(&registry_lock);
+
+    snapshot_file_t *file = find_registered_(path);
+    if (file != NULL) {
+        file->refs++;
+        *count = file->count;
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_NO_ERROR;
+    }
+
+    file = calloc(1, sizeof(snapshot_file_t));
+    if (file == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_MALLOC_ERROR;
+    }
+    pthread_mutex_init(&file->lock, NULL);
+    file->refs = 1;
+    file->path = strdup(path);
+    if (file->path == NULL) {
+        free_file_(file);
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_MALLOC_ERROR;
+    }
+
+    gdbm_error err = map_(file);
+    if (err != GDBM_NO_ERROR) {
+        free_file_(file);
+        pthread_mutex_unlock(&registry_lock);
+        return err;
+    }
+
+    *count = file->count;
+    file->next = registry;
+    registry = file;
+    pthread_mutex_unlock(&registry_lock);
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error snapshot_file_close(const char *path) {
+    pthread_mutex_lock(&registry_lock);
+
+    snapshot_file_t **link = &registry;
+    while (*link != NULL && strcmp((*link)->path, path) != 0) {
+        link = &(*link)->next;
+    }
+    snapshot_file_t *file = *link;
+    if (file == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        return GDBM_ITEM_NOT_FOUND;
+    }
+
+    if (--file->refs == 0) {
+        *link = file->next;
+        // wait for a caller still holding the file
+        pthread_mutex_lock(&file->lock);
+        pthread_mutex_unlock(&file->lock);
+        free_file_(file);
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    return GDBM_NO_ERROR;
+}
+
+snapshot_file_t *snapshot_file_acquire(const char *path) {
+    pthread_mutex_lock(&registry_lock);
+    snapshot_file_t *file = registry != NULL ? find_registered_(path) : NULL;
+    if (file != NULL) {
+        pthread_mutex_lock(&file->lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return file;
+}
+
+void snapshot_file_release(snapshot_file_t *file) {
+    pthread_mutex_unlock(&file->lock);
+}
+
+size_t snapshot_file_count(snapshot_file_t *file) {
+    return file->count;
+}
+
+gdbm_error snapshot_file_entry(
+    snapshot_file_t *file, size_t index, datum *key, datum *value
+) {
+    const file_entry_t *entry = &file->entries[index];
+    if (entry->offset > file->size ||
+        entry->key_len > file->size - entry->offset ||
+        entry->value_len > file->size - entry->offset - entry->key_len ||
+        entry->key_len > INT32_MAX || entry->value_len > INT32_MAX) {
+        return GDBM_BAD_FILE_OFFSET;
+    }
+
+    key->dptr = (char *)file->map + entry->offset;
+    key->dsize = (int)entry->key_len;
+    value->dptr = key->dptr + entry->key_len;
+    value->dsize = (int)entry->value_len;
+    return GDBM_NO_ERROR;
+}
+
+gdbm_error snapshot_file_find(snapshot_file_t *file, datum key, datum *value) {
+    size_t lo = 0;
+    size_t hi = file->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        datum mid_key;
+        gdbm_error err = snapshot_file_entry(file, mid, &mid_key, value);
+        if (err != GDBM_NO_ERROR) {
+            return err;
+        }
+        int ret =
+            compare_(mid_key.dptr, mid_key.dsize, key.dptr, key.dsize);
+        if (ret == 0) {
+            return GDBM_NO_ERROR;
+        }
+        if (ret < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return GDBM_ITEM_NOT_FOUND;
+}
@@ -0,0 +1,60 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _SNAPSHOT_FILE_H_
+#define _SNAPSHOT_FILE_H_
+
+#include <gdbm.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// A read-only file of records sorted by key, mapped into memory. Opening
+// it only reads the header however many records it has, its pages are
+// shared with the page cache, and lookups are binary searches over an
+// index of fixed-size entries. Keys are ordered by their bytes.
+//
+// Open files are registered by path. A file written over an open one is
+// only seen once it is closed as many times as opened and opened again.
+typedef struct snapshot_file_s snapshot_file_t;
+
+// Write the records to `path` through a temporary file renamed over it.
+// Keys must be unique.
+gdbm_error snapshot_file_write(
+    const char *path, const datum *keys, const datum *values, size_t count
+);
+
+// Map `path` and register it. Opening a registered file again only adds a
+// reference. `*count` is the number of records.
+gdbm_error snapshot_file_open(const char *path, size_t *count);
+// Drop a reference, and unmap the file with the last one.
+// GDBM_ITEM_NOT_FOUND if `path` is not registered.
+gdbm_error snapshot_file_close(const char *path);
+
+// Find a registered file and lock it. NULL if `path` is not registered.
+snapshot_file_t *snapshot_file_acquire(const char *path);
+void snapshot_file_release(snapshot_file_t *file);
+
+size_t snapshot_file_count(snapshot_file_t *file);
+// Point `*value` into the mapping at the value of `key`.
+// GDBM_ITEM_NOT_FOUND if there is none.
+gdbm_error snapshot_file_find(snapshot_file_t *file, datum key, datum *value);
+// Point `*key` and `*value` at the record at `index`, in key order.
+gdbm_error snapshot_file_entry(
+    snapshot_file_t *file, size_t index, datum *key, datum *value
+);
+
+#endif // _SNAPSHOT_FILE_H_
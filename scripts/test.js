@@ -1 +1,16 @@
-console.log("on(scripts.test): TODO = implement test script");
+// Run every test/*.test.js file with the built-in test runner.
+const { spawnSync } = require("node:child_process");
+const fs = require("node:fs");
+const path = require("node:path");
+
+const dir = path.join(__dirname, "..", "test");
+const files = fs
+    .readdirSync(dir)
+    .filter((file) => file.endsWith(".test.js"))
+    .sort()
+    .map((file) => path.join(dir, file));
+
+const { status } = spawnSync(process.execPath, ["--test", ...files], {
+    stdio: "inherit",
+});
+process.exit(status ?? 1);
@@ -16,7 +16,11 @@ limitations under the License.
 
 const crypto = require("node:crypto");
 const http = require("node:http");
-const { Users } = require("./_CredentialsInterface.js");
+const {
+    Users,
+    onUsersWritten,
+    resolveTableName,
+} = require("./_CredentialsInterface.js");
 
 const HEADER_AUTHORIZATION = "Authorization";
 const HEADER_WWW_AUTHENTICATE = "WWW-Authenticate";
@@ -74,6 +78,269 @@ class AbstractAuthProtocol {
      * The response header field for WWW-Authenticate
      */
     async getChallenge(reason) {}
+
+    /**
+     * Verify the session the incoming request carries, if any.
+     * Protocols issuing sessions override this; a valid session lets the
+     * request in without verifying its credentials.
+     * @param {object|http.IncomingMessage} request
+     * Incoming request, same as {@link AbstractAuthProtocol.verify}.
+     * @returns {{ ok: true, scheme: string, userId: string }|undefined}
+     * The result of a valid session, otherwise undefined.
+     */
+    verifySession(request) {
+        return undefined;
+    }
+}
+
+/**
+ * Signed session tokens issued after a successful verification, so that
+ * later requests are verified with one HMAC instead of a credentials
+ * lookup. Tokens are kept by clients in a cookie and expire after
+ * `maxAge`; revoked tokens are remembered in memory until they expire.
+ *
+ * A token is only valid for the table and realm it was issued for, and
+ * every write to the values of a user through `Users` in this process
+ * revokes the tokens issued to the user for that table.
+ */
+class AuthSessions {
+    static #VERSION = "v2";
+    static #TOKEN_ID_LENGTH = 12;
+
+    #secret;
+    #maxAge;
+    #cookieName;
+    #cookieAttributes;
+    /**
+     * Revoked token ids and when their tokens were issued.
+     * @type {Map<string, number>}
+     */
+    #revokedTokens = new Map();
+    /**
+     * Users whose tokens issued up to the time are revoked, by the table
+     * name and the user id as JSON.
+     * @type {Map<string, number>}
+     */
+    #revokedUsers = new Map();
+    /**
+     * Stops revoking the tokens of users whose values are written.
+     * @type {() => void}
+     */
+    #stopRevoking;
+
+    /**
+     * @constructor
+     * @param {object} params
+     * @param {string|Buffer} params.secret
+     * The key to sign tokens with. Tokens signed with another key are
+     * rejected, e.g. after a restart with a new random key.
+     * @param {number} [params.maxAge] - Lifetime of tokens in seconds. Defaults to 900.
+     * @param {string} [params.cookieName] - Defaults to "alier_session".
+     * @param {string} [params.path] - Path attribute of the cookie. Defaults to "/".
+     * @param {boolean} [params.secure]
+     * Whether the cookie is only sent over HTTPS. Defaults to true.
+     */
+    constructor(params) {
+        const secret = params?.secret;
+        const maxAge = params?.maxAge ?? 900;
+        const cookieName = params?.cookieName ?? "alier_session";
+        const path = params?.path ?? "/";
+        const secure = params?.secure ?? true;
+
+        if (typeof secret !== "string" && !Buffer.isBuffer(secret)) {
+            throw new TypeError("secret must be a string or a Buffer");
+        } else if (secret.length === 0) {
+            throw new TypeError("secret must not be empty");
+        } else if (!(Number.isSafeInteger(maxAge) && maxAge > 0)) {
+            throw new TypeError("maxAge must be a positive integer");
+        } else if (!/^[\w\-]+$/.test(cookieName)) {
+            throw new TypeError("cookieName must be a token");
+        }
+
+        this.#secret = crypto.createSecretKey(Buffer.from(secret));
+        this.#maxAge = maxAge;
+        this.#cookieName = cookieName;
+        this.#cookieAttributes =
+            `Max-Age=${maxAge}; Path=${path}; HttpOnly; SameSite=Strict` +
+            (secure ? "; Secure" : "");
+
+        this.#stopRevoking = onUsersWritten((tableName, userIds) => {
+            for (const userId of userIds) {
+                this.revokeUser(userId, tableName);
+            }
+        });
+    }
+
+    /**
+     * Stop following the writes to the values of users. The listener keeps
+     * the sessions alive until then, so call this when they are dropped.
+     * Tokens of users written afterwards are not revoked anymore.
+     */
+    close() {
+        this.#stopRevoking();
+    }
+
+    get cookieName() {
+        return this.#cookieName;
+    }
+
+    /**
+     * Issue a token for the user.
+     * @param {string} userId
+     * @param {{ tableName?: string, realm?: string }} [scope]
+     * The credentials table of the user, the first one by default, and the
+     * realm the token is valid for.
+     * @returns {{ token: string, cookie: string }}
+     * The token and the value of a Set-Cookie header carrying it.
+     */
+    issue(userId, scope) {
+        const id = crypto
+            .randomBytes(AuthSessions.#TOKEN_ID_LENGTH)
+            .toString("base64url");
+        const payload = [
+            AuthSessions.#VERSION,
+            Buffer.from(userId).toString("base64url"),
+            Date.now().toString(36),
+            id,
+        ].join(".");
+        const mac = this.#sign(payload, scope).toString("base64url");
+        const token = `${payload}.${mac}`;
+        const cookie = `${this.#cookieName}=${token}; ${this.#cookieAttributes}`;
+        return { token, cookie };
+    }
+
+    /**
+     * Verify a token.
+     * @param {string} token
+     * @param {{ tableName?: string, realm?: string }} [scope]
+     * Same as the one the token was issued for.
+     * @returns {{ userId: string, id: string, issuedAt: number }|undefined}
+     * The session, or undefined if the token is forged, expired, revoked or
+     * issued for another scope.
+     */
+    verify(token, scope) {
+        const parts = typeof token === "string" ? token.split(".") : [];
+        if (parts.length !== 5 || parts[0] !== AuthSessions.#VERSION) {
+            return undefined;
+        }
+
+        const mac = Buffer.from(parts[4], "base64url");
+        const expected = this.#sign(parts.slice(0, 4).join("."), scope);
+        if (
+            mac.length !== expected.length ||
+            !crypto.timingSafeEqual(mac, expected)
+        ) {
+            return undefined;
+        }
+
+        const issuedAt = parseInt(parts[2], 36);
+        if (!(Date.now() - issuedAt < this.#maxAge * 1000)) {
+            return undefined;
+        }
+
+        const userId = Buffer.from(parts[1], "base64url").toString();
+        const id = parts[3];
+        const revokedAt = this.#revokedUsers.get(
+            JSON.stringify([resolveTableName(scope?.tableName), userId]),
+        );
+        if (this.#revokedTokens.has(id) || issuedAt <= (revokedAt ?? -Infinity)) {
+            return undefined;
+        }
+        return { userId, id, issuedAt };
+    }
+
+    /**
+     * Revoke a token, e.g. on logout.
+     * @param {string} token
+     * @param {{ tableName?: string, realm?: string }} [scope]
+     * Same as the one the token was issued for.
+     * @returns {boolean} Whether the token was valid.
+     */
+    revoke(token, scope) {
+        const session = this.verify(token, scope);
+        if (session === undefined) {
+            return false;
+        }
+        this.#pruneRevoked();
+        this.#revokedTokens.set(session.id, session.issuedAt);
+        return true;
+    }
+
+    /**
+     * Revoke every token issued to the user so far. Writes through `Users`
+     * call this already.
+     * @param {string} userId
+     * @param {string} [tableName] - Defaults to the first table.
+     */
+    revokeUser(userId, tableName) {
+        this.#pruneRevoked();
+        this.#revokedUsers.set(
+            JSON.stringify([resolveTableName(tableName), userId]),
+            Date.now(),
+        );
+    }
+
+    /**
+     * Get the token of the request.
+     * @param {object|http.IncomingMessage} request
+     * Incoming request, same as {@link AbstractAuthProtocol.verify}.
+     * @returns {string|undefined}
+     */
+    getToken(request) {
+        if (request instanceof http.IncomingMessage) {
+            const header = request.headers.cookie;
+            if (header == null) {
+                return undefined;
+            }
+            for (const pair of header.split(";")) {
+                const [name, value] = pair.trim().split("=", 2);
+                if (name === this.#cookieName) {
+                    return value;
+                }
+            }
+            return undefined;
+        }
+
+        // the parser keeps the first pair as the value, the rest as params
+        for (const header of request.headers?.cookie ?? []) {
+            const value = header.params?.[this.#cookieName];
+            if (value != null) {
+                return value;
+            }
+            const [name, first] = header.value.split("=", 2);
+            if (name === this.#cookieName) {
+                return first;
+            }
+        }
+        return undefined;
+    }
+
+    #sign(payload, scope) {
+        // the payload has no NUL, so the scope cannot be moved into it
+        const tableName = resolveTableName(scope?.tableName) ?? null;
+        const realm = scope?.realm ?? null;
+        return crypto
+            .createHmac("sha256", this.#secret)
+            .update(`${JSON.stringify([tableName, realm])}\0${payload}`)
+            .digest();
+    }
+
+    /**
+     * Forget revocations of tokens that have expired anyway.
+     */
+    #pruneRevoked() {
+        const expired = Date.now() - this.#maxAge * 1000;
+        for (const [id, issuedAt] of this.#revokedTokens) {
+            if (issuedAt < expired) {
+                this.#revokedTokens.delete(id);
+            }
+        }
+        for (const [user, revokedAt] of this.#revokedUsers) {
+            if (revokedAt < expired) {
+                this.#revokedUsers.delete(user);
+            }
+        }
+    }
 }
 
 class DigestAuthProtocol extends AbstractAuthProtocol {
@@ -89,9 +356,11 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
     #qop;
     #realm;
     #domain;
-    #secretData;
+    #nonceKey;
+    #nonceMaxAge;
     #opaque;
     #hash;
+    #sessions;
 
     /**
      * @constructor
@@ -106,6 +375,12 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
      * @param {"SHA-256"|undefined} params.algorithm - The algorithm to hash.
      * @param {number?} params.opaqueLength
      * A number for byte array to generate opaque.
+     * @param {number?} params.nonceMaxAge
+     * Seconds a nonce is accepted for. Older nonces are rejected as stale,
+     * so that clients retry with a new one. Defaults to 300.
+     * @param {AuthSessions?} params.sessions
+     * Optional. Issue a session on every successful verification, with
+     * which later requests are let in until it expires or is revoked.
      * @param {string?} credentialsTableName
      * The table name for Credentials. Defaults to the first table.
      * @param {object?} credentialsProjection
@@ -122,6 +397,8 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
         const algorithm = params.algorithm ?? "MD5";
         const opaqueLength = params.opaqueLength ?? 32;
         const secretData = params.secretData;
+        const sessions = params.sessions ?? null;
+        const nonceMaxAge = params.nonceMaxAge ?? 300;
 
         if (secretData == null) {
             throw new TypeError("Given params does not have the secretData property");
@@ -132,6 +409,10 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
             typeof credentialsProjection !== "object"
         ) {
             throw new TypeError("credentialsPath must be an optional object");
+        } else if (!(Number.isSafeInteger(nonceMaxAge) && nonceMaxAge > 0)) {
+            throw new TypeError("nonceMaxAge must be a positive integer");
+        } else if (sessions != null && !(sessions instanceof AuthSessions)) {
+            throw new TypeError("sessions must be an optional AuthSessions");
         }
 
         this.#qop = qop;
@@ -139,13 +420,15 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
         this.#domain = domain;
         this.#algorithm = algorithm;
         this.#opaque = crypto.randomBytes(opaqueLength).toString("base64");
-        this.#secretData = secretData;
+        this.#nonceKey = crypto.createSecretKey(Buffer.from(secretData));
+        this.#nonceMaxAge = nonceMaxAge;
         this.#hash = crypto.createHash(
             DigestAuthProtocol.algorithmMapForHash[algorithm],
         );
 
         this.#credentialsTableName = credentialsTableName;
         this.#credentialsProjection = credentialsProjection ?? null;
+        this.#sessions = sessions;
     }
 
     get scheme() {
@@ -162,12 +445,49 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
         return header;
     }
 
+    /**
+     * Make a nonce holding its issue time, signed together with the opaque,
+     * so that it is verified without keeping the nonces issued.
+     * @returns {string}
+     */
     makeNonce() {
-        const timestamp = Date.now();
-        const hash = this.#hash.copy();
-        hash.update(`${timestamp}:${this.#secretData}`);
-        const nonce = hash.digest("base64");
-        return nonce;
+        const timestamp = Date.now().toString(36);
+        const mac = this.#signNonce(timestamp).toString("base64url");
+        return `${timestamp}.${mac}`;
+    }
+
+    /**
+     * Check a nonce made by {@link DigestAuthProtocol.makeNonce}.
+     * @param {string} nonce
+     * @returns {"ok"|"stale"|"invalid"}
+     */
+    checkNonce(nonce) {
+        const parts = typeof nonce === "string" ? nonce.split(".") : [];
+        if (parts.length !== 2) {
+            return "invalid";
+        }
+
+        const mac = Buffer.from(parts[1], "base64url");
+        const expected = this.#signNonce(parts[0]);
+        if (
+            mac.length !== expected.length ||
+            !crypto.timingSafeEqual(mac, expected)
+        ) {
+            return "invalid";
+        }
+
+        const age = Date.now() - parseInt(parts[0], 36);
+        if (!(age >= 0)) {
+            return "invalid";
+        }
+        return age < this.#nonceMaxAge * 1000 ? "ok" : "stale";
+    }
+
+    #signNonce(timestamp) {
+        return crypto
+            .createHmac("sha256", this.#nonceKey)
+            .update(`${timestamp}:${this.#opaque}`)
+            .digest();
     }
 
     getChallengeParameters() {
@@ -207,7 +527,27 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
         }
     }
 
+    verifySession(request) {
+        if (this.#sessions == null) {
+            return undefined;
+        }
+        const session = this.#sessions.verify(
+            this.#sessions.getToken(request),
+            this.#sessionScope(),
+        );
+        if (session === undefined) {
+            return undefined;
+        }
+        return { ok: true, scheme: this.scheme, userId: session.userId };
+    }
+
     async verifyParameters(method, parameters) {
+        // checked first, so that forged nonces never reach the store
+        const nonce = this.checkNonce(parameters.nonce);
+        if (nonce === "invalid") {
+            return { ok: false, scheme: this.scheme };
+        }
+
         const username = parameters.username;
         const password = await Users.getContent(username, {
             tableName: this.#credentialsTableName,
@@ -236,8 +576,23 @@ class DigestAuthProtocol extends AbstractAuthProtocol {
         if (password == null) {
             return { ok: false, scheme: this.scheme };
         }
+        if (result && nonce === "stale") {
+            // the client knows the password and only needs a new nonce
+            return { ok: false, scheme: this.scheme, reason: { stale: true } };
+        }
+        if (result && this.#sessions != null) {
+            const { cookie } = this.#sessions.issue(
+                username,
+                this.#sessionScope(),
+            );
+            return { ok: true, scheme: this.scheme, setCookie: cookie };
+        }
         return { ok: result, scheme: this.scheme };
     }
+
+    #sessionScope() {
+        return { tableName: this.#credentialsTableName, realm: this.#realm };
+    }
 }
 
 function parseAuthorizationHeader(header) {
@@ -305,4 +660,4 @@ function parametersToHeader(scheme, params, quotedParams) {
     return header;
 }
 
-module.exports = { AbstractAuthProtocol, DigestAuthProtocol };
+module.exports = { AbstractAuthProtocol, AuthSessions, DigestAuthProtocol };
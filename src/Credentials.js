@@ -15,7 +15,7 @@ limitations under the License.
 */
 
 const CredStore = require("./_CredentialsStore.js");
-const { StoreClasses, registerTable, Users } = require("./_CredentialsInterface.js");
+const { StoreClasses, registerTable, ready, Users } = require("./_CredentialsInterface.js");
 
 for (const storeClass of Object.values(CredStore)) {
     if (storeClass !== CredStore.AbstractCredentialStore) {
@@ -27,5 +27,6 @@ module.exports = {
     AbstractCredentialStore: CredStore.AbstractCredentialStore,
     StoreClasses,
     registerTable,
+    ready,
     Users,
 };
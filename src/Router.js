@@ -250,6 +250,10 @@ class Router {
         } else {
             const verification_result = (await endpoint.verify(request_desc)) ?? ({ ok: false });
 
+            if (verification_result.ok && typeof verification_result.setCookie === "string") {
+                response.setHeader("set-cookie", verification_result.setCookie);
+            }
+
             if (!verification_result.ok) {
                 const failed_scheme = verification_result.scheme;
                 const status_code   = (failed_scheme != null) ? (verification_result.status ?? 401) : 401;
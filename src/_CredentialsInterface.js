@@ -159,6 +159,16 @@ function registerTable(tableName, storeType, args, defaultUserInfo) {
     }
 }
 
+/**
+ * Wait until every registered table is open, e.g. before serving requests,
+ * so that tables opened lazily do not delay the first calls on them.
+ * @async
+ * @returns {Promise<void>}
+ */
+async function ready() {
+    await Promise.all(Array.from(tableMap.values(), (table) => table.ready()));
+}
+
 /**
  * Get the table.
  * @param {string|null|undefined} tableName - The table name.
@@ -178,6 +188,101 @@ const getTable = (tableName) => {
     return table;
 };
 
+/**
+ * Get the name of the table `getTable` gives for the name.
+ * @param {string|null|undefined} tableName - The table name.
+ * @returns {string|undefined}
+ */
+const resolveTableName = (tableName) => {
+    return tableName === undefined ? tableMap.keys().next().value : tableName;
+};
+
+/**
+ * @param {any[]} userIds
+ * @throws {TypeError} If any of them is not a string.
+ */
+const validateUserIds = (userIds) => {
+    if (!userIds.every((userId) => typeof userId === "string")) {
+        throw new TypeError("userId must be string");
+    }
+};
+
+/**
+ * Maximum number of users whose projected contents are cached per table.
+ */
+const PROJECTION_CACHE_SIZE = 1024;
+
+/**
+ * Contents filtered by `Users.getContent` with a projection, per table,
+ * user and projection as JSON. The least recently used users are evicted
+ * first. `generation` changes on every write, so that reads overlapping
+ * a write do not cache what they read.
+ * @type {WeakMap<AbstractCredentialStore, { generation: number, users: Map<string, Map<string, any>> }>}
+ */
+const projectionCaches = new WeakMap();
+
+/**
+ * @param {AbstractCredentialStore} table
+ * @returns {{ generation: number, users: Map<string, Map<string, any>> }|undefined}
+ * Undefined if the table cannot be cached.
+ */
+const getProjectionCache = (table) => {
+    if (table.constructor.isShared) {
+        return undefined;
+    }
+    let cache = projectionCaches.get(table);
+    if (cache === undefined) {
+        cache = { generation: 0, users: new Map() };
+        projectionCaches.set(table, cache);
+    }
+    return cache;
+};
+
+/**
+ * Functions called with the table name and the users whose values were
+ * written, e.g. to revoke the sessions issued to them.
+ * @type {Set<(tableName: string, userIds: string[]) => void>}
+ */
+const writeListeners = new Set();
+
+/**
+ * Call `listener` after every write to the values of users.
+ * @param {(tableName: string, userIds: string[]) => void} listener
+ * @returns {() => void} A function to stop calling it.
+ */
+const onUsersWritten = (listener) => {
+    writeListeners.add(listener);
+    return () => writeListeners.delete(listener);
+};
+
+/**
+ * Run `write` on the values of `userIds`, then drop their cached contents
+ * and tell the write listeners.
+ * @template T
+ * @param {string|undefined} tableName
+ * @param {AbstractCredentialStore} table
+ * @param {string[]} userIds
+ * @param {() => Promise<T>} write
+ * @returns {Promise<T>}
+ */
+const invalidatingProjections = async (tableName, table, userIds, write) => {
+    try {
+        return await write();
+    } finally {
+        const cache = projectionCaches.get(table);
+        if (cache !== undefined) {
+            cache.generation++;
+            for (const userId of userIds) {
+                cache.users.delete(userId);
+            }
+        }
+        const name = resolveTableName(tableName);
+        for (const listener of writeListeners) {
+            listener(name, userIds);
+        }
+    }
+};
+
 const filterWithProjection = (obj, proj) => {
     if (typeof obj !== "object") {
         throw new Error();
@@ -226,6 +331,30 @@ const Users = {
         return await table.signup(userId, value);
     },
 
+    /**
+     * Sign-up many accounts in tableName with one call to the store.
+     * Each account succeeds or fails on its own.
+     * @async
+     * @param {{ userId: string, content?: any }[]} users - Accounts to sign up.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Optional. Table name.
+     * @returns {Promise<boolean[]>} Success of each sign-up, in the order of `users`.
+     */
+    async signupMany(users, options) {
+        const tableName = options?.tableName;
+
+        const table = getTable(tableName);
+
+        validateUserIds(users.map((user) => user?.userId));
+
+        const entries = users.map(({ userId, content }) => [
+            userId,
+            { content: content ?? null, info: createDefaultUserInfo(tableName) },
+        ]);
+
+        return await table.signupMany(entries);
+    },
+
     /**
      * Remove account by key in tableName.
      * @async
@@ -243,7 +372,9 @@ const Users = {
             throw new TypeError("userId must be string");
         }
 
-        return await table.remove(userId);
+        return await invalidatingProjections(tableName, table, [userId], () =>
+            table.remove(userId)
+        );
     },
 
     /**
@@ -276,6 +407,9 @@ const Users = {
      * The projection to the target. If undefined, get all values.
      * If object, only return the keys with true.
      * With any invalid key, return undefined.
+     * Projected contents are cached, and the same frozen object returned,
+     * until the user is written through `Users`. Tables other processes
+     * may write to, e.g. GDBM files, are not cached.
      * @returns {Promise<any|undefined>}
      */
     async getContent(userId, options) {
@@ -284,22 +418,77 @@ const Users = {
 
         const table = getTable(tableName);
 
-        const value = await table.get(userId);
-        if (value == null) {
+        if (projection == null || typeof projection !== "object") {
+            return await table.getField(userId, "content");
+        }
+
+        const cache = getProjectionCache(table);
+        const fingerprint = JSON.stringify(projection);
+        const cached = cache?.users.get(userId);
+        if (cached?.has(fingerprint)) {
+            cache.users.delete(userId);
+            cache.users.set(userId, cached);
+            return cached.get(fingerprint);
+        }
+
+        const generation = cache?.generation;
+        const content = await table.getField(userId, "content");
+        if (content == null) {
+            return content;
+        }
+
+        let filtered;
+        try {
+            filtered = filterWithProjection(content, projection);
+        } catch {
             return undefined;
         }
 
-        let content = value.content;
+        if (cache !== undefined && cache.generation === generation) {
+            const projections = cache.users.get(userId) ?? new Map();
+            projections.set(fingerprint, filtered);
+            cache.users.delete(userId);
+            cache.users.set(userId, projections);
+            if (cache.users.size > PROJECTION_CACHE_SIZE) {
+                cache.users.delete(cache.users.keys().next().value);
+            }
+        }
+        return filtered;
+    },
+
+    /**
+     * Get the contents of many users with one call to the store.
+     * @async
+     * @param {string[]} userIds - User identifiers.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Optional. Table name.
+     * @param {{ [key: string]: boolean|object }} [options.projection]
+     * The projection applied to each content, as in `getContent`.
+     * @returns {Promise<(any|undefined)[]>} Contents in the order of `userIds`.
+     */
+    async getContents(userIds, options) {
+        const tableName = options?.tableName;
+        const projection = options?.projection;
+
+        const table = getTable(tableName);
+
+        validateUserIds(userIds);
+
+        const contents = await table.getFields(userIds, "content");
 
-        if (content != null && projection != null && typeof projection === "object") {
+        if (projection == null || typeof projection !== "object") {
+            return contents;
+        }
+        return contents.map((content) => {
+            if (content == null) {
+                return content;
+            }
             try {
-                content = filterWithProjection(content, projection);
+                return filterWithProjection(content, projection);
             } catch {
                 return undefined;
             }
-        }
-
-        return content;
+        });
     },
 
     /**
@@ -318,7 +507,35 @@ const Users = {
 
         const table = getTable(tableName);
 
-        return await table.update(userId, { content }, true);
+        return await invalidatingProjections(tableName, table, [userId], () =>
+            table.update(userId, { content }, true)
+        );
+    },
+
+    /**
+     * Merge the contents of many users with one call to the store, as
+     * `updateContent` does for each. Each user succeeds or fails on its own.
+     * @async
+     * @param {{ userId: string, content: any }[]} users - Users and contents to merge.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Optional. Table name.
+     * @returns {Promise<boolean[]>} Success of each update, in the order of `users`.
+     */
+    async updateContents(users, options) {
+        const tableName = options?.tableName;
+
+        const table = getTable(tableName);
+
+        validateUserIds(users.map((user) => user?.userId));
+
+        const entries = users.map(({ userId, content }) => [userId, { content }]);
+
+        return await invalidatingProjections(
+            tableName,
+            table,
+            users.map(({ userId }) => userId),
+            () => table.updateMany(entries, true)
+        );
     },
 
     /**
@@ -354,7 +571,9 @@ const Users = {
             throw new TypeError("options.projection must be optional Object");
         }
 
-        return await table.delete(userId, actualProjection);
+        return await invalidatingProjections(tableName, table, [userId], () =>
+            table.delete(userId, actualProjection)
+        );
     },
 
     /**
@@ -378,8 +597,7 @@ const Users = {
 
         const table = getTable(tableName);
 
-        const value = await table.get(userId);
-        let info = value.info;
+        let info = await table.getField(userId, "info");
 
         const projection = options?.projection;
         if (projection != null && typeof projection === "object") {
@@ -420,8 +638,249 @@ const Users = {
 
         const table = getTable(tableName);
 
-        return await table.update(userId, { info }, false);
+        return await invalidatingProjections(tableName, table, [userId], () =>
+            table.update(userId, { info }, false)
+        );
+    },
+
+    /**
+     * Add `delta` to the user's counter atomically, e.g. failed login attempts.
+     * Counters do not need the user to exist and are not removed with the user.
+     * @async
+     * @param {string} userId - User identifier.
+     * @param {string} counterName - Counter name.
+     * @param {number} [delta] - Safe integer to add. Defaults to 1.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Table name.
+     * @returns {Promise<number|undefined>} The new value, or undefined on failure.
+     */
+    async incrementCounter(userId, counterName, delta, options) {
+        const tableName = options?.tableName;
+        const delta_ = delta ?? 1;
+
+        if (typeof userId !== "string") {
+            throw new TypeError("userId must be string");
+        }
+        if (typeof counterName !== "string") {
+            throw new TypeError("counterName must be string");
+        }
+        if (!Number.isSafeInteger(delta_)) {
+            throw new TypeError("delta must be a safe integer");
+        }
+
+        const table = getTable(tableName);
+
+        return await table.increment(userId, counterName, delta_);
+    },
+
+    /**
+     * Get the user's counters with one store access.
+     * @async
+     * @param {string} userId - User identifier.
+     * @param {string[]} counterNames - Counter names.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Table name.
+     * @returns {Promise<number[]|undefined>}
+     * Values in the order of `counterNames`, 0 for missing counters.
+     */
+    async getCounters(userId, counterNames, options) {
+        const tableName = options?.tableName;
+
+        if (typeof userId !== "string") {
+            throw new TypeError("userId must be string");
+        }
+        if (
+            !Array.isArray(counterNames) ||
+            counterNames.some((name) => typeof name !== "string")
+        ) {
+            throw new TypeError("counterNames must be string[]");
+        }
+
+        const table = getTable(tableName);
+
+        return await table.getCounters(userId, counterNames);
+    },
+
+    /**
+     * Reset the user's counter to 0.
+     * @async
+     * @param {string} userId - User identifier.
+     * @param {string} counterName - Counter name.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Table name.
+     * @returns {Promise<boolean>}
+     */
+    async resetCounter(userId, counterName, options) {
+        const tableName = options?.tableName;
+
+        if (typeof userId !== "string") {
+            throw new TypeError("userId must be string");
+        }
+        if (typeof counterName !== "string") {
+            throw new TypeError("counterName must be string");
+        }
+
+        const table = getTable(tableName);
+
+        return await table.resetCounter(userId, counterName);
+    },
+
+    /**
+     * List users matching a condition, a page at a time.
+     * Paths of the condition start with "content" or "info",
+     * e.g. `{ path: "info.role", equals: "admin" }`.
+     * A page may hold fewer than `limit` users, even none, while more
+     * remain; the listing is over when `cursor` is undefined.
+     * Users come in no particular order, so a user written between two
+     * pages may be listed twice or not at all. Use `listUserIds` to page
+     * through users in a stable order.
+     * @async
+     * @param {ScanPredicate|null} predicate
+     * Condition on users, null for all. See {@link AbstractCredentialStore.scan}.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Table name.
+     * @param {number} [options.limit] - Maximum number of users in the page.
+     * @param {string} [options.cursor] - Cursor returned with the previous page.
+     * @returns {Promise<{ users: { userId: string, content: any, info: any }[], cursor: string|undefined }>}
+     */
+    async scan(predicate, options) {
+        const tableName = options?.tableName;
+        const limit = options?.limit;
+        const cursor = options?.cursor;
+
+        if (limit !== undefined && !(Number.isSafeInteger(limit) && limit > 0)) {
+            throw new TypeError("limit must be a positive integer");
+        }
+        if (cursor !== undefined && typeof cursor !== "string") {
+            throw new TypeError("cursor must be string");
+        }
+
+        const table = getTable(tableName);
+
+        const page = await table.scan(predicate ?? null, { limit, cursor });
+        const users = page.items.map(({ key, value }) => ({
+            userId: key,
+            content: value?.content,
+            info: value?.info,
+        }));
+        return { users, cursor: page.cursor };
+    },
+
+    /**
+     * List user IDs in ascending order, e.g. to autocomplete a prefix or to
+     * page through the users after the last ID of the previous page.
+     * Such paging lists every user once, and also the users added meanwhile
+     * after `after`. See {@link AbstractCredentialStore.listKeys}.
+     * @async
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Table name.
+     * @param {string} [options.prefix] - Only IDs starting with this.
+     * @param {string} [options.after] - Only IDs after this.
+     * @param {number} [options.limit] - Maximum number of IDs. Defaults to 100.
+     * @returns {Promise<string[]>}
+     */
+    async listUserIds(options) {
+        const tableName = options?.tableName;
+        const prefix = options?.prefix;
+        const after = options?.after;
+        const limit = options?.limit;
+
+        if (prefix !== undefined && typeof prefix !== "string") {
+            throw new TypeError("prefix must be string");
+        }
+        if (after !== undefined && typeof after !== "string") {
+            throw new TypeError("after must be string");
+        }
+        if (limit !== undefined && !(Number.isSafeInteger(limit) && limit > 0)) {
+            throw new TypeError("limit must be a positive integer");
+        }
+
+        const table = getTable(tableName);
+
+        return table.listKeys({ prefix, gt: after }, limit);
+    },
+
+    /**
+     * Apply several user operations in one table as a unit.
+     * If any of them fails, none of them is applied.
+     * @async
+     * @param {(
+     *  { type: "signup", userId: string, content?: any } |
+     *  { type: "updateContent", userId: string, content: any } |
+     *  { type: "removeUser", userId: string } |
+     *  { type: "incrementCounter", userId: string, counterName: string, delta?: number } |
+     *  { type: "resetCounter", userId: string, counterName: string }
+     * )[]} ops - Operations, same as the methods of the same name.
+     * @param {object} [options]
+     * @param {string} [options.tableName] - Table name.
+     * @returns {Promise<boolean>} Committed or not.
+     */
+    async commitBatch(ops, options) {
+        const tableName = options?.tableName;
+
+        if (!Array.isArray(ops)) {
+            throw new TypeError("ops must be an array");
+        }
+
+        const table = getTable(tableName);
+
+        const storeOps = ops.map((op) => {
+            const key = op?.userId;
+            if (typeof key !== "string") {
+                throw new TypeError("userId must be string");
+            }
+            switch (op.type) {
+                case "signup": {
+                    const info = createDefaultUserInfo(tableName);
+                    const value = { content: op.content ?? null, info };
+                    return { type: "signup", key, value };
+                }
+                case "updateContent":
+                    return {
+                        type: "update",
+                        key,
+                        value: { content: op.content },
+                        allowNewKey: true,
+                    };
+                case "removeUser":
+                    return { type: "remove", key };
+                case "incrementCounter": {
+                    const delta = op.delta ?? 1;
+                    if (typeof op.counterName !== "string") {
+                        throw new TypeError("counterName must be string");
+                    }
+                    if (!Number.isSafeInteger(delta)) {
+                        throw new TypeError("delta must be a safe integer");
+                    }
+                    return { type: "increment", key, name: op.counterName, delta };
+                }
+                case "resetCounter":
+                    if (typeof op.counterName !== "string") {
+                        throw new TypeError("counterName must be string");
+                    }
+                    return { type: "resetCounter", key, name: op.counterName };
+                default:
+                    throw new TypeError(`unknown operation type: ${op.type}`);
+            }
+        });
+
+        return await invalidatingProjections(
+            tableName,
+            table,
+            // counters are not part of the values
+            storeOps
+                .filter(({ type }) => type !== "increment" && type !== "resetCounter")
+                .map(({ key }) => key),
+            () => table.commitBatch(storeOps)
+        );
     },
 };
 
-module.exports = { StoreClasses, registerTable, Users };
+module.exports = {
+    StoreClasses,
+    registerTable,
+    ready,
+    Users,
+    onUsersWritten,
+    resolveTableName,
+};
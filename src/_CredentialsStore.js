@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+const cluster = require("node:cluster");
 const path = require("node:path");
 const fs = require("node:fs");
 const fsPromises = require("node:fs/promises");
@@ -34,6 +35,56 @@ try {
 }
 const gdbm = _gdbm;
 
+/**
+ * Separator between a record key and the suffix of its sibling records.
+ * Account keys must not contain it.
+ */
+const SIBLING_SEPARATOR = "\0";
+
+/**
+ * Top-level value fields kept in their own sibling record,
+ * so that they can be read and written without the rest of the value.
+ */
+const SIBLING_FIELDS = Object.freeze(["info"]);
+
+/**
+ * Default number of items in a page of `scan`.
+ */
+const DEFAULT_SCAN_LIMIT = 100;
+
+/**
+ * Number of records a native scan examines for one page, which bounds how
+ * long it keeps the table to itself.
+ */
+const SCAN_BUDGET = 4096;
+
+/**
+ * Default number of keys returned by `listKeys`.
+ */
+const DEFAULT_KEY_LIMIT = 100;
+
+/**
+ * Block sizes accepted by `rebuild`, and the least one recommended by
+ * `analyze`, the usual page size.
+ */
+const MIN_BLOCK_SIZE = 512;
+const MAX_BLOCK_SIZE = 65536;
+const MIN_RECOMMENDED_BLOCK_SIZE = 4096;
+
+/**
+ * Memory the recommended GDBM bucket cache may take.
+ */
+const MAX_CACHE_BYTES = 64 * 1024 * 1024;
+
+/**
+ * Shared memory of a `gdbmshared` table by default, and the least one.
+ */
+const DEFAULT_SHARED_SIZE = 64 * 1024 * 1024;
+const MIN_SHARED_SIZE = 1024 * 1024;
+
+const siblingKeyOf = (key, suffix) => key + SIBLING_SEPARATOR + suffix;
+const counterKeyOf = (key, name) => siblingKeyOf(key, "#" + name);
+
 /**
  * @interface
  */
@@ -52,12 +103,29 @@ class AbstractCredentialStore {
         throw new Error("not implemented");
     }
 
+    /**
+     * Whether other processes write to the same values, so that a process
+     * must not cache them.
+     * @returns {boolean}
+     */
+    static get isShared() {
+        return false;
+    }
+
     /**
      * Create the store.
      * @param {Object} args - Initialize arguments
      */
     constructor(args) {}
 
+    /**
+     * Resolves once the store is open. A store that opens lazily starts
+     * opening here if no call has done so yet; others resolve at once.
+     * @async
+     * @returns {Promise<void>}
+     */
+    async ready() {}
+
     /**
      * @returns {number}
      */
@@ -98,6 +166,20 @@ class AbstractCredentialStore {
         throw new Error("not implemented");
     }
 
+    /**
+     * Get a top-level field of the value with the key.
+     * Stores may override it to read the field without the rest of the value.
+     * @async
+     * @param {string} key - Account identifier.
+     * @param {string} field - Field name.
+     * @returns {Promise<any|undefined>}
+     * The field value. If key or field is invalid, return undefined.
+     */
+    async getField(key, field) {
+        const value = await this.get(key);
+        return value == null ? undefined : value[field];
+    }
+
     /**
      * Check the account exists.
      * @async
@@ -121,6 +203,55 @@ class AbstractCredentialStore {
         throw new Error("not implemented");
     }
 
+    /**
+     * Sign-up many accounts. Unlike `commitBatch`, each account succeeds
+     * or fails on its own.
+     * Stores may override it to do so in fewer round trips.
+     * @async
+     * @param {[string, any][]} entries - Pairs of account identifier and initialize value.
+     * @returns {Promise<boolean[]>} Success of each sign-up in the order of `entries`.
+     */
+    async signupMany(entries) {
+        const results = [];
+        for (const [key, value] of entries) {
+            results.push(await this.signup(key, value));
+        }
+        return results;
+    }
+
+    /**
+     * Get a top-level field of the values with the keys, or the whole
+     * values if `field` is undefined.
+     * Stores may override it to do so in fewer round trips.
+     * @async
+     * @param {string[]} keys - Account identifiers.
+     * @param {string} [field] - Field name.
+     * @returns {Promise<any[]>} Values in the order of `keys`, undefined for invalid ones.
+     */
+    async getFields(keys, field) {
+        const results = [];
+        for (const key of keys) {
+            results.push(field === undefined ? await this.get(key) : await this.getField(key, field));
+        }
+        return results;
+    }
+
+    /**
+     * Update many values. Each one succeeds or fails on its own.
+     * Stores may override it to do so in fewer round trips.
+     * @async
+     * @param {[string, any][]} entries - Pairs of account identifier and value to set.
+     * @param {boolean} allowNewKey - Allow new key to stored values.
+     * @returns {Promise<boolean[]>} Success of each update in the order of `entries`.
+     */
+    async updateMany(entries, allowNewKey) {
+        const results = [];
+        for (const [key, value] of entries) {
+            results.push(await this.update(key, value, allowNewKey));
+        }
+        return results;
+    }
+
     /**
      * Delete the value in the `deletePath`.
      * @async
@@ -135,6 +266,114 @@ class AbstractCredentialStore {
     async delete(key, projection) {
         throw new Error("not implemented");
     }
+
+    /**
+     * Add `delta` to the named counter of the account atomically.
+     * Counters are kept apart from the account value and survive `remove`.
+     * @async
+     * @param {string} key - Account identifier.
+     * @param {string} name - Counter name.
+     * @param {number} delta - Integer to add.
+     * @returns {Promise<number|undefined>} The new value, or undefined on failure.
+     */
+    async increment(key, name, delta) {
+        throw new Error("not implemented");
+    }
+
+    /**
+     * Get the named counters of the account.
+     * @async
+     * @param {string} key - Account identifier.
+     * @param {string[]} names - Counter names.
+     * @returns {Promise<number[]|undefined>}
+     * Values in the order of `names`, 0 for missing counters.
+     * Undefined on failure.
+     */
+    async getCounters(key, names) {
+        throw new Error("not implemented");
+    }
+
+    /**
+     * Reset the named counter of the account to 0.
+     * @async
+     * @param {string} key - Account identifier.
+     * @param {string} name - Counter name.
+     * @returns {Promise<boolean>} Success to reset or not.
+     */
+    async resetCounter(key, name) {
+        throw new Error("not implemented");
+    }
+
+    /**
+     * @typedef {(
+     *  { type: "signup", key: string, value?: any } |
+     *  { type: "update", key: string, value: any, allowNewKey: boolean } |
+     *  { type: "remove", key: string } |
+     *  { type: "increment", key: string, name: string, delta: number } |
+     *  { type: "resetCounter", key: string, name: string }
+     * )} BatchOperation
+     * Same as the method of the same type name.
+     */
+
+    /**
+     * Apply all operations as a unit.
+     * Operations see the effects of the earlier ones in the batch.
+     * If any of them fails, none of them is applied.
+     * @async
+     * @param {BatchOperation[]} ops - Operations to apply in order.
+     * @returns {Promise<boolean>} Committed or not.
+     */
+    async commitBatch(ops) {
+        throw new Error("not implemented");
+    }
+
+    /**
+     * @typedef {(
+     *  { and: ScanPredicate[] } |
+     *  { or: ScanPredicate[] } |
+     *  { path: string, equals: null|boolean|number|string } |
+     *  { path: string, prefix: string } |
+     *  { path: string, range: { gt?: number|string, gte?: number|string, lt?: number|string, lte?: number|string } }
+     * )} ScanPredicate
+     * Condition on a value. `path` is a dot-separated path into the value,
+     * e.g. "info.role"; array elements are addressed by index.
+     */
+
+    /**
+     * List the accounts whose value satisfies `predicate`, a page at a time.
+     * A page may hold fewer than `limit` items, even none, while more
+     * accounts remain; the scan is over when `cursor` is undefined.
+     * Accounts come in no particular order, e.g. the hash order of GDBM,
+     * so an account written between two pages may be listed twice or not
+     * at all; accounts left alone during the scan are listed once.
+     * @async
+     * @param {ScanPredicate|null} predicate - Condition, null for all.
+     * @param {object} [options]
+     * @param {number} [options.limit] - Maximum number of items. Defaults to 100.
+     * @param {string} [options.cursor] - Cursor returned by the previous page.
+     * @returns {Promise<{ items: { key: string, value: any }[], cursor: string|undefined }>}
+     * @throws {Error} With code "ERR_SCAN_CURSOR" if the cursor account is gone.
+     */
+    async scan(predicate, options) {
+        throw new Error("not implemented");
+    }
+
+    /**
+     * @typedef {{ prefix?: string, gt?: string, gte?: string, lt?: string, lte?: string }} KeyRange
+     * Bounds on account keys, which are ordered by their UTF-8 bytes.
+     */
+
+    /**
+     * List the account keys within `range` in ascending order, e.g. for
+     * autocompletion with `{ prefix }` or paging with `{ gt: lastKey }`.
+     * @async
+     * @param {KeyRange} range - Bounds, {} for all keys.
+     * @param {number} [limit] - Maximum number of keys. Defaults to 100.
+     * @returns {Promise<string[]>}
+     */
+    async listKeys(range, limit) {
+        throw new Error("not implemented");
+    }
 }
 
 class InMemoryCredentialStore extends AbstractCredentialStore {
@@ -147,6 +386,8 @@ class InMemoryCredentialStore extends AbstractCredentialStore {
     }
 
     _store;
+    /** @type {Map<string, number>} */
+    _counters;
 
     /**
      * @param {object} args
@@ -154,6 +395,7 @@ class InMemoryCredentialStore extends AbstractCredentialStore {
     constructor(args) {
         super(args);
         this._store = new Map();
+        this._counters = new Map();
     }
 
     get size() {
@@ -169,6 +411,21 @@ class InMemoryCredentialStore extends AbstractCredentialStore {
      * @returns {Promise<boolean>} If sign-up success, return true, otherwise false.
      */
     async signup(key, value) {
+        return this._signup(key, value);
+    }
+
+    async signupMany(entries) {
+        return entries.map(([key, value]) => this._signup(key, value));
+    }
+
+    /**
+     * Shared by `signup` and `signupMany`, so that subclasses overriding
+     * either one are not called back by the other.
+     * @param {string} key
+     * @param {any} value
+     * @returns {boolean}
+     */
+    _signup(key, value) {
         if (this._store.has(key)) {
             return false;
         }
@@ -222,6 +479,31 @@ class InMemoryCredentialStore extends AbstractCredentialStore {
      * @returns {Promise<boolean>} Success to set or not.
      */
     async update(key, value, allowNewKey) {
+        return this._update(key, value, allowNewKey);
+    }
+
+    async getFields(keys, field) {
+        return keys.map((key) => {
+            const value = this._store.get(key);
+            if (field === undefined) {
+                return value;
+            }
+            return value == null ? undefined : value[field];
+        });
+    }
+
+    async updateMany(entries, allowNewKey) {
+        return entries.map(([key, value]) => this._update(key, value, allowNewKey));
+    }
+
+    /**
+     * Same as `_signup` for `update` and `updateMany`.
+     * @param {string} key
+     * @param {any} value
+     * @param {boolean} allowNewKey
+     * @returns {boolean}
+     */
+    _update(key, value, allowNewKey) {
         if (!this._store.has(key)) {
             return false;
         }
@@ -269,8 +551,308 @@ class InMemoryCredentialStore extends AbstractCredentialStore {
             return false;
         }
     }
+
+    async increment(key, name, delta) {
+        const counterKey = counterKeyOf(key, name);
+        const value = (this._counters.get(counterKey) ?? 0) + delta;
+        if (!Number.isSafeInteger(value)) {
+            return undefined;
+        }
+        this._counters.set(counterKey, value);
+        return value;
+    }
+
+    async getCounters(key, names) {
+        return names.map((name) => this._counters.get(counterKeyOf(key, name)) ?? 0);
+    }
+
+    async resetCounter(key, name) {
+        this._counters.delete(counterKeyOf(key, name));
+        return true;
+    }
+
+    async commitBatch(ops) {
+        const removed = Symbol("removed");
+        const staged = new Map();
+        const stagedCounters = new Map();
+        const current = (key) => {
+            if (staged.has(key)) {
+                return staged.get(key);
+            }
+            return this._store.has(key) ? this._store.get(key) : removed;
+        };
+
+        for (const op of ops) {
+            const oldValue = current(op.key);
+            switch (op.type) {
+                case "signup": {
+                    if (oldValue !== removed) {
+                        return false;
+                    }
+                    const value = op.value;
+                    staged.set(
+                        op.key,
+                        value == null ? value : deepFreeze(toNullObject(value))
+                    );
+                    break;
+                }
+                case "update": {
+                    if (oldValue === removed || op.value == null) {
+                        return false;
+                    }
+                    try {
+                        const merged = structuredMerge(oldValue, op.value, op.allowNewKey);
+                        staged.set(op.key, deepFreeze(merged));
+                    } catch (e) {
+                        return false;
+                    }
+                    break;
+                }
+                case "remove": {
+                    if (oldValue === removed) {
+                        return false;
+                    }
+                    staged.set(op.key, removed);
+                    break;
+                }
+                case "increment": {
+                    const counterKey = counterKeyOf(op.key, op.name);
+                    const value =
+                        (stagedCounters.get(counterKey) ??
+                            this._counters.get(counterKey) ??
+                            0) + op.delta;
+                    if (!Number.isSafeInteger(value)) {
+                        return false;
+                    }
+                    stagedCounters.set(counterKey, value);
+                    break;
+                }
+                case "resetCounter": {
+                    stagedCounters.set(counterKeyOf(op.key, op.name), 0);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        for (const [key, value] of staged) {
+            if (value === removed) {
+                this._store.delete(key);
+            } else {
+                this._store.set(key, value);
+            }
+        }
+        for (const [counterKey, value] of stagedCounters) {
+            if (value === 0) {
+                this._counters.delete(counterKey);
+            } else {
+                this._counters.set(counterKey, value);
+            }
+        }
+        return true;
+    }
+
+    async scan(predicate, options) {
+        const limit = options?.limit ?? DEFAULT_SCAN_LIMIT;
+        const cursor = options?.cursor;
+        const compiled = compilePredicate(predicate);
+
+        if (cursor !== undefined && !this._store.has(cursor)) {
+            throw scanCursorError();
+        }
+
+        const items = [];
+        let started = cursor === undefined;
+        for (const [key, value] of this._store) {
+            if (!started) {
+                started = key === cursor;
+                continue;
+            }
+            if (compiled(value)) {
+                items.push({ key, value });
+                if (items.length >= limit) {
+                    return { items, cursor: key };
+                }
+            }
+        }
+        return { items, cursor: undefined };
+    }
+
+    /**
+     * Sorts all keys on every call.
+     * @async
+     * @see {@link AbstractCredentialStore.listKeys}
+     */
+    async listKeys(range, limit) {
+        validateKeyRange(range);
+        return keysInRange(this._store.keys(), range, limit ?? DEFAULT_KEY_LIMIT);
+    }
+}
+
+/**
+ * Accounts of a binary snapshot mapped by the native addon, with the
+ * changes made since on top, behind the part of the Map interface that
+ * the in-memory stores use. Values of the snapshot are parsed when first
+ * read. Keys of the snapshot come first in byte order, then the added
+ * ones in insertion order.
+ */
+class SnapshotMap {
+    /** @type {string|undefined} */
+    #path;
+    #size = 0;
+    /**
+     * Values read from the snapshot or set since.
+     * @type {Map<string, any>}
+     */
+    #values = new Map();
+    /**
+     * Keys of the snapshot deleted since.
+     * @type {Set<string>}
+     */
+    #removed = new Set();
+    /**
+     * Keys set since that are not in the snapshot.
+     * @type {Set<string>}
+     */
+    #added = new Set();
+
+    /**
+     * @param {string} [snapshotPath] - Empty if undefined.
+     */
+    constructor(snapshotPath) {
+        if (snapshotPath !== undefined) {
+            this.#size = gdbm.openSnapshotFile(snapshotPath);
+            this.#path = snapshotPath;
+        }
+    }
+
+    get size() {
+        return this.#size;
+    }
+
+    #inSnapshot(key) {
+        return (
+            this.#path !== undefined &&
+            typeof key === "string" &&
+            gdbm.hasSnapshotKey(this.#path, key)
+        );
+    }
+
+    /**
+     * @param {string} key
+     * @param {boolean} keep - Keep the parsed value for the next read.
+     */
+    #read(key, keep) {
+        if (this.#values.has(key)) {
+            return this.#values.get(key);
+        }
+        if (this.#path === undefined || typeof key !== "string" || this.#removed.has(key)) {
+            return undefined;
+        }
+        const text = gdbm.getSnapshotString(this.#path, key);
+        if (text === undefined) {
+            return undefined;
+        }
+        const value = JSON.parse(text, reviverFreezeNullObj);
+        if (keep) {
+            this.#values.set(key, value);
+        }
+        return value;
+    }
+
+    has(key) {
+        if (this.#values.has(key)) {
+            return true;
+        }
+        return !this.#removed.has(key) && this.#inSnapshot(key);
+    }
+
+    get(key) {
+        return this.#read(key, true);
+    }
+
+    set(key, value) {
+        if (!this.#values.has(key)) {
+            if (this.#removed.delete(key)) {
+                this.#size++;
+            } else if (!this.#inSnapshot(key)) {
+                this.#added.add(key);
+                this.#size++;
+            }
+        }
+        this.#values.set(key, value);
+        return this;
+    }
+
+    delete(key) {
+        if (!this.has(key)) {
+            return false;
+        }
+        this.#values.delete(key);
+        if (!this.#added.delete(key)) {
+            this.#removed.add(key);
+        }
+        this.#size--;
+        return true;
+    }
+
+    *keys() {
+        if (this.#path !== undefined) {
+            for (const key of gdbm.listSnapshotKeys(this.#path)) {
+                if (!this.#removed.has(key)) {
+                    yield key;
+                }
+            }
+        }
+        yield* this.#added;
+    }
+
+    /**
+     * Values are not kept, so that walking the whole store does not parse
+     * it into memory for good.
+     */
+    *entries() {
+        for (const key of this.keys()) {
+            yield [key, this.#read(key, false)];
+        }
+    }
+
+    [Symbol.iterator]() {
+        return this.entries();
+    }
+
+    /**
+     * Keys and JSON texts of the values, to write a new snapshot. Values
+     * not read since are taken from the snapshot as they are.
+     * @returns {{ keys: string[], values: string[] }}
+     */
+    toJSONEntries() {
+        const keys = [];
+        const values = [];
+        for (const key of this.keys()) {
+            keys.push(key);
+            if (this.#values.has(key)) {
+                // undefined has no JSON text; the journal saves it as null too
+                values.push(JSON.stringify(this.#values.get(key), replacerMap) ?? "null");
+            } else {
+                values.push(gdbm.getSnapshotString(this.#path, key));
+            }
+        }
+        return { keys, values };
+    }
+
+    close() {
+        if (this.#path !== undefined) {
+            gdbm.closeSnapshotFile(this.#path);
+            this.#path = undefined;
+        }
+    }
 }
 
+/**
+ * Note that counters are only kept in memory and not saved to the file.
+ */
 class JsonCachedCredentialStore extends InMemoryCredentialStore {
     static get typeName() {
         return "jsoncached";
@@ -282,18 +864,73 @@ class JsonCachedCredentialStore extends InMemoryCredentialStore {
 
     static #EXT = ".json";
     static #MODE = 0o640;
+    static #JOURNAL_EXT = ".log";
+    static #COMPACTING_EXT = ".log.1";
+    static #TMP_EXT = ".tmp";
+    static #SNAPSHOT_EXT = ".snap";
+    // compact once the journal outgrows both this and the snapshot
+    static #COMPACT_MIN_BYTES = 1024 * 1024;
 
     /** @type {string} */
     #filepath;
+    /** @type {string} */
+    #journalPath;
+    /** @type {string} */
+    #compactingPath;
+    /**
+     * Binary snapshot replacing the file, if enabled.
+     * @type {string|undefined}
+     */
+    #snapshotPath;
+    #journalBytes = 0;
+    #snapshotBytes = 0;
+    // journal writes and the journal switch of a compaction, in order
+    #queue = Promise.resolve();
+    /** @type {Promise<void>|undefined} */
+    #compaction;
+    #flushDelay;
+    /**
+     * Journal lines waiting for the next flush.
+     * @type {{ lines: string[], done: Promise<void> }|undefined}
+     */
+    #batch;
+    /**
+     * Batches whose append has not settled yet.
+     * @type {Set<{ lines: string[], done: Promise<void> }>}
+     */
+    #unflushed = new Set();
+    /** @type {Promise<void>|undefined} */
+    #flushing;
 
     /**
      * Create the store by simply .json file and cached memory.
      * This store must be for debugging.
+     *
+     * Every write appends one JSON line with the new values of the changed
+     * accounts to a journal next to the file, `name`.json.log. Once the
+     * journal outgrows the file, the file is rewritten from memory in the
+     * background and the journal started over. On startup the file is
+     * loaded and the journal replayed.
+     *
+     * Writes made within `flushDelay` milliseconds of each other are
+     * appended together and settle when that append does.
+     *
+     * With `binarySnapshot`, the file is replaced by a binary snapshot,
+     * `name`.snap, that the native addon maps into memory. Opening it takes
+     * the same time for any number of accounts, and each value is parsed
+     * when first read. An existing .json file is converted on startup and
+     * removed.
      * @param {Object} args - Initialize arguments
      * @param {string} args.name - Table name. File name will be `name`.json.
      * @param {string} [args.dirpath]
      * Directory path to save/load the data, relative to entry script or absolute path.
      * If undefined, file path to save/load the data is same directory with entry script.
+     * @param {number} [args.flushDelay]
+     * Milliseconds to gather writes before appending them. Default is 0,
+     * which gathers the writes of the current turn of the event loop.
+     * @param {boolean} [args.binarySnapshot]
+     * Keep the snapshot in the binary format. Needs the native addon.
+     * Default is false.
      */
     constructor(args) {
         const args_ = { name: args.name, dirpath: args.dirpath };
@@ -305,6 +942,18 @@ class JsonCachedCredentialStore extends InMemoryCredentialStore {
         if (typeof args_.dirpath !== "string" && args_.dirpath !== undefined) {
             throw new TypeError("path must be string or undefined");
         }
+        const flushDelay = args.flushDelay ?? 0;
+        if (!(Number.isInteger(flushDelay) && flushDelay >= 0)) {
+            throw new TypeError("flushDelay must be a non-negative integer");
+        }
+        this.#flushDelay = flushDelay;
+        const binarySnapshot = args.binarySnapshot ?? false;
+        if (typeof binarySnapshot !== "boolean") {
+            throw new TypeError("binarySnapshot must be boolean");
+        }
+        if (binarySnapshot && gdbm == null) {
+            throw new Error("binarySnapshot needs the native addon");
+        }
 
         const ext = JsonCachedCredentialStore.#EXT;
         const filename = path.extname(args_.name) === "" ? args_.name + ext : args_.name;
@@ -320,12 +969,29 @@ class JsonCachedCredentialStore extends InMemoryCredentialStore {
         }
         pathList.push(filename);
         this.#filepath = path.resolve(...pathList);
+        this.#journalPath = this.#filepath + JsonCachedCredentialStore.#JOURNAL_EXT;
+        this.#compactingPath = this.#filepath + JsonCachedCredentialStore.#COMPACTING_EXT;
+        if (binarySnapshot) {
+            this.#snapshotPath = path.join(
+                path.dirname(this.#filepath),
+                path.basename(this.#filepath, path.extname(this.#filepath)) +
+                    JsonCachedCredentialStore.#SNAPSHOT_EXT
+            );
+        }
 
-        if (fs.existsSync(this.#filepath)) {
-            const contents = fs.readFileSync(this.#filepath, { encoding: "utf-8" });
-            const values = JSON.parse(contents, reviverFreezeNullObj);
-            for (const [key, value] of Object.entries(values)) {
-                this._store.set(key, value);
+        const converting = binarySnapshot && !fs.existsSync(this.#snapshotPath);
+        this._store = this.#loadFiles();
+
+        // an interrupted compaction is finished before anything is appended,
+        // and so is the conversion of a .json file
+        if (fs.existsSync(this.#compactingPath) || converting) {
+            this.#snapshotBytes = this.#writeSnapshotSync(this.#serialize());
+            fs.rmSync(this.#journalPath, { force: true });
+            fs.rmSync(this.#compactingPath, { force: true });
+            this.#journalBytes = 0;
+            if (converting) {
+                fs.rmSync(this.#filepath, { force: true });
+                this._store = this.#loadFiles();
             }
         }
     }
@@ -334,72 +1000,308 @@ class JsonCachedCredentialStore extends InMemoryCredentialStore {
         return this._store.size;
     }
 
-    async #saveMem(store, filepath) {
-        const mode = JsonCachedCredentialStore.#MODE;
-        const contents = JSON.stringify(store, replacerMap, 2);
-        await fsPromises.writeFile(filepath, contents, { flag: "w", mode: mode });
-    }
+    /**
+     * Read the file, or map the binary snapshot, and replay the journals,
+     * cutting a torn last line off the current journal.
+     * @returns {Map<string, any>|SnapshotMap}
+     */
+    #loadFiles() {
+        let store = new Map();
+        let mapped = false;
+        if (this.#snapshotPath !== undefined) {
+            mapped = fs.existsSync(this.#snapshotPath);
+            if (mapped) {
+                // a reload maps the file anew, as it may have been compacted
+                if (this._store instanceof SnapshotMap) {
+                    this._store.close();
+                }
+                this.#snapshotBytes = fs.statSync(this.#snapshotPath).size;
+            }
+            store = new SnapshotMap(mapped ? this.#snapshotPath : undefined);
+        }
+        if (!mapped && fs.existsSync(this.#filepath)) {
+            const contents = fs.readFileSync(this.#filepath, { encoding: "utf-8" });
+            const values = JSON.parse(contents, reviverFreezeNullObj);
+            for (const [key, value] of Object.entries(values)) {
+                store.set(key, value);
+            }
+            this.#snapshotBytes = Buffer.byteLength(contents);
+        }
 
-    async #loadFile(filepath) {
-        const contents = await fsPromises.readFile(filepath);
-        const values = JSON.parse(contents, reviverFreezeNullObj);
-        const store = new Map();
-        for (const [key, value] of Object.entries(values)) {
-            store.set(key, value);
+        for (const journalPath of [this.#compactingPath, this.#journalPath]) {
+            if (!fs.existsSync(journalPath)) {
+                continue;
+            }
+            const contents = fs.readFileSync(journalPath);
+            const validLength = replayJournal(store, contents);
+            if (journalPath === this.#journalPath) {
+                if (validLength < contents.length) {
+                    fs.truncateSync(journalPath, validLength);
+                }
+                this.#journalBytes = validLength;
+            }
         }
         return store;
     }
 
-    async signup(key, value) {
-        const result = await super.signup(key, value);
-        if (result) {
-            try {
-                await this.#saveMem(this._store, this.#filepath);
-            } catch (e) {
-                this._store = await this.#loadFile(this.#filepath);
-                return false;
+    /**
+     * Add the current values of `keys` to the next flush as one line.
+     * @param {Iterable<string>} keys
+     * @returns {Promise<void>} Settles when the line has been appended.
+     */
+    #journal(keys) {
+        const changes = [];
+        for (const key of keys) {
+            changes.push(this._store.has(key) ? [key, this._store.get(key)] : [key]);
+        }
+        const line = JSON.stringify(changes, replacerMap) + "\n";
+
+        if (this.#batch === undefined) {
+            let flush;
+            const done = new Promise((resolve) => {
+                flush = resolve;
+            }).then(() => this.#flush(batch));
+            const batch = { lines: [], done: done };
+            this.#batch = batch;
+            this.#unflushed.add(batch);
+            if (this.#flushDelay > 0) {
+                setTimeout(flush, this.#flushDelay);
+            } else {
+                setImmediate(flush);
             }
         }
-        return result;
+        this.#batch.lines.push(line);
+        return this.#batch.done;
     }
 
-    async remove(key) {
-        const result = await super.remove(key);
-        if (result) {
-            try {
-                await this.#saveMem(this._store, this.#filepath);
-            } catch (e) {
-                this._store = await this.#loadFile(this.#filepath);
-                return false;
+    /**
+     * Append `batch` to the journal once the previous flush has finished.
+     * If the append fails, the store is reloaded from the files together
+     * with the lines of the next batch, and the writes of `batch` fail.
+     * @param {{ lines: string[], done: Promise<void> }} batch
+     */
+    async #flush(batch) {
+        // writes arriving while a flush runs go to the batch after it
+        while (this.#flushing !== undefined) {
+            await this.#flushing;
+        }
+        if (this.#batch === batch) {
+            this.#batch = undefined;
+        }
+
+        const contents = batch.lines.join("");
+        const write = this.#queue.then(() =>
+            fsPromises.appendFile(this.#journalPath, contents, {
+                mode: JsonCachedCredentialStore.#MODE,
+            })
+        );
+        this.#queue = write.catch(() => {});
+        this.#flushing = this.#queue;
+        try {
+            await write;
+        } catch (e) {
+            const store = this.#loadFiles();
+            if (this.#batch !== undefined) {
+                replayJournal(store, Buffer.from(this.#batch.lines.join("")));
             }
+            this._store = store;
+            throw e;
+        } finally {
+            this.#flushing = undefined;
+            this.#unflushed.delete(batch);
+        }
+
+        this.#journalBytes += Buffer.byteLength(contents);
+        if (
+            this.#compaction === undefined &&
+            this.#journalBytes >
+                Math.max(JsonCachedCredentialStore.#COMPACT_MIN_BYTES, this.#snapshotBytes)
+        ) {
+            this.compact().catch(() => {});
         }
-        return result;
     }
 
-    async update(key, value, allowNewKey) {
-        const result = await super.update(key, value, allowNewKey);
-        if (result) {
+    /**
+     * Rewrite the file from memory and start the journal over. Writes go on
+     * meanwhile, into a new journal. The file is only rewritten once the
+     * writes it holds are in the journal; if one of them fails, the
+     * compaction fails and the old journal is kept, to be compacted with
+     * the new one next time.
+     * @async
+     * @returns {Promise<void>}
+     */
+    async compact() {
+        if (this.#compaction !== undefined) {
+            return this.#compaction;
+        }
+
+        // between two journal writes, so the snapshot covers the old journal
+        const switched = this.#queue.then(async () => {
+            const contents = this.#serialize();
+            // writes in memory that are still to be appended
+            const pending = [...this.#unflushed].map((batch) => batch.done);
+            if (fs.existsSync(this.#compactingPath)) {
+                // a failed compaction left its journal; keep adding to it
+                const journal = await fsPromises.readFile(this.#journalPath).catch((e) => {
+                    if (e.code === "ENOENT") {
+                        return Buffer.alloc(0);
+                    }
+                    throw e;
+                });
+                await fsPromises.appendFile(this.#compactingPath, journal);
+                await fsPromises.rm(this.#journalPath, { force: true });
+            } else {
+                await fsPromises.rename(this.#journalPath, this.#compactingPath).catch((e) => {
+                    if (e.code !== "ENOENT") {
+                        throw e;
+                    }
+                });
+            }
+            this.#journalBytes = 0;
+            return { contents, pending };
+        });
+        this.#queue = switched.catch(() => {});
+
+        this.#compaction = (async () => {
             try {
-                await this.#saveMem(this._store, this.#filepath);
-            } catch (e) {
-                this._store = await this.#loadFile(this.#filepath);
-                return false;
+                const { contents, pending } = await switched;
+                // a failed append rolls its writes back to the files, which
+                // must not hold them by then
+                for (const result of await Promise.allSettled(pending)) {
+                    if (result.status === "rejected") {
+                        throw result.reason;
+                    }
+                }
+                const bytes = await this.#writeSnapshot(contents);
+                await fsPromises.rm(this.#compactingPath, { force: true });
+                this.#snapshotBytes = bytes;
+            } finally {
+                this.#compaction = undefined;
             }
+        })();
+        return this.#compaction;
+    }
+
+    /**
+     * Contents of the snapshot: the JSON text of the file, or the keys and
+     * the JSON texts of the values of the binary snapshot.
+     * @returns {string|{ keys: string[], values: string[] }}
+     */
+    #serialize() {
+        if (this.#snapshotPath === undefined) {
+            return JSON.stringify(this._store, replacerMap, 2);
         }
-        return result;
+        return this._store.toJSONEntries();
+    }
+
+    /**
+     * @param {string|{ keys: string[], values: string[] }} contents
+     * @returns {number} Size of the written snapshot.
+     */
+    #writeSnapshotSync(contents) {
+        if (this.#snapshotPath !== undefined) {
+            gdbm.writeSnapshotFile(this.#snapshotPath, contents.keys, contents.values);
+            return fs.statSync(this.#snapshotPath).size;
+        }
+        const tmpPath = this.#filepath + JsonCachedCredentialStore.#TMP_EXT;
+        fs.writeFileSync(tmpPath, contents, { mode: JsonCachedCredentialStore.#MODE });
+        fs.renameSync(tmpPath, this.#filepath);
+        return Buffer.byteLength(contents);
+    }
+
+    /**
+     * Same as `#writeSnapshotSync`, though the binary snapshot is still
+     * written synchronously.
+     * @param {string|{ keys: string[], values: string[] }} contents
+     * @returns {Promise<number>}
+     */
+    async #writeSnapshot(contents) {
+        if (this.#snapshotPath !== undefined) {
+            return this.#writeSnapshotSync(contents);
+        }
+        const tmpPath = this.#filepath + JsonCachedCredentialStore.#TMP_EXT;
+        await fsPromises.writeFile(tmpPath, contents, {
+            flag: "w",
+            mode: JsonCachedCredentialStore.#MODE,
+        });
+        await fsPromises.rename(tmpPath, this.#filepath);
+        return Buffer.byteLength(contents);
+    }
+
+    /**
+     * Journal the change of `keys` if `result` is true. If that fails, the
+     * changes of the whole flush are rolled back and false returned.
+     * @param {boolean} result
+     * @param {Iterable<string>} keys
+     * @returns {Promise<boolean>}
+     */
+    async #persist(result, keys) {
+        if (!result) {
+            return result;
+        }
+        try {
+            await this.#journal(keys);
+        } catch (e) {
+            return false;
+        }
+        return true;
+    }
+
+    async signup(key, value) {
+        return this.#persist(await super.signup(key, value), [key]);
+    }
+
+    async remove(key) {
+        return this.#persist(await super.remove(key), [key]);
+    }
+
+    async update(key, value, allowNewKey) {
+        return this.#persist(await super.update(key, value, allowNewKey), [key]);
+    }
+
+    async signupMany(entries) {
+        return this.#persistMany(await super.signupMany(entries), entries);
+    }
+
+    async updateMany(entries, allowNewKey) {
+        return this.#persistMany(await super.updateMany(entries, allowNewKey), entries);
+    }
+
+    /**
+     * Journal the changed keys of `entries` in one line, as `#persist`
+     * does. If that fails, every result is false.
+     * @param {boolean[]} results
+     * @param {[string, any][]} entries
+     * @returns {Promise<boolean[]>}
+     */
+    async #persistMany(results, entries) {
+        const keys = entries.filter((_, i) => results[i]).map(([key]) => key);
+        if (!(await this.#persist(keys.length > 0, keys)) && keys.length > 0) {
+            return results.map(() => false);
+        }
+        return results;
     }
 
     async delete(key, projection) {
-        const result = await super.delete(key, projection);
-        if (result) {
-            try {
-                await this.#saveMem(this._store, this.#filepath);
-            } catch (e) {
-                this._store = await this.#loadFile(this.#filepath);
-                return false;
-            }
+        return this.#persist(await super.delete(key, projection), [key]);
+    }
+
+    async commitBatch(ops) {
+        const keys = new Set(
+            ops.filter((op) => op.type !== "increment" && op.type !== "resetCounter")
+                .map((op) => op.key)
+        );
+        return this.#persist(await super.commitBatch(ops), keys);
+    }
+
+    /**
+     * Release the mapping of the binary snapshot. The store cannot be used
+     * afterwards.
+     */
+    close() {
+        if (this._store instanceof SnapshotMap) {
+            this._store.close();
         }
-        return result;
     }
 }
 
@@ -414,9 +1316,134 @@ class GdbmCredentialStore extends AbstractCredentialStore {
         return GdbmCredentialStore.#isAvailable;
     }
 
+    // every worker process opens the same file
+    static get isShared() {
+        return true;
+    }
+
+    static #sweepTimer;
+
+    static #RECENT_KEYS_EXT = ".mru";
+    /**
+     * Reads of a record before giving up an update that others keep
+     * changing under it.
+     */
+    static #SWAP_ATTEMPTS = 8;
+
+    /**
+     * Buffer shared by reads whose value is decoded right away.
+     * @type {Uint8Array}
+     */
+    static #readArena = new Uint8Array(4096);
+
+    /**
+     * Read a value into the read arena, growing it as needed.
+     * @returns {number} Length of the value, or -1 if it does not exist.
+     */
+    static #readInto(filepath, key, suffix) {
+        let length = gdbm.readInto(filepath, key, GdbmCredentialStore.#readArena, 0, suffix);
+        while (length > GdbmCredentialStore.#readArena.length) {
+            GdbmCredentialStore.#readArena = new Uint8Array(
+                Math.max(length, GdbmCredentialStore.#readArena.length * 2),
+            );
+            length = gdbm.readInto(filepath, key, GdbmCredentialStore.#readArena, 0, suffix);
+        }
+        return length;
+    }
+
+    /**
+     * Keep GDBM files open between calls instead of opening them on every
+     * call. At most `maxOpen` files are kept open; the least recently used
+     * one is closed to open another.
+     *
+     * An open file stays locked for writing, so no other process can use
+     * it until it is closed. Only enable the cache when a single process
+     * uses the GDBM files; it cannot be enabled in a cluster worker.
+     * @param {Object} options
+     * @param {number} options.maxOpen
+     * Maximum number of open files. 0 closes them all and disables the cache.
+     * @param {number} [options.idleTimeoutMs]
+     * Files unused for this long are closed. Defaults to 0, never.
+     */
+    static configureHandleCache(options) {
+        const maxOpen = options.maxOpen;
+        const idleTimeoutMs = options.idleTimeoutMs ?? 0;
+        if (!(Number.isInteger(maxOpen) && maxOpen >= 0)) {
+            throw new TypeError("maxOpen must be a non-negative integer");
+        }
+        if (!(Number.isInteger(idleTimeoutMs) && idleTimeoutMs >= 0)) {
+            throw new TypeError("idleTimeoutMs must be a non-negative integer");
+        }
+        if (maxOpen > 0 && cluster.isWorker) {
+            throw new Error(
+                "the handle cache locks files other workers need to open",
+            );
+        }
+
+        gdbm.configureHandleCache(maxOpen, idleTimeoutMs);
+
+        clearInterval(GdbmCredentialStore.#sweepTimer);
+        GdbmCredentialStore.#sweepTimer = undefined;
+        if (maxOpen > 0 && idleTimeoutMs > 0) {
+            GdbmCredentialStore.#sweepTimer = setInterval(
+                () => gdbm.sweepHandleCache(),
+                idleTimeoutMs,
+            );
+            GdbmCredentialStore.#sweepTimer.unref();
+        }
+    }
+
+    /**
+     * Copy fetched contents shorter than `bytes` into buffers managed by V8
+     * and release the native memory at once, instead of handing it over to
+     * the returned buffer. Defaults to 0, never copy.
+     * @param {number} bytes
+     */
+    static setCopyThreshold(bytes) {
+        if (!(Number.isInteger(bytes) && bytes >= 0)) {
+            throw new TypeError("bytes must be a non-negative integer");
+        }
+        gdbm.setCopyThreshold(bytes);
+    }
+
+    /**
+     * Counters of the handle cache.
+     * @returns {{
+     *  hits: number,
+     *  misses: number,
+     *  evictions: number,
+     *  opens: number,
+     *  openTimeTotalMs: number,
+     *  openTimeMaxMs: number,
+     *  openHandles: number
+     * }}
+     */
+    static get handleCacheStats() {
+        return gdbm.getHandleCacheStats();
+    }
+
     #filepath;
     #encoder;
     #decoder;
+    #orderedKeys;
+    #keyIndexOpen = false;
+    #closeKeyIndex = () => this.#closeIndex();
+    #blockSize;
+    #isOpen = false;
+    /**
+     * Creation of a lazily opened table, while under way.
+     * @type {Promise<void>|undefined}
+     */
+    #creating;
+    /** @type {Promise<void>|undefined} */
+    #preloading;
+    #preloadKeys;
+    /**
+     * Recently used keys, the least recent first.
+     * @type {Set<string>|undefined}
+     */
+    #recentKeys;
+    #saveRecentKeys = () => this.#saveRecent();
 
     /**
      * Create the store.
@@ -424,6 +1451,22 @@ class GdbmCredentialStore extends AbstractCredentialStore {
      * @param {string} args.name
      * @param {string} [args.dirpath]
      * @param {number} [args.blockSize]
+     * @param {boolean} [args.orderedKeys]
+     * Keep an ordered index of the keys, so that `listKeys` takes
+     * logarithmic time instead of reading every account. The index is
+     * built on the first `listKeys`, and saved to a ".idx" file next to the
+     * GDBM file on `close` or exit to be loaded next time. Only writes made
+     * by this process are seen by it. Defaults to false.
+     * @param {boolean} [args.lazyOpen]
+     * Create or open the GDBM file on a worker thread on first use, or on
+     * `ready`, instead of in the constructor. Defaults to false.
+     * @param {number} [args.preloadKeys]
+     * Keep track of this many most recently used keys, save them to a
+     * ".mru" file next to the GDBM file on `close` or exit, and look them up
+     * on a worker thread once the table is open next time, so that their
+     * blocks are cached before they are asked for. With the handle cache,
+     * the bucket cache of the kept GDBM handle is filled as well. Defaults
+     * to 0, none.
      */
     constructor(args) {
         super(args);
@@ -453,19 +1496,318 @@ class GdbmCredentialStore extends AbstractCredentialStore {
 
         const blockSize = args.blockSize ?? 0;
 
-        gdbm.createTable(this.#filepath, blockSize);
+        if (args.orderedKeys !== undefined && typeof args.orderedKeys !== "boolean") {
+            throw new TypeError("orderedKeys must be boolean");
+        }
+        this.#orderedKeys = args.orderedKeys ?? false;
+
+        if (args.lazyOpen !== undefined && typeof args.lazyOpen !== "boolean") {
+            throw new TypeError("lazyOpen must be boolean");
+        }
+        const preloadKeys = args.preloadKeys ?? 0;
+        if (!(Number.isInteger(preloadKeys) && preloadKeys >= 0)) {
+            throw new TypeError("preloadKeys must be a non-negative integer");
+        }
+        this.#blockSize = blockSize;
+        this.#preloadKeys = preloadKeys;
+        if (preloadKeys > 0) {
+            this.#recentKeys = new Set();
+            process.once("exit", this.#saveRecentKeys);
+        }
 
         this.#encoder = new TextEncoder();
         this.#decoder = new TextDecoder();
+
+        if (!(args.lazyOpen ?? false)) {
+            gdbm.createTable(this.#filepath, blockSize);
+            this.#opened();
+        }
     }
 
     /**
+     * Opens a lazily opened table synchronously if it is not open yet.
      * @returns {number}
      */
     get size() {
+        if (!this.#isOpen) {
+            gdbm.createTable(this.#filepath, this.#blockSize);
+            this.#opened();
+        }
         return gdbm.countRecords(this.#filepath);
     }
 
+    /**
+     * Resolves once the table is open and the recent keys are preloaded.
+     * @async
+     * @see {@link AbstractCredentialStore.ready}
+     */
+    async ready() {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        await this.#preloading;
+    }
+
+    /**
+     * Create the GDBM file of a lazily opened table on a worker thread.
+     * Calls made meanwhile wait for the same creation; a failed one is
+     * tried again by the next call.
+     * @returns {Promise<void>}
+     */
+    #open() {
+        this.#creating ??= gdbm.createTableAsync(this.#filepath, this.#blockSize).then(
+            () => {
+                this.#creating = undefined;
+                if (!this.#isOpen) {
+                    this.#opened();
+                }
+            },
+            (err) => {
+                this.#creating = undefined;
+                throw err;
+            }
+        );
+        return this.#creating;
+    }
+
+    #opened() {
+        this.#isOpen = true;
+        if (this.#preloadKeys > 0) {
+            // reads do not wait for it
+            this.#preloading = this.#preload();
+        }
+    }
+
+    /**
+     * Look up the keys saved by the last `close` or exit. Never rejects.
+     * @returns {Promise<void>}
+     */
+    async #preload() {
+        let keys;
+        try {
+            const text = await fsPromises.readFile(
+                this.#filepath + GdbmCredentialStore.#RECENT_KEYS_EXT,
+                { encoding: "utf-8" }
+            );
+            keys = JSON.parse(text);
+            if (!Array.isArray(keys) || !keys.every((key) => typeof key === "string")) {
+                return;
+            }
+            keys = keys.slice(-this.#preloadKeys);
+            // keys used since the table opened stay the most recent
+            this.#recentKeys = new Set([...keys, ...this.#recentKeys]);
+            while (this.#recentKeys.size > this.#preloadKeys) {
+                this.#recentKeys.delete(this.#recentKeys.values().next().value);
+            }
+            await gdbm.preloadKeys(this.#filepath, keys);
+        } catch (err) {
+            if (_debug_gdbm && err.code !== "ENOENT") {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+        }
+    }
+
+    /**
+     * Mark `key` as the most recently used one.
+     * @param {string} key
+     */
+    #touch(key) {
+        if (this.#recentKeys === undefined) {
+            return;
+        }
+        this.#recentKeys.delete(key);
+        this.#recentKeys.add(key);
+        if (this.#recentKeys.size > this.#preloadKeys) {
+            this.#recentKeys.delete(this.#recentKeys.values().next().value);
+        }
+    }
+
+    #saveRecent() {
+        try {
+            // keys are as private as the table
+            fs.writeFileSync(
+                this.#filepath + GdbmCredentialStore.#RECENT_KEYS_EXT,
+                JSON.stringify([...this.#recentKeys]),
+                { mode: 0o600 }
+            );
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+        }
+    }
+
+    /**
+     * Path of the GDBM file.
+     * @returns {string}
+     */
+    get _filepath() {
+        return this.#filepath;
+    }
+
+    /**
+     * @typedef {{ min: number, max: number, count: number }[]} SizeHistogram
+     * Non-empty power-of-two bins of sizes in bytes.
+     */
+
+    /**
+     * Read the whole table on a worker thread and describe how it is laid
+     * out, with a recommended block size and bucket cache size.
+     * @async
+     * @returns {Promise<{
+     *  records: number, siblings: number, keyBytes: number, valueBytes: number,
+     *  keySizes: SizeHistogram, valueSizes: SizeHistogram, recordSizes: SizeHistogram,
+     *  multiBlockRecords: number, blockSize: number, directoryDepth: number,
+     *  bucketSize: number, bucketCount: number, bucketFill: number|undefined,
+     *  cacheSize: number, fileSize: number,
+     *  recommended: { blockSize: number, cacheSize: number }
+     * }>}
+     * `siblings` counts the records kept next to the accounts (info,
+     * counters), and `multiBlockRecords` the records larger than a block.
+     * `bucketSize` is the number of entries a bucket holds and `cacheSize`
+     * the number of buckets GDBM caches.
+     */
+    async analyze() {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        const stats = await gdbm.analyzeTable(this.#filepath);
+        const entries = stats.records + stats.siblings;
+        const capacity = stats.bucketCount * stats.bucketSize;
+        return {
+            ...stats,
+            keySizes: toSizeHistogram(stats.keySizes),
+            valueSizes: toSizeHistogram(stats.valueSizes),
+            recordSizes: toSizeHistogram(stats.recordSizes),
+            bucketFill: capacity > 0 ? entries / capacity : undefined,
+            recommended: recommendGeometry(stats),
+        };
+    }
+
+    /**
+     * Copy the table into a new GDBM file with `newBlockSize` on a worker
+     * thread and replace the file with it. Other calls on the table fail
+     * until it is done.
+     * @async
+     * @param {number} newBlockSize - Power of two from 512 to 65536.
+     * @returns {Promise<void>}
+     */
+    async rebuild(newBlockSize) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        if (
+            !Number.isInteger(newBlockSize) ||
+            newBlockSize < MIN_BLOCK_SIZE ||
+            newBlockSize > MAX_BLOCK_SIZE ||
+            (newBlockSize & (newBlockSize - 1)) !== 0
+        ) {
+            throw new RangeError(
+                `newBlockSize must be a power of two from ${MIN_BLOCK_SIZE} to ${MAX_BLOCK_SIZE}`
+            );
+        }
+        await gdbm.rebuildTable(this.#filepath, newBlockSize);
+    }
+
+    /**
+     * Stringify a value for the native functions that take strings as
+     * content; they encode it into a reused buffer.
+     */
+    #stringify(value) {
+        return value !== undefined ? JSON.stringify(value) : "";
+    }
+
+    #encode(value) {
+        return this.#encoder.encode(this.#stringify(value));
+    }
+
+    #decode(content) {
+        return this.#parse(this.#decoder.decode(content));
+    }
+
+    #parse(text) {
+        if (text.length === 0) {
+            return null;
+        }
+        return JSON.parse(text);
+    }
+
+    /**
+     * Get the value stored in the record itself, without sibling fields.
+     * @param {string} key
+     * @returns {any} The value, or undefined if the key does not exist.
+     */
+    #getMain(key) {
+        let content;
+        try {
+            content = gdbm.getString(this.#filepath, key);
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            return undefined;
+        }
+        return content !== undefined ? this.#parse(content) : undefined;
+    }
+
+    /**
+     * Get a sibling field.
+     * @param {string} key
+     * @param {string} field
+     * @returns {any} The field value, or undefined if the sibling does not exist.
+     */
+    #getSibling(key, field) {
+        let length;
+        try {
+            length = GdbmCredentialStore.#readInto(this.#filepath, key, field);
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            return undefined;
+        }
+        if (length < 0) {
+            return undefined;
+        }
+        return this.#decode(GdbmCredentialStore.#readArena.subarray(0, length));
+    }
+
+    /**
+     * Get the value of the record, or of a sibling if `field` is given, parsed
+     * natively into frozen objects without prototype, as reviverFreezeNullObj
+     * makes them.
+     * @param {string} key
+     * @param {string} [field]
+     * @returns {any} The value, or undefined if the record does not exist.
+     */
+    #getFrozen(key, field) {
+        try {
+            return gdbm.getObject(this.#filepath, key, field);
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            return undefined;
+        }
+    }
+
+    /**
+     * Get a field, looking into the record for values written
+     * before the field was kept in a sibling.
+     */
+    #getField(key, field, frozen) {
+        if (SIBLING_FIELDS.includes(field)) {
+            const value = frozen
+                ? this.#getFrozen(key, field)
+                : this.#getSibling(key, field);
+            if (value !== undefined) {
+                return value;
+            }
+        }
+        const value = frozen ? this.#getFrozen(key) : this.#getMain(key);
+        return value == null ? undefined : value[field];
+    }
+
     /**
      * Sign-up new account.
      * @async
@@ -475,17 +1817,30 @@ class GdbmCredentialStore extends AbstractCredentialStore {
      * @returns {Promise<boolean>} If sign-up success, return true, otherwise false.
      */
     async signup(key, value) {
-        const stringified = value !== undefined ? JSON.stringify(value) : undefined;
-        const encoded = this.#encoder.encode(stringified);
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        if (key.includes(SIBLING_SEPARATOR)) {
+            return false;
+        }
+        const [main, siblingFields] = splitSiblingFields(value);
+        const encoded = this.#stringify(main);
+        const siblings = siblingFields.map(([field, fieldValue]) => ({
+            suffix: field,
+            content: this.#encode(fieldValue),
+        }));
         let result;
         try {
-            result = gdbm.insertRecord(this.#filepath, key, encoded);
+            result = gdbm.insertRecord(this.#filepath, key, encoded, siblings);
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
             }
             return false;
         }
+        if (result) {
+            this.#touch(key);
+        }
         return result;
     }
 
@@ -496,15 +1851,19 @@ class GdbmCredentialStore extends AbstractCredentialStore {
      * @returns {Promise<boolean>} Success to remove or not.
      */
     async remove(key) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
         let result;
         try {
-            result = gdbm.removeRecord(this.#filepath, key);
+            result = gdbm.removeRecord(this.#filepath, key, SIBLING_FIELDS);
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
             }
             return false;
         }
+        this.#recentKeys?.delete(key);
         return result;
     }
 
@@ -517,88 +1876,544 @@ class GdbmCredentialStore extends AbstractCredentialStore {
      * Account data. If key is invalid, return undefined.
      */
     async get(key) {
-        let value;
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        const parsed = this.#getFrozen(key);
+        if (parsed !== undefined) {
+            this.#touch(key);
+        }
+        if (parsed == null || typeof parsed !== "object") {
+            return parsed;
+        }
+
+        let value = parsed;
+        for (const field of SIBLING_FIELDS) {
+            const fieldValue = this.#getFrozen(key, field);
+            if (fieldValue !== undefined) {
+                if (value === parsed) {
+                    value = Object.assign(Object.create(null), parsed);
+                }
+                value[field] = fieldValue;
+            }
+        }
+
+        return value === parsed ? parsed : Object.freeze(value);
+    }
+
+    /**
+     * Get a top-level field of the value with the key.
+     * Sibling fields are read without the rest of the value.
+     * @async
+     * @param {string} key - Account identifier.
+     * @param {string} field - Field name.
+     * @returns {Promise<any|undefined>}
+     */
+    async getField(key, field) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        const value = this.#getField(key, field, true);
+        if (value !== undefined) {
+            this.#touch(key);
+        }
+        return value;
+    }
+
+    /**
+     * Check the account exists.
+     * @async
+     * @param {string} key - Account identifier.
+     * @returns {Promise<boolean>} If account exists, return true, otherwise false.
+     */
+    async has(key) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        let result;
         try {
-            value = gdbm.getContent(this.#filepath, key);
+            result = gdbm.hasKey(this.#filepath, key);
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
             }
-            return undefined;
+            result = false;
+        }
+        if (result) {
+            this.#touch(key);
         }
+        return result;
+    }
 
-        if (value.length === 0) {
-            return null;
+    /**
+     * Update the value to the data store.
+     * Sibling fields in `value` only rewrite their own records, together
+     * with the record in one native call.
+     * @async
+     * @template V
+     * @param {string} key - The field key to set the value.
+     * @param {V} value - Set value.
+     * @param {boolean} allowNewKey - Allow new key to stored value.
+     * @returns {Promise<boolean>} Success to set or not.
+     */
+    async update(key, value, allowNewKey) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        if (value == null) {
+            return false;
+        }
+
+        const [main, siblingFields] = splitSiblingFields(value);
+        const fields = siblingFields.map(([field]) => field);
+        const updatesMain =
+            siblingFields.length === 0 || Object.keys(main).length > 0;
+
+        return this.#updateRecord(
+            key,
+            (oldContent, oldFields) => {
+                const changed = {
+                    fields: siblingFields.map(([field, patch], i) =>
+                        mergeField(
+                            this.#fieldOf(oldContent, field, oldFields[i]),
+                            field,
+                            patch,
+                            allowNewKey
+                        )
+                    ),
+                };
+                if (updatesMain) {
+                    changed.value = this.#merge(oldContent, main, allowNewKey);
+                }
+                return changed;
+            },
+            fields
+        );
+    }
+
+    #updateMain(key, value, allowNewKey) {
+        return this.#updateRecord(key, (oldContent) => ({
+            value: this.#merge(oldContent, value, allowNewKey),
+        }));
+    }
+
+    /**
+     * The value of a sibling field from the stored contents, looking into
+     * the record for values written before the field was kept in a sibling.
+     * @param {string} oldContent - Stored content of the record.
+     * @param {string} field
+     * @param {string|undefined} fieldContent - Stored content of the sibling.
+     */
+    #fieldOf(oldContent, field, fieldContent) {
+        if (fieldContent !== undefined) {
+            return this.#parse(fieldContent);
+        }
+        const oldParsed = oldContent.length > 0 ? this.#parse(oldContent) : null;
+        return oldParsed == null ? undefined : oldParsed[field];
+    }
+
+    /**
+     * Replace the record and the siblings of `fields` with `change` applied
+     * to their stored contents, unless the record is removed meanwhile.
+     * They are replaced in one native call, only if nobody changed any of
+     * them since they were read, and read again otherwise.
+     * @param {string} key
+     * @param {(oldContent: string, oldFields: (string|undefined)[]) =>
+     *     { value?: any, fields?: any[] }} change
+     * The new value, left as stored without `value`, and the new values of
+     * `fields`, undefined to remove the sibling. Throws to leave the record
+     * alone.
+     * @param {string[]} [fields] - Sibling fields changed along.
+     * @returns {boolean} Replaced or not.
+     */
+    #updateRecord(key, change, fields = []) {
+        const keys = [key, ...fields.map((field) => siblingKeyOf(key, field))];
+        for (let i = 0; i < GdbmCredentialStore.#SWAP_ATTEMPTS; i++) {
+            let oldContents;
+            try {
+                oldContents = keys.map((recordKey) =>
+                    gdbm.getString(this.#filepath, recordKey)
+                );
+            } catch (err) {
+                if (_debug_gdbm) {
+                    console.error(`${GdbmCredentialStore.name}`, err);
+                }
+                return false;
+            }
+            const [oldContent, ...oldFields] = oldContents;
+            if (oldContent === undefined) {
+                return false;
+            }
+
+            let changed;
+            try {
+                changed = change(oldContent, oldFields);
+            } catch (err) {
+                return false;
+            }
+
+            // the record is swapped even when kept, so that no sibling is
+            // written for a record removed meanwhile
+            const contents = [
+                Object.hasOwn(changed, "value")
+                    ? this.#encode(changed.value)
+                    : this.#encoder.encode(oldContent),
+                ...fields.map((_, j) =>
+                    changed.fields[j] !== undefined
+                        ? this.#encode(changed.fields[j])
+                        : null
+                ),
+            ];
+            // a missing sibling left missing is not swapped
+            const indexes = keys
+                .map((_, j) => j)
+                .filter((j) => contents[j] !== null || oldContents[j] !== undefined);
+
+            let swapped;
+            try {
+                [swapped] = gdbm.compareAndSwapRecords(
+                    this.#filepath,
+                    indexes.map((j) => keys[j]),
+                    indexes.map((j) => oldContents[j]),
+                    indexes.map((j) => contents[j]),
+                    indexes.length > 1
+                );
+            } catch (err) {
+                if (_debug_gdbm) {
+                    console.error(`${GdbmCredentialStore.name}`, err);
+                }
+                return false;
+            }
+            if (swapped) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Merge `value` into the stored content of a record.
+     * @throws {Error} If the values cannot be merged.
+     */
+    #merge(oldContent, value, allowNewKey) {
+        if (oldContent.length === 0) {
+            return value;
+        }
+        const oldParsed = this.#parse(oldContent);
+        try {
+            return structuredMerge(oldParsed, value, allowNewKey);
+        } catch (err) {
+            console.error(`${GdbmCredentialStore.name} error: Failed to merge`);
+            throw err;
+        }
+    }
+
+    /**
+     * Sign-up many accounts with the table opened once.
+     * @async
+     * @param {[string, any][]} entries - Pairs of account identifier and initialize value.
+     * @returns {Promise<boolean[]>} Success of each sign-up in the order of `entries`.
+     */
+    async signupMany(entries) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        const results = entries.map(() => false);
+        const records = [];
+        const indexes = [];
+        entries.forEach(([key, value], i) => {
+            if (key.includes(SIBLING_SEPARATOR)) {
+                return;
+            }
+            const [main, siblingFields] = splitSiblingFields(value);
+            records.push({
+                key,
+                content: this.#encode(main),
+                siblings: siblingFields.map(([field, fieldValue]) => ({
+                    suffix: field,
+                    content: this.#encode(fieldValue),
+                })),
+            });
+            indexes.push(i);
+        });
+
+        let inserted;
+        try {
+            inserted = gdbm.insertRecords(this.#filepath, records);
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            // nothing is written when the arguments are rejected
+            return super.signupMany(entries);
+        }
+        inserted.forEach((result, i) => {
+            if (result) {
+                results[indexes[i]] = true;
+                this.#touch(records[i].key);
+            }
+        });
+        return results;
+    }
+
+    /**
+     * Get a top-level field of the values with the keys, or the whole
+     * values if `field` is undefined, with the table opened once per
+     * record kind.
+     * @async
+     * @param {string[]} keys - Account identifiers.
+     * @param {string} [field] - Field name.
+     * @returns {Promise<any[]>} Values in the order of `keys`, undefined for invalid ones.
+     */
+    async getFields(keys, field) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        let values;
+        try {
+            values = this.#getManyFrozen(keys, field);
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            return super.getFields(keys, field);
+        }
+        values.forEach((value, i) => {
+            if (value !== undefined) {
+                this.#touch(keys[i]);
+            }
+        });
+        return values;
+    }
+
+    /**
+     * Same as `#getField` or `get` for many keys, but throws on failure.
+     * @param {string[]} keys
+     * @param {string} [field]
+     * @returns {any[]}
+     */
+    #getManyFrozen(keys, field) {
+        if (field !== undefined && SIBLING_FIELDS.includes(field)) {
+            const values = gdbm.getObjects(this.#filepath, keys, field);
+            // values written before the field was kept in a sibling
+            const missing = [];
+            values.forEach((value, i) => {
+                if (value === undefined) {
+                    missing.push(i);
+                }
+            });
+            if (missing.length > 0) {
+                const parsed = gdbm.getObjects(
+                    this.#filepath,
+                    missing.map((i) => keys[i])
+                );
+                missing.forEach((i, j) => {
+                    values[i] = parsed[j] == null ? undefined : parsed[j][field];
+                });
+            }
+            return values;
+        }
+
+        const parsed = gdbm.getObjects(this.#filepath, keys);
+        if (field !== undefined) {
+            return parsed.map((value) => (value == null ? undefined : value[field]));
+        }
+
+        const values = parsed.slice();
+        for (const siblingField of SIBLING_FIELDS) {
+            const fieldValues = gdbm.getObjects(this.#filepath, keys, siblingField);
+            fieldValues.forEach((fieldValue, i) => {
+                const value = values[i];
+                if (fieldValue === undefined || value == null || typeof value !== "object") {
+                    return;
+                }
+                if (value === parsed[i]) {
+                    values[i] = Object.assign(Object.create(null), value);
+                }
+                values[i][siblingField] = fieldValue;
+            });
+        }
+        return values.map((value, i) => (value === parsed[i] ? value : Object.freeze(value)));
+    }
+
+    /**
+     * Update many values with the table opened once to read them and once
+     * to write them. Values with sibling fields, or keys given more than
+     * once, are updated one by one, as are values changed by others between
+     * the read and the write.
+     * @async
+     * @param {[string, any][]} entries - Pairs of account identifier and value to set.
+     * @param {boolean} allowNewKey - Allow new key to stored values.
+     * @returns {Promise<boolean[]>} Success of each update in the order of `entries`.
+     */
+    async updateMany(entries, allowNewKey) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        const keys = entries.map(([key]) => key);
+        const mains = entries.map(([, value]) => {
+            if (value == null) {
+                return undefined;
+            }
+            const [main, siblingFields] = splitSiblingFields(value);
+            return siblingFields.length === 0 ? main : null;
+        });
+        if (mains.includes(null) || new Set(keys).size !== keys.length) {
+            return super.updateMany(entries, allowNewKey);
+        }
+
+        let oldContents;
+        try {
+            oldContents = gdbm.getStrings(this.#filepath, keys);
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            return super.updateMany(entries, allowNewKey);
+        }
+
+        const results = entries.map(() => false);
+        const updatedKeys = [];
+        const contents = [];
+        const indexes = [];
+        oldContents.forEach((oldContent, i) => {
+            if (oldContent === undefined || mains[i] === undefined) {
+                return;
+            }
+            let newValue;
+            try {
+                newValue = this.#merge(oldContent, mains[i], allowNewKey);
+            } catch (err) {
+                return;
+            }
+            updatedKeys.push(keys[i]);
+            contents.push(this.#encode(newValue));
+            indexes.push(i);
+        });
+
+        let swapped;
+        try {
+            swapped = gdbm.compareAndSwapRecords(
+                this.#filepath,
+                updatedKeys,
+                indexes.map((i) => oldContents[i]),
+                contents
+            );
+        } catch (err) {
+            if (_debug_gdbm) {
+                console.error(`${GdbmCredentialStore.name}`, err);
+            }
+            return super.updateMany(entries, allowNewKey);
         }
+        swapped.forEach((result, j) => {
+            const i = indexes[j];
+            // changed or removed since it was read
+            results[i] =
+                result || this.#updateMain(keys[i], mains[i], allowNewKey);
+        });
+        return results;
+    }
 
-        const decoded = this.#decoder.decode(value);
-        const parsed = JSON.parse(decoded, reviverFreezeNullObj);
+    /**
+     * Delete the value in the `deletePath`.
+     * @async
+     * @param {string} key - Account identifier.
+     * @param {{ [key: string]: boolean|null }} projection
+     * Projection to the delete data.
+     * If property is true, delete key.
+     * If property is null, replace the value to null.
+     * If undefined, replaced by null.
+     * @returns {Promise<boolean>} Success to delete or not.
+     */
+    async delete(key, projection) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        if (projection == null) {
+            return this.#updateRecord(
+                key,
+                () => ({
+                    value: undefined,
+                    fields: SIBLING_FIELDS.map(() => undefined),
+                }),
+                SIBLING_FIELDS
+            );
+        }
 
-        return parsed;
+        const [main, siblingFields] = splitSiblingFields(projection);
+        const fields = siblingFields.map(([field]) => field);
+        const deletesMain =
+            siblingFields.length === 0 || Object.keys(main).length > 0;
+
+        return this.#updateRecord(
+            key,
+            (oldContent, oldFields) => {
+                const changed = {
+                    fields: siblingFields.map(([field, fieldProjection], i) => {
+                        const oldValue = this.#fieldOf(
+                            oldContent,
+                            field,
+                            oldFields[i]
+                        );
+                        if (oldValue === undefined) {
+                            throw new TypeError("no value to delete from");
+                        }
+                        return deleteNestedObject(
+                            { [field]: oldValue },
+                            { [field]: fieldProjection }
+                        )[field];
+                    }),
+                };
+                if (deletesMain) {
+                    const oldParsed = this.#parse(oldContent);
+                    if (oldParsed == null) {
+                        throw new TypeError("no value to delete from");
+                    }
+                    changed.value = deleteNestedObject(oldParsed, main);
+                }
+                return changed;
+            },
+            fields
+        );
     }
 
-    /**
-     * Check the account exists.
-     * @async
-     * @param {string} key - Account identifier.
-     * @returns {Promise<boolean>} If account exists, return true, otherwise false.
-     */
-    async has(key) {
-        let result;
+    async increment(key, name, delta) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
         try {
-            result = gdbm.hasKey(this.#filepath, key);
+            return gdbm.incr(this.#filepath, counterKeyOf(key, name), delta);
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
             }
-            result = false;
+            return undefined;
         }
-        return result;
     }
 
-    /**
-     * Update the value to the data store.
-     * @async
-     * @template V
-     * @param {string} key - The field key to set the value.
-     * @param {V} value - Set value.
-     * @param {boolean} allowNewKey - Allow new key to stored value.
-     * @returns {Promise<boolean>} Success to set or not.
-     */
-    async update(key, value, allowNewKey) {
-        if (value == null) {
-            return false;
+    async getCounters(key, names) {
+        if (!this.#isOpen) {
+            await this.#open();
         }
-
-        let oldContent;
+        const counterKeys = names.map((name) => counterKeyOf(key, name));
+        let values;
         try {
-            oldContent = gdbm.getContent(this.#filepath, key);
+            values = gdbm.getCounters(this.#filepath, counterKeys);
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
             }
-            return false;
+            return undefined;
         }
+        return values.map((value) => value ?? 0);
+    }
 
-        let newValue;
-        if (oldContent.length === 0) {
-            newValue = value;
-        } else {
-            const oldDecoded = this.#decoder.decode(oldContent);
-            const oldParsed = JSON.parse(oldDecoded);
-
-            try {
-                newValue = structuredMerge(oldParsed, value, allowNewKey);
-            } catch (err) {
-                console.error(`${GdbmCredentialStore.name} error: Failed to merge`);
-                return false;
-            }
+    async resetCounter(key, name) {
+        if (!this.#isOpen) {
+            await this.#open();
         }
-
-        const stringified = JSON.stringify(newValue);
-        const encoded = this.#encoder.encode(stringified);
         try {
-            gdbm.updateContent(this.#filepath, key, encoded);
+            gdbm.removeRecord(this.#filepath, counterKeyOf(key, name));
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
@@ -609,67 +2424,356 @@ class GdbmCredentialStore extends AbstractCredentialStore {
     }
 
     /**
-     * Delete the value in the `deletePath`.
+     * Apply all operations as a unit.
+     * The batch is written to a redo log before the table is changed,
+     * so a crash in the middle is completed on the next access.
      * @async
-     * @param {string} key - Account identifier.
-     * @param {{ [key: string]: boolean|null }} projection
-     * Projection to the delete data.
-     * If property is true, delete key.
-     * If property is null, replace the value to null.
-     * If undefined, replaced by null.
-     * @returns {Promise<boolean>} Success to delete or not.
+     * @param {BatchOperation[]} ops - Operations to apply in order.
+     * @returns {Promise<boolean>} Committed or not.
      */
-    async delete(key, projection) {
-        if (projection == null) {
-            const encoded = this.#encoder.encode(undefined);
-            try {
-                gdbm.updateContent(this.#filepath, key, encoded);
-            } catch (err) {
-                if (_debug_gdbm) {
-                    console.error(`${GdbmCredentialStore.name}`, err);
+    async commitBatch(ops) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        // values written earlier in this batch by native key,
+        // undefined when removed
+        const pending = new Map();
+        const current = (nativeKey, read) =>
+            pending.has(nativeKey) ? pending.get(nativeKey) : read();
+        const nativeOps = [];
+        for (const op of ops) {
+            switch (op.type) {
+                case "signup": {
+                    if (op.key.includes(SIBLING_SEPARATOR)) {
+                        return false;
+                    }
+                    const [main, siblingFields] = splitSiblingFields(op.value);
+                    const content = this.#encode(main);
+                    pending.set(op.key, main ?? null);
+                    nativeOps.push({ type: "insert", key: op.key, content });
+                    for (const [field, fieldValue] of siblingFields) {
+                        const key = siblingKeyOf(op.key, field);
+                        pending.set(key, fieldValue);
+                        nativeOps.push({ type: "upsert", key, content: this.#encode(fieldValue) });
+                    }
+                    break;
                 }
-                return false;
+                case "update": {
+                    if (op.value == null) {
+                        return false;
+                    }
+                    const oldMain = current(op.key, () => this.#getMain(op.key));
+                    if (oldMain === undefined) {
+                        return false;
+                    }
+                    const [main, siblingFields] = splitSiblingFields(op.value);
+                    try {
+                        if (siblingFields.length === 0 || Object.keys(main).length > 0) {
+                            const newMain =
+                                oldMain === null
+                                    ? main
+                                    : structuredMerge(oldMain, main, op.allowNewKey);
+                            pending.set(op.key, newMain);
+                            nativeOps.push({
+                                type: "update",
+                                key: op.key,
+                                content: this.#encode(newMain),
+                            });
+                        }
+                        for (const [field, patch] of siblingFields) {
+                            const key = siblingKeyOf(op.key, field);
+                            const oldValue = current(key, () =>
+                                this.#getField(op.key, field)
+                            );
+                            const newValue = mergeField(
+                                oldValue,
+                                field,
+                                patch,
+                                op.allowNewKey
+                            );
+                            pending.set(key, newValue);
+                            nativeOps.push({ type: "upsert", key, content: this.#encode(newValue) });
+                        }
+                    } catch (err) {
+                        return false;
+                    }
+                    break;
+                }
+                case "remove": {
+                    pending.set(op.key, undefined);
+                    nativeOps.push({ type: "remove", key: op.key });
+                    for (const field of SIBLING_FIELDS) {
+                        const key = siblingKeyOf(op.key, field);
+                        pending.set(key, undefined);
+                        nativeOps.push({ type: "discard", key });
+                    }
+                    break;
+                }
+                case "increment": {
+                    const key = counterKeyOf(op.key, op.name);
+                    nativeOps.push({ type: "incr", key, delta: op.delta });
+                    break;
+                }
+                case "resetCounter": {
+                    const key = counterKeyOf(op.key, op.name);
+                    // an int64 zero, whatever the byte order
+                    const content = new Uint8Array(8);
+                    nativeOps.push({ type: "upsert", key, content });
+                    break;
+                }
+                default:
+                    return false;
             }
-            return true;
         }
 
-        let oldContent;
         try {
-            oldContent = gdbm.getContent(this.#filepath, key);
+            return gdbm.commitBatch(this.#filepath, nativeOps);
         } catch (err) {
             if (_debug_gdbm) {
                 console.error(`${GdbmCredentialStore.name}`, err);
             }
             return false;
         }
+    }
+
+    /**
+     * List the accounts whose value satisfies `predicate`.
+     * The predicate is tested on the stored JSON text on a worker thread,
+     * so accounts that do not match are never parsed.
+     * @async
+     * @see {@link AbstractCredentialStore.scan}
+     */
+    async scan(predicate, options) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        const limit = options?.limit ?? DEFAULT_SCAN_LIMIT;
+        const cursor = options?.cursor;
+        const nativePredicate = toNativePredicate(predicate);
+
+        const { entries, cursor: nextCursor } = await gdbm.scan(
+            this.#filepath,
+            nativePredicate,
+            SIBLING_FIELDS,
+            limit,
+            SCAN_BUDGET,
+            cursor,
+        );
 
-        const oldDecoded = this.#decoder.decode(oldContent);
-        const oldParsed = JSON.parse(oldDecoded);
+        const items = entries.map(([key, main, ...siblings]) => {
+            if (main == null || typeof main !== "object") {
+                return { key, value: main };
+            }
+            const value = Object.assign(Object.create(null), main);
+            SIBLING_FIELDS.forEach((field, i) => {
+                if (siblings[i] !== undefined) {
+                    value[field] = siblings[i];
+                }
+            });
+            return { key, value: Object.freeze(value) };
+        });
+        return { items, cursor: nextCursor };
+    }
 
-        if (oldParsed == null) {
-            return false;
+    /**
+     * Served by the key index with `orderedKeys`; otherwise every key is
+     * scanned, without reading the accounts.
+     * @async
+     * @see {@link AbstractCredentialStore.listKeys}
+     */
+    async listKeys(range, limit) {
+        if (!this.#isOpen) {
+            await this.#open();
+        }
+        validateKeyRange(range);
+        limit ??= DEFAULT_KEY_LIMIT;
+
+        if (!this.#orderedKeys) {
+            const keys = [];
+            let cursor;
+            do {
+                const page = await gdbm.scanKeys(this.#filepath, SCAN_BUDGET, cursor);
+                keys.push(...page.keys);
+                cursor = page.cursor;
+            } while (cursor !== undefined);
+            return keysInRange(keys, range, limit);
         }
 
-        let newValue;
-        try {
-            newValue = deleteNestedObject(oldParsed, projection);
-        } catch (err) {
-            return false;
+        if (!this.#keyIndexOpen) {
+            gdbm.openKeyIndex(this.#filepath);
+            this.#keyIndexOpen = true;
+            process.once("exit", this.#closeKeyIndex);
+        }
+        return gdbm.queryKeys(this.#filepath, range, limit);
+    }
+
+    #closeIndex() {
+        if (this.#keyIndexOpen) {
+            this.#keyIndexOpen = false;
+            gdbm.closeKeyIndex(this.#filepath);
+        }
+    }
+
+    /**
+     * Save and release the key index, if it is open. It is opened again by
+     * the next `listKeys`. The recently used keys are saved too, if kept.
+     */
+    close() {
+        process.removeListener("exit", this.#closeKeyIndex);
+        this.#closeIndex();
+        if (this.#recentKeys !== undefined) {
+            process.removeListener("exit", this.#saveRecentKeys);
+            this.#saveRecent();
+        }
+    }
+}
+
+/**
+ * A GDBM store served from a native in-memory hash table.
+ * Every write is appended to a log file next to the GDBM file, and the
+ * whole table is written to the GDBM file periodically, which empties the
+ * log. On startup the table is loaded from the GDBM file and the log.
+ */
+class GdbmMemoryCredentialStore extends GdbmCredentialStore {
+    static get typeName() {
+        return "gdbmmemory";
+    }
+
+    static get isAvailable() {
+        return GdbmCredentialStore.isAvailable;
+    }
+
+    // the records live in the memory of this process
+    static get isShared() {
+        return false;
+    }
+
+    #timer;
+    #onExit;
+
+    /**
+     * Create the store.
+     * @param {Object} args - Initialize arguments
+     * @param {string} args.name
+     * @param {string} [args.dirpath]
+     * @param {number} [args.blockSize]
+     * @param {number} [args.snapshotInterval]
+     * Milliseconds between snapshots to the GDBM file. Defaults to 60000.
+     * @param {boolean} [args.syncWrites]
+     * Flush the log to disk on every write. Defaults to true; when false,
+     * writes of the last moments before a system crash may be lost.
+     * @param {number} [args.sharedSize]
+     * Bytes of shared memory to keep the table in, so that every process
+     * opening it with a shared size sees the same records. Defaults to 0,
+     * a table of this process only.
+     * `lazyOpen` and `preloadKeys` are not supported.
+     */
+    constructor(args) {
+        // the table is loaded into memory before the constructor returns
+        if (args.lazyOpen || args.preloadKeys) {
+            throw new TypeError("lazyOpen and preloadKeys are not supported by memory tables");
+        }
+        super(args);
+
+        const snapshotInterval = args.snapshotInterval ?? 60000;
+        const syncWrites = args.syncWrites ?? true;
+        const sharedSize = args.sharedSize ?? 0;
+        if (!(Number.isInteger(snapshotInterval) && snapshotInterval > 0)) {
+            throw new TypeError("snapshotInterval must be a positive integer");
+        }
+        if (typeof syncWrites !== "boolean") {
+            throw new TypeError("syncWrites must be boolean");
+        }
+        if (
+            !Number.isSafeInteger(sharedSize) ||
+            (sharedSize !== 0 && sharedSize < MIN_SHARED_SIZE)
+        ) {
+            throw new TypeError(
+                `sharedSize must be 0 or an integer of at least ${MIN_SHARED_SIZE}`
+            );
         }
 
-        const newStringified = JSON.stringify(newValue);
-        const newEncoded = this.#encoder.encode(newStringified);
+        gdbm.openMemoryTable(this._filepath, syncWrites, sharedSize);
+
+        this.#timer = setInterval(() => this.snapshot(), snapshotInterval);
+        this.#timer.unref();
+        this.#onExit = () => this.snapshot();
+        process.once("exit", this.#onExit);
+    }
 
+    /**
+     * Write the table to the GDBM file now.
+     * @returns {boolean} false if the store is closed or writing failed.
+     */
+    snapshot() {
         try {
-            gdbm.updateContent(this.#filepath, key, newEncoded);
+            return gdbm.snapshotMemoryTable(this._filepath);
         } catch (err) {
             if (_debug_gdbm) {
-                console.error(`${GdbmCredentialStore.name}`, err);
+                console.error(`${GdbmMemoryCredentialStore.name}`, err);
             }
             return false;
         }
+    }
+
+    /**
+     * Take a last snapshot and release the table.
+     * The store must not be used afterwards.
+     */
+    close() {
+        clearInterval(this.#timer);
+        process.removeListener("exit", this.#onExit);
+        this.snapshot();
+        gdbm.closeMemoryTable(this._filepath);
+        super.close();
+    }
+}
+
+/**
+ * A memory table in shared memory, for the worker processes of a cluster.
+ * Reads take no lock; writes of every process go to one log and are seen
+ * by the others at once. The records must fit in `sharedSize` bytes.
+ */
+class GdbmSharedMemoryCredentialStore extends GdbmMemoryCredentialStore {
+    static get typeName() {
+        return "gdbmshared";
+    }
+
+    static get isAvailable() {
+        // the segment is guarded with Linux open file description locks
+        return GdbmCredentialStore.isAvailable && process.platform === "linux";
+    }
+
+    static get isShared() {
         return true;
     }
+
+    #onExit;
+
+    /**
+     * Create the store.
+     * @param {Object} args - Initialize arguments of `gdbmmemory`, except
+     * `orderedKeys`, since the key index of a process would miss the writes
+     * of the others.
+     * @param {number} [args.sharedSize]
+     * Bytes of shared memory. Defaults to 64 MiB. Only the first process
+     * opening the table sets the size.
+     */
+    constructor(args) {
+        if (args.orderedKeys) {
+            throw new TypeError("orderedKeys is not supported by shared tables");
+        }
+        super({ ...args, sharedSize: args.sharedSize ?? DEFAULT_SHARED_SIZE });
+
+        // the last process to close the table frees the shared memory
+        this.#onExit = () => gdbm.closeMemoryTable(this._filepath);
+        process.once("exit", this.#onExit);
+    }
+
+    close() {
+        process.removeListener("exit", this.#onExit);
+        super.close();
+    }
 }
 
 const objectToMap = (value, valueTypes, nullable) => {
@@ -698,11 +2802,17 @@ const objectToMap = (value, valueTypes, nullable) => {
     throw new Error(`value is invalid: ${value}`);
 };
 
+// Objects frozen together with everything below them. Stored values share
+// unchanged branches, so a merge only walks and copies the patched path.
+const deepFrozen = new WeakSet();
+// objects parsed natively are frozen the same way
+gdbm?.setFrozenSet(deepFrozen);
+
 function deepFreeze(obj) {
     if (
         obj === null ||
         (typeof obj !== "object" && typeof obj !== "function") ||
-        Object.isFrozen(obj)
+        deepFrozen.has(obj)
     ) {
         return obj;
     }
@@ -710,20 +2820,18 @@ function deepFreeze(obj) {
     if (obj instanceof Array) {
         obj.forEach((item) => deepFreeze(item));
     } else {
-        Object.values(obj).forEach((value) => {
-            if (!Object.isFrozen(value)) {
-                deepFreeze(value);
-            }
-        });
+        Object.values(obj).forEach((value) => deepFreeze(value));
     }
 
     Object.freeze(obj);
+    deepFrozen.add(obj);
 
     return obj;
 }
 
 function toNullObject(obj) {
     if (typeof obj !== "object" || obj === null) return obj;
+    if (deepFrozen.has(obj) && Object.getPrototypeOf(obj) === null) return obj;
 
     const nullObj = Object.assign(Object.create(null), obj);
     for (const key in nullObj) {
@@ -770,6 +2878,38 @@ function structuredMerge(target, source, allowNewKey) {
     throw new Error();
 }
 
+/**
+ * Merge `patch` into one top-level field as `structuredMerge` would do
+ * within the whole value.
+ * @param {any} oldValue - Current field value, undefined if absent.
+ */
+function mergeField(oldValue, field, patch, allowNewKey) {
+    const target = oldValue === undefined ? {} : { [field]: oldValue };
+    return structuredMerge(target, { [field]: patch }, allowNewKey)[field];
+}
+
+/**
+ * Split the top-level sibling fields off the value.
+ * @returns {[any, [string, any][]]} The rest of the value and the fields.
+ */
+function splitSiblingFields(value) {
+    if (value === null || typeof value !== "object") {
+        return [value, []];
+    }
+    let main = value;
+    const siblingFields = [];
+    for (const field of SIBLING_FIELDS) {
+        if (Object.hasOwn(value, field)) {
+            if (main === value) {
+                main = { ...value };
+            }
+            siblingFields.push([field, value[field]]);
+            delete main[field];
+        }
+    }
+    return [main, siblingFields];
+}
+
 function deleteNestedObject(obj, projection) {
     if (typeof obj !== "object" || typeof projection !== "object") {
         throw new Error();
@@ -790,10 +2930,300 @@ function deleteNestedObject(obj, projection) {
     return deepFreeze(newObj);
 }
 
+function scanCursorError() {
+    const err = new Error("Scan cursor no longer exists");
+    err.code = "ERR_SCAN_CURSOR";
+    return err;
+}
+
+function invalidPredicate() {
+    return new TypeError("Invalid predicate");
+}
+
+/**
+ * Compile a scan predicate into a function of the value.
+ * @param {ScanPredicate|null} predicate
+ * @returns {(value: any) => boolean}
+ */
+function compilePredicate(predicate) {
+    if (predicate === null) {
+        return () => true;
+    }
+    if (typeof predicate !== "object") {
+        throw invalidPredicate();
+    }
+    if (Array.isArray(predicate.and)) {
+        const children = predicate.and.map(compilePredicate);
+        return (value) => children.every((child) => child(value));
+    }
+    if (Array.isArray(predicate.or)) {
+        const children = predicate.or.map(compilePredicate);
+        return (value) => children.some((child) => child(value));
+    }
+    if (typeof predicate.path !== "string") {
+        throw invalidPredicate();
+    }
+
+    const segments = predicate.path === "" ? [] : predicate.path.split(".");
+    const lookup = (value) => {
+        for (const segment of segments) {
+            if (value === null || typeof value !== "object" ||
+                !Object.hasOwn(value, segment)) {
+                return undefined;
+            }
+            value = value[segment];
+        }
+        return value;
+    };
+
+    if (Object.hasOwn(predicate, "equals")) {
+        const expected = predicate.equals;
+        if (expected !== null && !["boolean", "number", "string"].includes(typeof expected)) {
+            throw invalidPredicate();
+        }
+        return (value) => lookup(value) === expected;
+    }
+    if (Object.hasOwn(predicate, "prefix")) {
+        const prefix = predicate.prefix;
+        if (typeof prefix !== "string") {
+            throw invalidPredicate();
+        }
+        return (value) => {
+            const found = lookup(value);
+            return typeof found === "string" && found.startsWith(prefix);
+        };
+    }
+    if (typeof predicate.range === "object" && predicate.range !== null) {
+        const { gt, gte, lt, lte } = predicate.range;
+        const lower = gt ?? gte;
+        const upper = lt ?? lte;
+        const type = typeof (lower ?? upper);
+        if (
+            (gt !== undefined && gte !== undefined) ||
+            (lt !== undefined && lte !== undefined) ||
+            (type !== "number" && type !== "string" && type !== "undefined") ||
+            (lower !== undefined && typeof lower !== type) ||
+            (upper !== undefined && typeof upper !== type)
+        ) {
+            throw invalidPredicate();
+        }
+        return (value) => {
+            const found = lookup(value);
+            if (found === undefined || (type !== "undefined" && typeof found !== type)) {
+                return false;
+            }
+            return (
+                (gt === undefined || found > gt) &&
+                (gte === undefined || found >= gte) &&
+                (lt === undefined || found < lt) &&
+                (lte === undefined || found <= lte)
+            );
+        };
+    }
+    throw invalidPredicate();
+}
+
+/**
+ * Translate a scan predicate for the native scan, where a path starting
+ * with a sibling field refers to the sibling record.
+ * @param {ScanPredicate|null} predicate
+ */
+function toNativePredicate(predicate) {
+    if (predicate === null || typeof predicate !== "object") {
+        return predicate;
+    }
+    if (Array.isArray(predicate.and)) {
+        return { and: predicate.and.map(toNativePredicate) };
+    }
+    if (Array.isArray(predicate.or)) {
+        return { or: predicate.or.map(toNativePredicate) };
+    }
+    if (typeof predicate.path !== "string") {
+        throw invalidPredicate();
+    }
+
+    const path = predicate.path === "" ? [] : predicate.path.split(".");
+    const siblingIndex = SIBLING_FIELDS.indexOf(path[0]);
+    const nativePredicate =
+        siblingIndex >= 0
+            ? { record: siblingIndex + 1, path: path.slice(1) }
+            : { record: 0, path };
+    for (const op of ["equals", "prefix", "range"]) {
+        if (Object.hasOwn(predicate, op)) {
+            nativePredicate[op] = predicate[op];
+        }
+    }
+    return nativePredicate;
+}
+
+/**
+ * Apply the complete lines of a JSON lines journal to `store`. Each line is
+ * an array of changes, `[key, value]` to set a key or `[key]` to remove it.
+ * @param {Map<string, any>} store
+ * @param {Buffer} contents
+ * @returns {number} Length of the valid part; the rest is a torn write.
+ */
+function replayJournal(store, contents) {
+    let start = 0;
+    while (start < contents.length) {
+        const end = contents.indexOf(0x0a, start);
+        if (end < 0) {
+            break;
+        }
+        let changes;
+        try {
+            changes = JSON.parse(contents.toString("utf-8", start, end));
+        } catch {
+            break;
+        }
+        if (!Array.isArray(changes)) {
+            break;
+        }
+        for (const [key, ...value] of changes) {
+            if (value.length > 0) {
+                store.set(key, freezeNullObj(value[0]));
+            } else {
+                store.delete(key);
+            }
+        }
+        start = end + 1;
+    }
+    return start;
+}
+
+/**
+ * @param {number[]} bins - Counts of sizes in power-of-two bins.
+ * @returns {SizeHistogram}
+ */
+function toSizeHistogram(bins) {
+    return bins.flatMap((count, i) => {
+        if (count === 0) {
+            return [];
+        }
+        const min = i === 0 ? 0 : 2 ** (i - 1);
+        const max = i === 0 ? 0 : i === bins.length - 1 ? Infinity : 2 ** i - 1;
+        return [{ min, max, count }];
+    });
+}
+
+/**
+ * Pick a block size that holds 95% of the records in one block, and a
+ * cache large enough for every bucket of a table rebuilt with it.
+ * @param {object} stats - Result of gdbm.analyzeTable.
+ * @returns {{ blockSize: number, cacheSize: number }}
+ */
+function recommendGeometry(stats) {
+    const entries = stats.records + stats.siblings;
+    let blockSize = MIN_RECOMMENDED_BLOCK_SIZE;
+    let counted = 0;
+    for (let i = 0; i < stats.recordSizes.length; i++) {
+        counted += stats.recordSizes[i];
+        if (counted >= entries * 0.95) {
+            // bin i holds sizes below 2 ** i
+            blockSize = Math.max(blockSize, 2 ** i);
+            break;
+        }
+    }
+    blockSize = Math.min(blockSize, MAX_BLOCK_SIZE);
+
+    // a bucket entry takes about 24 bytes, and split buckets are ln 2 full
+    // on average
+    const bucketSize =
+        stats.blockSize === blockSize && stats.bucketSize > 0
+            ? stats.bucketSize
+            : Math.floor((blockSize - 32) / 24);
+    const buckets = Math.ceil(entries / (bucketSize * Math.LN2));
+    const cacheSize = Math.max(
+        1,
+        Math.min(buckets, Math.floor(MAX_CACHE_BYTES / blockSize))
+    );
+
+    return { blockSize, cacheSize };
+}
+
+/**
+ * @param {KeyRange} range
+ */
+function validateKeyRange(range) {
+    if (range === null || typeof range !== "object") {
+        throw new TypeError("range must be an object");
+    }
+    for (const bound of ["prefix", "gt", "gte", "lt", "lte"]) {
+        if (range[bound] !== undefined && typeof range[bound] !== "string") {
+            throw new TypeError(`range.${bound} must be string`);
+        }
+    }
+    if (range.gt !== undefined && range.gte !== undefined) {
+        throw new TypeError("range must not have both gt and gte");
+    }
+    if (range.lt !== undefined && range.lte !== undefined) {
+        throw new TypeError("range must not have both lt and lte");
+    }
+}
+
+/**
+ * Pick the keys within `range` from unordered keys, in the byte order of
+ * the native key index.
+ * @param {Iterable<string>} keys
+ * @param {KeyRange} range
+ * @param {number} limit
+ * @returns {string[]}
+ */
+function keysInRange(keys, range, limit) {
+    const encode = (key) => (key !== undefined ? Buffer.from(key) : undefined);
+    const prefix = encode(range.prefix);
+    const lower = encode(range.gt ?? range.gte);
+    const upper = encode(range.lt ?? range.lte);
+    const lowerMin = range.gt !== undefined ? 1 : 0;
+    const upperMax = range.lt !== undefined ? -1 : 0;
+
+    const sorted = Array.from(keys, (key) => [key, Buffer.from(key)]).sort(
+        (a, b) => Buffer.compare(a[1], b[1])
+    );
+    const result = [];
+    for (const [key, bytes] of sorted) {
+        if (result.length >= limit) {
+            break;
+        }
+        if (upper !== undefined && Buffer.compare(bytes, upper) > upperMax) {
+            break;
+        }
+        if (
+            (lower !== undefined && Buffer.compare(bytes, lower) < lowerMin) ||
+            (prefix !== undefined &&
+                !bytes.subarray(0, prefix.length).equals(prefix))
+        ) {
+            continue;
+        }
+        result.push(key);
+    }
+    return result;
+}
+
 function reviverFreezeNullObj(key, value) {
     if (value !== null && typeof value === "object") {
+        // children are revived first, so this freezes the whole branch
         const obj = Object.assign(Object.create(null), value);
         Object.freeze(obj);
+        deepFrozen.add(obj);
+        return obj;
+    }
+    return value;
+}
+
+/**
+ * Same as parsing with `reviverFreezeNullObj`, for an already parsed value.
+ * @param {any} value
+ * @returns {any}
+ */
+function freezeNullObj(value) {
+    if (value !== null && typeof value === "object") {
+        const obj = Object.create(null);
+        for (const [key, child] of Object.entries(value)) {
+            obj[key] = freezeNullObj(child);
+        }
+        Object.freeze(obj);
+        deepFrozen.add(obj);
         return obj;
     }
     return value;
@@ -815,4 +3245,6 @@ module.exports = {
     InMemoryCredentialStore,
     JsonCachedCredentialStore,
     GdbmCredentialStore,
+    GdbmMemoryCredentialStore,
+    GdbmSharedMemoryCredentialStore,
 };
@@ -100,7 +100,8 @@ class WebEntity {
      *      status: number?,
      *      reason: ({
      *          [param_name: string]: number | string | null | boolean
-     *      })?
+     *      })?,
+     *      setCookie: string?
      *  }
      * )>} an object representing a verification result.
      * 
@@ -122,6 +123,9 @@ class WebEntity {
      *      -   `error_description`: `string`
      *          -   a string representing a human-readable description of the authentication/authorization error.
      * 
+     * -    `setCookie` is a `Set-Cookie` field value to send back with the response,
+     *      e.g. a session issued by the protocol. See {@link AuthSessions}.
+     * 
      * Any of the above properties except the `ok` property is optional.
      * However, if the result contains the status and/or the reason, it should have the scheme property.
      * 
@@ -130,6 +134,14 @@ class WebEntity {
         if (!this.authRequired) {
             return { ok: true };
         } else {
+            //  a valid session lets the request in without its credentials.
+            for (const auth_protocol of this.authProtocols) {
+                const session_result = auth_protocol.verifySession(request);
+                if (session_result?.ok) {
+                    return session_result;
+                }
+            }
+
             const authorization = request.headers?.authorization?.[0];
             if (authorization == null) {
                 return { ok: false };
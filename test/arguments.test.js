@@ -0,0 +1,58 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("argument marshalling", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("accepts string and byte contents", () => {
+        const table = makeTable(dir, "contents");
+        assert.equal(gdbm.insertRecord(table, "s", "text"), true);
+        assert.equal(
+            gdbm.insertRecord(table, "b", new TextEncoder().encode("bytes")),
+            true
+        );
+        assert.equal(gdbm.getString(table, "s"), "text");
+        assert.equal(gdbm.getString(table, "b"), "bytes");
+    });
+
+    it("rejects missing arguments", () => {
+        const table = makeTable(dir, "count");
+        assert.throws(() => gdbm.insertRecord(table, "a"), {
+            name: "TypeError",
+            message: "Wrong number of arguments",
+        });
+        assert.throws(() => gdbm.getContent(table), TypeError);
+    });
+
+    it("rejects arguments of the wrong type", () => {
+        const table = makeTable(dir, "types");
+        for (const call of [
+            () => gdbm.insertRecord(table, 1, "x"),
+            () => gdbm.insertRecord(table, "a", {}),
+            () => gdbm.insertRecord(table, "a", "x", [{ suffix: 1 }]),
+            () => gdbm.getStrings(table, "a"),
+        ]) {
+            assert.throws(call, {
+                name: "TypeError",
+                message: "Wrong arguments",
+            });
+        }
+        assert.equal(gdbm.hasKey(table, "a"), false);
+    });
+});
@@ -0,0 +1,141 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+    decode,
+} = require("./helpers.js");
+
+describe("single-lock record updates", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("upserts a missing or present record", () => {
+        const table = makeTable(dir, "upsert");
+        gdbm.upsert(table, "a", "1");
+        gdbm.upsert(table, "a", "2");
+        assert.equal(gdbm.getString(table, "a"), "2");
+    });
+
+    it("returns the replaced value", () => {
+        const table = makeTable(dir, "replace");
+        gdbm.insertRecord(table, "a", "old");
+        const old = gdbm.replaceReturningOld(table, "a", "new");
+        assert.equal(decode(old), "old");
+        assert.equal(gdbm.getString(table, "a"), "new");
+    });
+
+    it("replaces nothing for a missing key", () => {
+        const table = makeTable(dir, "replace-missing");
+        assert.equal(gdbm.replaceReturningOld(table, "a", "x"), undefined);
+        assert.equal(gdbm.hasKey(table, "a"), false);
+    });
+
+    it("returns the deleted value", () => {
+        const table = makeTable(dir, "delete");
+        gdbm.insertRecord(table, "a", "value");
+        assert.equal(decode(gdbm.deleteReturningValue(table, "a")), "value");
+        assert.equal(gdbm.hasKey(table, "a"), false);
+        assert.equal(gdbm.deleteReturningValue(table, "a"), undefined);
+    });
+
+    it("swaps only records that are still as expected", () => {
+        const table = makeTable(dir, "swap");
+        gdbm.insertRecord(table, "a", "old");
+        assert.deepEqual(
+            gdbm.compareAndSwapRecords(
+                table,
+                ["a", "missing"],
+                ["old", "old"],
+                [encode("new"), encode("new")]
+            ),
+            [true, false]
+        );
+        assert.equal(gdbm.getString(table, "a"), "new");
+        assert.equal(gdbm.hasKey(table, "missing"), false);
+
+        assert.deepEqual(
+            gdbm.compareAndSwapRecords(table, ["a"], ["old"], [encode("x")]),
+            [false]
+        );
+        assert.equal(gdbm.getString(table, "a"), "new");
+    });
+
+    it("stores a missing record and removes one as expected", () => {
+        const table = makeTable(dir, "swap-absent");
+        gdbm.insertRecord(table, "a", "old");
+        assert.deepEqual(
+            gdbm.compareAndSwapRecords(
+                table,
+                ["a", "b"],
+                ["old", undefined],
+                [null, encode("new")]
+            ),
+            [true, true]
+        );
+        assert.equal(gdbm.hasKey(table, "a"), false);
+        assert.equal(gdbm.getString(table, "b"), "new");
+    });
+
+    it("swaps all records or none", () => {
+        const table = makeTable(dir, "swap-all");
+        gdbm.insertRecord(table, "a", "old");
+        gdbm.insertRecord(table, "b", "changed");
+        assert.deepEqual(
+            gdbm.compareAndSwapRecords(
+                table,
+                ["a", "b"],
+                ["old", "old"],
+                [encode("new"), encode("new")],
+                true
+            ),
+            [false, false]
+        );
+        assert.equal(gdbm.getString(table, "a"), "old");
+
+        assert.deepEqual(
+            gdbm.compareAndSwapRecords(
+                table,
+                ["a", "b", "c"],
+                ["old", "changed", undefined],
+                [encode("new"), null, encode("new")],
+                true
+            ),
+            [true, true, true]
+        );
+        assert.equal(gdbm.getString(table, "a"), "new");
+        assert.equal(gdbm.hasKey(table, "b"), false);
+        assert.equal(gdbm.getString(table, "c"), "new");
+    });
+
+    it("rejects arrays of different lengths", () => {
+        const table = makeTable(dir, "lengths");
+        assert.throws(
+            () =>
+                gdbm.compareAndSwapRecords(
+                    table,
+                    ["a"],
+                    ["x", "y"],
+                    [encode("z")]
+                ),
+            TypeError
+        );
+    });
+});
@@ -0,0 +1,123 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+    decode,
+} = require("./helpers.js");
+
+/**
+ * A frame of a redo log, as a batch interrupted before it was applied
+ * leaves it next to the table.
+ * @param {["S"|"D", string, string][]} entries
+ */
+function redoFrame(entries) {
+    const parts = [];
+    for (const [op, key, data] of entries) {
+        const header = Buffer.alloc(9);
+        header[0] = op.charCodeAt(0);
+        header.writeUInt32LE(Buffer.byteLength(key), 1);
+        header.writeUInt32LE(Buffer.byteLength(data), 5);
+        parts.push(header, Buffer.from(key), Buffer.from(data));
+    }
+    const payload = Buffer.concat(parts);
+    // FNV-1a
+    let checksum = 2166136261;
+    for (const byte of payload) {
+        checksum = Math.imul(checksum ^ byte, 16777619) >>> 0;
+    }
+    const head = Buffer.alloc(12);
+    head.write("RDO1");
+    head.writeUInt32LE(entries.length, 4);
+    head.writeUInt32LE(payload.length, 8);
+    const tail = Buffer.alloc(4);
+    tail.writeUInt32LE(checksum);
+    return Buffer.concat([head, payload, tail]);
+}
+
+describe("commitBatch", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("applies every operation", () => {
+        const table = makeTable(dir, "all");
+        gdbm.insertRecord(table, "gone", encode("1"));
+        const committed = gdbm.commitBatch(table, [
+            { type: "insert", key: "a", content: encode('{"x":1}') },
+            { type: "remove", key: "gone" },
+            { type: "incr", key: "n", delta: 2 },
+        ]);
+        assert.equal(committed, true);
+        assert.equal(decode(gdbm.getContent(table, "a")), '{"x":1}');
+        assert.equal(gdbm.hasKey(table, "gone"), false);
+        assert.deepEqual(gdbm.getCounters(table, ["n"]), [2]);
+        assert.equal(fs.existsSync(`${table}.redo`), false);
+    });
+
+    it("applies nothing if an operation cannot be applied", () => {
+        const table = makeTable(dir, "none");
+        gdbm.insertRecord(table, "a", encode("1"));
+        const committed = gdbm.commitBatch(table, [
+            { type: "insert", key: "b", content: encode("2") },
+            { type: "insert", key: "a", content: encode("3") },
+        ]);
+        assert.equal(committed, false);
+        assert.equal(gdbm.hasKey(table, "b"), false);
+        assert.equal(decode(gdbm.getContent(table, "a")), "1");
+    });
+
+    it("fails removing a missing key", () => {
+        const table = makeTable(dir, "missing");
+        const committed = gdbm.commitBatch(table, [
+            { type: "remove", key: "missing" },
+        ]);
+        assert.equal(committed, false);
+    });
+
+    it("rolls an interrupted batch forward before the next read", () => {
+        const table = makeTable(dir, "redo");
+        gdbm.insertRecord(table, "gone", encode("1"));
+        const done = redoFrame([
+            ["S", "k1", "v1"],
+            ["D", "gone", ""],
+        ]);
+        // a frame torn by the crash is ignored
+        const torn = redoFrame([["S", "k2", "v2"]]).subarray(0, 15);
+        fs.writeFileSync(`${table}.redo`, Buffer.concat([done, torn]));
+
+        assert.equal(decode(gdbm.getContent(table, "k1")), "v1");
+        assert.equal(gdbm.hasKey(table, "gone"), false);
+        assert.equal(gdbm.hasKey(table, "k2"), false);
+        assert.equal(fs.existsSync(`${table}.redo`), false);
+    });
+
+    it("rolls a batch forward into a table held by the handle cache", (t) => {
+        const table = makeTable(dir, "cached");
+        gdbm.configureHandleCache(4, 0);
+        t.after(() => gdbm.configureHandleCache(0, 0));
+        gdbm.hasKey(table, "k");
+        fs.writeFileSync(`${table}.redo`, redoFrame([["S", "k", "v"]]));
+
+        assert.equal(decode(gdbm.getContent(table, "k")), "v");
+        assert.equal(fs.existsSync(`${table}.redo`), false);
+    });
+});
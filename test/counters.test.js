@@ -0,0 +1,42 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("counters", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("starts a missing counter at zero and adds the delta", () => {
+        const table = makeTable(dir, "incr");
+        assert.equal(gdbm.incr(table, "hits", 1), 1);
+        assert.equal(gdbm.incr(table, "hits", 41), 42);
+        assert.equal(gdbm.incr(table, "hits", -2), 40);
+    });
+
+    it("gets many counters, undefined for missing ones", () => {
+        const table = makeTable(dir, "get");
+        gdbm.incr(table, "a", 3);
+        assert.deepEqual(gdbm.getCounters(table, ["a", "missing"]), [3, undefined]);
+    });
+
+    it("throws for a missing table", () => {
+        assert.throws(() => gdbm.incr(`${dir}/missing.gdbm`, "a", 1), {
+            code: /^GDBM_ERR_/,
+        });
+    });
+});
@@ -0,0 +1,163 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const crypto = require("node:crypto");
+const { describe, it } = require("node:test");
+const { AuthSessions, DigestAuthProtocol } = require("../src/Auth.js");
+const { registerTable, Users } = require("../src/Credentials.js");
+
+const sha256 = (text) => crypto.createHash("sha256").update(text).digest("hex");
+
+const REALM = "test";
+
+// The parameters a client sends for `password`, see RFC 7616.
+const respond = (params, password) => {
+    const a1 = sha256(`${params.username}:${REALM}:${password}`);
+    const a2 = sha256(`GET:${params.uri}`);
+    const response = sha256(
+        `${a1}:${params.nonce}:${params.nc}:${params.cnonce}:auth:${a2}`
+    );
+    return { ...params, qop: "auth", response };
+};
+
+describe("DigestAuthProtocol", () => {
+    registerTable("accounts", "inmemory", {});
+
+    const makeProtocol = (params) =>
+        new DigestAuthProtocol(
+            {
+                qop: "auth",
+                secretData: "nonce secret",
+                realm: REALM,
+                algorithm: "SHA-256",
+                ...params,
+            },
+            "accounts"
+        );
+
+    const request = (nonce) => ({
+        username: "alice",
+        uri: "/private",
+        nonce,
+        nc: "00000001",
+        cnonce: "client",
+    });
+
+    it("checks its own nonces", (t) => {
+        const protocol = makeProtocol({ nonceMaxAge: 10 });
+        const nonce = protocol.makeNonce();
+        assert.equal(protocol.checkNonce(nonce), "ok");
+
+        assert.equal(makeProtocol().checkNonce(nonce), "invalid");
+        const [timestamp, mac] = nonce.split(".");
+        const older = (parseInt(timestamp, 36) - 1).toString(36);
+        assert.equal(protocol.checkNonce(`${older}.${mac}`), "invalid");
+        assert.equal(protocol.checkNonce("garbage"), "invalid");
+        assert.equal(protocol.checkNonce(undefined), "invalid");
+
+        const now = Date.now();
+        t.mock.method(Date, "now", () => now + 10 * 1000);
+        assert.equal(protocol.checkNonce(nonce), "stale");
+    });
+
+    it("accepts the right password and rejects a wrong one", async () => {
+        await Users.signup("alice", { content: "s3cret", tableName: "accounts" });
+        const protocol = makeProtocol();
+        const params = request(protocol.makeNonce());
+
+        assert.deepEqual(
+            await protocol.verifyParameters("GET", respond(params, "s3cret")),
+            { ok: true, scheme: "Digest" }
+        );
+        assert.deepEqual(
+            await protocol.verifyParameters("GET", respond(params, "wrong")),
+            { ok: false, scheme: "Digest" }
+        );
+        assert.deepEqual(
+            await protocol.verifyParameters(
+                "GET",
+                respond({ ...params, username: "nobody" }, "s3cret")
+            ),
+            { ok: false, scheme: "Digest" }
+        );
+    });
+
+    it("rejects a forged nonce before the password", async () => {
+        const protocol = makeProtocol();
+        const forged = `${Date.now().toString(36)}.${"A".repeat(43)}`;
+        assert.deepEqual(
+            await protocol.verifyParameters(
+                "GET",
+                respond(request(forged), "s3cret")
+            ),
+            { ok: false, scheme: "Digest" }
+        );
+    });
+
+    it("tells a client with a stale nonce to retry", async (t) => {
+        const protocol = makeProtocol({ nonceMaxAge: 1 });
+        const params = request(protocol.makeNonce());
+        const now = Date.now();
+        t.mock.method(Date, "now", () => now + 1000);
+
+        assert.deepEqual(
+            await protocol.verifyParameters("GET", respond(params, "s3cret")),
+            { ok: false, scheme: "Digest", reason: { stale: true } }
+        );
+        // a stale nonce does not tell whether the password was right
+        assert.deepEqual(
+            await protocol.verifyParameters("GET", respond(params, "wrong")),
+            { ok: false, scheme: "Digest" }
+        );
+    });
+
+    it("issues a session for the realm and table", async () => {
+        const sessions = new AuthSessions({ secret: "session secret" });
+        const protocol = makeProtocol({ sessions });
+        const params = request(protocol.makeNonce());
+
+        const result = await protocol.verifyParameters(
+            "GET",
+            respond(params, "s3cret")
+        );
+        assert.equal(result.ok, true);
+        const token = result.setCookie.split(";")[0].split("=")[1];
+        const cookieRequest = {
+            headers: { cookie: [{ value: `alier_session=${token}` }] },
+        };
+        assert.deepEqual(protocol.verifySession(cookieRequest), {
+            ok: true,
+            scheme: "Digest",
+            userId: "alice",
+        });
+        assert.equal(
+            makeProtocol({ sessions, realm: "other" }).verifySession(
+                cookieRequest
+            ),
+            undefined
+        );
+
+        await Users.updateContent("alice", "changed", { tableName: "accounts" });
+        assert.equal(protocol.verifySession(cookieRequest), undefined);
+    });
+
+    it("rejects bad parameters", () => {
+        assert.throws(() => makeProtocol({ secretData: undefined }), TypeError);
+        assert.throws(() => makeProtocol({ qop: undefined }), TypeError);
+        assert.throws(() => makeProtocol({ nonceMaxAge: 0 }), TypeError);
+        assert.throws(() => makeProtocol({ sessions: {} }), TypeError);
+    });
+});
@@ -0,0 +1,66 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { InMemoryCredentialStore } = require("../src/_CredentialsStore.js");
+
+describe("deep-frozen values", () => {
+    it("freezes stored values all the way down", async () => {
+        const store = new InMemoryCredentialStore({});
+        await store.signup("a", { content: { tags: ["x"] }, info: {} });
+        const value = await store.get("a");
+        assert.equal(Object.getPrototypeOf(value), null);
+        assert.ok(Object.isFrozen(value));
+        assert.ok(Object.isFrozen(value.content));
+        assert.ok(Object.isFrozen(value.content.tags));
+    });
+
+    it("stores a value read from the store as is", async () => {
+        const store = new InMemoryCredentialStore({});
+        await store.signup("a", { content: { n: 1 }, info: { role: "x" } });
+        const value = await store.get("a");
+        await store.signup("b", value);
+        assert.equal(await store.get("b"), value);
+    });
+
+    it("copies a shallowly frozen value", async () => {
+        const store = new InMemoryCredentialStore({});
+        const inner = { n: 1 };
+        const value = Object.freeze(
+            Object.assign(Object.create(null), { content: inner })
+        );
+        await store.signup("a", value);
+        const stored = await store.get("a");
+        assert.notEqual(stored.content, inner);
+        assert.ok(Object.isFrozen(stored.content));
+        assert.equal(Object.isFrozen(inner), false);
+    });
+
+    it("shares the branches an update does not touch", async () => {
+        const store = new InMemoryCredentialStore({});
+        await store.signup("a", {
+            content: { profile: { name: "a" }, settings: { theme: "x" } },
+            info: { role: "user" },
+        });
+        const before = await store.get("a");
+        await store.update("a", { content: { settings: { theme: "y" } } }, false);
+        const after = await store.get("a");
+        assert.equal(after.content.settings.theme, "y");
+        assert.equal(after.content.profile, before.content.profile);
+        assert.equal(after.info, before.info);
+        assert.ok(Object.isFrozen(after.content.settings));
+    });
+});
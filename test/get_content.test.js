@@ -0,0 +1,54 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it, after } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("getContent", needsAddon, () => {
+    const dir = makeTempDir();
+
+    after(() => {
+        gdbm?.setCopyThreshold(0);
+    });
+
+    it("gives the same bytes whether they are copied or not", () => {
+        const table = makeTable(dir, "threshold");
+        const big = "x".repeat(5000);
+        gdbm.insertRecord(table, "big", big);
+        gdbm.insertRecord(table, "small", "hi");
+
+        for (const threshold of [0, 1024, 1 << 20]) {
+            gdbm.setCopyThreshold(threshold);
+            const content = gdbm.getContent(table, "big");
+            assert.ok(content instanceof Uint8Array);
+            assert.equal(new TextDecoder().decode(content), big);
+            assert.equal(content.buffer.byteLength, big.length);
+            assert.equal(
+                new TextDecoder().decode(gdbm.getContent(table, "small")),
+                "hi"
+            );
+        }
+    });
+
+    it("gives undefined for a missing key", () => {
+        const table = makeTable(dir, "missing");
+        assert.equal(gdbm.getContent(table, "missing"), undefined);
+    });
+
+    it("rejects a negative threshold", () => {
+        assert.throws(() => gdbm.setCopyThreshold(-1), TypeError);
+    });
+});
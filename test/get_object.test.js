@@ -0,0 +1,84 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("getObject", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("parses into frozen objects without prototype", () => {
+        const table = makeTable(dir, "parse");
+        gdbm.insertRecord(table, "a", '{"s":"é\\u0041","n":-1.5e2,"l":[true,null,{}]}');
+        const value = gdbm.getObject(table, "a");
+        assert.equal(Object.getPrototypeOf(value), null);
+        assert.equal(Object.isFrozen(value), true);
+        assert.equal(Object.isFrozen(value.l[2]), true);
+        // arrays too, as reviverFreezeNullObj makes them
+        assert.deepEqual(JSON.parse(JSON.stringify(value)), {
+            s: "éA",
+            n: -150,
+            l: { 0: true, 1: null, 2: {} },
+        });
+    });
+
+    it("keeps __proto__ as an own property", () => {
+        const table = makeTable(dir, "proto");
+        gdbm.insertRecord(table, "a", '{"__proto__":{"x":1}}');
+        const value = gdbm.getObject(table, "a");
+        assert.deepEqual(Object.keys(value), ["__proto__"]);
+        assert.equal(Object.getPrototypeOf(value), null);
+        assert.equal(value.__proto__.x, 1);
+    });
+
+    it("adds the parsed objects to the frozen set", () => {
+        const table = makeTable(dir, "frozen");
+        gdbm.insertRecord(table, "a", '{"b":{"c":[1]}}');
+        const frozen = new WeakSet();
+        gdbm.setFrozenSet(frozen);
+        const value = gdbm.getObject(table, "a");
+        assert.equal(frozen.has(value), true);
+        assert.equal(frozen.has(value.b), true);
+        assert.equal(frozen.has(value.b.c), true);
+    });
+
+    it("gives undefined for a missing key and null for empty content", () => {
+        const table = makeTable(dir, "missing");
+        gdbm.insertRecord(table, "empty", "");
+        assert.equal(gdbm.getObject(table, "missing"), undefined);
+        assert.equal(gdbm.getObject(table, "empty"), null);
+    });
+
+    it("throws on invalid JSON", () => {
+        const table = makeTable(dir, "invalid");
+        gdbm.insertRecord(table, "a", '{"a":}');
+        assert.throws(() => gdbm.getObject(table, "a"), {
+            code: "ERR_INVALID_JSON",
+        });
+    });
+
+    it("parses many records", () => {
+        const table = makeTable(dir, "many");
+        gdbm.insertRecord(table, "a", "1");
+        gdbm.insertRecord(table, "b", '"x"');
+        assert.deepEqual(gdbm.getObjects(table, ["a", "missing", "b"]), [
+            1,
+            undefined,
+            "x",
+        ]);
+    });
+});
@@ -0,0 +1,56 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("getString", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("decodes the content as UTF-8", () => {
+        const table = makeTable(dir, "one");
+        gdbm.insertRecord(table, "a", "héllo 🙂");
+        assert.equal(gdbm.getString(table, "a"), "héllo 🙂");
+    });
+
+    it("gives undefined for a missing key", () => {
+        const table = makeTable(dir, "missing");
+        assert.equal(gdbm.getString(table, "missing"), undefined);
+    });
+
+    it("gets many strings in the order of the keys", () => {
+        const table = makeTable(dir, "many");
+        gdbm.insertRecord(table, "a", "1");
+        gdbm.insertRecord(table, "b", "2");
+        assert.deepEqual(gdbm.getStrings(table, ["b", "missing", "a"]), [
+            "2",
+            undefined,
+            "1",
+        ]);
+    });
+
+    it("gets siblings with a suffix", () => {
+        const table = makeTable(dir, "suffix");
+        gdbm.insertRecord(table, "a", "{}", [
+            { suffix: "info", content: new TextEncoder().encode("i") },
+        ]);
+        assert.deepEqual(gdbm.getStrings(table, ["a", "b"], "info"), [
+            "i",
+            undefined,
+        ]);
+    });
+});
@@ -0,0 +1,90 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const { spawn } = require("node:child_process");
+const { once } = require("node:events");
+const { afterEach, describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("handle cache", needsAddon, () => {
+    const dir = makeTempDir();
+
+    afterEach(() => gdbm.configureHandleCache(0, 0));
+
+    it("keeps files open between calls", () => {
+        const table = makeTable(dir, "hits");
+        gdbm.configureHandleCache(2, 0);
+        const before = gdbm.getHandleCacheStats();
+        gdbm.hasKey(table, "a");
+        gdbm.hasKey(table, "a");
+        const after = gdbm.getHandleCacheStats();
+        assert.equal(after.misses - before.misses, 1);
+        assert.equal(after.hits - before.hits, 1);
+        assert.equal(after.openHandles, 1);
+    });
+
+    it("closes the least recently used file beyond the limit", () => {
+        const tables = ["lru1", "lru2", "lru3"].map((name) => makeTable(dir, name));
+        gdbm.configureHandleCache(2, 0);
+        for (const table of tables) {
+            gdbm.hasKey(table, "a");
+        }
+        assert.equal(gdbm.getHandleCacheStats().openHandles, 2);
+    });
+
+    it("closes idle files on a sweep", async () => {
+        const table = makeTable(dir, "idle");
+        gdbm.configureHandleCache(2, 1);
+        gdbm.hasKey(table, "a");
+        await new Promise((resolve) => setTimeout(resolve, 5));
+        gdbm.sweepHandleCache();
+        assert.equal(gdbm.getHandleCacheStats().openHandles, 0);
+    });
+
+    it("does not keep a file that failed to open", () => {
+        gdbm.configureHandleCache(2, 0);
+        const missing = `${dir}/later.gdbm`;
+        assert.throws(() => gdbm.hasKey(missing, "a"), { code: /^GDBM_ERR_/ });
+        assert.equal(gdbm.getHandleCacheStats().openHandles, 0);
+        gdbm.createTable(missing, 0);
+        assert.equal(gdbm.hasKey(missing, "a"), false);
+    });
+
+    it("gives up a locked file quickly on the main thread", async () => {
+        const table = makeTable(dir, "locked");
+        gdbm.insertRecord(table, "a", "1");
+        // another process keeps the file open as a writer for a while
+        const addon = require.resolve("../build/Release/gdbm_binding.node");
+        const child = spawn(process.execPath, [
+            "-e",
+            `const gdbm = require(${JSON.stringify(addon)});
+            gdbm.configureHandleCache(1, 0);
+            gdbm.hasKey(${JSON.stringify(table)}, "a");
+            console.log("locked");
+            setTimeout(() => {}, 300);`,
+        ]);
+        const exited = once(child, "exit");
+        await once(child.stdout, "data");
+
+        const start = Date.now();
+        assert.throws(() => gdbm.hasKey(table, "a"), { code: /^GDBM_ERR_/ });
+        assert.ok(Date.now() - start < 100);
+        // worker threads wait for the lock
+        assert.equal(await gdbm.preloadKeys(table, ["a"]), 1);
+        await exited;
+    });
+});
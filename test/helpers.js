@@ -0,0 +1,68 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const fs = require("node:fs");
+const os = require("node:os");
+const path = require("node:path");
+const { after } = require("node:test");
+
+let gdbm;
+try {
+    gdbm = require("../build/Release/gdbm_binding");
+} catch (e) {
+    if (e.code !== "MODULE_NOT_FOUND") {
+        throw e;
+    }
+}
+
+/**
+ * Test options skipping tests of the native addon when it is not built.
+ */
+const needsAddon = {
+    skip: gdbm === undefined ? "the native addon is not built" : false,
+};
+
+/**
+ * Make a directory removed after the tests of the file.
+ * @returns {string}
+ */
+function makeTempDir() {
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), "alier-test-"));
+    after(() => fs.rmSync(dir, { recursive: true, force: true }));
+    return dir;
+}
+
+/**
+ * Create an empty GDBM table in `dir`.
+ * @param {string} dir
+ * @param {string} name
+ * @returns {string} The path of the table.
+ */
+function makeTable(dir, name) {
+    const filepath = path.join(dir, `${name}.gdbm`);
+    gdbm.createTable(filepath, 0);
+    return filepath;
+}
+
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+
+/** @param {string} text */
+const encode = (text) => encoder.encode(text);
+/** @param {Uint8Array} bytes */
+const decode = (bytes) => decoder.decode(bytes);
+
+module.exports = { gdbm, needsAddon, makeTempDir, makeTable, encode, decode };
@@ -0,0 +1,155 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const fsPromises = require("node:fs/promises");
+const { describe, it } = require("node:test");
+const { makeTempDir } = require("./helpers.js");
+const { JsonCachedCredentialStore } = require("../src/_CredentialsStore.js");
+
+describe("JsonCachedCredentialStore group flush", () => {
+    const dir = makeTempDir();
+
+    const open = (name, flushDelay) =>
+        new JsonCachedCredentialStore({ name, dirpath: dir, flushDelay });
+
+    // Count the appends to the journal of `name` and let `append` run them.
+    const mockAppend = (t, name, append) => {
+        const original = fsPromises.appendFile;
+        const calls = [];
+        t.mock.method(fsPromises, "appendFile", (file, data, options) => {
+            if (file !== `${dir}/${name}.json.log`) {
+                return original(file, data, options);
+            }
+            calls.push(String(data));
+            return append(calls.length, () => original(file, data, options));
+        });
+        return calls;
+    };
+
+    it("appends the writes within the delay together", async (t) => {
+        const calls = mockAppend(t, "group", (_, append) => append());
+        const store = open("group", 20);
+        const first = store.signup("a", { n: 1 });
+        await new Promise((resolve) => setTimeout(resolve, 5));
+        const results = await Promise.all([
+            first,
+            store.signup("b", { n: 2 }),
+            store.update("a", { n: 3 }, false),
+        ]);
+        assert.deepEqual(results, [true, true, true]);
+        assert.equal(calls.length, 1);
+        assert.equal(calls[0].split("\n").length - 1, 3);
+        assert.equal((await open("group").get("a")).n, 3);
+    });
+
+    it("fails every write of a failed append", async (t) => {
+        mockAppend(t, "fail", () => Promise.reject(new Error("disk full")));
+        const store = open("fail");
+        const results = await Promise.all([
+            store.signup("a", { n: 1 }),
+            store.signup("b", { n: 2 }),
+        ]);
+        assert.deepEqual(results, [false, false]);
+        assert.equal(await store.has("a"), false);
+        assert.equal(await store.has("b"), false);
+    });
+
+    it("keeps the next batch when rolling a failed one back", async (t) => {
+        let fail;
+        mockAppend(t, "rollback", (call, append) => {
+            if (call === 1) {
+                return new Promise((_, reject) => {
+                    fail = () => reject(new Error("disk full"));
+                });
+            }
+            return append();
+        });
+        const store = open("rollback");
+        const first = store.signup("a", { n: 1 });
+        while (fail === undefined) {
+            await new Promise((resolve) => setImmediate(resolve));
+        }
+        // the first batch is being appended, so this starts the next one
+        const second = store.signup("b", { n: 2 });
+        await new Promise((resolve) => setImmediate(resolve));
+        fail();
+
+        assert.equal(await first, false);
+        assert.equal(await second, true);
+        assert.equal(await store.has("a"), false);
+        assert.equal((await store.get("b")).n, 2);
+        const reopened = open("rollback");
+        assert.equal(await reopened.has("a"), false);
+        assert.equal((await reopened.get("b")).n, 2);
+    });
+
+    it("does not compact writes whose append fails", async (t) => {
+        const store = open("compact", 50);
+        assert.equal(await store.signup("a", { n: 1 }), true);
+        mockAppend(t, "compact", () =>
+            new Promise((_, reject) => {
+                setTimeout(() => reject(new Error("disk full")), 20);
+            })
+        );
+        // still waiting for its flush when the compaction takes the values
+        const write = store.signup("b", { n: 2 });
+        await new Promise((resolve) => setImmediate(resolve));
+        await assert.rejects(store.compact(), { message: "disk full" });
+
+        assert.equal(await write, false);
+        assert.equal(await store.has("b"), false);
+        // the old journal is kept for the next compaction
+        assert.equal(fs.existsSync(`${dir}/compact.json.log.1`), true);
+        const reopened = open("compact");
+        assert.equal((await reopened.get("a")).n, 1);
+        assert.equal(await reopened.has("b"), false);
+    });
+
+    it("rolls a failed append back during a compaction", async (t) => {
+        const store = open("compacting");
+        assert.equal(await store.signup("a", { n: 1 }), true);
+        let fail;
+        mockAppend(t, "compacting", (call, append) => {
+            if (call === 1) {
+                return new Promise((_, reject) => {
+                    fail = () => reject(new Error("disk full"));
+                });
+            }
+            return append();
+        });
+        const first = store.signup("x", { n: 0 });
+        while (fail === undefined) {
+            await new Promise((resolve) => setImmediate(resolve));
+        }
+        // the compaction waits for the append, and the next batch for both
+        const compaction = store.compact();
+        const second = store.signup("b", { n: 2 });
+        await new Promise((resolve) => setImmediate(resolve));
+        fail();
+
+        assert.equal(await first, false);
+        assert.equal(await second, true);
+        await compaction;
+        assert.equal(fs.existsSync(`${dir}/compacting.json.log.1`), false);
+        const file = JSON.parse(fs.readFileSync(`${dir}/compacting.json`, "utf-8"));
+        assert.deepEqual(Object.keys(file).sort(), ["a", "b"]);
+        assert.equal(await store.has("x"), false);
+        const reopened = open("compacting");
+        assert.equal(await reopened.has("x"), false);
+        assert.equal((await reopened.get("b")).n, 2);
+    });
+});
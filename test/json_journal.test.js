@@ -0,0 +1,93 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const { describe, it } = require("node:test");
+const { makeTempDir } = require("./helpers.js");
+const { JsonCachedCredentialStore } = require("../src/_CredentialsStore.js");
+
+describe("JsonCachedCredentialStore journal", () => {
+    const dir = makeTempDir();
+
+    const open = (name) => new JsonCachedCredentialStore({ name, dirpath: dir });
+
+    it("replays the journal on open", async () => {
+        const store = open("replay");
+        assert.equal(await store.signup("a", { n: 1 }), true);
+        assert.equal(await store.signup("b", { n: 2 }), true);
+        assert.equal(await store.update("a", { n: 3 }, false), true);
+        assert.equal(await store.remove("b"), true);
+        assert.equal(fs.existsSync(`${dir}/replay.json`), false);
+        assert.ok(fs.statSync(`${dir}/replay.json.log`).size > 0);
+
+        const reopened = open("replay");
+        assert.equal((await reopened.get("a")).n, 3);
+        assert.equal(await reopened.has("b"), false);
+        assert.equal(reopened.size, 1);
+    });
+
+    it("cuts a torn last line off the journal", async () => {
+        const store = open("torn");
+        await store.signup("a", { n: 1 });
+        const journal = `${dir}/torn.json.log`;
+        const length = fs.statSync(journal).size;
+        fs.appendFileSync(journal, '[["b",{"n":');
+
+        const reopened = open("torn");
+        assert.equal((await reopened.get("a")).n, 1);
+        assert.equal(await reopened.has("b"), false);
+        assert.equal(fs.statSync(journal).size, length);
+        // later lines are not appended to the torn one
+        await reopened.signup("c", { n: 3 });
+        assert.equal((await open("torn").get("c")).n, 3);
+    });
+
+    it("moves the journal to .log.1 while compacting", async () => {
+        const store = open("rotate");
+        await store.signup("a", { n: 1 });
+        const compaction = store.compact();
+        const write = store.signup("b", { n: 2 });
+        await compaction;
+        assert.equal(await write, true);
+
+        assert.equal(fs.existsSync(`${dir}/rotate.json.log.1`), false);
+        const file = JSON.parse(fs.readFileSync(`${dir}/rotate.json`, "utf-8"));
+        assert.equal(file.a.n, 1);
+        // the write made during the compaction went to the new journal
+        assert.match(fs.readFileSync(`${dir}/rotate.json.log`, "utf-8"), /"b"/);
+
+        const reopened = open("rotate");
+        assert.equal((await reopened.get("a")).n, 1);
+        assert.equal((await reopened.get("b")).n, 2);
+    });
+
+    it("finishes an interrupted compaction on open", async () => {
+        const store = open("interrupted");
+        await store.signup("a", { n: 1 });
+        await store.compact();
+        await store.signup("b", { n: 2 });
+        // as if the process died after moving the journal aside
+        fs.renameSync(`${dir}/interrupted.json.log`, `${dir}/interrupted.json.log.1`);
+        fs.writeFileSync(`${dir}/interrupted.json.log`, '[["c",{"n":3}]]\n');
+
+        const reopened = open("interrupted");
+        assert.equal(fs.existsSync(`${dir}/interrupted.json.log.1`), false);
+        assert.equal(fs.existsSync(`${dir}/interrupted.json.log`), false);
+        const file = JSON.parse(fs.readFileSync(`${dir}/interrupted.json`, "utf-8"));
+        assert.deepEqual(Object.keys(file).sort(), ["a", "b", "c"]);
+        assert.equal((await reopened.get("c")).n, 3);
+    });
+});
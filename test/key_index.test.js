@@ -0,0 +1,95 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+} = require("./helpers.js");
+
+describe("key index", needsAddon, () => {
+    const dir = makeTempDir();
+
+    const makeKeys = (name) => {
+        const table = makeTable(dir, name);
+        for (const key of ["b", "a", "ab", "c", "abc"]) {
+            gdbm.insertRecord(table, key, "{}");
+        }
+        return table;
+    };
+
+    it("lists keys in order by prefix and range", () => {
+        const table = makeKeys("query");
+        gdbm.openKeyIndex(table);
+        try {
+            assert.deepEqual(gdbm.queryKeys(table, {}, 10), [
+                "a",
+                "ab",
+                "abc",
+                "b",
+                "c",
+            ]);
+            assert.deepEqual(gdbm.queryKeys(table, { prefix: "a" }, 10), [
+                "a",
+                "ab",
+                "abc",
+            ]);
+            assert.deepEqual(
+                gdbm.queryKeys(table, { gt: "a", lte: "b" }, 10),
+                ["ab", "abc", "b"]
+            );
+            assert.deepEqual(gdbm.queryKeys(table, {}, 2), ["a", "ab"]);
+        } finally {
+            gdbm.closeKeyIndex(table);
+        }
+    });
+
+    it("follows writes and leaves siblings out", () => {
+        const table = makeKeys("writes");
+        gdbm.openKeyIndex(table);
+        try {
+            gdbm.insertRecord(table, "aa", "{}", [
+                { suffix: "info", content: encode("{}") },
+            ]);
+            gdbm.upsert(table, "d", "{}");
+            gdbm.removeRecord(table, "b");
+            assert.deepEqual(gdbm.queryKeys(table, {}, 10), [
+                "a",
+                "aa",
+                "ab",
+                "abc",
+                "c",
+                "d",
+            ]);
+        } finally {
+            gdbm.closeKeyIndex(table);
+        }
+    });
+
+    it("fails to query a closed index", () => {
+        const table = makeKeys("closed");
+        assert.throws(() => gdbm.queryKeys(table, {}, 10), {
+            message: "Key index is not open",
+        });
+        gdbm.openKeyIndex(table);
+        assert.equal(gdbm.closeKeyIndex(table), true);
+        assert.equal(gdbm.closeKeyIndex(table), false);
+        assert.throws(() => gdbm.queryKeys(table, {}, 10));
+    });
+});
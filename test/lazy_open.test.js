@@ -0,0 +1,84 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+const { GdbmCredentialStore } = require("../src/_CredentialsStore.js");
+
+describe("lazy open", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("creates a table on a worker thread", async () => {
+        const table = `${dir}/async.gdbm`;
+        await gdbm.createTableAsync(table, 0);
+        gdbm.insertRecord(table, "a", "1");
+        // opening an existing table keeps its records
+        await gdbm.createTableAsync(table, 0);
+        assert.equal(gdbm.getString(table, "a"), "1");
+    });
+
+    it("preloads the keys that exist", async () => {
+        const table = makeTable(dir, "preload");
+        gdbm.insertRecord(table, "a", "1");
+        gdbm.insertRecord(table, "b", "2");
+        assert.equal(await gdbm.preloadKeys(table, ["a", "b", "missing"]), 2);
+        assert.equal(await gdbm.preloadKeys(table, []), 0);
+    });
+
+    it("rejects a missing table or directory", async () => {
+        await assert.rejects(gdbm.preloadKeys(`${dir}/missing.gdbm`, ["a"]), {
+            code: "GDBM_ERR_3",
+        });
+        await assert.rejects(gdbm.createTableAsync(`${dir}/no/dir.gdbm`, 0), {
+            code: "GDBM_ERR_3",
+        });
+        assert.throws(() => gdbm.createTableAsync(`${dir}/bad.gdbm`, -1), RangeError);
+    });
+
+    it("opens the store on first use and saves the recent keys", async () => {
+        const options = { name: "users", dirpath: dir, lazyOpen: true, preloadKeys: 2 };
+        const store = new GdbmCredentialStore(options);
+        assert.equal(fs.existsSync(`${dir}/users.gdbm`), false);
+        await store.signup("a", { n: 1 });
+        await store.signup("b", { n: 2 });
+        await store.signup("c", { n: 3 });
+        await store.get("a");
+        store.close();
+        const recent = JSON.parse(fs.readFileSync(`${dir}/users.gdbm.mru`, "utf-8"));
+        assert.deepEqual(recent, ["c", "a"]);
+
+        const reopened = new GdbmCredentialStore(options);
+        await reopened.ready();
+        assert.equal((await reopened.get("c")).n, 3);
+        assert.equal(reopened.size, 3);
+        reopened.close();
+    });
+
+    it("fails every call while the table cannot be created", async () => {
+        const store = new GdbmCredentialStore({
+            name: "users",
+            dirpath: `${dir}/no/dir`,
+            lazyOpen: true,
+        });
+        await assert.rejects(store.ready(), { code: "GDBM_ERR_3" });
+        await assert.rejects(store.ready(), { code: "GDBM_ERR_3" });
+        assert.throws(
+            () => new GdbmCredentialStore({ name: "x", dirpath: dir, preloadKeys: -1 }),
+            TypeError
+        );
+    });
+});
@@ -0,0 +1,94 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+} = require("./helpers.js");
+
+describe("table maintenance", needsAddon, () => {
+    const dir = makeTempDir();
+
+    const fill = (table) => {
+        for (let i = 0; i < 50; i++) {
+            gdbm.insertRecord(table, `k${i}`, "v".repeat(i), [
+                { suffix: "info", content: encode("s") },
+            ]);
+        }
+    };
+
+    const sum = (bins) => bins.reduce((total, count) => total + count, 0);
+
+    it("counts records, siblings and sizes", async () => {
+        const table = makeTable(dir, "analyze");
+        fill(table);
+        const stats = await gdbm.analyzeTable(table);
+        assert.equal(stats.records, 50);
+        assert.equal(stats.siblings, 50);
+        assert.equal(sum(stats.keySizes), 100);
+        assert.equal(sum(stats.valueSizes), 100);
+        assert.equal(stats.multiBlockRecords, 0);
+        assert.ok(stats.fileSize > 0);
+    });
+
+    it("rebuilds a table with another block size", async () => {
+        const table = makeTable(dir, "rebuild");
+        fill(table);
+        await gdbm.rebuildTable(table, 1024);
+        assert.equal((await gdbm.analyzeTable(table)).blockSize, 1024);
+        assert.equal(gdbm.countRecords(table), 50);
+        assert.equal(gdbm.getString(table, "k10"), "v".repeat(10));
+        assert.deepEqual(
+            gdbm.getSibling(table, "k10", "info"),
+            encode("s")
+        );
+    });
+
+    it("rebuilds a table whose handle is cached", async () => {
+        const table = makeTable(dir, "cached");
+        fill(table);
+        gdbm.configureHandleCache(2, 0);
+        try {
+            gdbm.hasKey(table, "k1");
+            await gdbm.rebuildTable(table, 1024);
+            assert.equal(gdbm.getString(table, "k1"), "v");
+            gdbm.insertRecord(table, "new", "1");
+            assert.equal(gdbm.countRecords(table), 51);
+        } finally {
+            gdbm.configureHandleCache(0, 0);
+        }
+    });
+
+    it("rejects a bad block size and a missing table", async () => {
+        const table = makeTable(dir, "errors");
+        assert.throws(() => gdbm.rebuildTable(table, 0), RangeError);
+        await assert.rejects(gdbm.analyzeTable(`${dir}/missing.gdbm`), {
+            code: "GDBM_ERR_3",
+        });
+    });
+
+    it("cleans a table", () => {
+        const table = makeTable(dir, "clean");
+        fill(table);
+        gdbm.cleanTable(table, 0);
+        assert.equal(gdbm.countRecords(table), 0);
+        assert.equal(gdbm.hasKey(table, "k1"), false);
+    });
+});
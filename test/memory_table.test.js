@@ -0,0 +1,71 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+    decode,
+} = require("./helpers.js");
+
+describe("memory tables", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("serves the file from memory and logs writes", () => {
+        const table = makeTable(dir, "log");
+        gdbm.insertRecord(table, "before", encode("1"));
+        gdbm.openMemoryTable(table, false);
+        try {
+            assert.equal(decode(gdbm.getContent(table, "before")), "1");
+            gdbm.insertRecord(table, "after", encode("2"));
+            assert.equal(decode(gdbm.getContent(table, "after")), "2");
+            assert.ok(fs.statSync(`${table}.log`).size > 0);
+        } finally {
+            gdbm.closeMemoryTable(table);
+        }
+        // the log is replayed over the file on the next open
+        gdbm.openMemoryTable(table, false);
+        try {
+            assert.equal(decode(gdbm.getContent(table, "after")), "2");
+        } finally {
+            gdbm.closeMemoryTable(table);
+        }
+    });
+
+    it("empties the log with a snapshot", () => {
+        const table = makeTable(dir, "snapshot");
+        gdbm.openMemoryTable(table, true);
+        try {
+            gdbm.insertRecord(table, "a", encode("1"));
+            assert.equal(gdbm.snapshotMemoryTable(table), true);
+            assert.equal(fs.statSync(`${table}.log`).size, 0);
+        } finally {
+            gdbm.closeMemoryTable(table);
+        }
+        assert.equal(decode(gdbm.getContent(table, "a")), "1");
+    });
+
+    it("reports a table that is not open", () => {
+        const table = makeTable(dir, "closed");
+        assert.equal(gdbm.closeMemoryTable(table), false);
+        assert.equal(gdbm.snapshotMemoryTable(table), false);
+    });
+});
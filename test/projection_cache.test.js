@@ -0,0 +1,135 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { needsAddon, makeTempDir } = require("./helpers.js");
+const { registerTable, Users } = require("../src/Credentials.js");
+
+describe("projection cache", () => {
+    registerTable("cached", "inmemory", {}, { role: "user" });
+    const options = { tableName: "cached" };
+    const projection = { name: true };
+
+    const project = (userId) => Users.getContent(userId, { ...options, projection });
+
+    const signup = (userId) =>
+        Users.signup(userId, { ...options, content: { name: userId, n: 0 } });
+
+    it("returns the same object until the user is written", async () => {
+        await signup("a");
+        const first = await project("a");
+        assert.deepEqual({ ...first }, { name: "a" });
+        assert.ok(Object.isFrozen(first));
+        assert.equal(await project("a"), first);
+        // another projection is cached apart
+        const other = await Users.getContent("a", {
+            ...options,
+            projection: { n: true },
+        });
+        assert.equal(other.n, 0);
+        assert.equal(await project("a"), first);
+    });
+
+    const writes = {
+        updateContent: (userId) =>
+            Users.updateContent(userId, { name: "new" }, options),
+        updateContents: async (userId) =>
+            (
+                await Users.updateContents(
+                    [{ userId, content: { name: "new" } }],
+                    options
+                )
+            )[0],
+        deleteContent: (userId) =>
+            Users.deleteContent(userId, { ...options, projection: { n: true } }),
+        setUserInfo: (userId) =>
+            Users.setUserInfo(userId, { role: "admin" }, options),
+        commitBatch: (userId) =>
+            Users.commitBatch(
+                [{ type: "updateContent", userId, content: { name: "new" } }],
+                options
+            ),
+        removeUser: (userId) => Users.removeUser(userId, options),
+    };
+
+    for (const [name, write] of Object.entries(writes)) {
+        it(`is invalidated by ${name}`, async () => {
+            const userId = `by-${name}`;
+            await signup(userId);
+            await signup(`${userId}-other`);
+            const before = await project(userId);
+            const other = await project(`${userId}-other`);
+
+            assert.equal(await write(userId), true);
+            const after = await project(userId);
+            assert.notEqual(after, before);
+            if (name === "removeUser") {
+                assert.equal(after, undefined);
+            } else if (name === "deleteContent" || name === "setUserInfo") {
+                assert.equal(after.name, userId);
+            } else {
+                assert.equal(after.name, "new");
+            }
+            // other users stay cached
+            assert.equal(await project(`${userId}-other`), other);
+        });
+    }
+
+    it("keeps counter writes from invalidating", async () => {
+        await signup("counted");
+        const before = await project("counted");
+        await Users.incrementCounter("counted", "logins", 1, options);
+        await Users.commitBatch(
+            [{ type: "resetCounter", userId: "counted", counterName: "logins" }],
+            options
+        );
+        assert.equal(await project("counted"), before);
+    });
+
+    it("evicts the least recently used users beyond its size", async () => {
+        registerTable("lru", "inmemory", {});
+        const lru = { tableName: "lru", projection };
+        const limit = 1024;
+        const userIds = Array.from({ length: limit + 1 }, (_, i) => `u${i}`);
+        await Users.signupMany(
+            userIds.map((userId) => ({ userId, content: { name: userId } })),
+            { tableName: "lru" }
+        );
+        const cached = [];
+        for (const userId of userIds.slice(0, limit)) {
+            cached.push(await Users.getContent(userId, lru));
+        }
+        // the first user is used again, so the second one is the oldest
+        assert.equal(await Users.getContent(userIds[0], lru), cached[0]);
+        await Users.getContent(userIds[limit], lru);
+        assert.equal(await Users.getContent(userIds[0], lru), cached[0]);
+        assert.equal(await Users.getContent(userIds[2], lru), cached[2]);
+        assert.notEqual(await Users.getContent(userIds[1], lru), cached[1]);
+    });
+});
+
+describe("projection cache of GDBM files", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("is not used, as other processes may write the file", async () => {
+        registerTable("file", "gdbm", { name: "file", dirpath: dir });
+        const options = { tableName: "file", projection: { name: true } };
+        await Users.signup("a", { tableName: "file", content: { name: "a" } });
+        const first = await Users.getContent("a", options);
+        assert.equal(first.name, "a");
+        assert.notEqual(await Users.getContent("a", options), first);
+    });
+});
@@ -0,0 +1,65 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+describe("readInto", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("copies the content at the offset and returns its length", () => {
+        const table = makeTable(dir, "offset");
+        gdbm.insertRecord(table, "a", "hello");
+        const target = new Uint8Array(8);
+        assert.equal(gdbm.readInto(table, "a", target, 2), 5);
+        assert.deepEqual(
+            Array.from(target),
+            [0, 0, 104, 101, 108, 108, 111, 0]
+        );
+    });
+
+    it("returns the length without copying if the target is short", () => {
+        const table = makeTable(dir, "short");
+        gdbm.insertRecord(table, "a", "hello");
+        const target = new Uint8Array(3);
+        assert.equal(gdbm.readInto(table, "a", target, 0), 5);
+        assert.deepEqual(Array.from(target), [0, 0, 0]);
+    });
+
+    it("reads a sibling with a suffix", () => {
+        const table = makeTable(dir, "suffix");
+        gdbm.insertRecord(table, "a", "{}", [
+            { suffix: "info", content: new TextEncoder().encode("ok") },
+        ]);
+        const target = new Uint8Array(2);
+        assert.equal(gdbm.readInto(table, "a", target, 0, "info"), 2);
+        assert.equal(new TextDecoder().decode(target), "ok");
+    });
+
+    it("returns -1 for a missing key", () => {
+        const table = makeTable(dir, "missing");
+        assert.equal(gdbm.readInto(table, "a", new Uint8Array(4), 0), -1);
+    });
+
+    it("rejects an offset past the end of the target", () => {
+        const table = makeTable(dir, "range");
+        gdbm.insertRecord(table, "a", "hello");
+        assert.throws(
+            () => gdbm.readInto(table, "a", new Uint8Array(4), 5),
+            RangeError
+        );
+    });
+});
@@ -0,0 +1,139 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+} = require("./helpers.js");
+const { GdbmCredentialStore } = require("../src/_CredentialsStore.js");
+
+describe("scan", needsAddon, () => {
+    const dir = makeTempDir();
+
+    const makeUsers = (name) => {
+        const table = makeTable(dir, name);
+        for (let i = 0; i < 5; i++) {
+            gdbm.insertRecord(table, `u${i}`, JSON.stringify({ age: 20 + i }), [
+                {
+                    suffix: "info",
+                    content: encode(JSON.stringify({ admin: i % 2 === 1 })),
+                },
+            ]);
+        }
+        return table;
+    };
+
+    const keysOf = (page) => page.entries.map(([key]) => key).sort();
+
+    it("lists every record without a predicate", async () => {
+        const table = makeUsers("all");
+        const page = await gdbm.scan(table, null, [], 10, 100);
+        assert.deepEqual(keysOf(page), ["u0", "u1", "u2", "u3", "u4"]);
+        assert.equal(page.cursor, undefined);
+        const entry = page.entries.find(([key]) => key === "u2");
+        assert.equal(entry[1].age, 22);
+    });
+
+    it("filters by the main record and its siblings", async () => {
+        const table = makeUsers("filter");
+        const range = { path: ["age"], range: { gte: 22 } };
+        const admin = { record: 1, path: ["admin"], equals: true };
+
+        const page = await gdbm.scan(table, range, ["info"], 10, 100);
+        assert.deepEqual(keysOf(page), ["u2", "u3", "u4"]);
+        for (const [, , info] of page.entries) {
+            assert.equal(typeof info.admin, "boolean");
+        }
+
+        const both = await gdbm.scan(
+            table,
+            { and: [range, admin] },
+            ["info"],
+            10,
+            100
+        );
+        assert.deepEqual(keysOf(both), ["u3"]);
+    });
+
+    it("pages through the table with a cursor", async () => {
+        const table = makeUsers("pages");
+        const keys = [];
+        let cursor;
+        do {
+            const page = await gdbm.scan(table, null, [], 2, 100, cursor);
+            assert.ok(page.entries.length <= 2);
+            keys.push(...page.entries.map(([key]) => key));
+            cursor = page.cursor;
+        } while (cursor !== undefined);
+        assert.deepEqual(keys.sort(), ["u0", "u1", "u2", "u3", "u4"]);
+    });
+
+    it("throws on a malformed predicate", () => {
+        const table = makeUsers("invalid");
+        assert.throws(() => gdbm.scan(table, { bogus: 1 }, [], 10, 100), {
+            name: "TypeError",
+            message: "Invalid predicate",
+        });
+        // record 2 needs a second sibling suffix
+        const sibling = { record: 2, path: ["a"], equals: 1 };
+        assert.throws(
+            () => gdbm.scan(table, sibling, ["info"], 10, 100),
+            TypeError
+        );
+    });
+
+    it("rejects a missing table", async () => {
+        await assert.rejects(
+            gdbm.scan(`${dir}/missing.gdbm`, null, [], 10, 100),
+            { code: "GDBM_ERR_3" }
+        );
+    });
+
+    it("pages through the keys without reading the records", async () => {
+        const table = makeUsers("keys");
+        // not JSON, which a scan of the records would reject
+        gdbm.insertRecord(table, "raw", "{");
+        const keys = [];
+        let cursor;
+        do {
+            const page = await gdbm.scanKeys(table, 2, cursor);
+            assert.ok(page.keys.length <= 2);
+            keys.push(...page.keys);
+            cursor = page.cursor;
+        } while (cursor !== undefined);
+        assert.deepEqual(keys.sort(), ["raw", "u0", "u1", "u2", "u3", "u4"]);
+
+        const page = await gdbm.scanKeys(table, 1);
+        gdbm.removeRecord(table, page.cursor, ["info"]);
+        await assert.rejects(gdbm.scanKeys(table, 1, page.cursor), {
+            code: "ERR_SCAN_CURSOR",
+        });
+        assert.throws(() => gdbm.scanKeys(table, 0), RangeError);
+    });
+
+    it("lists the keys of a store without a key index", async () => {
+        const store = new GdbmCredentialStore({ name: "listed", dirpath: dir });
+        for (const key of ["b2", "a1", "b1", "c1"]) {
+            await store.signup(key, { n: 1 });
+        }
+        assert.deepEqual(await store.listKeys({ prefix: "b" }), ["b1", "b2"]);
+        assert.deepEqual(await store.listKeys({ gt: "b1" }, 2), ["b2", "c1"]);
+    });
+});
@@ -0,0 +1,156 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { AuthSessions } = require("../src/Auth.js");
+const { registerTable, Users } = require("../src/Credentials.js");
+
+const tick = () => new Promise((resolve) => setTimeout(resolve, 2));
+
+describe("AuthSessions", () => {
+    registerTable("people", "inmemory", {}, { role: "user" });
+    registerTable("admins", "inmemory", {});
+
+    const sessions = new AuthSessions({ secret: "test secret", maxAge: 60 });
+    const scope = { tableName: "people", realm: "app" };
+
+    it("accepts a token issued for the scope", () => {
+        const { token, cookie } = sessions.issue("alice", scope);
+        assert.ok(cookie.startsWith(`alier_session=${token}; Max-Age=60;`));
+        const session = sessions.verify(token, scope);
+        assert.equal(session?.userId, "alice");
+        // the first table is the default one
+        assert.equal(sessions.verify(token, { realm: "app" })?.userId, "alice");
+    });
+
+    it("rejects a forged token", () => {
+        const { token } = sessions.issue("alice", scope);
+        const parts = token.split(".");
+        parts[1] = Buffer.from("mallory").toString("base64url");
+        assert.equal(sessions.verify(parts.join("."), scope), undefined);
+
+        const other = new AuthSessions({ secret: "other secret" });
+        assert.equal(other.verify(token, scope), undefined);
+        assert.equal(sessions.verify("v2.garbage", scope), undefined);
+        assert.equal(sessions.verify(undefined, scope), undefined);
+    });
+
+    it("rejects a token for another table or realm", () => {
+        const { token } = sessions.issue("alice", scope);
+        assert.equal(
+            sessions.verify(token, { tableName: "admins", realm: "app" }),
+            undefined
+        );
+        assert.equal(
+            sessions.verify(token, { tableName: "people", realm: "other" }),
+            undefined
+        );
+    });
+
+    it("rejects an expired token", (t) => {
+        const { token } = sessions.issue("alice", scope);
+        const now = Date.now();
+        t.mock.method(Date, "now", () => now + 60 * 1000);
+        assert.equal(sessions.verify(token, scope), undefined);
+    });
+
+    it("rejects a revoked token", () => {
+        const first = sessions.issue("alice", scope).token;
+        const second = sessions.issue("alice", scope).token;
+        assert.equal(sessions.revoke(first, scope), true);
+        assert.equal(sessions.revoke(first, scope), false);
+        assert.equal(sessions.verify(first, scope), undefined);
+        assert.equal(sessions.verify(second, scope)?.userId, "alice");
+    });
+
+    it("rejects tokens issued before the user was revoked", async () => {
+        const before = sessions.issue("bob", scope).token;
+        const admin = sessions.issue("bob", { tableName: "admins" }).token;
+        sessions.revokeUser("bob", "people");
+        await tick();
+        const after = sessions.issue("bob", scope).token;
+        assert.equal(sessions.verify(before, scope), undefined);
+        assert.equal(sessions.verify(after, scope)?.userId, "bob");
+        // the same user id in another table keeps its tokens
+        assert.equal(
+            sessions.verify(admin, { tableName: "admins" })?.userId,
+            "bob"
+        );
+    });
+
+    it("revokes the tokens of a user written through Users", async () => {
+        await Users.signup("carol", { tableName: "people" });
+        await Users.signup("dave", { tableName: "people" });
+        const carol = sessions.issue("carol", scope).token;
+        const dave = sessions.issue("dave", scope).token;
+
+        assert.equal(
+            await Users.setUserInfo("carol", { role: "admin" }, {
+                tableName: "people",
+            }),
+            true
+        );
+        assert.equal(sessions.verify(carol, scope), undefined);
+        assert.equal(sessions.verify(dave, scope)?.userId, "dave");
+
+        await Users.removeUser("dave", { tableName: "people" });
+        assert.equal(sessions.verify(dave, scope), undefined);
+    });
+
+    it("keeps the tokens of a user whose counters change", async () => {
+        await Users.signup("erin", { tableName: "people" });
+        const token = sessions.issue("erin", scope).token;
+        assert.equal(
+            await Users.commitBatch(
+                [
+                    { type: "incrementCounter", userId: "erin", counterName: "n" },
+                    { type: "resetCounter", userId: "erin", counterName: "m" },
+                ],
+                { tableName: "people" }
+            ),
+            true
+        );
+        assert.equal(sessions.verify(token, scope)?.userId, "erin");
+
+        await Users.commitBatch(
+            [{ type: "updateContent", userId: "erin", content: 1 }],
+            { tableName: "people" }
+        );
+        assert.equal(sessions.verify(token, scope), undefined);
+    });
+
+    it("stops revoking tokens once closed", async () => {
+        const closed = new AuthSessions({ secret: "test secret", maxAge: 60 });
+        await Users.signup("frank", { tableName: "people" });
+        const token = closed.issue("frank", scope).token;
+        closed.close();
+        await Users.setUserInfo("frank", { role: "admin" }, {
+            tableName: "people",
+        });
+        assert.equal(closed.verify(token, scope)?.userId, "frank");
+        // the other sessions still follow the writes
+        assert.equal(sessions.verify(token, scope), undefined);
+    });
+
+    it("rejects bad parameters", () => {
+        assert.throws(() => new AuthSessions({}), TypeError);
+        assert.throws(() => new AuthSessions({ secret: "" }), TypeError);
+        assert.throws(
+            () => new AuthSessions({ secret: "s", maxAge: 0 }),
+            TypeError
+        );
+    });
+});
@@ -0,0 +1,97 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { spawnSync } = require("node:child_process");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir, makeTable } = require("./helpers.js");
+
+const SHARED_SIZE = 1 << 20;
+
+// Run `body` in another Node process with `gdbm` and `table` in scope.
+const runChild = (table, body, options) => {
+    const addon = require.resolve("../build/Release/gdbm_binding.node");
+    const script = [
+        `const gdbm = require(${JSON.stringify(addon)});`,
+        `const table = ${JSON.stringify(table)};`,
+        body,
+    ].join("\n");
+    const result = spawnSync(process.execPath, ["-e", script], {
+        encoding: "utf8",
+        ...options,
+    });
+    if (options?.timeout === undefined) {
+        assert.equal(result.status, 0, result.stderr);
+    }
+    return result.stdout.trim();
+};
+
+describe("shared memory tables", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("shares records between processes", () => {
+        const table = makeTable(dir, "shared");
+        gdbm.insertRecord(table, "file", "0");
+        gdbm.openMemoryTable(table, false, SHARED_SIZE);
+        try {
+            gdbm.insertRecord(table, "parent", "1");
+            const seen = runChild(
+                table,
+                `gdbm.openMemoryTable(table, false, ${SHARED_SIZE});
+                console.log(gdbm.getString(table, "file"),
+                    gdbm.getString(table, "parent"));
+                gdbm.insertRecord(table, "child", "2");
+                gdbm.closeMemoryTable(table);`
+            );
+            assert.equal(seen, "0 1");
+            assert.equal(gdbm.getString(table, "child"), "2");
+            assert.equal(gdbm.snapshotMemoryTable(table), true);
+        } finally {
+            gdbm.closeMemoryTable(table);
+        }
+        assert.equal(gdbm.getString(table, "child"), "2");
+    });
+
+    it("stays usable after a writer is killed", () => {
+        const table = makeTable(dir, "killed");
+        gdbm.openMemoryTable(table, false, SHARED_SIZE);
+        try {
+            gdbm.insertRecord(table, "kept", "1");
+            runChild(
+                table,
+                `gdbm.openMemoryTable(table, false, ${SHARED_SIZE});
+                for (let i = 0; ; i++) {
+                    gdbm.upsert(table, \`k\${i % 100}\`, String(i));
+                }`,
+                { timeout: 200, killSignal: "SIGKILL" }
+            );
+            assert.equal(gdbm.getString(table, "kept"), "1");
+            assert.ok(gdbm.hasKey(table, "k0"));
+            gdbm.upsert(table, "after", "2");
+            assert.equal(gdbm.getString(table, "after"), "2");
+        } finally {
+            gdbm.closeMemoryTable(table);
+        }
+    });
+
+    it("rejects a negative size", () => {
+        const table = makeTable(dir, "negative");
+        assert.throws(
+            () => gdbm.openMemoryTable(table, false, -1),
+            RangeError
+        );
+        assert.equal(gdbm.closeMemoryTable(table), false);
+    });
+});
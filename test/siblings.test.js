@@ -0,0 +1,113 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+    decode,
+} = require("./helpers.js");
+const { GdbmCredentialStore } = require("../src/_CredentialsStore.js");
+
+describe("sibling records", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("inserts and reads siblings apart from the record", () => {
+        const table = makeTable(dir, "insert");
+        const inserted = gdbm.insertRecord(table, "u", encode("{}"), [
+            { suffix: "info", content: encode('{"role":"admin"}') },
+        ]);
+        assert.equal(inserted, true);
+        assert.equal(decode(gdbm.getSibling(table, "u", "info")), '{"role":"admin"}');
+        assert.equal(decode(gdbm.getContent(table, "u")), "{}");
+        // siblings are not counted as records
+        assert.equal(gdbm.countRecords(table), 1);
+    });
+
+    it("sets and removes a sibling", () => {
+        const table = makeTable(dir, "set");
+        gdbm.insertRecord(table, "u", encode("{}"));
+        gdbm.setSibling(table, "u", "info", encode("1"));
+        assert.equal(decode(gdbm.getSibling(table, "u", "info")), "1");
+        gdbm.setSibling(table, "u", "info", null);
+        assert.equal(gdbm.getSibling(table, "u", "info"), undefined);
+    });
+
+    it("gives undefined for a missing sibling", () => {
+        const table = makeTable(dir, "missing");
+        assert.equal(gdbm.getSibling(table, "nobody", "info"), undefined);
+    });
+
+    it("removes the siblings with the record", () => {
+        const table = makeTable(dir, "remove");
+        gdbm.insertRecord(table, "u", encode("{}"), [
+            { suffix: "info", content: encode("1") },
+        ]);
+        assert.equal(gdbm.removeRecord(table, "u", ["info"]), true);
+        assert.equal(gdbm.getSibling(table, "u", "info"), undefined);
+        assert.equal(gdbm.removeRecord(table, "u", ["info"]), false);
+    });
+});
+
+describe("sibling fields of the store", needsAddon, () => {
+    const dir = makeTempDir();
+    const store = new GdbmCredentialStore({ name: "users", dirpath: dir });
+    const table = `${dir}/users.gdbm`;
+
+    it("updates the record and the sibling together", async () => {
+        await store.signup("u", { n: 1, info: { role: "user" } });
+        assert.equal(
+            await store.update("u", { n: 2, info: { role: "admin" } }, true),
+            true
+        );
+        const value = await store.get("u");
+        assert.equal(value.n, 2);
+        assert.equal(value.info.role, "admin");
+        assert.equal(decode(gdbm.getContent(table, "u")), '{"n":2}');
+    });
+
+    it("writes no sibling for a missing record", async () => {
+        assert.equal(
+            await store.update("gone", { info: { role: "admin" } }, true),
+            false
+        );
+        assert.equal(gdbm.getSibling(table, "gone", "info"), undefined);
+    });
+
+    it("deletes from the record and the sibling together", async () => {
+        await store.signup("d", { n: 1, info: { role: "user", x: 1 } });
+        assert.equal(await store.delete("d", { n: true, info: { x: true } }), true);
+        const value = await store.get("d");
+        assert.equal(value.n, undefined);
+        assert.deepEqual({ ...value.info }, { role: "user" });
+        // nothing is deleted if the sibling is missing
+        await store.signup("e", { n: 1 });
+        assert.equal(await store.delete("e", { n: true, info: { x: true } }), false);
+        assert.equal((await store.get("e")).n, 1);
+    });
+
+    it("removes the siblings with the whole value", async () => {
+        await store.signup("w", { n: 1, info: { role: "user" } });
+        assert.equal(await store.delete("w"), true);
+        assert.equal(gdbm.getSibling(table, "w", "info"), undefined);
+        assert.equal(await store.has("w"), true);
+        assert.equal(await store.delete("missing"), false);
+    });
+});
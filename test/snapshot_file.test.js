@@ -0,0 +1,61 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const { describe, it } = require("node:test");
+const { gdbm, needsAddon, makeTempDir } = require("./helpers.js");
+
+describe("snapshot files", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("maps the written keys and values", () => {
+        const file = `${dir}/users.snapshot`;
+        gdbm.writeSnapshotFile(file, ["b", "a", "é"], ["2", "1", "ü"]);
+        assert.equal(gdbm.openSnapshotFile(file), 3);
+        try {
+            assert.equal(gdbm.getSnapshotString(file, "a"), "1");
+            assert.equal(gdbm.getSnapshotString(file, "é"), "ü");
+            assert.equal(gdbm.getSnapshotString(file, "missing"), undefined);
+            assert.equal(gdbm.hasSnapshotKey(file, "b"), true);
+            assert.equal(gdbm.hasSnapshotKey(file, "missing"), false);
+            assert.deepEqual(gdbm.listSnapshotKeys(file), ["a", "b", "é"]);
+        } finally {
+            assert.equal(gdbm.closeSnapshotFile(file), true);
+        }
+        assert.equal(gdbm.closeSnapshotFile(file), false);
+        assert.throws(() => gdbm.getSnapshotString(file, "a"), {
+            message: "Snapshot file is not open",
+        });
+    });
+
+    it("rejects keys and values of different lengths", () => {
+        assert.throws(
+            () => gdbm.writeSnapshotFile(`${dir}/odd.snapshot`, ["a"], ["1", "2"]),
+            TypeError
+        );
+    });
+
+    it("fails to open a missing or corrupt file", () => {
+        assert.throws(() => gdbm.openSnapshotFile(`${dir}/missing.snapshot`), {
+            code: "GDBM_ERR_3",
+        });
+        const corrupt = `${dir}/corrupt.snapshot`;
+        fs.writeFileSync(corrupt, "not a snapshot file");
+        assert.throws(() => gdbm.openSnapshotFile(corrupt), {
+            code: "GDBM_ERR_7",
+        });
+    });
+});
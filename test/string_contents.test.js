@@ -0,0 +1,63 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const {
+    gdbm,
+    needsAddon,
+    makeTempDir,
+    makeTable,
+    encode,
+    decode,
+} = require("./helpers.js");
+
+describe("string contents", needsAddon, () => {
+    const dir = makeTempDir();
+
+    it("stores strings as UTF-8 like encoded contents", () => {
+        const table = makeTable(dir, "insert");
+        assert.equal(gdbm.insertRecord(table, "s", '{"name":"é"}'), true);
+        assert.equal(gdbm.insertRecord(table, "b", encode('{"name":"é"}')), true);
+        assert.deepEqual(gdbm.getContent(table, "s"), gdbm.getContent(table, "b"));
+    });
+
+    it("does not insert over an existing record", () => {
+        const table = makeTable(dir, "exists");
+        gdbm.insertRecord(table, "a", "1");
+        assert.equal(gdbm.insertRecord(table, "a", "2"), false);
+        assert.equal(decode(gdbm.getContent(table, "a")), "1");
+    });
+
+    it("updates with a string", () => {
+        const table = makeTable(dir, "update");
+        gdbm.insertRecord(table, "a", "1");
+        gdbm.updateContent(table, "a", "2");
+        assert.equal(decode(gdbm.getContent(table, "a")), "2");
+    });
+
+    it("throws updating a missing key", () => {
+        const table = makeTable(dir, "missing");
+        assert.throws(() => gdbm.updateContent(table, "missing", "1"), {
+            code: /^GDBM_ERR_/,
+        });
+    });
+
+    it("rejects contents that are neither strings nor bytes", () => {
+        const table = makeTable(dir, "bad");
+        assert.throws(() => gdbm.insertRecord(table, "a", 1), TypeError);
+    });
+});
@@ -0,0 +1,112 @@
+/*
+Copyright 2024 Suredesigns Corp.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+const assert = require("node:assert/strict");
+const { describe, it } = require("node:test");
+const { registerTable, Users } = require("../src/Credentials.js");
+
+describe("Users batch calls", () => {
+    registerTable("batch", "inmemory", {}, { role: "user" });
+    const options = { tableName: "batch" };
+
+    it("signs up many users, each on its own", async () => {
+        assert.equal(await Users.signup("taken", options), true);
+        assert.deepEqual(
+            await Users.signupMany(
+                [
+                    { userId: "a", content: { n: 1 } },
+                    { userId: "taken", content: { n: 0 } },
+                    { userId: "b" },
+                ],
+                options
+            ),
+            [true, false, true]
+        );
+        assert.equal((await Users.getContent("a", options)).n, 1);
+        assert.equal(await Users.getContent("b", options), null);
+        assert.equal(await Users.getContent("taken", options), null);
+        assert.equal((await Users.getUserInfo("b", options)).role, "user");
+    });
+
+    it("gets many contents in order", async () => {
+        await Users.signupMany(
+            [
+                { userId: "c", content: { n: 1, secret: "x" } },
+                { userId: "d", content: { n: 2, secret: "y" } },
+            ],
+            options
+        );
+        const contents = await Users.getContents(["d", "missing", "c"], options);
+        assert.deepEqual(
+            contents.map((content) => content?.n),
+            [2, undefined, 1]
+        );
+        assert.deepEqual(
+            (
+                await Users.getContents(["c", "d"], {
+                    ...options,
+                    projection: { n: true },
+                })
+            ).map((content) => ({ ...content })),
+            [{ n: 1 }, { n: 2 }]
+        );
+        assert.deepEqual(
+            await Users.getContents(["c"], {
+                ...options,
+                projection: { nothing: true },
+            }),
+            [undefined]
+        );
+    });
+
+    it("updates many contents, each on its own", async () => {
+        await Users.signupMany(
+            [
+                { userId: "e", content: { n: 1 } },
+                { userId: "f", content: { n: 1 } },
+            ],
+            options
+        );
+        assert.deepEqual(
+            await Users.updateContents(
+                [
+                    { userId: "e", content: { n: 2 } },
+                    { userId: "missing", content: { n: 2 } },
+                    { userId: "f", content: { m: 3 } },
+                ],
+                options
+            ),
+            [true, false, true]
+        );
+        assert.equal((await Users.getContent("e", options)).n, 2);
+        assert.deepEqual({ ...(await Users.getContent("f", options)) }, {
+            n: 1,
+            m: 3,
+        });
+        assert.equal(await Users.exists("missing", options), false);
+    });
+
+    it("rejects user ids that are not strings", async () => {
+        await assert.rejects(
+            Users.signupMany([{ userId: 1 }], options),
+            TypeError
+        );
+        await assert.rejects(Users.getContents(["a", null], options), TypeError);
+        await assert.rejects(
+            Users.updateContents([{ content: 1 }], options),
+            TypeError
+        );
+    });
+});